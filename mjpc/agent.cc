@@ -23,6 +23,7 @@
 #include <sstream>
 #include <string>
 #include <string_view>
+#include <thread>
 #include <utility>
 
 #include <absl/container/flat_hash_map.h>
@@ -70,6 +71,7 @@ Agent::Agent(const mjModel* model, std::shared_ptr<Task> task)
 // initialize data, settings, planners, state
 void Agent::Initialize(const mjModel* model) {
   // ----- model ----- //
+  UnregisterResiduals();
   mjModel* old_model = model_;
   model_ = mj_copyModel(nullptr, model);  // agent's copy of model
 
@@ -86,8 +88,14 @@ void Agent::Initialize(const mjModel* model) {
     mju_error("Ctrl limits required for all actuators.\n");
   }
 
-  // planner
-  planner_ = GetNumberOrDefault(0, model, "agent_planner");
+  // planner, discarding a pending switch
+  {
+    std::unique_lock<std::mutex> lock = FinishPlannerSwitch();
+    next_planner_.store(-1);
+    planner_ = GetNumberOrDefault(0, model, "agent_planner");
+    gui_planner_id = planner_;
+    planner_allocated_.assign(planners_.size(), 0);
+  }
 
   // estimator
   estimator_ =
@@ -109,17 +117,27 @@ void Agent::Initialize(const mjModel* model) {
   active_task_id_ = gui_task_id;
   ActiveTask()->Reset(model);
 
+  // shared Jacobians, entries keyed by the previous model are stale
+  derivative_cache_.Clear();
+
   // initialize planner
   for (const auto& planner : planners_) {
+    planner->derivative_cache = &derivative_cache_;
+    planner->data_arena = &data_arena_;
     planner->Initialize(model_, *ActiveTask());
   }
 
+  // mjData of the previous model. planners lease the per-thread data when
+  // they plan, so none holds it while another is prepared for a switch.
+  data_arena_.Clear();
+
   // initialize state
   state.Initialize(model);
 
   // initialize estimator
   if (reset_estimator && estimator_enabled) {
     for (const auto& estimator : estimators_) {
+      estimator->derivative_cache = &derivative_cache_;
       estimator->Initialize(model_);
       estimator->Reset();
     }
@@ -153,6 +171,9 @@ void Agent::Initialize(const mjModel* model) {
   planner_threads_ =
       std::max(1, NumAvailableHardwareThreads() - 3 - 2 * estimator_threads_);
 
+  // residual dispatch for the new models
+  RegisterResiduals();
+
   // delete the previous model after all the planners have been updated to use
   // the new one.
   if (old_model) {
@@ -160,11 +181,37 @@ void Agent::Initialize(const mjModel* model) {
   }
 }
 
+void Agent::RegisterResiduals() {
+  // rollouts on the planning model use the planning residual when set
+  RegisterResidual(model_, ActiveTask(), /*planning=*/true);
+  residual_models_.push_back(model_);
+
+  // estimators simulate their own model copies
+  if (estimator_enabled) {
+    for (const auto& estimator : estimators_) {
+      const mjModel* estimator_model = estimator->Model();
+      if (estimator_model && estimator_model != model_) {
+        RegisterResidual(estimator_model, ActiveTask());
+        residual_models_.push_back(estimator_model);
+      }
+    }
+  }
+}
+
+void Agent::UnregisterResiduals() {
+  for (const mjModel* model : residual_models_) {
+    UnregisterResidual(model);
+  }
+  residual_models_.clear();
+}
+
 // allocate memory
 void Agent::Allocate() {
-  // planner
-  for (const auto& planner : planners_) {
-    planner->Allocate();
+  {
+    // active planner, the others are allocated when switched to
+    std::unique_lock<std::mutex> lock = FinishPlannerSwitch();
+    ActivePlanner().Allocate();
+    planner_allocated_[planner_] = 1;
   }
 
   // state
@@ -179,13 +226,23 @@ void Agent::Allocate() {
 
 // reset data, settings, planners, state
 void Agent::Reset(const double* initial_repeated_action) {
-  // planner
-  for (const auto& planner : planners_) {
-    planner->Reset(kMaxTrajectoryHorizon, initial_repeated_action);
+  {
+    // allocated planners, including the active one
+    std::unique_lock<std::mutex> lock = FinishPlannerSwitch();
+    if (!planner_allocated_[planner_]) {
+      ActivePlanner().Allocate();
+      planner_allocated_[planner_] = 1;
+    }
+    for (int i = 0; i < planners_.size(); i++) {
+      if (planner_allocated_[i]) {
+        planners_[i]->Reset(kMaxTrajectoryHorizon, initial_repeated_action);
+      }
+    }
   }
 
   // state
   state.Reset();
+  planned_planner_ = -1;
 
   // estimator
   if (reset_estimator && estimator_enabled) {
@@ -268,6 +325,17 @@ void Agent::SetTaskList(std::vector<std::shared_ptr<Task>> tasks) {
 }
 
 void Agent::PlanIteration(ThreadPool* pool) {
+  PlanIteration(pool, PlanningBudget());
+}
+
+double Agent::PlanningBudget() const {
+  if (budget_sim_time && planning_budget > 0.0) {
+    return realtime_rate > 0.0 ? planning_budget / realtime_rate : 0.0;
+  }
+  return planning_budget;
+}
+
+void Agent::PlanIteration(ThreadPool* pool, double budget) {
   // start agent timer
   auto agent_start = std::chrono::steady_clock::now();
 
@@ -279,19 +347,48 @@ void Agent::PlanIteration(ThreadPool* pool) {
   steps_ =
       mju_max(mju_min(horizon_ / timestep_ + 1, kMaxTrajectoryHorizon), 1);
 
+  // activate a prepared planner, unless a switch is being requested
+  if (next_planner_.load() >= 0) {
+    std::unique_lock<std::mutex> lock(planner_switch_mutex_, std::try_to_lock);
+    int next = lock.owns_lock() ? next_planner_.exchange(-1) : -1;
+    if (next >= 0) {
+      // warm start from the active planner's policy
+      const Trajectory* best = ActivePlanner().BestTrajectory();
+      if (best && planned_planner_ == planner_) {
+        planners_[next]->WarmStart(*best);
+      }
+
+      // hand over the per-thread data
+      data_arena_.Lease(&planners_[next]->data_);
+      planner_ = next;
+    }
+  }
+
   // plan
   if (!allocate_enabled) {
+    // the policy is already optimized for this state
+    if (plan_enabled && !plan_unchanged_state && planned_planner_ == planner_ &&
+        planned_sequence_ == state.Sequence()) {
+      return;
+    }
+
     // set state
     ActivePlanner().SetState(state);
 
     // copy the task's residual function parameters into a new object, which
     // remains constant during planning and doesn't require locking from the
-    // rollout threads
-    residual_fn_ = ActiveTask()->Residual();
+    // rollout threads, which evaluate it directly
+    Task* task = ActiveTask();
+    residual_fn_ = task->Residual();
+    task->SetPlanningResidual(residual_fn_.get());
 
     if (plan_enabled) {
-      // planner policy
+      // planner policy, within the budget
+      ActivePlanner().StartBudget(agent_start, budget);
       ActivePlanner().OptimizePolicy(steps_, *pool);
+      ActivePlanner().StopBudget();
+      planned_sequence_ = ActivePlanner().StateSequence();
+      planned_planner_ = planner_;
 
       // compute time
       agent_compute_time_ =
@@ -310,6 +407,7 @@ void Agent::PlanIteration(ThreadPool* pool) {
     }
 
     // release the planning residual function
+    task->SetPlanningResidual(nullptr);
     residual_fn_.reset();
   }
 }
@@ -328,6 +426,34 @@ void Agent::Plan(std::atomic<bool>& exitrequest,
   }  // exitrequest sent -- stop planning
 }
 
+void Agent::SetPlanner(int index) {
+  if (index < 0 || index >= planners_.size()) {
+    mju_error("Agent: invalid planner %d", index);
+  }
+  std::lock_guard<std::mutex> lock(planner_switch_mutex_);
+
+  // wait for a previous switch to be prepared, then replace it
+  if (planner_switch_thread_.joinable()) planner_switch_thread_.join();
+  next_planner_.store(-1);
+  gui_planner_id = index;
+  if (index == planner_) return;
+
+  // allocate and reset without blocking the planning thread
+  int allocate = !planner_allocated_[index];
+  planner_allocated_[index] = 1;
+  planner_switch_thread_ = std::thread([this, index, allocate]() {
+    if (allocate) planners_[index]->Allocate();
+    planners_[index]->Reset(kMaxTrajectoryHorizon);
+    next_planner_.store(index);
+  });
+}
+
+std::unique_lock<std::mutex> Agent::FinishPlannerSwitch() {
+  std::unique_lock<std::mutex> lock(planner_switch_mutex_);
+  if (planner_switch_thread_.joinable()) planner_switch_thread_.join();
+  return lock;
+}
+
 void Agent::RunBeforeStep(StepJob job) {
   std::lock_guard<std::mutex> lock(step_jobs_mutex_);
   step_jobs_.push_back(std::move(job));
@@ -650,7 +776,7 @@ void Agent::GUI(mjUI& ui) {
   // ----- agent ----- //
   mjuiDef defAgent[] = {{mjITEM_SECTION, "Agent", 1, nullptr, "AP"},
                         {mjITEM_BUTTON, "Reset", 2, nullptr, " #459"},
-                        {mjITEM_SELECT, "Planner", 2, &planner_, ""},
+                        {mjITEM_SELECT, "Planner", 2, &gui_planner_id, ""},
                         {mjITEM_SELECT, "Estimator", 2, &estimator_, ""},
                         {mjITEM_CHECKINT, "Plan", 2, &plan_enabled, ""},
                         {mjITEM_CHECKINT, "Action", 2, &action_enabled, ""},
@@ -684,8 +810,8 @@ void Agent::GUI(mjUI& ui) {
   // add agent
   mjui_add(&ui, defAgent);
 
-  // planner
-  ActivePlanner().GUI(ui);
+  // planner, or the planner being switched to
+  planners_[gui_planner_id]->GUI(ui);
 
   // estimator
   if (ActiveEstimatorIndex() > 0) {
@@ -730,11 +856,14 @@ void Agent::AgentEvent(mjuiItem* it, mjData* data,
       break;
     case 1:  // planner change
       if (model_) {
+        // switch without interrupting planning
+        this->SetPlanner(gui_planner_id);
+
         // reset plots
         this->PlotInitialize();
         this->PlotReset();
 
-        // reset agent
+        // reload GUI
         uiloadrequest.fetch_sub(1);
       }
       break;
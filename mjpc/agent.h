@@ -16,15 +16,18 @@
 #define MJPC_AGENT_H_
 
 #include <atomic>
+#include <cstdint>
 #include <deque>
 #include <memory>
 #include <mutex>
 #include <string>
 #include <string_view>
+#include <thread>
 #include <vector>
 
 #include <absl/functional/any_invocable.h>
 #include <mujoco/mujoco.h>
+#include "mjpc/derivatives.h"
 #include "mjpc/estimators/include.h"
 #include "mjpc/planners/include.h"
 #include "mjpc/states/state.h"
@@ -53,6 +56,8 @@ class Agent {
 
   // destructor
   ~Agent() {
+    FinishPlannerSwitch();
+    UnregisterResiduals();
     if (model_) mj_deleteModel(model_);  // we made a copy in Initialize
   }
 
@@ -67,9 +72,23 @@ class Agent {
   // reset data, settings, planners, states
   void Reset(const double* initial_repeated_action = nullptr);
 
-  // single planner iteration
+  // single planner iteration, within planning_budget
   void PlanIteration(ThreadPool* pool);
 
+  // single planner iteration within a wall-clock budget (seconds), unlimited
+  // if not positive. the planner scales its work to the budget and keeps the
+  // best policy found so far.
+  void PlanIteration(ThreadPool* pool, double budget);
+
+  // switches to planner index while the active planner keeps planning. the
+  // planner is allocated on first use and reset on a background thread, then
+  // the next planning iteration warm starts it from the active planner's best
+  // trajectory and makes it active. other planners are not reallocated.
+  void SetPlanner(int index);
+
+  // wall-clock budget (seconds) for a planner iteration from planning_budget
+  double PlanningBudget() const;
+
   // call planner to update nominal policy
   void Plan(std::atomic<bool>& exitrequest, std::atomic<int>& uiloadrequest);
 
@@ -177,6 +196,18 @@ class Agent {
   int allocate_enabled;
   int plot_enabled;
   int gui_task_id = 0;
+  int gui_planner_id = 0;
+
+  // planning budget per iteration (seconds), unlimited if not positive. with
+  // budget_sim_time the budget is simulation time, converted to wall-clock
+  // time with realtime_rate (simulation seconds per wall-clock second).
+  double planning_budget = 0.0;
+  bool budget_sim_time = false;
+  double realtime_rate = 1.0;
+
+  // when false, planner iterations are skipped while neither the state nor
+  // the planner changed since the last optimized policy
+  bool plan_unchanged_state = true;
 
   // state
   mjpc::State state;
@@ -188,6 +219,10 @@ class Agent {
   bool estimator_enabled = false;
 
  private:
+  // register the planning and estimator models for residual dispatch
+  void RegisterResiduals();
+  void UnregisterResiduals();
+
   // model
   mjModel* model_ = nullptr;
 
@@ -211,14 +246,38 @@ class Agent {
   // residual function for the active task, updated once per planning iteration
   std::unique_ptr<ResidualFn> residual_fn_;
 
+  // models registered for residual dispatch (planning model, estimators)
+  std::vector<const mjModel*> residual_models_;
+
+  // per-thread mjData shared by the planners, outlives them
+  mjpc::MjDataArena data_arena_;
+
   // planners
   std::vector<std::unique_ptr<mjpc::Planner>> planners_;
   int planner_;
 
+  // planners with memory for the current model, only the planners that were
+  // active are allocated
+  std::vector<int> planner_allocated_;
+
+  // planner switch, prepared on planner_switch_thread_. next_planner_ is the
+  // prepared planner, -1 if none.
+  std::mutex planner_switch_mutex_;
+  std::thread planner_switch_thread_;
+  std::atomic_int next_planner_ = -1;
+
+  // waits for the preparation of a planner switch and returns the held
+  // planner_switch_mutex_, which guards planner_ and planner_allocated_
+  // against SetPlanner
+  std::unique_lock<std::mutex> FinishPlannerSwitch();
+
   // estimators
   std::vector<std::unique_ptr<mjpc::Estimator>> estimators_;
   int estimator_;
 
+  // Jacobians shared between planners and estimators
+  mjpc::DerivativeCache derivative_cache_;
+
   // task queue for RunBeforeStep
   std::mutex step_jobs_mutex_;
   std::deque<StepJob> step_jobs_;
@@ -234,6 +293,10 @@ class Agent {
   // planning iterations counter
   std::atomic_int count_;
 
+  // state snapshot and planner of the last optimized policy
+  std::uint64_t planned_sequence_ = 0;
+  int planned_planner_ = -1;
+
   // names
   char task_names_[1024];
   char planner_names_[1024];
@@ -108,20 +108,10 @@ void sensor(const mjModel* m, mjData* d, int stage);
 
 // sensor callback
 void sensor(const mjModel* model, mjData* data, int stage) {
-  if (stage == mjSTAGE_ACC) {
-    if (!sim->agent->allocate_enabled && sim->uiloadrequest.load() == 0) {
-      if (sim->agent->IsPlanningModel(model)) {
-        // the planning thread and rollout threads don't need
-        // synchronization when using PlanningResidual.
-        const mjpc::ResidualFn* residual = sim->agent->PlanningResidual();
-        residual->Residual(model, data, data->sensordata);
-      } else {
-        // this residual is used by the physics thread and the UI thread (for
-        // plots), and is run with a shared lock, to safely run with changes to
-        // weights and parameters
-        sim->agent->ActiveTask()->Residual(model, data, data->sensordata);
-      }
-    }
+  // tasks and their registered models change while the agent is reallocated
+  // or a model is loading
+  if (!sim->agent->allocate_enabled && sim->uiloadrequest.load() == 0) {
+    mjpc::ResidualSensorCallback(model, data, stage);
   }
 }
 
@@ -241,6 +231,10 @@ void PhysicsLoop(mj::Simulate& sim) {
         }
         sim.agent->PlotInitialize();
 
+        // residual dispatch for the new physics model
+        mjpc::UnregisterResidual(m);
+        mjpc::RegisterResidual(mnew, sim.agent->ActiveTask());
+
         sim.Load(mnew, dnew, sim.filename, true);
         m = mnew;
         d = dnew;
@@ -437,6 +431,9 @@ MjpcApp::MjpcApp(std::vector<std::shared_ptr<mjpc::Task>> tasks, int task_id) {
   sim->agent->Reset();
   sim->agent->PlotInitialize();
 
+  // residuals of the physics model are evaluated by the active task
+  mjpc::RegisterResidual(m, sim->agent->ActiveTask());
+
   sim->agent->plan_enabled = absl::GetFlag(FLAGS_planner_enabled);
 
   // Get the index of the closest sim percentage to the input.
@@ -0,0 +1,899 @@
+// Copyright 2024 DeepMind Technologies Limited
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "mjpc/derivatives.h"
+
+#include <algorithm>
+#include <vector>
+
+#include <mujoco/mujoco.h>
+
+namespace mjpc {
+
+namespace {
+
+// true if x0 and x1 are both in range
+bool InRange(double x0, double x1, const double* range) {
+  return x0 >= range[0] && x0 <= range[1] && x1 >= range[0] &&
+         x1 <= range[1];
+}
+
+// deviation of transition outputs from nominal outputs
+void TransitionDeviation(const mjModel* m, const mjData* d,
+                         const double* nominal, double* deviation) {
+  // dimensions
+  int nq = m->nq, nv = m->nv, na = m->na, ns = m->nsensordata;
+  int ndx = 2 * nv + na;
+  int nstate = nq + nv + na;
+
+  // state
+  mj_differentiatePos(m, deviation, 1.0, nominal, d->qpos);
+  mju_sub(deviation + nv, d->qvel, nominal + nq, nv);
+  mju_sub(deviation + 2 * nv, d->act, nominal + nq + nv, na);
+
+  // sensors
+  mju_sub(deviation + ndx, d->sensordata, nominal + nstate, ns);
+}
+
+// inverse dynamics outputs: force (nv), sensors (nsensordata)
+void InverseOutput(const mjModel* m, mjData* d, int skipstage, bool skipsensor,
+                   bool flg_actuation, double* output) {
+  mj_inverseSkip(m, d, skipstage, skipsensor);
+  mju_copy(output, d->qfrc_inverse, m->nv);
+  if (flg_actuation) {
+    mj_fwdActuation(m, d);
+    mju_subFrom(output, d->qfrc_actuator, m->nv);
+  }
+  mju_copy(output + m->nv, d->sensordata, m->nsensordata);
+}
+
+}  // namespace
+
+// compute islands from model structure and contacts in data
+void DerivativeColoring::Compute(const mjModel* m, const mjData* d,
+                                 int sensor_begin, int sensor_end) {
+  // dimensions
+  int nbody = m->nbody, nv = m->nv, nu = m->nu, na = m->na;
+  rootid_ = m->body_rootid;
+
+  // union-find over kinematic trees
+  parent_.resize(nbody);
+  for (int i = 0; i < nbody; i++) {
+    parent_[i] = i;
+  }
+
+  // degrees of freedom per tree
+  tree_dof_.assign(nbody, 0);
+  for (int i = 0; i < nv; i++) {
+    tree_dof_[rootid_[m->dof_bodyid[i]]]++;
+  }
+
+  // deformable objects couple all trees
+  bool coupled = m->nflex > 0;
+
+  // tendons
+  tendon_body_.resize(m->ntendon);
+  for (int i = 0; i < m->ntendon; i++) {
+    tendon_body_[i] = 0;
+    int adr = m->tendon_adr[i];
+    for (int j = 0; j < m->tendon_num[i]; j++) {
+      int type = m->wrap_type[adr + j];
+      int id = m->wrap_objid[adr + j];
+      int body = -1;
+      if (type == mjWRAP_JOINT) {
+        body = m->jnt_bodyid[id];
+      } else if (type == mjWRAP_SITE) {
+        body = m->site_bodyid[id];
+      } else if (type == mjWRAP_SPHERE || type == mjWRAP_CYLINDER) {
+        body = m->geom_bodyid[id];
+      }
+      if (body < 0) continue;
+      Merge(tendon_body_[i], body);
+      if (tree_dof_[rootid_[tendon_body_[i]]] == 0) tendon_body_[i] = body;
+    }
+  }
+
+  // actuator transmissions
+  actuator_body_.resize(nu);
+  for (int i = 0; i < nu; i++) {
+    int id0 = m->actuator_trnid[2 * i];
+    int id1 = m->actuator_trnid[2 * i + 1];
+    int body = 0;
+    int other = 0;
+    switch (m->actuator_trntype[i]) {
+      case mjTRN_JOINT:
+      case mjTRN_JOINTINPARENT:
+        body = m->jnt_bodyid[id0];
+        break;
+      case mjTRN_SLIDERCRANK:
+        body = m->site_bodyid[id0];
+        other = m->site_bodyid[id1];
+        break;
+      case mjTRN_TENDON:
+        body = tendon_body_[id0];
+        break;
+      case mjTRN_SITE:
+        body = m->site_bodyid[id0];
+        if (id1 >= 0) other = m->site_bodyid[id1];
+        break;
+      case mjTRN_BODY:
+        body = id0;
+        break;
+      default:
+        coupled = true;
+    }
+    Merge(body, other);
+    if (tree_dof_[rootid_[body]] == 0) body = other;
+    actuator_body_[i] = body;
+  }
+
+  // equality constraints
+  for (int i = 0; i < m->neq; i++) {
+    int id0 = m->eq_obj1id[i];
+    int id1 = m->eq_obj2id[i];
+    switch (m->eq_type[i]) {
+      case mjEQ_CONNECT:
+      case mjEQ_WELD:
+        Merge(id0, id1);
+        break;
+      case mjEQ_JOINT:
+        Merge(m->jnt_bodyid[id0], id1 >= 0 ? m->jnt_bodyid[id1] : 0);
+        break;
+      case mjEQ_TENDON:
+        Merge(tendon_body_[id0], id1 >= 0 ? tendon_body_[id1] : 0);
+        break;
+      default:
+        coupled = true;
+    }
+  }
+
+  // contacts
+  if (d) {
+    for (int i = 0; i < d->ncon; i++) {
+      const mjContact* contact = d->contact + i;
+      if (contact->geom1 < 0 || contact->geom2 < 0) {
+        coupled = true;
+        continue;
+      }
+      Merge(m->geom_bodyid[contact->geom1], m->geom_bodyid[contact->geom2]);
+    }
+  }
+
+  // single island
+  if (coupled) {
+    int first = -1;
+    for (int i = 0; i < nbody; i++) {
+      if (rootid_[i] != i || tree_dof_[i] == 0) continue;
+      if (first < 0) {
+        first = i;
+      } else {
+        Merge(first, i);
+      }
+    }
+  }
+
+  // enumerate islands
+  num_island = 0;
+  root_island_.assign(nbody, -1);
+  for (int i = 0; i < nbody; i++) {
+    if (rootid_[i] != i || tree_dof_[i] == 0) continue;
+    int root = Find(i);
+    if (root_island_[root] < 0) root_island_[root] = num_island++;
+  }
+
+  // degrees of freedom
+  dof_island.resize(nv);
+  for (int i = 0; i < nv; i++) {
+    dof_island[i] = BodyIsland(m, m->dof_bodyid[i]);
+  }
+
+  // actuators, actuators without degrees of freedom get their own island
+  actuator_island.resize(nu);
+  act_island.assign(na, kStaticIsland);
+  for (int i = 0; i < nu; i++) {
+    int island = BodyIsland(m, actuator_body_[i]);
+    if (island == kStaticIsland) island = num_island++;
+    actuator_island[i] = island;
+    int actadr = m->actuator_actadr[i];
+    if (actadr < 0) continue;
+    for (int j = 0; j < m->actuator_actnum[i]; j++) {
+      act_island[actadr + j] = island;
+    }
+  }
+
+  // sensors
+  global_sensor = false;
+  sensor_island.assign(m->nsensordata, kStaticIsland);
+  for (int i = 0; i < m->nsensor; i++) {
+    int adr = m->sensor_adr[i];
+    int dim = m->sensor_dim[i];
+    if (adr + dim <= sensor_begin || adr >= sensor_end) continue;
+    int island = SensorIsland(m, i);
+    if (island == kGlobalIsland) global_sensor = true;
+    std::fill(sensor_island.begin() + adr, sensor_island.begin() + adr + dim,
+              island);
+  }
+}
+
+// assign colors to columns, returns number of colors
+int DerivativeColoring::Color(const int* column_island, int num_column) {
+  // color is index of column within its island
+  int num_color = 0;
+  island_count_.assign(num_island, 0);
+  column_color_.resize(num_column);
+  for (int i = 0; i < num_column; i++) {
+    int island = column_island[i];
+    if (island < 0) {
+      column_color_[i] = -1;
+      continue;
+    }
+    column_color_[i] = island_count_[island]++;
+    num_color = std::max(num_color, column_color_[i] + 1);
+  }
+
+  // column perturbed in each island for each color
+  color_column.assign(num_color * num_island, -1);
+  for (int i = 0; i < num_column; i++) {
+    if (column_color_[i] < 0) continue;
+    color_column[column_color_[i] * num_island + column_island[i]] = i;
+  }
+
+  return num_color;
+}
+
+// find root of tree in union-find structure
+int DerivativeColoring::Find(int tree) {
+  while (parent_[tree] != tree) {
+    parent_[tree] = parent_[parent_[tree]];
+    tree = parent_[tree];
+  }
+  return tree;
+}
+
+// merge trees containing bodies
+void DerivativeColoring::Merge(int body0, int body1) {
+  int tree0 = rootid_[body0];
+  int tree1 = rootid_[body1];
+  if (tree_dof_[tree0] == 0 || tree_dof_[tree1] == 0) return;
+  int root0 = Find(tree0);
+  int root1 = Find(tree1);
+  if (root0 != root1) parent_[root1] = root0;
+}
+
+// island containing body
+int DerivativeColoring::BodyIsland(const mjModel* m, int body) {
+  int tree = rootid_[body];
+  if (tree_dof_[tree] == 0) return kStaticIsland;
+  return root_island_[Find(tree)];
+}
+
+// island containing object
+int DerivativeColoring::ObjectIsland(const mjModel* m, int type, int id) {
+  if (id < 0) return kGlobalIsland;
+  switch (type) {
+    case mjOBJ_BODY:
+    case mjOBJ_XBODY:
+      return BodyIsland(m, id);
+    case mjOBJ_GEOM:
+      return BodyIsland(m, m->geom_bodyid[id]);
+    case mjOBJ_SITE:
+      return BodyIsland(m, m->site_bodyid[id]);
+    case mjOBJ_CAMERA:
+      return BodyIsland(m, m->cam_bodyid[id]);
+    case mjOBJ_JOINT:
+      return BodyIsland(m, m->jnt_bodyid[id]);
+    case mjOBJ_TENDON:
+      return BodyIsland(m, tendon_body_[id]);
+    case mjOBJ_ACTUATOR:
+      return actuator_island[id];
+    default:
+      return kGlobalIsland;
+  }
+}
+
+// island of sensor
+int DerivativeColoring::SensorIsland(const mjModel* m, int sensor) {
+  int objid = m->sensor_objid[sensor];
+  switch (m->sensor_type[sensor]) {
+    case mjSENS_USER:
+    case mjSENS_PLUGIN:
+    case mjSENS_RANGEFINDER:
+      return kGlobalIsland;
+    case mjSENS_CLOCK:
+      return kStaticIsland;
+    case mjSENS_SUBTREECOM:
+    case mjSENS_SUBTREELINVEL:
+    case mjSENS_SUBTREEANGMOM:
+      if (objid == 0) return kGlobalIsland;
+      break;
+    default:
+      break;
+  }
+
+  // object
+  int island = ObjectIsland(m, m->sensor_objtype[sensor], objid);
+  int refid = m->sensor_refid[sensor];
+  if (island == kGlobalIsland || refid < 0) return island;
+
+  // reference object
+  int ref_island = ObjectIsland(m, m->sensor_reftype[sensor], refid);
+  if (ref_island == kStaticIsland) return island;
+  if (island == kStaticIsland || island == ref_island) return ref_island;
+  return kGlobalIsland;
+}
+
+// transition derivatives
+void ColoredDerivatives::Transition(const mjModel* m, mjData* d, double eps,
+                                    bool centered, double* A, double* B,
+                                    double* C, double* D, int sensor_begin,
+                                    int sensor_end) {
+  // dimensions
+  int nq = m->nq, nv = m->nv, na = m->na, nu = m->nu, ns = m->nsensordata;
+  int ndx = 2 * nv + na;
+  int nstate = nq + nv + na;
+  if (sensor_end < 0) sensor_end = ns;
+  bool state_columns = A || C;
+  bool ctrl_columns = B || D;
+  bool sensor_rows = C || D;
+  if (!sensor_rows) sensor_end = sensor_begin;
+  int num_column = (state_columns ? ndx : 0) + (ctrl_columns ? nu : 0);
+
+  // structural islands (contacts only merge islands)
+  coloring.Compute(m, nullptr, sensor_begin, sensor_end);
+  int num_color = ColorTransition(m, state_columns, ctrl_columns);
+
+  // no reduction, use MuJoCo
+  num_sensor_evaluations_ = 0;
+  if (num_color >= num_column) {
+    mjd_transitionFD(m, d, eps, centered, A, B, C, D);
+    num_evaluations_ = 1 + (centered ? 2 : 1) * num_column;
+    return;
+  }
+
+  // save state
+  int spec = mjSTATE_INTEGRATION;
+  state_.resize(mj_stateSize(m, spec));
+  mj_getState(m, d, state_.data(), spec);
+
+  // nominal transition
+  nominal_.resize(nstate + ns);
+  mj_step(m, d);
+  mju_copy(nominal_.data(), d->qpos, nq);
+  mju_copy(nominal_.data() + nq, d->qvel, nv);
+  mju_copy(nominal_.data() + nq + nv, d->act, na);
+  mju_copy(nominal_.data() + nstate, d->sensordata, ns);
+  num_evaluations_ = 1;
+
+  // islands with contacts at nominal state
+  coloring.Compute(m, d, sensor_begin, sensor_end);
+  num_color = ColorTransition(m, state_columns, ctrl_columns);
+  mj_setState(m, d, state_.data(), spec);
+
+  // row islands
+  row_island_.resize(ndx + ns);
+  for (int i = 0; i < nv; i++) {
+    row_island_[i] = coloring.dof_island[i];
+    row_island_[nv + i] = coloring.dof_island[i];
+  }
+  for (int i = 0; i < na; i++) {
+    row_island_[2 * nv + i] = coloring.act_island[i];
+  }
+  for (int i = 0; i < ns; i++) {
+    row_island_[ndx + i] = coloring.sensor_island[i];
+  }
+
+  // ctrl nudge directions, one-sided at control limits
+  nudge_forward_.resize(nu);
+  nudge_backward_.resize(nu);
+  for (int i = 0; i < nu; i++) {
+    const double* range = m->actuator_ctrlrange + 2 * i;
+    double ctrl = d->ctrl[i];
+    bool limited = m->actuator_ctrllimited[i];
+    nudge_forward_[i] = !limited || InRange(ctrl, ctrl + eps, range);
+    nudge_backward_[i] = (centered || !nudge_forward_[i]) &&
+                         (!limited || InRange(ctrl - eps, ctrl, range));
+  }
+
+  // zero outputs, structurally independent entries are not evaluated
+  if (A) mju_zero(A, ndx * ndx);
+  if (B) mju_zero(B, ndx * nu);
+  if (C) mju_zero(C, ns * ndx);
+  if (D) mju_zero(D, ns * nu);
+
+  // sensor rows that depend on every column are not recovered from colors
+  global_row_.clear();
+  for (int i = 0; i < ns; i++) {
+    if (coloring.sensor_island[i] == kGlobalIsland) global_row_.push_back(i);
+  }
+  deviation_plus_.resize(ndx + ns);
+  deviation_minus_.resize(ndx + ns);
+  if (!global_row_.empty()) GlobalSensors(m, d, eps, centered, C, D);
+
+  // loop over colors
+  int num_island = coloring.num_island;
+  for (int c = 0; c < num_color; c++) {
+    const int* columns = coloring.color_column.data() + c * num_island;
+
+    // required nudges
+    bool plus = false;
+    bool minus = false;
+    for (int k = 0; k < num_island; k++) {
+      int col = columns[k];
+      if (col < 0) continue;
+      if (col < ndx) {
+        plus = true;
+        minus = minus || centered;
+      } else {
+        plus = plus || nudge_forward_[col - ndx];
+        minus = minus || nudge_backward_[col - ndx];
+      }
+    }
+
+    // nudge forward
+    if (plus) {
+      PerturbTransition(m, d, c, eps, 1);
+      mj_step(m, d);
+      TransitionDeviation(m, d, nominal_.data(), deviation_plus_.data());
+      mj_setState(m, d, state_.data(), spec);
+      num_evaluations_++;
+    }
+
+    // nudge backward
+    if (minus) {
+      PerturbTransition(m, d, c, eps, -1);
+      mj_step(m, d);
+      TransitionDeviation(m, d, nominal_.data(), deviation_minus_.data());
+      mj_setState(m, d, state_.data(), spec);
+      num_evaluations_++;
+    }
+
+    // recover columns
+    for (int r = 0; r < ndx + ns; r++) {
+      int island = row_island_[r];
+      if (island < 0) continue;
+      int col = columns[island];
+      if (col < 0) continue;
+
+      // difference
+      bool forward = col < ndx || nudge_forward_[col - ndx];
+      bool backward = col < ndx ? centered : nudge_backward_[col - ndx];
+      double value = 0.0;
+      if (forward && backward) {
+        value = 0.5 * (deviation_plus_[r] - deviation_minus_[r]) / eps;
+      } else if (forward) {
+        value = deviation_plus_[r] / eps;
+      } else if (backward) {
+        value = -deviation_minus_[r] / eps;
+      }
+
+      // set Jacobian element
+      if (r < ndx) {
+        if (col < ndx) {
+          if (A) A[r * ndx + col] = value;
+        } else if (B) {
+          B[r * nu + col - ndx] = value;
+        }
+      } else {
+        if (col < ndx) {
+          if (C) C[(r - ndx) * ndx + col] = value;
+        } else if (D) {
+          D[(r - ndx) * nu + col - ndx] = value;
+        }
+      }
+    }
+  }
+}
+
+// inverse dynamics derivatives
+void ColoredDerivatives::Inverse(const mjModel* m, mjData* d, double eps,
+                                 bool flg_actuation, double* DfDq,
+                                 double* DfDv, double* DfDa, double* DsDq,
+                                 double* DsDv, double* DsDa, int sensor_begin,
+                                 int sensor_end) {
+  // dimensions
+  int nq = m->nq, nv = m->nv, ns = m->nsensordata;
+  if (sensor_end < 0) sensor_end = ns;
+  double* DfD[3] = {DfDq, DfDv, DfDa};
+  double* DsD[3] = {DsDq, DsDv, DsDa};
+  bool sensor_rows = DsDq || DsDv || DsDa;
+  if (!sensor_rows) sensor_end = sensor_begin;
+  int num_block = 0;
+  for (int b = 0; b < 3; b++) {
+    if (DfD[b] || DsD[b]) num_block++;
+  }
+
+  // structural islands (contacts only merge islands)
+  coloring.Compute(m, nullptr, sensor_begin, sensor_end);
+  int num_color = coloring.Color(coloring.dof_island.data(), nv);
+
+  // no reduction, use MuJoCo
+  if ((sensor_rows && coloring.global_sensor) || num_color >= nv) {
+    mjd_inverseFD(m, d, eps, flg_actuation, DfDq, DfDv, DfDa, DsDq, DsDv,
+                  DsDa, nullptr);
+    num_evaluations_ = 1 + num_block * nv;
+    return;
+  }
+
+  // save inputs
+  state_.resize(nq + 2 * nv);
+  mju_copy(state_.data(), d->qpos, nq);
+  mju_copy(state_.data() + nq, d->qvel, nv);
+  mju_copy(state_.data() + nq + nv, d->qacc, nv);
+
+  // nominal
+  nominal_.resize(nv + ns);
+  InverseOutput(m, d, mjSTAGE_NONE, !sensor_rows, flg_actuation,
+                nominal_.data());
+  num_evaluations_ = 1;
+
+  // islands with contacts at nominal configuration
+  coloring.Compute(m, d, sensor_begin, sensor_end);
+  num_color = coloring.Color(coloring.dof_island.data(), nv);
+  int num_island = coloring.num_island;
+
+  // row islands
+  row_island_.resize(nv + ns);
+  std::copy(coloring.dof_island.begin(), coloring.dof_island.end(),
+            row_island_.begin());
+  std::copy(coloring.sensor_island.begin(), coloring.sensor_island.end(),
+            row_island_.begin() + nv);
+
+  // perturb acceleration, velocity, then position so that skipped stages
+  // hold nominal values
+  output_.resize(nv + ns);
+  dpos_.resize(nv);
+  for (int b = 2; b >= 0; b--) {
+    if (!DfD[b] && !DsD[b]) continue;
+    int skipstage = b == 2 ? mjSTAGE_VEL : (b == 1 ? mjSTAGE_POS : mjSTAGE_NONE);
+    if (DfD[b]) mju_zero(DfD[b], nv * nv);
+    if (DsD[b]) mju_zero(DsD[b], nv * ns);
+
+    for (int c = 0; c < num_color; c++) {
+      const int* columns = coloring.color_column.data() + c * num_island;
+
+      // nudge
+      mju_zero(dpos_.data(), nv);
+      for (int k = 0; k < num_island; k++) {
+        int col = columns[k];
+        if (col < 0) continue;
+        if (b == 0) {
+          dpos_[col] = eps;
+        } else if (b == 1) {
+          d->qvel[col] += eps;
+        } else {
+          d->qacc[col] += eps;
+        }
+      }
+      if (b == 0) mj_integratePos(m, d->qpos, dpos_.data(), 1.0);
+
+      // evaluate
+      InverseOutput(m, d, skipstage, !sensor_rows, flg_actuation,
+                    output_.data());
+      mju_subFrom(output_.data(), nominal_.data(), nv + ns);
+      num_evaluations_++;
+
+      // restore inputs
+      mju_copy(d->qpos, state_.data(), nq);
+      mju_copy(d->qvel, state_.data() + nq, nv);
+      mju_copy(d->qacc, state_.data() + nq + nv, nv);
+
+      // recover columns (transposed)
+      for (int r = 0; r < nv + ns; r++) {
+        int island = row_island_[r];
+        if (island < 0) continue;
+        int col = columns[island];
+        if (col < 0) continue;
+        double value = output_[r] / eps;
+        if (r < nv) {
+          if (DfD[b]) DfD[b][col * nv + r] = value;
+        } else if (DsD[b]) {
+          DsD[b][col * ns + r - nv] = value;
+        }
+      }
+    }
+  }
+}
+
+// color transition columns, returns number of colors
+int ColoredDerivatives::ColorTransition(const mjModel* m, bool state_columns,
+                                        bool ctrl_columns) {
+  // dimensions
+  int nv = m->nv, na = m->na, nu = m->nu;
+  int ndx = 2 * nv + na;
+
+  // column islands
+  column_island_.resize(ndx + nu);
+  for (int i = 0; i < nv; i++) {
+    int island = state_columns ? coloring.dof_island[i] : kStaticIsland;
+    column_island_[i] = island;
+    column_island_[nv + i] = island;
+  }
+  for (int i = 0; i < na; i++) {
+    column_island_[2 * nv + i] =
+        state_columns ? coloring.act_island[i] : kStaticIsland;
+  }
+  for (int i = 0; i < nu; i++) {
+    column_island_[ndx + i] =
+        ctrl_columns ? coloring.actuator_island[i] : kStaticIsland;
+  }
+
+  return coloring.Color(column_island_.data(), ndx + nu);
+}
+
+// perturb colored columns of transition
+void ColoredDerivatives::PerturbTransition(const mjModel* m, mjData* d,
+                                           int color, double eps, int sign) {
+  // dimensions
+  int nv = m->nv, na = m->na;
+  int ndx = 2 * nv + na;
+  int num_island = coloring.num_island;
+  const int* columns = coloring.color_column.data() + color * num_island;
+
+  // nudge
+  dpos_.resize(nv);
+  mju_zero(dpos_.data(), nv);
+  for (int k = 0; k < num_island; k++) {
+    int col = columns[k];
+    if (col < 0) continue;
+    if (col < nv) {
+      dpos_[col] = sign * eps;
+    } else if (col < 2 * nv) {
+      d->qvel[col - nv] += sign * eps;
+    } else if (col < ndx) {
+      d->act[col - 2 * nv] += sign * eps;
+    } else {
+      int i = col - ndx;
+      bool nudge = sign > 0 ? nudge_forward_[i] : nudge_backward_[i];
+      if (nudge) d->ctrl[i] += sign * eps;
+    }
+  }
+  mj_integratePos(m, d->qpos, dpos_.data(), 1.0);
+}
+
+// rows global_row_ of C and D, one column at a time
+void ColoredDerivatives::GlobalSensors(const mjModel* m, mjData* d,
+                                       double eps, bool centered, double* C,
+                                       double* D) {
+  // dimensions
+  int nv = m->nv, na = m->na, nu = m->nu;
+  int ndx = 2 * nv + na;
+  int nstate = m->nq + nv + na;
+  int num_row = global_row_.size();
+  int spec = mjSTATE_INTEGRATION;
+  dpos_.resize(nv);
+
+  // stages at nominal state, the nominal transition can leave intermediate
+  // (e.g., Runge-Kutta) stages in d
+  mj_forward(m, d);
+  num_sensor_evaluations_ = 1;
+
+  // columns in order of decreasing skipped stage: ctrl, act, qvel, qpos;
+  // a skipped stage always holds values at the nominal state
+  for (int k = 0; k < nu + ndx; k++) {
+    int col = k < nu ? ndx + k : ndx + nu - 1 - k;
+    if (col < ndx ? !C : !D) continue;
+    int skipstage = mjSTAGE_NONE;
+    if (col >= 2 * nv) {
+      skipstage = mjSTAGE_VEL;
+    } else if (col >= nv) {
+      skipstage = mjSTAGE_POS;
+    }
+
+    // nudges
+    bool forward = col < ndx || nudge_forward_[col - ndx];
+    bool backward = col < ndx ? centered : nudge_backward_[col - ndx];
+    for (int sign = 1; sign >= -1; sign -= 2) {
+      if (sign > 0 ? !forward : !backward) continue;
+      double delta = sign * eps;
+      if (col < nv) {
+        mju_zero(dpos_.data(), nv);
+        dpos_[col] = delta;
+        mj_integratePos(m, d->qpos, dpos_.data(), 1.0);
+      } else if (col < 2 * nv) {
+        d->qvel[col - nv] += delta;
+      } else if (col < ndx) {
+        d->act[col - 2 * nv] += delta;
+      } else {
+        d->ctrl[col - ndx] += delta;
+      }
+      mj_forwardSkip(m, d, skipstage, 0);
+      double* deviation =
+          sign > 0 ? deviation_plus_.data() : deviation_minus_.data();
+      for (int j = 0; j < num_row; j++) {
+        int row = global_row_[j];
+        deviation[j] = d->sensordata[row] - nominal_[nstate + row];
+      }
+      mj_setState(m, d, state_.data(), spec);
+      num_sensor_evaluations_++;
+    }
+
+    // set Jacobian elements
+    for (int j = 0; j < num_row; j++) {
+      double value = 0.0;
+      if (forward && backward) {
+        value = 0.5 * (deviation_plus_[j] - deviation_minus_[j]) / eps;
+      } else if (forward) {
+        value = deviation_plus_[j] / eps;
+      } else if (backward) {
+        value = -deviation_minus_[j] / eps;
+      }
+      int row = global_row_[j];
+      if (col < ndx) {
+        C[row * ndx + col] = value;
+      } else {
+        D[row * nu + col - ndx] = value;
+      }
+    }
+  }
+}
+
+// copy cached Jacobians at the state of d into non-null outputs
+bool DerivativeCache::Lookup(const mjModel* m, const mjData* d, double eps,
+                             bool centered, double* A, double* B, double* C,
+                             double* D, int sensor_begin, int sensor_end,
+                             const mjModel* key) {
+  // dimensions
+  int nv = m->nv, na = m->na, nu = m->nu, ns = m->nsensordata;
+  int ndx = 2 * nv + na;
+  if (sensor_end < 0) sensor_end = ns;
+
+  const std::lock_guard<std::mutex> lock(mtx_);
+  Key(m, d);
+  const Entry* entry = Find(m, key ? key : m, eps, centered);
+
+  // check for requested outputs
+  bool rows = entry && entry->sensor_begin <= sensor_begin &&
+              sensor_end <= entry->sensor_end;
+  if (!entry || (A && !entry->has_A) || (B && !entry->has_B) ||
+      (C && !(entry->has_C && rows)) || (D && !(entry->has_D && rows))) {
+    num_misses_++;
+    return false;
+  }
+
+  // copy
+  int num_row = sensor_end - sensor_begin;
+  if (A) mju_copy(A, entry->A.data(), ndx * ndx);
+  if (B) mju_copy(B, entry->B.data(), ndx * nu);
+  if (C) {
+    mju_copy(C + sensor_begin * ndx, entry->C.data() + sensor_begin * ndx,
+             num_row * ndx);
+  }
+  if (D) {
+    mju_copy(D + sensor_begin * nu, entry->D.data() + sensor_begin * nu,
+             num_row * nu);
+  }
+  num_hits_++;
+  return true;
+}
+
+// store non-null Jacobians computed at the state of d
+void DerivativeCache::Store(const mjModel* m, const mjData* d, double eps,
+                            bool centered, const double* A, const double* B,
+                            const double* C, const double* D,
+                            int sensor_begin, int sensor_end,
+                            const mjModel* key) {
+  // dimensions
+  int nv = m->nv, na = m->na, nu = m->nu, ns = m->nsensordata;
+  int ndx = 2 * nv + na;
+  if (sensor_end < 0) sensor_end = ns;
+
+  const std::lock_guard<std::mutex> lock(mtx_);
+  Key(m, d);
+  Entry* entry = Find(m, key ? key : m, eps, centered);
+
+  // replace oldest entry
+  if (!entry) {
+    entry = &entries_[0];
+    for (int i = 1; i < kDerivativeCacheSize; i++) {
+      if (entries_[i].stamp < entry->stamp) entry = &entries_[i];
+    }
+    entry->model = key ? key : m;
+    entry->nv = nv;
+    entry->na = na;
+    entry->nu = nu;
+    entry->nsensordata = ns;
+    entry->timestep = m->opt.timestep;
+    entry->integrator = m->opt.integrator;
+    entry->eps = eps;
+    entry->centered = centered;
+    entry->hash = hash_;
+    entry->state = key_;
+    entry->has_A = entry->has_B = entry->has_C = entry->has_D = false;
+  }
+  entry->stamp = ++stamp_;
+
+  // dynamics Jacobians
+  if (A) {
+    entry->A.assign(A, A + ndx * ndx);
+    entry->has_A = true;
+  }
+  if (B) {
+    entry->B.assign(B, B + ndx * nu);
+    entry->has_B = true;
+  }
+
+  // sensor Jacobians, rows outside of stored range are invalidated
+  if (C || D) {
+    bool rows = entry->sensor_begin <= sensor_begin &&
+                sensor_end <= entry->sensor_end && (!C || entry->has_C) &&
+                (!D || entry->has_D);
+    if (!rows) {
+      entry->has_C = entry->has_D = false;
+      entry->sensor_begin = sensor_begin;
+      entry->sensor_end = sensor_end;
+    }
+    int num_row = sensor_end - sensor_begin;
+    if (C) {
+      entry->C.resize(ns * ndx);
+      mju_copy(entry->C.data() + sensor_begin * ndx, C + sensor_begin * ndx,
+               num_row * ndx);
+      entry->has_C = true;
+    }
+    if (D) {
+      entry->D.resize(ns * nu);
+      mju_copy(entry->D.data() + sensor_begin * nu, D + sensor_begin * nu,
+               num_row * nu);
+      entry->has_D = true;
+    }
+  }
+}
+
+// remove all entries
+void DerivativeCache::Clear() {
+  const std::lock_guard<std::mutex> lock(mtx_);
+  for (Entry& entry : entries_) {
+    entry.model = nullptr;
+    entry.stamp = 0;
+  }
+}
+
+// set key_ and hash_ from model and data
+void DerivativeCache::Key(const mjModel* m, const mjData* d) {
+  // state, controls and inputs that change the dynamics or sensors (mocap
+  // bodies, userdata). time and warmstart do not change the Jacobians and
+  // differ between consumers (e.g., planner and estimator) at the same state
+  const unsigned int spec = mjSTATE_QPOS | mjSTATE_QVEL | mjSTATE_ACT |
+                            mjSTATE_CTRL | mjSTATE_MOCAP_POS |
+                            mjSTATE_MOCAP_QUAT | mjSTATE_USERDATA;
+  key_.resize(mj_stateSize(m, spec));
+  mj_getState(m, d, key_.data(), spec);
+
+  // FNV-1a
+  hash_ = 14695981039346656037ull;
+  const unsigned char* bytes =
+      reinterpret_cast<const unsigned char*>(key_.data());
+  for (size_t i = 0; i < key_.size() * sizeof(double); i++) {
+    hash_ = (hash_ ^ bytes[i]) * 1099511628211ull;
+  }
+}
+
+// entry matching model, settings and key_, nullptr if none
+DerivativeCache::Entry* DerivativeCache::Find(const mjModel* m,
+                                              const mjModel* key, double eps,
+                                              bool centered) {
+  for (Entry& entry : entries_) {
+    if (entry.stamp == 0 || entry.model != key || entry.hash != hash_ ||
+        entry.nv != m->nv || entry.na != m->na || entry.nu != m->nu ||
+        entry.nsensordata != m->nsensordata ||
+        entry.timestep != m->opt.timestep ||
+        entry.integrator != m->opt.integrator || entry.eps != eps ||
+        entry.centered != centered || entry.state != key_) {
+      continue;
+    }
+    return &entry;
+  }
+  return nullptr;
+}
+
+}  // namespace mjpc
@@ -0,0 +1,279 @@
+// Copyright 2024 DeepMind Technologies Limited
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MJPC_DERIVATIVES_H_
+#define MJPC_DERIVATIVES_H_
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+#include <mujoco/mujoco.h>
+
+namespace mjpc {
+
+// island for rows that can depend on every column (e.g., user sensors)
+inline constexpr int kGlobalIsland = -1;
+
+// island for rows and columns that do not depend on any degree of freedom
+inline constexpr int kStaticIsland = -2;
+
+// partition of a model into islands: sets of kinematic trees coupled by
+// contacts, equality constraints, tendons or actuator transmissions. columns
+// in different islands do not interact within one time step and can be
+// perturbed together (same color) when finite differencing.
+class DerivativeColoring {
+ public:
+  // constructor
+  DerivativeColoring() = default;
+
+  // destructor
+  ~DerivativeColoring() = default;
+
+  // compute islands from model structure and contacts in data; sensors
+  // outside [sensor_begin, sensor_end) are assigned to kStaticIsland
+  void Compute(const mjModel* m, const mjData* d, int sensor_begin,
+               int sensor_end);
+
+  // assign colors to columns, returns number of colors;
+  // color_column (num_color x num_island) is the column perturbed in each
+  // island for each color (-1 if none), columns with negative islands are
+  // never perturbed
+  int Color(const int* column_island, int num_column);
+
+  // number of islands
+  int num_island = 0;
+
+  // true if a sensor in range depends on every island
+  bool global_sensor = false;
+
+  // islands
+  std::vector<int> dof_island;       // nv
+  std::vector<int> actuator_island;  // nu
+  std::vector<int> act_island;       // na
+  std::vector<int> sensor_island;    // nsensordata
+
+  // colors (num_color x num_island)
+  std::vector<int> color_column;
+
+ private:
+  // find root of tree in union-find structure
+  int Find(int tree);
+
+  // merge trees containing bodies, trees without degrees of freedom are
+  // not merged
+  void Merge(int body0, int body1);
+
+  // island containing body
+  int BodyIsland(const mjModel* m, int body);
+
+  // island containing object
+  int ObjectIsland(const mjModel* m, int type, int id);
+
+  // island of sensor
+  int SensorIsland(const mjModel* m, int sensor);
+
+  // union-find parents (nbody)
+  std::vector<int> parent_;
+
+  // degrees of freedom per tree (nbody)
+  std::vector<int> tree_dof_;
+
+  // island of union-find root (nbody)
+  std::vector<int> root_island_;
+
+  // representative body per tendon (ntendon)
+  std::vector<int> tendon_body_;
+
+  // representative body per actuator (nu)
+  std::vector<int> actuator_body_;
+
+  // body_rootid
+  const int* rootid_ = nullptr;
+
+  // coloring scratch
+  std::vector<int> island_count_;
+  std::vector<int> column_color_;
+};
+
+// finite-difference derivatives that perturb structurally independent columns
+// together and recover the individual columns from the island structure;
+// outputs match mjd_transitionFD and mjd_inverseFD. transition sensor rows
+// that depend on every column (e.g., user sensors for residuals) are computed
+// one column at a time with the physics stages before the column skipped.
+// falls back to the MuJoCo routines when coloring does not reduce the number
+// of evaluations, or for inverse dynamics, when a requested sensor row
+// depends on every column.
+class ColoredDerivatives {
+ public:
+  // constructor
+  ColoredDerivatives() = default;
+
+  // destructor
+  ~ColoredDerivatives() = default;
+
+  // transition derivatives, same layout as mjd_transitionFD; only rows of C
+  // and D in [sensor_begin, sensor_end) are computed (sensor_end < 0: all)
+  void Transition(const mjModel* m, mjData* d, double eps, bool centered,
+                  double* A, double* B, double* C, double* D,
+                  int sensor_begin = 0, int sensor_end = -1);
+
+  // inverse dynamics derivatives, same (transposed) layout as mjd_inverseFD;
+  // only columns of DsDq, DsDv, DsDa in [sensor_begin, sensor_end) are
+  // computed (sensor_end < 0: all)
+  void Inverse(const mjModel* m, mjData* d, double eps, bool flg_actuation,
+               double* DfDq, double* DfDv, double* DfDa, double* DsDq,
+               double* DsDv, double* DsDa, int sensor_begin = 0,
+               int sensor_end = -1);
+
+  // number of physics evaluations used by last call
+  int NumEvaluations() const { return num_evaluations_; }
+
+  // number of forward evaluations for sensor rows that depend on every
+  // column used by last call
+  int NumSensorEvaluations() const { return num_sensor_evaluations_; }
+
+  // islands and colors
+  DerivativeColoring coloring;
+
+ private:
+  // color transition columns, returns number of colors
+  int ColorTransition(const mjModel* m, bool state_columns, bool ctrl_columns);
+
+  // perturb colored columns of transition
+  void PerturbTransition(const mjModel* m, mjData* d, int color, double eps,
+                         int sign);
+
+  // rows global_row_ of C and D, one column at a time
+  void GlobalSensors(const mjModel* m, mjData* d, double eps, bool centered,
+                     double* C, double* D);
+
+  // number of physics evaluations
+  int num_evaluations_ = 0;
+  int num_sensor_evaluations_ = 0;
+
+  // saved state
+  std::vector<double> state_;
+
+  // column islands
+  std::vector<int> column_island_;
+
+  // row islands
+  std::vector<int> row_island_;
+
+  // requested sensor rows that depend on every column
+  std::vector<int> global_row_;
+
+  // ctrl nudge directions (nu)
+  std::vector<int> nudge_forward_;
+  std::vector<int> nudge_backward_;
+
+  // nominal and perturbed outputs
+  std::vector<double> nominal_;
+  std::vector<double> output_;
+  std::vector<double> deviation_plus_;
+  std::vector<double> deviation_minus_;
+
+  // position perturbation (nv)
+  std::vector<double> dpos_;
+};
+
+// number of entries in derivative cache
+inline constexpr int kDerivativeCacheSize = 4;
+
+// thread-safe cache of transition Jacobians shared between consumers of the
+// same model (e.g., planner and estimator). entries are keyed by model,
+// time step, integrator, finite-difference settings and a hash of the
+// state (qpos, qvel, act), controls, mocap poses and userdata; a hash match
+// is confirmed by comparing the full key before a hit is returned. rows that
+// depend on other inputs (e.g., time) should not be stored.
+class DerivativeCache {
+ public:
+  // constructor
+  DerivativeCache() = default;
+
+  // destructor
+  ~DerivativeCache() = default;
+
+  // copy cached Jacobians at the state of d into non-null outputs (layout of
+  // mjd_transitionFD, only rows of C and D in [sensor_begin, sensor_end)),
+  // returns false if no entry provides all requested outputs; key identifies
+  // the model (default: m)
+  bool Lookup(const mjModel* m, const mjData* d, double eps, bool centered,
+              double* A, double* B, double* C, double* D, int sensor_begin,
+              int sensor_end, const mjModel* key = nullptr);
+
+  // store non-null Jacobians computed at the state of d
+  void Store(const mjModel* m, const mjData* d, double eps, bool centered,
+             const double* A, const double* B, const double* C,
+             const double* D, int sensor_begin, int sensor_end,
+             const mjModel* key = nullptr);
+
+  // remove all entries
+  void Clear();
+
+  // number of lookups returning cached Jacobians
+  int NumHits() const { return num_hits_.load(); }
+
+  // number of lookups without cached Jacobians
+  int NumMisses() const { return num_misses_.load(); }
+
+ private:
+  // cached Jacobians
+  struct Entry {
+    const mjModel* model = nullptr;
+    int nv = 0;
+    int na = 0;
+    int nu = 0;
+    int nsensordata = 0;
+    double timestep = 0.0;
+    int integrator = 0;
+    double eps = 0.0;
+    bool centered = false;
+    uint64_t hash = 0;
+    uint64_t stamp = 0;  // insertion order, 0: empty
+    std::vector<double> state;
+    bool has_A = false;
+    bool has_B = false;
+    bool has_C = false;
+    bool has_D = false;
+    int sensor_begin = 0;
+    int sensor_end = 0;
+    std::vector<double> A;  // ndx x ndx
+    std::vector<double> B;  // ndx x nu
+    std::vector<double> C;  // nsensordata x ndx
+    std::vector<double> D;  // nsensordata x nu
+  };
+
+  // set key_ and hash_ from model and data
+  void Key(const mjModel* m, const mjData* d);
+
+  // entry matching model, settings and key_, nullptr if none
+  Entry* Find(const mjModel* m, const mjModel* key, double eps, bool centered);
+
+  std::mutex mtx_;
+  Entry entries_[kDerivativeCacheSize];
+  uint64_t stamp_ = 0;
+  std::atomic_int num_hits_ = 0;
+  std::atomic_int num_misses_ = 0;
+
+  // state key scratch
+  std::vector<double> key_;
+  uint64_t hash_ = 0;
+};
+
+}  // namespace mjpc
+
+#endif  // MJPC_DERIVATIVES_H_
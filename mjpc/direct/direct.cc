@@ -26,6 +26,7 @@
 #include "mjpc/direct/trajectory.h"
 #include "mjpc/direct/model_parameters.h"
 #include "mjpc/norm.h"
+#include "mjpc/task.h"
 #include "mjpc/threadpool.h"
 #include "mjpc/utilities.h"
 
@@ -63,6 +64,9 @@ void Direct::Initialize(const mjModel* model) {
     data_.push_back(MakeUniqueMjData(mj_makeData(model)));
   }
 
+  // colored finite-difference derivatives
+  derivatives_.resize(pool_.NumThreads());
+
   // timestep
   this->model->opt.timestep =
       GetNumberOrDefault(this->model->opt.timestep, model, "direct_timestep");
@@ -89,6 +93,7 @@ void Direct::Initialize(const mjModel* model) {
   // perturbation models
   if (nparam_ > 0) {
     // clear memory
+    for (const UniqueMjModel& m : model_perturb_) UnregisterResidual(m.get());
     model_perturb_.clear();
 
     // add model for each time step (need for threaded evaluation)
@@ -98,6 +103,9 @@ void Direct::Initialize(const mjModel* model) {
 
       // set discrete inverse dynamics
       model_perturb_[i].get()->opt.enableflags |= mjENBL_INVDISCRETE;
+
+      // user sensors are evaluated by the residual of the optimizer's model
+      RegisterResidualAlias(model_perturb_[i].get(), this->model);
     }
   }
 
@@ -1638,6 +1646,22 @@ void Direct::InverseDynamicsPrediction() {
   timer_.cost_prediction += GetDuration(start);
 }
 
+// finite-difference inverse dynamics derivatives for one time step
+void Direct::InverseDynamicsFD(mjData* data, double* DfDq, double* DfDv,
+                               double* DfDa, double* DsDq, double* DsDv,
+                               double* DsDa) {
+  if (finite_difference.flg_coloring) {
+    derivatives_[ThreadPool::WorkerId()].Inverse(
+        model, data, finite_difference.tolerance,
+        finite_difference.flg_actuation, DfDq, DfDv, DfDa, DsDq, DsDv, DsDa,
+        sensor_start_index_, sensor_start_index_ + nsensordata_);
+  } else {
+    mjd_inverseFD(model, data, finite_difference.tolerance,
+                  finite_difference.flg_actuation, DfDq, DfDv, DfDa, DsDq,
+                  DsDv, DsDa, NULL);
+  }
+}
+
 // compute inverse dynamics derivatives (via finite difference)
 void Direct::InverseDynamicsDerivatives() {
   // start timer
@@ -1675,9 +1699,7 @@ void Direct::InverseDynamicsDerivatives() {
 
     // finite-difference derivatives
     double* dqds = direct.block_sensor_configurationT_.Get(t);
-    mjd_inverseFD(direct.model, d, direct.finite_difference.tolerance,
-                  direct.finite_difference.flg_actuation, NULL, NULL, NULL,
-                  dqds, NULL, NULL, NULL);
+    direct.InverseDynamicsFD(d, NULL, NULL, NULL, dqds, NULL, NULL);
     // transpose
     mju_transpose(dsdq, dqds, nv, direct.model->nsensordata);
 
@@ -1739,9 +1761,7 @@ void Direct::InverseDynamicsDerivatives() {
       mju_copy(data->qacc, a, nv);
 
       // finite-difference derivatives
-      mjd_inverseFD(direct.model, data, direct.finite_difference.tolerance,
-                    direct.finite_difference.flg_actuation, dqdf, dvdf, dadf,
-                    dqds, dvds, dads, NULL);
+      direct.InverseDynamicsFD(data, dqdf, dvdf, dadf, dqds, dvds, dads);
 
       // transpose
       mju_transpose(dsdq, dqds, nv, direct.model->nsensordata);
@@ -1778,9 +1798,7 @@ void Direct::InverseDynamicsDerivatives() {
     // finite-difference derivatives
     double* dqds = direct.block_sensor_configurationT_.Get(t);
     double* dvds = direct.block_sensor_velocityT_.Get(t);
-    mjd_inverseFD(direct.model, d, direct.finite_difference.tolerance,
-                  direct.finite_difference.flg_actuation, NULL, NULL, NULL,
-                  dqds, dvds, NULL, NULL);
+    direct.InverseDynamicsFD(d, NULL, NULL, NULL, dqds, dvds, NULL);
     // transpose
     mju_transpose(dsdq, dqds, nv, direct.model->nsensordata);
     mju_transpose(dsdv, dvds, nv, direct.model->nsensordata);
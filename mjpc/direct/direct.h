@@ -20,9 +20,11 @@
 #include <vector>
 
 #include <mujoco/mujoco.h>
+#include "mjpc/derivatives.h"
 #include "mjpc/direct/model_parameters.h"
 #include "mjpc/direct/trajectory.h"
 #include "mjpc/norm.h"
+#include "mjpc/task.h"
 #include "mjpc/threadpool.h"
 #include "mjpc/utilities.h"
 
@@ -67,6 +69,7 @@ class Direct {
 
   // destructor
   virtual ~Direct() {
+    for (const UniqueMjModel& m : model_perturb_) UnregisterResidual(m.get());
     if (model) mj_deleteModel(model);
   }
 
@@ -217,6 +220,7 @@ class Direct {
   struct FiniteDifferenceSettings {
     double tolerance = 1.0e-7;
     bool flg_actuation = 1;
+    bool flg_coloring = true;  // perturb independent trees together
   } finite_difference;
 
  protected:
@@ -232,6 +236,11 @@ class Direct {
   // compute inverse dynamics derivatives (via finite difference)
   void InverseDynamicsDerivatives();
 
+  // finite-difference inverse dynamics derivatives for one time step
+  void InverseDynamicsFD(mjData* data, double* DfDq, double* DfDv,
+                         double* DfDa, double* DsDq, double* DsDv,
+                         double* DsDa);
+
   // evaluate configurations derivatives
   void ConfigurationDerivative();
 
@@ -311,6 +320,9 @@ class Direct {
   // data
   std::vector<UniqueMjData> data_;
 
+  // colored finite-difference derivatives (per worker)
+  std::vector<ColoredDerivatives> derivatives_;
+
   // cost
   double cost_sensor_ = 0.0;
   double cost_force_ = 0.0;
@@ -100,13 +100,8 @@ void Batch::Initialize(const mjModel* model) {
   // scratch
   scratch_prior_.resize(ntotal_max + 12 * nv * nv);
 
-  // conditioned matrix
-  mat00_.resize(ntotal_max * ntotal_max);
-  mat10_.resize(ntotal_max * ntotal_max);
-  mat11_.resize(ntotal_max * ntotal_max);
-  condmat_.resize(ntotal_max * ntotal_max);
-  scratch0_condmat_.resize(ntotal_max * ntotal_max);
-  scratch1_condmat_.resize(ntotal_max * ntotal_max);
+  // marginalization scratch
+  scratch_marginal_.resize(9 * nv * nv);
 
   // timer
   filter_timer_.prior_step.resize(max_history_);
@@ -217,13 +212,8 @@ void Batch::Reset(const mjData* data) {
   // scratch
   std::fill(scratch_prior_.begin(), scratch_prior_.end(), 0.0);
 
-  // conditioned matrix
-  std::fill(mat00_.begin(), mat00_.end(), 0.0);
-  std::fill(mat10_.begin(), mat10_.end(), 0.0);
-  std::fill(mat11_.begin(), mat11_.end(), 0.0);
-  std::fill(condmat_.begin(), condmat_.end(), 0.0);
-  std::fill(scratch0_condmat_.begin(), scratch0_condmat_.end(), 0.0);
-  std::fill(scratch1_condmat_.begin(), scratch1_condmat_.end(), 0.0);
+  // marginalization scratch
+  std::fill(scratch_marginal_.begin(), scratch_marginal_.end(), 0.0);
 
   // timer
   std::fill(filter_timer_.prior_step.begin(), filter_timer_.prior_step.end(),
@@ -350,67 +340,19 @@ void Batch::Update(const double* ctrl, const double* sensor, int mode) {
 
   // -- update prior weights -- //
 
-  // prior weights
-  double* weights = weight_prior_.data();
+  // start timer
+  auto start_prior = std::chrono::steady_clock::now();
 
   // recursive update
   if (filter_settings.recursive_prior_update &&
       configuration_length_ == configuration_length_cache) {
-    // condition dimension
-    int ncondition = nvel_ - nv;
-
-    // band to dense cost Hessian
-    mju_band2Dense(cost_hessian_.data(), cost_hessian_band_.data(), ntotal_,
-                   nband_, nparam_, 1);
-
-    // compute conditioned matrix
-    double* condmat = condmat_.data();
-    ConditionMatrix(condmat, cost_hessian_.data(), mat00_.data(), mat10_.data(),
-                    mat11_.data(), scratch0_condmat_.data(),
-                    scratch1_condmat_.data(), ntotal_, nv, ncondition);
-
-    // zero memory
-    mju_zero(weights, ntotal_ * ntotal_);
-
-    // set conditioned matrix in prior weights
-    SetBlockInMatrix(weights, condmat, 1.0, ntotal_, ntotal_, ncondition,
-                     ncondition, 0, 0);
-
-    // set bottom right to scale_prior * I
-    for (int i = ncondition; i < ntotal_; i++) {
-      weights[ntotal_ * i + i] = scale_prior;
-    }
-
-    // make block band
-    DenseToBlockBand(weights, ntotal_, nv, 3);
-  } else {
-    // dimension
-    int nvar_new = ntotal_;
-    if (current_time_index_ < configuration_length_ - 2) {
-      nvar_new += nv;
-    }
-
-    // check same size
-    if (ntotal_ != nvar_new) {
-      // get previous weights
-      double* previous_weights = scratch0_condmat_.data();
-      mju_copy(previous_weights, weights, ntotal_ * ntotal_);
-
-      // set previous in new weights (dimension may have increased)
-      mju_zero(weights, nvar_new * nvar_new);
-      SetBlockInMatrix(weights, previous_weights, 1.0, nvar_new, nvar_new,
-                       ntotal_, ntotal_, 0, 0);
-
-      // scale_prior * I
-      for (int i = ntotal_; i < nvar_new; i++) {
-        weights[nvar_new * i + i] = scale_prior;
-      }
-
-      // make block band
-      DenseToBlockBand(weights, nvar_new, nv, 3);
-    }
+    // marginalize first configuration, prior for shifted trajectory
+    MarginalizePrior();
   }
 
+  // stop timer
+  filter_timer_.prior_weight_update = 1.0e-3 * GetDuration(start_prior);
+
   // restore configuration length
   if (configuration_length_ != configuration_length_cache) {
     ShiftResizeTrajectory(0, configuration_length_cache);
@@ -509,6 +451,70 @@ void Batch::SetPriorWeights(const double* weights, double scale) {
   scale_prior = scale;
 }
 
+// dense prior weights
+const double* Batch::PriorWeights() {
+  mju_band2Dense(weight_prior_.data(), weight_prior_band_.data(), nvel_,
+                 nband_, 0, 1);
+  return weight_prior_.data();
+}
+
+// set rows [index, index + n) of prior weights to scale_prior * I
+void Batch::SetPriorWeightsDiagonal(int index, int n) {
+  double* band = weight_prior_band_.data() + index * nband_;
+  mju_zero(band, n * nband_);
+  for (int i = 0; i < n; i++) {
+    band[i * nband_ + nband_ - 1] = scale_prior;
+  }
+}
+
+// marginalize first configuration from cost Hessian into prior weights:
+// weights = H11 - H10 * H00^-1 * H10', configurations shifted by one.
+// H10 only couples the next two configurations, and the Cholesky factor of
+// the remaining band is not needed, so the update is O(nv^3) plus an
+// O(nvel_ * nband_) copy.
+void Batch::MarginalizePrior() {
+  // dimensions
+  int nv = model->nv;
+  int n = nvel_ - nv;           // marginal dimension
+  int m = std::min(2 * nv, n);  // coupled rows
+
+  // unpack
+  const double* hessian = cost_hessian_band_.data();
+  double* weights = weight_prior_band_.data();
+  double* h00 = scratch_marginal_.data();    // nv x nv
+  double* h10 = h00 + nv * nv;               // m x nv
+  double* solve = h10 + 2 * nv * nv;         // m x nv: (H00^-1 * H10')'
+  double* correction = solve + 2 * nv * nv;  // m x m
+
+  // H00, H10
+  BlockFromBand(h00, hessian, nband_, nv, nv, 0, 0);
+  BlockFromBand(h10, hessian, nband_, m, nv, nv, 0);
+
+  // H10 * H00^-1 * H10'
+  mju_cholFactor(h00, nv, 0.0);
+  for (int i = 0; i < m; i++) {
+    mju_cholSolve(solve + i * nv, h00, h10 + i * nv, nv);
+  }
+  mju_mulMatMatT(correction, h10, solve, m, nv, m);
+
+  // H11: band rows are unchanged by shifting rows and columns together
+  mju_copy(weights, hessian + nv * nband_, n * nband_);
+
+  // zero entries left of the first column
+  for (int i = 0; i < std::min(n, nband_ - 1); i++) {
+    mju_zero(weights + i * nband_, nband_ - 1 - i);
+  }
+
+  // subtract correction, lower triangle
+  for (int i = 0; i < m; i++) {
+    mju_subFrom(weights + i * nband_ + nband_ - 1 - i, correction + i * m,
+                i + 1);
+  }
+
+  // new configuration: scale_prior * I
+  SetPriorWeightsDiagonal(n, nv);
+}
+
 // shift trajectory heads
 void Batch::Shift(int shift) {
   // update trajectory lengths
@@ -552,10 +558,6 @@ double Batch::CostPrior(double* gradient, double* hessian) {
   // initial cost
   double cost = 0.0;
 
-  // dense2band
-  mju_dense2Band(weight_prior_band_.data(), weight_prior_.data(), nvel_, nband_,
-                 0);
-
   // compute cost
   if (!cost_skip_) {
     // residual
@@ -609,8 +611,8 @@ double Batch::CostPrior(double* gradient, double* hessian) {
               double* tmp1 = tmp0 + nv * nv;
 
               // get matrices
-              BlockFromMatrix(bbij, weight_prior_.data(), nv, nv, nvel_, nvel_,
-                              (i + t) * nv, (j + t) * nv);
+              BlockFromBand(bbij, weight_prior_band_.data(), nband_, nv, nv,
+                            (i + t) * nv, (j + t) * nv);
               const double* bdi = block_prior_current_configuration_.Get(i + t);
               const double* bdj = block_prior_current_configuration_.Get(j + t);
 
@@ -792,9 +794,7 @@ void Batch::InitializeFilter() {
   }
 
   // prior weight
-  for (int i = 0; i < ntotal_; i++) {
-    weight_prior_[ntotal_ * i + i] = scale_prior;
-  }
+  SetPriorWeightsDiagonal(0, nvel_);
 }
 
 // shift head and resize trajectories
@@ -1140,22 +1140,10 @@ void Batch::SetGUIData() {
   // changing horizon cases
   if (horizon > configuration_length_) {  // increase horizon
     // -- prior weights resize -- //
-    int ntotal_new = model->nv * horizon;
 
-    // get previous weights
-    double* weights = weight_prior_.data();
-    double* previous_weights = scratch0_condmat_.data();
-    mju_copy(previous_weights, weights, ntotal_ * ntotal_);
-
-    // set previous in new weights (dimension may have increased)
-    mju_zero(weights, ntotal_new * ntotal_new);
-    SetBlockInMatrix(weights, previous_weights, 1.0, ntotal_new, ntotal_new,
-                     ntotal_, ntotal_, 0, 0);
-
-    // scale_prior * I
-    for (int i = ntotal_; i < ntotal_new; i++) {
-      weights[ntotal_new * i + i] = scale_prior;
-    }
+    // new configurations with scale_prior * I, previous rows are unchanged
+    int nvel_new = model->nv * horizon;
+    SetPriorWeightsDiagonal(nvel_, nvel_new - nvel_);
 
     // modify trajectories
     ShiftResizeTrajectory(0, horizon);
@@ -1166,17 +1154,7 @@ void Batch::SetGUIData() {
     ntotal_ = nvel_ + nparam_;
   } else if (horizon < configuration_length_) {  // decrease horizon
     // -- prior weights resize -- //
-    int ntotal_new = model->nv * horizon;
-
-    // get previous weights
-    double* weights = weight_prior_.data();
-    double* previous_weights = scratch0_condmat_.data();
-    BlockFromMatrix(previous_weights, weights, ntotal_new, ntotal_new, ntotal_,
-                    ntotal_, 0, 0);
-
-    // set previous in new weights (dimension may have increased)
-    mju_zero(weights, ntotal_ * ntotal_);
-    mju_copy(weights, previous_weights, ntotal_new * ntotal_new);
+    // leading band rows are the leading block of the prior weights
 
     // compute difference in estimation horizons
     int horizon_diff = configuration_length_ - horizon;
@@ -136,8 +136,8 @@ class Batch : public Direct, public Estimator {
   // set prior weights
   void SetPriorWeights(const double* weights, double scale = 1.0);
 
-  // get prior weights
-  const double* PriorWeights() { return weight_prior_.data(); }
+  // get prior weights (dense, assembled from band)
+  const double* PriorWeights();
 
   // state (nstate_)
   std::vector<double> state;
@@ -170,6 +170,12 @@ class Batch : public Direct, public Estimator {
   // Jacobian
   void JacobianPrior();
 
+  // set prior weight rows [index, index + n) to scale_prior * I
+  void SetPriorWeightsDiagonal(int index, int n);
+
+  // marginalize first configuration of cost Hessian into prior weights
+  void MarginalizePrior();
+
   // initialize filter mode
   void InitializeFilter();
 
@@ -210,13 +216,8 @@ class Batch : public Direct, public Estimator {
   std::vector<double> weight_prior_band_;  // (nv * max_history_ + nparam) * (nv
                                            // * max_history_ + nparam)
 
-  // conditioned matrix
-  std::vector<double> mat00_;
-  std::vector<double> mat10_;
-  std::vector<double> mat11_;
-  std::vector<double> condmat_;
-  std::vector<double> scratch0_condmat_;
-  std::vector<double> scratch1_condmat_;
+  // marginalization scratch
+  std::vector<double> scratch_marginal_;  // 9 * nv * nv
 
   // filter mode status
   int current_time_index_;
@@ -21,6 +21,7 @@
 
 #include <mujoco/mujoco.h>
 
+#include "mjpc/derivatives.h"
 #include "mjpc/utilities.h"
 
 namespace mjpc {
@@ -29,6 +30,9 @@ namespace mjpc {
 inline constexpr int kMaxProcessNoise = 1028;
 inline constexpr int kMaxSensorNoise = 1028;
 
+// minimum diagonal of regularized covariance factorizations
+inline constexpr double kMinCovarianceDiagonal = 1.0e-12;
+
 // virtual estimator class
 class Estimator {
  public:
@@ -95,6 +99,10 @@ class Estimator {
   virtual void Plots(mjvFigure* fig_planner, mjvFigure* fig_timer,
                      int planner_shift, int timer_shift, int planning,
                      int* shift) = 0;
+
+  // Jacobians shared with other consumers of the model (e.g., planner), not
+  // owned
+  DerivativeCache* derivative_cache = nullptr;
 };
 
 // ground truth estimator
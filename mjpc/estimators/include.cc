@@ -24,7 +24,9 @@ const char kEstimatorNames[] =
     "Ground Truth\n"
     "Kalman\n"
     "Unscented\n"
-    "Batch";
+    "Batch\n"
+    "Square Root Kalman\n"
+    "Square Root Unscented";
 
 // load all available estimators
 std::vector<std::unique_ptr<mjpc::Estimator>> LoadEstimators() {
@@ -36,6 +38,8 @@ std::vector<std::unique_ptr<mjpc::Estimator>> LoadEstimators() {
   estimators.emplace_back(new mjpc::Kalman());       // extended Kalman filter
   estimators.emplace_back(new mjpc::Unscented());    // unscented Kalman filter
   estimators.emplace_back(new mjpc::Batch());       // recursive batch filter
+  estimators.emplace_back(new mjpc::SquareRootKalman());     // square-root EKF
+  estimators.emplace_back(new mjpc::SquareRootUnscented());  // square-root UKF
 
   return estimators;
 }
@@ -14,6 +14,7 @@
 
 #include "mjpc/estimators/kalman.h"
 
+#include <algorithm>
 #include <chrono>
 #include <string>
 #include <vector>
@@ -32,6 +33,7 @@ void Kalman::Initialize(const mjModel* model) {
   // model
   if (this->model) mj_deleteModel(this->model);
   this->model = mj_copyModel(nullptr, model);
+  source_model_ = model;
 
   // data
   if (this->data_) mj_deleteData(this->data_);
@@ -41,6 +43,15 @@ void Kalman::Initialize(const mjModel* model) {
   this->model->opt.timestep = GetNumberOrDefault(this->model->opt.timestep,
                                                  model, "estimator_timestep");
 
+  // sequential measurement update, square-root filters keep their factor
+  int sequential = GetNumberOrDefault(static_cast<int>(settings.sequential),
+                                      model, "kalman_sequential");
+  if (sequential && settings.square_root) {
+    mju_warning("kalman_sequential is ignored by the square-root filter\n");
+  } else {
+    settings.sequential = sequential;
+  }
+
   // dimension
   nstate_ = model->nq + model->nv + model->na;
   ndstate_ = 2 * model->nv + model->na;
@@ -88,12 +99,22 @@ void Kalman::Initialize(const mjModel* model) {
   // correction
   correction_.resize(ndstate_);
 
+  // sequential update
+  timer_sensor_.resize(nsensor_);
+
   // scratch
   tmp0_.resize(ndstate_ * nsensordata_);
   tmp1_.resize(nsensordata_ * nsensordata_);
   tmp2_.resize(nsensordata_ * ndstate_);
   tmp3_.resize(ndstate_ * ndstate_);
 
+  // square root
+  int narray = nsensordata_ + ndstate_;
+  covariance_factor_.resize(ndstate_ * ndstate_);
+  pre_array_.resize(std::max(narray * narray, 2 * ndstate_ * ndstate_));
+  post_array_.resize(narray * narray);
+  householder_.resize(std::max(narray, 2 * ndstate_));
+
   // -- GUI data -- //
 
   // time step
@@ -165,12 +186,21 @@ void Kalman::Reset(const mjData* data) {
   timer_measurement_ = 0.0;
   timer_prediction_ = 0.0;
 
+  // sequential update
+  std::fill(timer_sensor_.begin(), timer_sensor_.end(), 0.0);
+  num_sensor_updated_ = 0;
+
   // scratch
   std::fill(tmp0_.begin(), tmp0_.end(), 0.0);
   std::fill(tmp1_.begin(), tmp1_.end(), 0.0);
   std::fill(tmp2_.begin(), tmp2_.end(), 0.0);
   std::fill(tmp3_.begin(), tmp3_.end(), 0.0);
 
+  // square root, factorized at the first update
+  std::fill(covariance_factor_.begin(), covariance_factor_.end(), 0.0);
+  covariance_dirty_ = false;
+  factor_dirty_ = true;
+
   // time step
   gui_timestep_ = model->opt.timestep;
 
@@ -185,7 +215,8 @@ void Kalman::Reset(const mjData* data) {
 }
 
 // update measurement
-void Kalman::UpdateMeasurement(const double* ctrl, const double* sensor) {
+void Kalman::UpdateMeasurement(const double* ctrl, const double* sensor,
+                               const int* sensor_mask) {
   // start timer
   auto start = std::chrono::steady_clock::now();
 
@@ -209,12 +240,27 @@ void Kalman::UpdateMeasurement(const double* ctrl, const double* sensor) {
   // -- Kalman gain: P * C' (C * P * C' + R)^-1 -- //
 
   // sensor Jacobian
-  mjd_transitionFD(model, data_, settings.epsilon, settings.flg_centered, NULL,
-                   NULL, sensor_jacobian_.data(), NULL);
+  TransitionJacobians(NULL, sensor_jacobian_.data());
 
   // grab rows
   double* C = sensor_jacobian_.data() + sensor_start_index_ * ndstate_;
 
+  // sequential update, the square-root update takes precedence
+  if (settings.sequential && !settings.square_root) {
+    SequentialMeasurement(C, sensor_mask);
+    timer_measurement_ = 1.0e-3 * GetDuration(start);
+    return;
+  }
+
+  // square-root update, dense update if the innovation factor is singular
+  if (settings.square_root && SquareRootMeasurement(C)) {
+    timer_measurement_ = 1.0e-3 * GetDuration(start);
+    return;
+  }
+
+  // dense covariance
+  CovarianceFromFactor();
+
   // P * C' = tmp0
   mju_mulMatMatT(tmp0_.data(), covariance.data(), C, ndstate_, ndstate_,
                  nsensordata_);
@@ -228,12 +274,8 @@ void Kalman::UpdateMeasurement(const double* ctrl, const double* sensor) {
     tmp1_[nsensordata_ * i + i] += noise_sensor[i];
   }
 
-  // factorize: C * P * C' + R
-  int rank = mju_cholFactor(tmp1_.data(), nsensordata_, 0.0);
-  if (rank < nsensordata_) {
-    // TODO(taylor): remove and return status
-    mju_error("measurement update rank: (%i / %i)\n", rank, nsensordata_);
-  }
+  // factorize: C * P * C' + R, regularized if P lost definiteness
+  mju_cholFactor(tmp1_.data(), nsensordata_, kMinCovarianceDiagonal);
 
   // -- correction: (P * C') * (C * P * C' + R)^-1 * sensor_error -- //
 
@@ -270,11 +312,220 @@ void Kalman::UpdateMeasurement(const double* ctrl, const double* sensor) {
 
   // symmetrize
   mju_symmetrize(covariance.data(), covariance.data(), ndstate_);
+  factor_dirty_ = true;
 
   // stop timer (ms)
   timer_measurement_ = 1.0e-3 * GetDuration(start);
 }
 
+// refactorize covariance if it changed since the last factorization
+void Kalman::FactorCovariance() {
+  if (!factor_dirty_) return;
+
+  // factorize, regularized if covariance lost definiteness
+  int n = ndstate_;
+  mju_copy(covariance_factor_.data(), covariance.data(), n * n);
+  if (mju_cholFactor(covariance_factor_.data(), n, 0.0) < n) {
+    mju_copy(covariance_factor_.data(), covariance.data(), n * n);
+    mju_cholFactor(covariance_factor_.data(), n, kMinCovarianceDiagonal);
+  }
+
+  // zero upper triangle
+  for (int i = 0; i < ndstate_; i++) {
+    mju_zero(covariance_factor_.data() + i * n + i + 1, n - i - 1);
+  }
+  factor_dirty_ = false;
+}
+
+// covariance from factor if a square-root update changed it
+void Kalman::CovarianceFromFactor() {
+  if (!covariance_dirty_) return;
+  double* S = covariance_factor_.data();
+  mju_mulMatMatT(covariance.data(), S, S, ndstate_, ndstate_, ndstate_);
+  mju_symmetrize(covariance.data(), covariance.data(), ndstate_);
+  covariance_dirty_ = false;
+}
+
+// square-root measurement update with sensor Jacobian C
+// "Square-Root Algorithms for Least-Squares Estimation", Morf and Kailath
+bool Kalman::SquareRootMeasurement(const double* C) {
+  // dimensions
+  int nq = model->nq, nv = model->nv, na = model->na;
+  int ny = nsensordata_, n = ndstate_, narray = ny + n;
+
+  // covariance factor: P = S * S'
+  FactorCovariance();
+  double* S = covariance_factor_.data();
+
+  // pre-array: [R^1/2, C * S; 0, S]
+  double* pre = pre_array_.data();
+  mju_zero(pre, narray * narray);
+  for (int i = 0; i < ny; i++) {
+    pre[narray * i + i] = mju_sqrt(noise_sensor[i]);
+  }
+  mju_mulMatMat(tmp0_.data(), C, S, ny, n, n);
+  SetBlockInMatrix(pre, tmp0_.data(), 1.0, narray, narray, ny, n, 0, ny);
+  SetBlockInMatrix(pre, S, 1.0, narray, narray, n, n, ny, ny);
+
+  // post-array: [(C * P * C' + R)^1/2, 0; P * C' * (C * P * C' + R)^-T/2, S+]
+  double* post = post_array_.data();
+  TriangularFactor(post, pre, narray, narray, householder_.data());
+
+  // singular innovation factor, leave estimate for dense update
+  for (int i = 0; i < ny; i++) {
+    double d = post[narray * i + i];
+    if (d * d < kMinCovarianceDiagonal) return false;
+  }
+
+  // -- correction: P * C' * (C * P * C' + R)^-1 * sensor_error -- //
+
+  // tmp2 = (C * P * C' + R)^-1/2 \ sensor_error
+  double* z = tmp2_.data();
+  for (int i = 0; i < ny; i++) {
+    z[i] = (sensor_error_[i] - mju_dot(post + narray * i, z, i)) /
+           post[narray * i + i];
+  }
+
+  // correction = post[ny:, :ny] * tmp2
+  mju_zero(correction_.data(), n);
+  for (int i = 0; i < n; i++) {
+    correction_[i] = mju_dot(post + narray * (ny + i), z, ny);
+  }
+
+  // -- state update -- //
+
+  // configuration
+  mj_integratePos(model, state.data(), correction_.data(), 1.0);
+
+  // velocity + act
+  mju_addTo(state.data() + nq, correction_.data() + nv, nv + na);
+
+  // -- covariance update -- //
+  BlockFromMatrix(S, post, n, n, narray, narray, ny, ny);
+  covariance_dirty_ = true;
+  return true;
+}
+
+// sequential scalar measurement update with sensor Jacobian C, exact for
+// diagonal sensor noise without factorizing C * P * C' + R
+void Kalman::SequentialMeasurement(const double* C, const int* sensor_mask) {
+  // dimensions
+  int nq = model->nq, nv = model->nv, na = model->na;
+  int n = ndstate_;
+
+  // unpack
+  CovarianceFromFactor();
+  double* P = covariance.data();
+  double* dx = correction_.data();
+  double* Pc = tmp3_.data();
+  mju_zero(dx, n);
+
+  // loop over sensors
+  num_sensor_updated_ = 0;
+  int adr = 0;
+  for (int i = 0; i < nsensor_; i++) {
+    // start timer
+    auto start = std::chrono::steady_clock::now();
+
+    // skip sensors without new data
+    int dim = model->sensor_dim[sensor_start_ + i];
+    if (sensor_mask && !sensor_mask[i]) {
+      timer_sensor_[i] = 0.0;
+      adr += dim;
+      continue;
+    }
+
+    // scalar updates, error linearized at the prior state
+    for (int k = adr; k < adr + dim; k++) {
+      const double* c = C + k * n;
+
+      // Pc = P * c'
+      mju_mulMatVec(Pc, P, c, n, n);
+
+      // innovation variance: c * P * c' + r
+      double innovation = mju_dot(c, Pc, n) + noise_sensor[k];
+
+      // correction += P * c' * (sensor_error - c * correction) / innovation
+      double error = sensor_error_[k] - mju_dot(c, dx, n);
+      mju_addToScl(dx, Pc, error / innovation, n);
+
+      // P -= P * c' * c * P / innovation
+      for (int j = 0; j < n; j++) {
+        mju_addToScl(P + j * n, Pc, -Pc[j] / innovation, n);
+      }
+    }
+
+    // stop timer (ms)
+    timer_sensor_[i] = 1.0e-3 * GetDuration(start);
+    num_sensor_updated_++;
+    adr += dim;
+  }
+
+  // -- state update -- //
+
+  // configuration
+  mj_integratePos(model, state.data(), dx, 1.0);
+
+  // velocity + act
+  mju_addTo(state.data() + nq, dx + nv, nv + na);
+
+  // symmetrize
+  mju_symmetrize(P, P, n);
+  factor_dirty_ = true;
+}
+
+// square-root prediction update with dynamics Jacobian
+void Kalman::SquareRootPrediction() {
+  int n = ndstate_;
+
+  // covariance factor: P = S * S'
+  FactorCovariance();
+  double* S = covariance_factor_.data();
+
+  // pre-array: [A * S, Q^1/2]
+  double* pre = pre_array_.data();
+  mju_zero(pre, n * 2 * n);
+  mju_mulMatMat(tmp3_.data(), dynamics_jacobian_.data(), S, n, n, n);
+  SetBlockInMatrix(pre, tmp3_.data(), 1.0, n, 2 * n, n, n, 0, 0);
+  for (int i = 0; i < n; i++) {
+    pre[2 * n * i + n + i] = mju_sqrt(noise_process[i]);
+  }
+
+  // S+ * S+' = A * P * A' + Q
+  TriangularFactor(S, pre, n, 2 * n, householder_.data());
+  covariance_dirty_ = true;
+}
+
+// transition Jacobians at data_, shared with planner through derivative cache
+void Kalman::TransitionJacobians(double* A, double* C) {
+  int sensor_end = sensor_start_index_ + nsensordata_;
+
+  // Jacobians computed by another consumer of the source model
+  if (derivative_cache &&
+      derivative_cache->Lookup(model, data_, settings.epsilon,
+                               settings.flg_centered, A, NULL, C, NULL,
+                               sensor_start_index_, sensor_end,
+                               source_model_)) {
+    return;
+  }
+
+  // finite difference
+  if (settings.flg_coloring) {
+    derivatives_.Transition(model, data_, settings.epsilon,
+                            settings.flg_centered, A, NULL, C, NULL,
+                            sensor_start_index_, sensor_end);
+  } else {
+    mjd_transitionFD(model, data_, settings.epsilon, settings.flg_centered, A,
+                     NULL, C, NULL);
+  }
+
+  if (derivative_cache) {
+    derivative_cache->Store(model, data_, settings.epsilon,
+                            settings.flg_centered, A, NULL, C, NULL,
+                            sensor_start_index_, sensor_end, source_model_);
+  }
+}
+
 // update time
 void Kalman::UpdatePrediction() {
   // start timer
@@ -289,8 +540,7 @@ void Kalman::UpdatePrediction() {
   mju_copy(data_->act, state.data() + nq + nv, na);
 
   // dynamics Jacobian
-  mjd_transitionFD(model, data_, settings.epsilon, settings.flg_centered,
-                   dynamics_jacobian_.data(), NULL, NULL, NULL);
+  TransitionJacobians(dynamics_jacobian_.data(), NULL);
 
   // integrate state
   mj_step(model, data_);
@@ -300,7 +550,15 @@ void Kalman::UpdatePrediction() {
   mju_copy(state.data() + nq, data_->qvel, nv);
   mju_copy(state.data() + nq + nv, data_->act, na);
 
+  // square-root update
+  if (settings.square_root) {
+    SquareRootPrediction();
+    timer_prediction_ = 1.0e-3 * GetDuration(start);
+    return;
+  }
+
   // -- update covariance: P = A * P * A' -- //
+  CovarianceFromFactor();
 
   //  tmp = P * A'
   mju_mulMatMatT(tmp3_.data(), covariance.data(), dynamics_jacobian_.data(),
@@ -317,6 +575,7 @@ void Kalman::UpdatePrediction() {
 
   // symmetrize
   mju_symmetrize(covariance.data(), covariance.data(), ndstate_);
+  factor_dirty_ = true;
 
   // stop timer
   timer_prediction_ = 1.0e-3 * GetDuration(start);
@@ -561,8 +820,12 @@ void Kalman::Plots(mjvFigure* fig_planner, mjvFigure* fig_timer,
   // Kalman info
   double estimator_bounds[2] = {-6, 6};
 
-  // covariance trace
-  double trace = Trace(covariance.data(), DimensionProcess());
+  // covariance trace, tr(S * S') = |S|^2 if only the factor is current
+  int n = DimensionProcess();
+  double trace =
+      covariance_dirty_
+          ? mju_dot(covariance_factor_.data(), covariance_factor_.data(), n * n)
+          : Trace(covariance.data(), n);
   mjpc::PlotUpdateData(fig_planner, estimator_bounds,
                        fig_planner->linedata[planner_shift + 0][0] + 1,
                        mju_log10(trace), 100, planner_shift + 0, 0, 1, -100);
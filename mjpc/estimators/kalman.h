@@ -20,6 +20,7 @@
 
 #include <mujoco/mujoco.h>
 
+#include "mjpc/derivatives.h"
 #include "mjpc/estimators/estimator.h"
 #include "mjpc/utilities.h"
 
@@ -47,13 +48,17 @@ class Kalman : public Estimator {
   // reset memory
   void Reset(const mjData* data = nullptr) override;
 
-  // update measurement
-  void UpdateMeasurement(const double* ctrl, const double* sensor);
+  // update measurement, sensor_mask (nsensor_) flags sensors with new data
+  // for the sequential update, nullptr uses every sensor. the mask is only
+  // available through this method; Update() and the estimator pipeline
+  // always pass every sensor
+  void UpdateMeasurement(const double* ctrl, const double* sensor,
+                         const int* sensor_mask = nullptr);
 
   // update time
   void UpdatePrediction();
 
-  // update
+  // update, every sensor is used
   void Update(const double* ctrl, const double* sensor, int mode = 0) override {
     // correct state with latest measurement
     if (mode == 0 || mode == 1) UpdateMeasurement(ctrl, sensor);
@@ -68,8 +73,17 @@ class Kalman : public Estimator {
   // get state
   double* State() override { return state.data(); };
 
-  // get covariance
-  double* Covariance() override { return covariance.data(); };
+  // get covariance, built from the factor if a square-root update changed it
+  double* Covariance() override {
+    CovarianceFromFactor();
+    return covariance.data();
+  };
+
+  // get lower-triangular covariance factor (ndstate_ x ndstate_)
+  const double* CovarianceFactor() {
+    FactorCovariance();
+    return covariance_factor_.data();
+  }
 
   // get time
   double& Time() override { return time; };
@@ -106,6 +120,8 @@ class Kalman : public Estimator {
   // set covariance
   void SetCovariance(const double* covariance) override {
     mju_copy(this->covariance.data(), covariance, ndstate_ * ndstate_);
+    covariance_dirty_ = false;
+    factor_dirty_ = true;
   }
 
   // get measurement timer (ms)
@@ -114,6 +130,12 @@ class Kalman : public Estimator {
   // get prediction timer (ms)
   double TimerPrediction() const { return timer_prediction_; }
 
+  // get sequential measurement timer of sensor i (ms), zero if skipped
+  double TimerSensor(int i) const { return timer_sensor_[i]; }
+
+  // number of sensors updated by the last sequential measurement update
+  int NumSensorUpdated() const { return num_sensor_updated_; }
+
   // estimator-specific GUI elements
   void GUI(mjUI& ui) override;
 
@@ -131,7 +153,8 @@ class Kalman : public Estimator {
   std::vector<double> state;
   double time;
 
-  // covariance (ndstate_ x ndstate_)
+  // covariance (ndstate_ x ndstate_), read with Covariance() and write with
+  // SetCovariance() once square-root updates have started
   std::vector<double> covariance;
 
   // process noise (ndstate_)
@@ -144,9 +167,32 @@ class Kalman : public Estimator {
   struct Settings {
     double epsilon = 1.0e-6;
     bool flg_centered = false;
+    bool flg_coloring = true;  // perturb independent trees together
+    bool square_root = false;  // propagate Cholesky factor of covariance
+    bool sequential = false;   // scalar updates, ignored with square_root
   } settings;
 
  private:
+  // refactorize covariance if it changed since the last factorization
+  void FactorCovariance();
+
+  // square-root measurement update with sensor Jacobian C, returns false
+  // without changing the estimate if the innovation factor is singular
+  bool SquareRootMeasurement(const double* C);
+
+  // sequential scalar measurement update with sensor Jacobian C
+  void SequentialMeasurement(const double* C, const int* sensor_mask);
+
+  // square-root prediction update with dynamics Jacobian
+  void SquareRootPrediction();
+
+  // covariance from factor if a square-root update changed it
+  void CovarianceFromFactor();
+
+  // transition Jacobians at data_ (A: ndstate_ x ndstate_,
+  // C: nsensordata x ndstate_), NULL outputs are skipped
+  void TransitionJacobians(double* A, double* C);
+
   // dimensions
   int nstate_;
   int ndstate_;
@@ -160,6 +206,9 @@ class Kalman : public Estimator {
   // data
   mjData* data_ = nullptr;
 
+  // model passed to Initialize, identifies shared Jacobians (not owned)
+  const mjModel* source_model_ = nullptr;
+
   // correction (ndstate_)
   std::vector<double> correction_;
 
@@ -172,6 +221,25 @@ class Kalman : public Estimator {
   // sensor error (nsensordata_)
   std::vector<double> sensor_error_;
 
+  // covariance factor, lower triangular (ndstate_ x ndstate_)
+  std::vector<double> covariance_factor_;
+
+  // covariance is older than covariance_factor_, or vice versa
+  bool covariance_dirty_ = false;
+  bool factor_dirty_ = true;
+
+  // square-root pre-array ((nsensordata_ + ndstate_)^2) and its factor
+  std::vector<double> pre_array_;
+  std::vector<double> post_array_;
+  std::vector<double> householder_;
+
+  // sequential measurement timer per sensor (ms) (nsensor_)
+  std::vector<double> timer_sensor_;
+  int num_sensor_updated_;
+
+  // colored finite-difference derivatives
+  ColoredDerivatives derivatives_;
+
   // timer (ms)
   double timer_measurement_;
   double timer_prediction_;
@@ -197,6 +265,19 @@ class Kalman : public Estimator {
   std::vector<double> gui_sensor_noise_;
 };
 
+// square-root Kalman filter, propagates a Cholesky factor of the covariance
+// with orthogonal transformations
+class SquareRootKalman : public Kalman {
+ public:
+  // constructor
+  SquareRootKalman() { settings.square_root = true; }
+  explicit SquareRootKalman(const mjModel* model) {
+    settings.square_root = true;
+    Initialize(model);
+    Reset();
+  }
+};
+
 }  // namespace mjpc
 
 #endif  // MJPC_ESTIMATORS_KALMAN_H_
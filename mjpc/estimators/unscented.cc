@@ -14,7 +14,9 @@
 
 #include "mjpc/estimators/unscented.h"
 
+#include <algorithm>
 #include <chrono>
+#include <memory>
 #include <string>
 #include <vector>
 
@@ -22,6 +24,7 @@
 
 #include "mjpc/array_safety.h"
 #include "mjpc/estimators/estimator.h"
+#include "mjpc/threadpool.h"
 #include "mjpc/utilities.h"
 
 namespace mjpc {
@@ -40,6 +43,21 @@ void Unscented::Initialize(const mjModel* model) {
   // settings
   settings.alpha = GetNumberOrDefault(1.0, model, "unscented_alpha");
   settings.beta = GetNumberOrDefault(2.0, model, "unscented_beta");
+  settings.num_threads = GetNumberOrDefault(1, model, "unscented_threads");
+
+  // thread pool
+  if (settings.num_threads > 1) {
+    pool_ = std::make_unique<ThreadPool>(settings.num_threads);
+  } else {
+    pool_.reset();
+  }
+
+  // sigma point data
+  data_threads_.clear();
+  int num_threads = Pool() ? Pool()->NumThreads() : 1;
+  for (int i = 0; i < num_threads; i++) {
+    data_threads_.push_back(MakeUniqueMjData(mj_makeData(model)));
+  }
 
   // timestep
   this->model->opt.timestep = GetNumberOrDefault(this->model->opt.timestep,
@@ -100,8 +118,8 @@ void Unscented::Initialize(const mjModel* model) {
   // covariance factor (ndstate x ndstate)
   covariance_factor_.resize(ndstate_ * ndstate_);
 
-  // factor column (ndstate)
-  factor_column_.resize(ndstate_);
+  // factor columns (ndstate x ndstate)
+  factor_column_.resize(ndstate_ * ndstate_);
 
   // state difference (ndstate x nsigma_)
   state_difference_.resize(ndstate_ * nsigma_);
@@ -130,6 +148,13 @@ void Unscented::Initialize(const mjModel* model) {
   // covariance sensor factor
   covariance_sensor_factor_.resize(nsensordata_ * nsensordata_);
 
+  // square root
+  state_array_.resize(ndstate_ * 3 * ndstate_);
+  sensor_array_.resize(nsensordata_ * (2 * ndstate_ + nsensordata_));
+  householder_.resize(std::max(3 * ndstate_, 2 * ndstate_ + nsensordata_));
+  gain_factor_.resize(ndstate_ * nsensordata_);
+  update_column_.resize(std::max(ndstate_, nsensordata_));
+
   // lambda
   double lambda = ndstate_ * (settings.alpha * settings.alpha - 1.0);
 
@@ -148,6 +173,9 @@ void Unscented::Initialize(const mjModel* model) {
   // correction
   correction_.resize(ndstate_);
 
+  // warmstart
+  warmstart_.resize(nv);
+
   // scratch
   tmp0_.resize(nsensordata_ * ndstate_);
   tmp1_.resize(ndstate_ * ndstate_);
@@ -261,6 +289,10 @@ void Unscented::Reset(const mjData* data) {
   std::fill(covariance_sensor_factor_.begin(), covariance_sensor_factor_.end(),
             0.0);
 
+  // square root, factorized at the first update
+  covariance_dirty_ = false;
+  factor_dirty_ = true;
+
   // sensor error
   mju_zero(sensor_error_.data(), nsensordata_);
 
@@ -289,33 +321,53 @@ void Unscented::Reset(const mjData* data) {
   std::fill(gui_sensor_noise_.begin(), gui_sensor_noise_.end(), noise_sensor_scl);
 }
 
+// factorize covariance, the square-root factor is only refactorized if the
+// covariance changed since the last factorization
+void Unscented::FactorCovariance() {
+  if (!factor_dirty_) return;
+
+  // factorize, regularized if covariance lost definiteness
+  int n = ndstate_;
+  mju_copy(covariance_factor_.data(), covariance.data(), n * n);
+  if (mju_cholFactor(covariance_factor_.data(), n, 0.0) < n) {
+    mju_copy(covariance_factor_.data(), covariance.data(), n * n);
+    mju_cholFactor(covariance_factor_.data(), n, kMinCovarianceDiagonal);
+  }
+
+  // zero upper triangle
+  for (int i = 0; i < n; i++) {
+    mju_zero(covariance_factor_.data() + i * n + i + 1, n - i - 1);
+  }
+  factor_dirty_ = false;
+}
+
+// covariance from factor if a square-root update changed it
+void Unscented::CovarianceFromFactor() {
+  if (!covariance_dirty_) return;
+  double* S = covariance_factor_.data();
+  mju_mulMatMatT(covariance.data(), S, S, ndstate_, ndstate_, ndstate_);
+  mju_symmetrize(covariance.data(), covariance.data(), ndstate_);
+  covariance_dirty_ = false;
+}
+
 // compute sigma points
 void Unscented::SigmaPoints() {
   // dimensions
   int nq = model->nq, nv = model->nv, na = model->na;
 
   // factorize covariance
-  mju_copy(covariance_factor_.data(), covariance.data(), ndstate_ * ndstate_);
-  int rank = mju_cholFactor(covariance_factor_.data(), ndstate_, 0.0);
-
-  // check failure
-  if (rank < ndstate_) {
-    // TODO(taylor): remove and return status
-    mju_error("covariance factorization failure: (%i / %i)\n", rank, ndstate_);
-  }
+  FactorCovariance();
 
   // -- loop over points -- //
 
   // nominal
   mju_copy(sigma_.data() + (nsigma_ - 1) * nstate_, state.data(), nstate_);
 
-  // unpack
-  double* column = factor_column_.data();
-
-  // loop over sigma points
-  // TODO(taylor): thread?
+  // (+) and (-) sigma points along each column of the factor, serial: each
+  // pair is only O(nstate) work, the steps are parallel in EvaluateSigmaPoints
   for (int i = 0; i < ndstate_; i++) {
     // zero column memory
+    double* column = factor_column_.data() + i * ndstate_;
     mju_zero(column, ndstate_);
 
     // column elements
@@ -348,45 +400,89 @@ void Unscented::SigmaPoints() {
   }
 }
 
-// evaluate sigma points
-// TODO(taylor): thread?
-void Unscented::EvaluateSigmaPoints() {
+// evaluate sigma point i with data
+void Unscented::EvaluateSigmaPoint(int i, mjData* data, double time) {
   // dimensions
   int nq = model->nq, nv = model->nv, na = model->na;
 
-  // zero memory
-  mju_zero(state_mean_.data(), nstate_);
-  mju_zero(sensor_mean_.data(), nsensordata_);
+  // set state
+  double* sigma = sigma_.data() + i * nstate_;
+  mju_copy(data->qpos, sigma, nq);
+  mju_copy(data->qvel, sigma + nq, nv);
+  mju_copy(data->act, sigma + nq + nv, na);
+  mju_copy(data->qacc_warmstart, warmstart_.data(), nv);
+  data->time = time;
+
+  // step
+  mj_step(model, data);
+
+  // get state
+  double* s = states_.data() + i * nstate_;
+  mju_copy(s, data->qpos, nq);
+  mju_copy(s + nq, data->qvel, nv);
+  mju_copy(s + nq + nv, data->act, na);
+
+  // get sensor
+  double* y = sensors_.data() + i * nsensordata_;
+  mju_copy(y, data->sensordata + sensor_start_index_, nsensordata_);
+}
 
+// evaluate sigma points
+void Unscented::EvaluateSigmaPoints() {
   // time cache
   double time_cache = data_->time;
 
-  // loop over sigma points
+  // every sigma point starts from the same warmstart, so the result does not
+  // depend on the order or thread in which the points are stepped
+  mju_copy(warmstart_.data(), data_->qacc_warmstart, model->nv);
+
+  // sigma point data for each thread, allocated if the shared pool changed
+  ThreadPool* thread_pool = Pool();
+  int num_threads = thread_pool ? thread_pool->NumThreads() : 1;
+  while (static_cast<int>(data_threads_.size()) < num_threads) {
+    data_threads_.push_back(MakeUniqueMjData(mj_makeData(model)));
+  }
+
+  // copy inputs
+  for (int i = 0; i < num_threads; i++) {
+    mjData* d = data_threads_[i].get();
+    mju_copy(d->ctrl, data_->ctrl, model->nu);
+    mju_copy(d->qfrc_applied, data_->qfrc_applied, model->nv);
+    mju_copy(d->xfrc_applied, data_->xfrc_applied, 6 * model->nbody);
+    mju_copy(d->mocap_pos, data_->mocap_pos, 3 * model->nmocap);
+    mju_copy(d->mocap_quat, data_->mocap_quat, 4 * model->nmocap);
+    mju_copy(d->userdata, data_->userdata, model->nuserdata);
+  }
+
+  // step sigma points, the nominal point is stepped with data_
+  if (!thread_pool) {
+    for (int i = 0; i < nsigma_ - 1; i++) {
+      EvaluateSigmaPoint(i, data_threads_[0].get(), time_cache);
+    }
+    EvaluateSigmaPoint(nsigma_ - 1, data_, time_cache);
+  } else {
+    int count_before = thread_pool->GetCount();
+    for (int i = 0; i < nsigma_; i++) {
+      thread_pool->Schedule([this, i, time_cache]() {
+        mjData* d = i == nsigma_ - 1
+                        ? data_
+                        : data_threads_[ThreadPool::WorkerId()].get();
+        EvaluateSigmaPoint(i, d, time_cache);
+      });
+    }
+    thread_pool->WaitCount(count_before + nsigma_);
+    thread_pool->ResetCount();
+  }
+
+  // update means, in sigma point order
+  mju_zero(state_mean_.data(), nstate_);
+  mju_zero(sensor_mean_.data(), nsensordata_);
   for (int i = 0; i < nsigma_; i++) {
-    // set state
-    double* sigma = sigma_.data() + i * nstate_;
-    mju_copy(data_->qpos, sigma, nq);
-    mju_copy(data_->qvel, sigma + nq, nv);
-    mju_copy(data_->act, sigma + nq + nv, na);
-    data_->time = time_cache;
-
-    // step
-    mj_step(model, data_);
-
-    // get state
-    double* s = states_.data() + i * nstate_;
-    mju_copy(s, data_->qpos, nq);
-    mju_copy(s + nq, data_->qvel, nv);
-    mju_copy(s + nq + nv, data_->act, na);
-
-    // get sensor
-    double* y = sensors_.data() + i * nsensordata_;
-    mju_copy(y, data_->sensordata + sensor_start_index_, nsensordata_);
-
-    // update means
     double weight = (i == nsigma_ - 1 ? weight_mean0 : weight_sigma);
-    mju_addToScl(state_mean_.data(), s, weight, nstate_);
-    mju_addToScl(sensor_mean_.data(), y, weight, nsensordata_);
+    mju_addToScl(state_mean_.data(), states_.data() + i * nstate_, weight,
+                 nstate_);
+    mju_addToScl(sensor_mean_.data(), sensors_.data() + i * nsensordata_,
+                 weight, nsensordata_);
   }
 
   // compute correct quaternion means
@@ -480,6 +576,114 @@ void Unscented::SigmaCovariances() {
   }
 }
 
+// compute factors of sigma covariances (square root)
+bool Unscented::SquareRootCovariances() {
+  // dimensions
+  int n = ndstate_, ny = nsensordata_, ns = nsigma_ - 1;
+
+  // unpack
+  double* cov_sy = covariance_state_sensor_.data();
+  double* ds0 = state_difference_.data() + ns * n;
+  double* dy0 = sensor_difference_.data() + ns * ny;
+  double weight = mju_sqrt(weight_sigma);
+
+  // covariance state sensor
+  mju_mulMatTMat(cov_sy, state_difference_.data(), sensor_difference_.data(),
+                 ns, n, ny);
+  mju_scl(cov_sy, cov_sy, weight_sigma, n * ny);
+  for (int i = 0; i < n; i++) {
+    mju_addToScl(cov_sy + i * ny, dy0, weight_covariance0 * ds0[i], ny);
+  }
+
+  // state array: [w^1/2 * ds_1, ..., w^1/2 * ds_ns, Q^1/2]
+  double* state_array = state_array_.data();
+  mju_zero(state_array, n * 3 * n);
+  for (int j = 0; j < ns; j++) {
+    double* ds = state_difference_.data() + j * n;
+    for (int i = 0; i < n; i++) {
+      state_array[3 * n * i + j] = weight * ds[i];
+    }
+  }
+  for (int i = 0; i < n; i++) {
+    state_array[3 * n * i + ns + i] = mju_sqrt(noise_process[i]);
+  }
+
+  // sensor array: [w^1/2 * dy_1, ..., w^1/2 * dy_ns, R^1/2]
+  double* sensor_array = sensor_array_.data();
+  int nsensor_array = ns + ny;
+  mju_zero(sensor_array, ny * nsensor_array);
+  for (int j = 0; j < ns; j++) {
+    double* dy = sensor_difference_.data() + j * ny;
+    for (int i = 0; i < ny; i++) {
+      sensor_array[nsensor_array * i + j] = weight * dy[i];
+    }
+  }
+  for (int i = 0; i < ny; i++) {
+    sensor_array[nsensor_array * i + ns + i] = mju_sqrt(noise_sensor[i]);
+  }
+
+  // factors
+  TriangularFactor(covariance_factor_.data(), state_array, n, 3 * n,
+                   householder_.data());
+  TriangularFactor(covariance_sensor_factor_.data(), sensor_array, ny,
+                   nsensor_array, householder_.data());
+
+  // nominal sigma point, its weight can be negative
+  int flg_plus = weight_covariance0 >= 0.0;
+  double weight0 = mju_sqrt(mju_abs(weight_covariance0));
+  double* column = update_column_.data();
+
+  mju_scl(column, ds0, weight0, n);
+  int rank = mju_cholUpdate(covariance_factor_.data(), column, n, flg_plus);
+  if (rank < n) return false;
+
+  mju_scl(column, dy0, weight0, ny);
+  rank = mju_cholUpdate(covariance_sensor_factor_.data(), column, ny, flg_plus);
+  return rank == ny;
+}
+
+// square-root correction and covariance update
+bool Unscented::SquareRootCorrection(const double* sensor) {
+  // dimensions
+  int n = ndstate_, ny = nsensordata_;
+
+  // factors of sigma covariances
+  if (!SquareRootCovariances()) return false;
+  double* factor = covariance_sensor_factor_.data();
+
+  // gain: K = covariance_state_sensor * covariance_sensor^-1 = tmp0
+  for (int i = 0; i < n; i++) {
+    mju_cholSolve(tmp0_.data() + ny * i, factor,
+                  covariance_state_sensor_.data() + ny * i, ny);
+  }
+
+  // sensor error
+  mju_sub(sensor_error_.data(), sensor + sensor_start_index_,
+          sensor_mean_.data(), ny);
+
+  // correction = K * sensor_error
+  mju_mulMatVec(correction_.data(), tmp0_.data(), sensor_error_.data(), n, ny);
+
+  // -- covariance update: S * S' = P - (K * Sy) * (K * Sy)' -- //
+
+  // gain factor = K * Sy
+  mju_mulMatMat(gain_factor_.data(), tmp0_.data(), factor, n, ny, ny);
+
+  // downdate with columns of gain factor
+  double* column = update_column_.data();
+  for (int j = 0; j < ny; j++) {
+    for (int i = 0; i < n; i++) {
+      column[i] = gain_factor_[ny * i + j];
+    }
+    int rank = mju_cholUpdate(covariance_factor_.data(), column, n, 0);
+    if (rank < n) return false;
+  }
+
+  // covariance is built from the factor when read
+  covariance_dirty_ = true;
+  return true;
+}
+
 // unscented filter update
 void Unscented::Update(const double* ctrl, const double* sensor, int mode) {
   // start timer
@@ -503,20 +707,29 @@ void Unscented::Update(const double* ctrl, const double* sensor, int mode) {
   // compute sigma point difference
   SigmaPointDifferences();
 
+  // square-root update, dense update if a factor loses rank
+  if (settings.square_root && SquareRootCorrection(sensor)) {
+
+    // state update
+    mju_copy(state.data(), state_mean_.data(), nstate_);
+    mj_integratePos(model, state.data(), correction_.data(), 1.0);
+    mju_addTo(state.data() + nq, correction_.data() + nv, nv + na);
+
+    // update time
+    time = time_cache + model->opt.timestep;
+
+    // stop timer (ms)
+    timer_update_ = 1.0e-3 * GetDuration(start);
+    return;
+  }
+
   // compute sigma covariances
   SigmaCovariances();
 
-  // factorize covariance sensor
+  // factorize covariance sensor, regularized if it lost definiteness
   double* factor = covariance_sensor_factor_.data();
   mju_copy(factor, covariance_sensor_.data(), nsensordata_ * nsensordata_);
-  int rank = mju_cholFactor(factor, nsensordata_, 0.0);
-
-  // check failure
-  if (rank < nsensordata_) {
-    // TODO(taylor): remove and return status
-    mju_error("covariance sensor factorization failure (%i / %i)\n", rank,
-              nsensordata_);
-  }
+  mju_cholFactor(factor, nsensordata_, kMinCovarianceDiagonal);
 
   // -- correction -- //
 
@@ -565,6 +778,8 @@ void Unscented::Update(const double* ctrl, const double* sensor, int mode) {
 
   // symmetrize
   mju_symmetrize(covariance.data(), covariance.data(), ndstate_);
+  covariance_dirty_ = false;
+  factor_dirty_ = true;
 
   // update time
   time = time_cache + model->opt.timestep;
@@ -864,8 +1079,12 @@ void Unscented::Plots(mjvFigure* fig_planner, mjvFigure* fig_timer,
   // Unscented info
   double estimator_bounds[2] = {-6, 6};
 
-  // covariance trace
-  double trace = Trace(covariance.data(), DimensionProcess());
+  // covariance trace, tr(S * S') = |S|^2 if only the factor is current
+  int n = DimensionProcess();
+  double trace =
+      covariance_dirty_
+          ? mju_dot(covariance_factor_.data(), covariance_factor_.data(), n * n)
+          : Trace(covariance.data(), n);
   mjpc::PlotUpdateData(fig_planner, estimator_bounds,
                        fig_planner->linedata[planner_shift + 0][0] + 1,
                        mju_log10(trace), 100, planner_shift + 0, 0, 1, -100);
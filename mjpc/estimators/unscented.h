@@ -17,10 +17,12 @@
 
 #include <mujoco/mujoco.h>
 
+#include <memory>
 #include <mutex>
 #include <vector>
 
 #include "mjpc/estimators/estimator.h"
+#include "mjpc/threadpool.h"
 #include "mjpc/utilities.h"
 
 namespace mjpc {
@@ -54,12 +56,20 @@ class Unscented : public Estimator {
   // evaluate sigma points
   void EvaluateSigmaPoints();
 
+  // thread pool for sigma point steps, shared if set, otherwise owned when
+  // settings.num_threads > 1, nullptr when serial
+  ThreadPool* Pool() const { return pool ? pool : pool_.get(); }
+
   // compute sigma point differences
   void SigmaPointDifferences();
 
   // compute sigma covariances
   void SigmaCovariances();
 
+  // compute factors of sigma covariances (square root), returns false if a
+  // factor loses rank
+  bool SquareRootCovariances();
+
   // update
   void Update(const double* ctrl, const double* sensor, int mode = 0) override;
 
@@ -69,8 +79,17 @@ class Unscented : public Estimator {
   // get state
   double* State() override { return state.data(); };
 
-  // get covariance
-  double* Covariance() override { return covariance.data(); };
+  // get covariance, built from the factor if a square-root update changed it
+  double* Covariance() override {
+    CovarianceFromFactor();
+    return covariance.data();
+  };
+
+  // get lower-triangular covariance factor (ndstate_ x ndstate_)
+  const double* CovarianceFactor() {
+    FactorCovariance();
+    return covariance_factor_.data();
+  }
 
   // get time
   double& Time() override { return time; };
@@ -109,6 +128,8 @@ class Unscented : public Estimator {
   // set covariance
   void SetCovariance(const double* covariance) override {
     mju_copy(this->covariance.data(), covariance, ndstate_ * ndstate_);
+    covariance_dirty_ = false;
+    factor_dirty_ = true;
   };
 
   // get update timer (ms)
@@ -131,7 +152,8 @@ class Unscented : public Estimator {
   std::vector<double> state;
   double time;
 
-  // covariance (ndstate_ x ndstate_)
+  // covariance (ndstate_ x ndstate_), read with Covariance() and write with
+  // SetCovariance() once square-root updates have started
   std::vector<double> covariance;
 
   // process noise (ndstate_)
@@ -152,8 +174,14 @@ class Unscented : public Estimator {
   struct Settings {
     double alpha = 1.0;
     double beta = 2.0;
+    int num_threads = 1;
+    bool square_root = false;  // propagate Cholesky factor of covariance
   } settings;
 
+  // thread pool shared with other consumers, not owned. Update waits for and
+  // resets the task count of its calling thread.
+  ThreadPool* pool = nullptr;
+
  private:
   // dimensions
   int nstate_;
@@ -169,6 +197,28 @@ class Unscented : public Estimator {
   // data
   mjData* data_ = nullptr;
 
+  // sigma point data, one per pool thread
+  std::vector<UniqueMjData> data_threads_;
+
+  // owned thread pool
+  std::unique_ptr<ThreadPool> pool_;
+
+  // warmstart of data_ at the start of the update (nv)
+  std::vector<double> warmstart_;
+
+  // evaluate a single sigma point with data
+  void EvaluateSigmaPoint(int i, mjData* data, double time);
+
+  // refactorize covariance if it changed since the last factorization
+  void FactorCovariance();
+
+  // covariance from factor if a square-root update changed it
+  void CovarianceFromFactor();
+
+  // square-root correction and covariance update, returns false without
+  // changing the estimate if a factor loses rank
+  bool SquareRootCorrection(const double* sensor);
+
   // correction (ndstate_)
   std::vector<double> correction_;
 
@@ -193,7 +243,7 @@ class Unscented : public Estimator {
   // covariance factor (ndstate_ x ndstate_)
   std::vector<double> covariance_factor_;
 
-  // factor column (ndstate_)
+  // factor columns (ndstate_ x ndstate_)
   std::vector<double> factor_column_;
 
   // state difference (ndstate_ x nsigma_)
@@ -223,6 +273,27 @@ class Unscented : public Estimator {
   // covariance sensor factor (nsensordata_ x nsensordata_)
   std::vector<double> covariance_sensor_factor_;
 
+  // covariance is older than covariance_factor_, or vice versa
+  bool covariance_dirty_ = false;
+  bool factor_dirty_ = true;
+
+  // square-root state array: weighted differences and noise
+  // (ndstate_ x 3 ndstate_)
+  std::vector<double> state_array_;
+
+  // square-root sensor array: weighted differences and noise
+  // (nsensordata_ x (2 ndstate_ + nsensordata_))
+  std::vector<double> sensor_array_;
+
+  // Householder vector (max(3 ndstate_, 2 ndstate_ + nsensordata_))
+  std::vector<double> householder_;
+
+  // gain factor: K * covariance_sensor_factor_ (ndstate_ x nsensordata_)
+  std::vector<double> gain_factor_;
+
+  // rank-one update column (max(ndstate_, nsensordata_))
+  std::vector<double> update_column_;
+
   // timer (ms)
   double timer_update_;
 
@@ -245,6 +316,21 @@ class Unscented : public Estimator {
   std::vector<double> gui_sensor_noise_;
 };
 
+// square-root unscented filter, propagates a Cholesky factor of the
+// covariance with orthogonal transformations and rank-one updates
+// "The Square-Root Unscented Kalman Filter for State and
+// Parameter-Estimation"
+class SquareRootUnscented : public Unscented {
+ public:
+  // constructor
+  SquareRootUnscented() { settings.square_root = true; }
+  explicit SquareRootUnscented(const mjModel* model) {
+    settings.square_root = true;
+    Initialize(model);
+    Reset();
+  }
+};
+
 }  // namespace mjpc
 
 #endif  // MJPC_ESTIMATORS_UNSCENTED_H_
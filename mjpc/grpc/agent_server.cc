@@ -17,6 +17,7 @@
 #include <cstdint>
 #include <memory>
 #include <string>
+#include <vector>
 
 #include <absl/flags/flag.h>
 #include <absl/flags/parse.h>
@@ -28,34 +29,61 @@
 #include <grpcpp/server_context.h>
 
 #include "mjpc/grpc/agent_service.h"
+#include "mjpc/planning_scheduler.h"
 #include "mjpc/tasks/tasks.h"
+#include "mjpc/utilities.h"
 
 ABSL_FLAG(int32_t, mjpc_port, 10000, "port to listen on");
 ABSL_FLAG(int32_t, mjpc_workers, -1,
           "number of worker threads for MJPC planning. -1 means use the number "
           "of available hardware threads.");
+ABSL_FLAG(int32_t, mjpc_num_agents, 1,
+          "number of agents, served on consecutive ports starting at "
+          "mjpc_port. multiple agents plan on a single shared pool of "
+          "mjpc_workers threads.");
 
 int main(int argc, char** argv) {
   absl::ParseCommandLine(argc, argv);
   int port = absl::GetFlag(FLAGS_mjpc_port);
 
-  std::string server_address = absl::StrCat("[::]:", port);
+  int num_agents = absl::GetFlag(FLAGS_mjpc_num_agents);
+  int num_workers = absl::GetFlag(FLAGS_mjpc_workers);
 
-  std::shared_ptr<grpc::ServerCredentials> server_credentials =
-      grpc::experimental::LocalServerCredentials(LOCAL_TCP);
-  grpc::ServerBuilder builder;
-  builder.AddListeningPort(server_address, server_credentials);
+  // a single agent owns its pool, multiple agents share a scheduler
+  std::unique_ptr<mjpc::PlanningScheduler> scheduler;
+  if (num_agents > 1) {
+    scheduler = std::make_unique<mjpc::PlanningScheduler>(
+        num_workers == -1 ? mjpc::NumAvailableHardwareThreads() : num_workers);
+  }
 
-  mjpc::agent_grpc::AgentService service(mjpc::GetTasks(),
-                                         absl::GetFlag(FLAGS_mjpc_workers));
-  builder.SetMaxReceiveMessageSize(40 * 1024 * 1024);
-  builder.RegisterService(&service);
+  std::vector<std::unique_ptr<mjpc::agent_grpc::AgentService>> services;
+  std::vector<std::unique_ptr<grpc::Server>> servers;
+  for (int i = 0; i < num_agents; i++) {
+    std::string server_address = absl::StrCat("[::]:", port + i);
 
-  std::unique_ptr<grpc::Server> server(builder.BuildAndStart());
-  LOG(INFO) << "Server listening on " << server_address;
+    std::shared_ptr<grpc::ServerCredentials> server_credentials =
+        grpc::experimental::LocalServerCredentials(LOCAL_TCP);
+    grpc::ServerBuilder builder;
+    builder.AddListeningPort(server_address, server_credentials);
 
-  // Keep the program running until the server shuts down.
-  server->Wait();
+    if (scheduler) {
+      services.push_back(std::make_unique<mjpc::agent_grpc::AgentService>(
+          mjpc::GetTasks(), scheduler.get()));
+    } else {
+      services.push_back(std::make_unique<mjpc::agent_grpc::AgentService>(
+          mjpc::GetTasks(), num_workers));
+    }
+    builder.SetMaxReceiveMessageSize(40 * 1024 * 1024);
+    builder.RegisterService(services.back().get());
+
+    servers.push_back(builder.BuildAndStart());
+    LOG(INFO) << "Server listening on " << server_address;
+  }
+
+  // Keep the program running until the servers shut down.
+  for (auto& server : servers) {
+    server->Wait();
+  }
 
   return 0;
 }
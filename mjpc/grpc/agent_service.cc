@@ -17,7 +17,6 @@
 #include <string_view>
 #include <vector>
 
-#include <absl/log/check.h>
 #include <absl/strings/str_format.h>
 #include <grpcpp/server_context.h>
 #include <grpcpp/support/status.h>
@@ -64,24 +63,6 @@ using ::agent::SetTaskParametersResponse;
 using ::agent::StepRequest;
 using ::agent::StepResponse;
 
-// task used to define desired behaviour
-mjpc::Task* task = nullptr;
-
-// model used for physics
-mjModel* model = nullptr;
-
-// model used for planning, owned by the Agent instance.
-mjModel* agent_model = nullptr;
-
-void residual_sensor_callback(const mjModel* m, mjData* d, int stage) {
-  // with the `m == model` guard in place, no need to clear the callback.
-  if (m == agent_model || m == model) {
-    if (stage == mjSTAGE_ACC) {
-      task->Residual(m, d, d->sensordata);
-    }
-  }
-}
-
 grpc::Status AgentService::Init(grpc::ServerContext* context,
                                 const InitRequest* request,
                                 InitResponse* response) {
@@ -110,22 +91,24 @@ grpc::Status AgentService::Init(grpc::ServerContext* context,
   agent_.Allocate();
   agent_.Reset();
 
-  task = agent_.ActiveTask();
-  CHECK_EQ(agent_model, nullptr)
-      << "Multiple instances of AgentService detected.";
-  agent_model = agent_.GetModel();
   // copy the model before agent model's timestep and integrator are updated
-  CHECK_EQ(model, nullptr)
-      << "Multiple instances of AgentService detected.";
-  model = mj_copyModel(nullptr, agent_model);
-  data_ = mj_makeData(model);
-  rollout_data_.reset(mj_makeData(model));
-  int home_id = mj_name2id(model, mjOBJ_KEY, "home");
+  if (model_) {
+    UnregisterResidual(model_);
+    mj_deleteModel(model_);
+  }
+  if (data_) mj_deleteData(data_);
+  model_ = mj_copyModel(nullptr, agent_.GetModel());
+  data_ = mj_makeData(model_);
+  rollout_data_.reset(mj_makeData(model_));
+  int home_id = mj_name2id(model_, mjOBJ_KEY, "home");
   if (home_id >= 0) {
-    mj_resetDataKeyframe(model, data_, home_id);
-    mj_resetDataKeyframe(model, rollout_data_.get(), home_id);
+    mj_resetDataKeyframe(model_, data_, home_id);
+    mj_resetDataKeyframe(model_, rollout_data_.get(), home_id);
   }
-  mjcb_sensor = residual_sensor_callback;
+
+  // residuals of the physics model are evaluated by the active task, the
+  // agent registers its planning model itself
+  RegisterResidual(model_, agent_.ActiveTask());
 
   agent_.SetState(data_);
 
@@ -136,13 +119,12 @@ grpc::Status AgentService::Init(grpc::ServerContext* context,
 }
 
 AgentService::~AgentService() {
+  if (scheduler_) scheduler_->RemoveAgent(scheduler_id_);
   if (data_) mj_deleteData(data_);
-  if (model) mj_deleteModel(model);
-  model = nullptr;
-  // no need to delete agent_model and task, since they're owned by agent_.
-  agent_model = nullptr;
-  task = nullptr;
-  mjcb_sensor = nullptr;
+  if (model_) {
+    UnregisterResidual(model_);
+    mj_deleteModel(model_);
+  }
 }
 
 grpc::Status AgentService::GetState(grpc::ServerContext* context,
@@ -151,8 +133,8 @@ grpc::Status AgentService::GetState(grpc::ServerContext* context,
   if (!Initialized()) {
     return {grpc::StatusCode::FAILED_PRECONDITION, "Init not called."};
   }
-  agent_.state.CopyTo(model, data_);
-  return grpc_agent_util::GetState(model, data_, response);
+  agent_.state.CopyTo(model_, data_);
+  return grpc_agent_util::GetState(model_, data_, response);
 }
 
 grpc::Status AgentService::SetState(grpc::ServerContext* context,
@@ -162,12 +144,12 @@ grpc::Status AgentService::SetState(grpc::ServerContext* context,
     return {grpc::StatusCode::FAILED_PRECONDITION, "Init not called."};
   }
   grpc::Status status =
-      grpc_agent_util::SetState(request, &agent_, model, data_);
+      grpc_agent_util::SetState(request, &agent_, model_, data_);
   if (!status.ok()) return status;
 
-  mj_forward(model, data_);
+  mj_forward(model_, data_);
   // Further update the state by calling task's Transition function.
-  task->Transition(model, data_);
+  agent_.ActiveTask()->Transition(model_, data_);
   agent_.SetState(data_);
 
   return grpc::Status::OK;
@@ -181,10 +163,10 @@ grpc::Status AgentService::GetAction(grpc::ServerContext* context,
   }
   // get action
   auto out = grpc_agent_util::GetAction(
-      request, &agent_, model, rollout_data_.get(), &rollout_state_, response);
+      request, &agent_, model_, rollout_data_.get(), &rollout_state_, response);
   // set data
   auto action = response->action().data();
-  for (int i = 0; i < model->nu; i++) {
+  for (int i = 0; i < model_->nu; i++) {
     data_->ctrl[i] = action[i];
   }
   return out;
@@ -196,7 +178,7 @@ grpc::Status AgentService::GetResiduals(
   if (!Initialized()) {
     return {grpc::StatusCode::FAILED_PRECONDITION, "Init not called."};
   }
-  return grpc_agent_util::GetResiduals(request, &agent_, model,
+  return grpc_agent_util::GetResiduals(request, &agent_, model_,
                                        data_, response);
 }
 
@@ -206,7 +188,7 @@ grpc::Status AgentService::GetCostValuesAndWeights(
   if (!Initialized()) {
     return {grpc::StatusCode::FAILED_PRECONDITION, "Init not called."};
   }
-  return grpc_agent_util::GetCostValuesAndWeights(request, &agent_, model,
+  return grpc_agent_util::GetCostValuesAndWeights(request, &agent_, model_,
                                                   data_, response);
 }
 
@@ -217,7 +199,11 @@ grpc::Status AgentService::PlannerStep(grpc::ServerContext* context,
     return {grpc::StatusCode::FAILED_PRECONDITION, "Init not called."};
   }
   agent_.plan_enabled = true;
-  agent_.PlanIteration(&thread_pool_);
+  if (scheduler_) {
+    scheduler_->PlanIteration(scheduler_id_);
+  } else {
+    agent_.PlanIteration(&thread_pool_);
+  }
 
   return grpc::Status::OK;
 }
@@ -229,18 +215,18 @@ grpc::Status AgentService::Step(grpc::ServerContext* context,
     return {grpc::StatusCode::FAILED_PRECONDITION, "Init not called."};
   }
   mjpc::State& state = agent_.state;
-  state.CopyTo(model, data_);
+  state.CopyTo(model_, data_);
   // mj_forward is needed because Transition might access properties from
   // mjData.
   // For performance, we could consider adding an option to the request for
   // callers to assume that data_ is up to date before the call.
-  mj_forward(model, data_);
-  agent_.ActiveTask()->Transition(model, data_);
+  mj_forward(model_, data_);
+  agent_.ActiveTask()->Transition(model_, data_);
   agent_.ActivePlanner().ActionFromPolicy(data_->ctrl, state.state().data(),
                                           state.time(),
                                           request->use_previous_policy());
-  mj_step(model, data_);
-  state.Set(model, data_);
+  mj_step(model_, data_);
+  state.Set(model_, data_);
   return grpc::Status::OK;
 }
 
@@ -253,7 +239,7 @@ grpc::Status AgentService::Reset(grpc::ServerContext* context,
 
   grpc::Status status =
       grpc_agent_util::Reset(&agent_, agent_.GetModel(), data_);
-  rollout_data_.reset(mj_makeData(model));
+  rollout_data_.reset(mj_makeData(model_));
   return status;
 }
 
@@ -27,6 +27,7 @@
 #include <mjpc/grpc/agent.grpc.pb.h>
 #include <mjpc/grpc/agent.pb.h>
 #include <mjpc/agent.h>
+#include <mjpc/planning_scheduler.h>
 #include <mjpc/task.h>
 #include <mjpc/threadpool.h>
 #include <mjpc/utilities.h>
@@ -41,6 +42,15 @@ class AgentService final : public agent::Agent::Service {
                                        : num_workers),
         tasks_(std::move(tasks)),
         rollout_data_(nullptr, mj_deleteData) {}
+
+  // plans on a pool shared with other services instead of its own
+  AgentService(std::vector<std::shared_ptr<mjpc::Task>> tasks,
+               mjpc::PlanningScheduler* scheduler, int priority = 0)
+      : thread_pool_(0),
+        tasks_(std::move(tasks)),
+        scheduler_(scheduler),
+        scheduler_id_(scheduler->AddAgent(&agent_, 0.0, priority)),
+        rollout_data_(nullptr, mj_deleteData) {}
   ~AgentService();
   grpc::Status Init(grpc::ServerContext* context,
                     const agent::InitRequest* request,
@@ -124,6 +134,13 @@ class AgentService final : public agent::Agent::Service {
   mjpc::ThreadPool thread_pool_;
   mjpc::Agent agent_;
   std::vector<std::shared_ptr<mjpc::Task>> tasks_;
+
+  // optional scheduler shared with other agents, and the agent's id in it
+  mjpc::PlanningScheduler* scheduler_ = nullptr;
+  int scheduler_id_ = -1;
+
+  // model and data used for physics, the agent owns its planning model
+  mjModel* model_ = nullptr;
   mjData* data_ = nullptr;
 
   // an mjData instance used for rollouts for action averaging
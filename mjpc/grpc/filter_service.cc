@@ -205,16 +205,14 @@ grpc::Status FilterService::Covariance(grpc::ServerContext* context,
   // set dimension
   output->set_dimension(nvelocity);
 
-  // covariance
-  double* covariance = active_filter->Covariance();
-
   // set covariance
   if (input.covariance_size() > 0) {
     CHECK_SIZE("covariance", ncovariance, input.covariance_size());
-    mju_copy(covariance, input.covariance().data(), ncovariance);
+    active_filter->SetCovariance(input.covariance().data());
   }
 
   // get covariance
+  double* covariance = active_filter->Covariance();
   for (int i = 0; i < ncovariance; i++) {
     output->add_covariance(covariance[i]);
   }
@@ -19,16 +19,35 @@
 #include <vector>
 #include <mujoco/mujoco.h>
 #include "mjpc/agent.h"
+#include "mjpc/planning_scheduler.h"
 #include "mjpc/task.h"
 #include "mjpc/tasks/tasks.h"
 #include "mjpc/threadpool.h"
 
 namespace mjpc {
+AgentRunner::AgentRunner(const mjModel* model, std::shared_ptr<Task> task,
+                         PlanningScheduler* scheduler, double period,
+                         int priority)
+    : model_(model), agent_plan_pool_(0), scheduler_(scheduler) {
+  std::vector<std::shared_ptr<Task>> task_v = {task};
+  agent_.SetTaskList(std::move(task_v));
+  agent_.Initialize(model);
+  RegisterResidual(model_, agent_.ActiveTask());
+  agent_.Allocate();
+  agent_.Reset();
+  agent_.plan_enabled = true;
+  agent_.action_enabled = true;
+  agent_.visualize_enabled = false;
+  agent_.plot_enabled = false;
+  scheduler_id_ = scheduler_->AddAgent(&agent_, period, priority);
+}
+
 AgentRunner::AgentRunner(const mjModel* model, std::shared_ptr<Task> task)
-    : agent_plan_pool_(1) {
+    : model_(model), agent_plan_pool_(1) {
   std::vector<std::shared_ptr<Task>> task_v = {task};
   agent_.SetTaskList(std::move(task_v));
   agent_.Initialize(model);
+  RegisterResidual(model_, agent_.ActiveTask());
   agent_.Allocate();
   agent_.Reset();
   agent_.plan_enabled = true;
@@ -41,8 +60,13 @@ AgentRunner::AgentRunner(const mjModel* model, std::shared_ptr<Task> task)
 }
 
 AgentRunner::~AgentRunner() {
-  exit_request_.store(true);  // ask the planner threadpool to stop
-  agent_plan_pool_.WaitCount(1);  // make sure it's stopped
+  if (scheduler_) {
+    scheduler_->RemoveAgent(scheduler_id_);
+  } else {
+    exit_request_.store(true);  // ask the planner threadpool to stop
+    agent_plan_pool_.WaitCount(1);  // make sure it's stopped
+  }
+  UnregisterResidual(model_);
 }
 
 void AgentRunner::Step(mjData* data) {
@@ -50,28 +74,11 @@ void AgentRunner::Step(mjData* data) {
   agent_.ActivePlanner().ActionFromPolicy(
     data->ctrl, &agent_.state.state()[0], agent_.state.time());
 }
-
-void AgentRunner::Residual(const mjModel* model, mjData* data) {
-  if (agent_.IsPlanningModel(model)) {
-    const mjpc::ResidualFn* residual = agent_.PlanningResidual();
-    residual->Residual(model, data, data->sensordata);
-  } else {
-    agent_.ActiveTask()->Residual(model, data, data->sensordata);
-  }
-}
 }  // namespace mjpc
 
 namespace {
 mjpc::AgentRunner* runner = nullptr;
 std::shared_ptr<mjpc::Task> task_;
-
-// not exposed to Unity, "extern C" is for MuJoco's callback assignment:
-extern "C" void residual_sensor_callback(const mjModel* model, mjData* data,
-                                          int stage) {
-  if (stage == mjSTAGE_ACC) {
-    runner->Residual(model, data);
-  }
-}
 }  // namespace
 
 
@@ -80,7 +87,6 @@ extern "C" void destroy_policy() {
     task_ = nullptr;
     delete runner;
     runner = nullptr;
-    mjcb_sensor = nullptr;
   }
 }
 
@@ -92,9 +98,6 @@ extern "C" void create_policy_from_task_id(const mjModel* model, int task_id) {
 extern "C" void create_policy(const mjModel* model,
                               std::shared_ptr<mjpc::Task> task) {
   destroy_policy();
-  if (mjcb_sensor == nullptr) {
-    mjcb_sensor = residual_sensor_callback;
-  }
   runner = new mjpc::AgentRunner(model, task);
   task_ = std::move(task);
 }
@@ -20,6 +20,7 @@
 #include <vector>
 #include <mujoco/mujoco.h>
 #include "mjpc/agent.h"
+#include "mjpc/planning_scheduler.h"
 #include "mjpc/task.h"
 #include "mjpc/threadpool.h"
 #include "mjpc/utilities.h"
@@ -30,11 +31,17 @@ class AgentRunner{
  public:
   ~AgentRunner();
   explicit AgentRunner(const mjModel* model, std::shared_ptr<Task> task);
+  // plans every period seconds on a scheduler shared with other agents
+  AgentRunner(const mjModel* model, std::shared_ptr<Task> task,
+              PlanningScheduler* scheduler, double period, int priority = 0);
   void Step(mjData* data);
-  void Residual(const mjModel* model, mjData* data);
  private:
+  // physics model, registered for residual dispatch
+  const mjModel* model_;
   Agent agent_;
   ThreadPool agent_plan_pool_;
+  PlanningScheduler* scheduler_ = nullptr;
+  int scheduler_id_ = -1;
   std::atomic_bool exit_request_ = false;
   std::atomic_int ui_load_request_ = 0;
 };
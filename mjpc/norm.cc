@@ -49,66 +49,232 @@ int NormParameterDimension(int type) {
 // evaluate norm; optionally: gradient, Hessian
 double Norm(double* g, double* H, const double* x, const double* params, int n,
             NormType type) {
+  double y = 0;
+  NormBatch(&y, g, H, x, params, n, /*num=*/1, /*stride=*/n, type);
+  return y;
+}
+
+namespace {
+
+// number of blocks evaluated together. element i of every block in a chunk is
+// gathered into a contiguous lane array, so the per-element math runs over
+// time steps in unit-stride loops
+inline constexpr int kNormChunk = 64;
+
+// sign of x, zero at zero
+inline double Sign(double x) { return (x > 0) - (x < 0); }
+
+// y = sum_i f(x_i), f evaluated by element.Value and, with its first and
+// second derivatives, by element.Derivatives; H is diagonal and pre-zeroed
+template <typename Element>
+void ElementwiseBatch(double* y, double* g, double* H, const double* x, int n,
+                      int num, int stride, const Element& element) {
+  int stride_hessian = stride * stride;
+  double lane_x[kNormChunk];
+  double lane_y[kNormChunk];
+  double lane_g[kNormChunk];
+  double lane_h[kNormChunk];
+  for (int begin = 0; begin < num; begin += kNormChunk) {
+    int count = std::min(kNormChunk, num - begin);
+    std::fill_n(lane_y, count, 0.0);
+    for (int i = 0; i < n; i++) {
+      // gather element i of each block
+      const double* xi = x + begin * stride + i;
+      for (int k = 0; k < count; k++) {
+        lane_x[k] = xi[k * stride];
+      }
+
+      // evaluate over lanes
+      if (!g) {
+        for (int k = 0; k < count; k++) {
+          lane_y[k] += element.Value(lane_x[k]);
+        }
+        continue;
+      }
+      for (int k = 0; k < count; k++) {
+        lane_y[k] += element.Derivatives(lane_x[k], lane_g + k, lane_h + k);
+      }
+
+      // scatter derivatives
+      double* gi = g + begin * stride + i;
+      for (int k = 0; k < count; k++) {
+        gi[k * stride] = lane_g[k];
+      }
+      if (H) {
+        double* Hi = H + begin * stride_hessian + i * n + i;
+        for (int k = 0; k < count; k++) {
+          Hi[k * stride_hessian] = lane_h[k];
+        }
+      }
+    }
+    std::copy_n(lane_y, count, y + begin);
+  }
+}
+
+// squared norms c[k] = x_k' * x_k of count blocks
+inline void SquaredNorms(double* c, const double* x, int n, int count,
+                         int stride) {
+  std::fill_n(c, count, 0.0);
+  for (int i = 0; i < n; i++) {
+    const double* xi = x + i;
+    for (int k = 0; k < count; k++) {
+      double xki = xi[k * stride];
+      c[k] += xki * xki;
+    }
+  }
+}
+
+// y = 0.5 * x^2
+struct QuadraticElement {
+  double Value(double x) const { return 0.5 * x * x; }
+  double Derivatives(double x, double* g, double* h) const {
+    *g = x;
+    *h = 1.0;
+    return 0.5 * x * x;
+  }
+};
+
+// y = p^2 * (cosh(x / p) - 1), cosh and sinh from a single exponential
+struct CoshElement {
+  double p;
+  double Value(double x) const {
+    double e = std::exp(x / p);
+    return p * p * (0.5 * (e + 1 / e) - 1.0);
+  }
+  double Derivatives(double x, double* g, double* h) const {
+    double e = std::exp(x / p);
+    double ch = 0.5 * (e + 1 / e);
+    *g = 0.5 * p * (e - 1 / e);
+    *h = ch;
+    return p * p * (ch - 1.0);
+  }
+};
+
+// y = abs(x)^p
+struct PowerElement {
+  double p;
+  double Value(double x) const { return std::pow(std::abs(x), p); }
+  double Derivatives(double x, double* g, double* h) const {
+    double s = std::abs(x);
+    *g = Sign(x) * p * std::pow(s, p - 1);
+    *h = (p - 1) * p * std::pow(s, p - 2);
+    return std::pow(s, p);
+  }
+};
+
+// y = sqrt(x^2 + p^2) - p
+struct SmoothAbsElement {
+  double p;
+  double Value(double x) const { return std::sqrt(x * x + p * p) - p; }
+  double Derivatives(double x, double* g, double* h) const {
+    double s = std::sqrt(x * x + p * p);
+    *g = s ? x / s : 0;
+    *h = s ? (1 - *g * *g) / s : 0;
+    return s - p;
+  }
+};
+
+// y = (abs(x)^q + p^q)^(1/q) - p
+struct SmoothAbs2Element {
+  double p, q, pq;
+  double Value(double x) const {
+    return std::pow(std::pow(std::abs(x), q) + pq, 1 / q) - p;
+  }
+  double Derivatives(double x, double* g, double* h) const {
+    double a = std::abs(x);
+    double d = std::pow(a, q);
+    double e = d + pq;
+    double s = std::pow(e, 1 / q);
+    double c = s * std::pow(a, q - 2) / e;
+    *g = c * x;
+    *h = c * (q - 1) * (1 - d / e);
+    return s - p;
+  }
+};
+
+// y = p * log(1 + exp(x / p))
+struct RectifyElement {
+  double p;
+  double Value(double x) const { return p * std::log(1 + std::exp(x / p)); }
+  double Derivatives(double x, double* g, double* h) const {
+    double s = std::exp(x / p);
+    *g = s / (1 + s);
+    *h = s / (p * (1 + s) * (1 + s));
+    return p * std::log(1 + s);
+  }
+};
+
+// y = max(x, 0)
+struct RampElement {
+  double Value(double x) const { return x > 0 ? x : 0; }
+  double Derivatives(double x, double* g, double* h) const {
+    *g = x > 0 ? 1 : 0;
+    *h = 0;
+    return x > 0 ? x : 0;
+  }
+};
+
+}  // namespace
+
+// evaluate norm for a batch of residual blocks; optionally: gradients,
+// Hessians. elementwise norms run over chunks of blocks in structure-of-arrays
+// order, the other norms reduce each chunk's squared norms the same way
+void NormBatch(double* y, double* g, double* H, const double* x,
+               const double* params, int n, int num, int stride,
+               NormType type) {
   if (H && !g) {
     mju_error("Called Norm with H and no g");
   }
-  double y = 0;                                                   // output
   double p = params ? params[0] : 0, q = params ? params[1] : 0;  // parameters
+  int stride_hessian = stride * stride;
 
-  if (H) mju_zero(H, n * n);
+  if (H) {
+    for (int k = 0; k < num; k++) {
+      mju_zero(H + k * stride_hessian, n * n);
+    }
+  }
 
   switch (type) {
     case NormType::kNull: {
-      y = x[0];
-      if (g) {
-        g[0] = 1.0;
-      }
-      if (H) {
-        H[0] = 0.0;
+      for (int k = 0; k < num; k++) {
+        y[k] = x[k * stride];
+        if (g) g[k * stride] = 1.0;
+        if (H) H[k * stride_hessian] = 0.0;
       }
       break;
     }
 
-    case NormType::kQuadratic: {  // y = 0.5 * x' * x
-      for (int i = 0; i < n; i++) {
-        y += x[i] * x[i];
-      }
-      y *= 0.5;
-
-      if (g) {  // x
-        for (int i = 0; i < n; i++) {
-          g[i] = x[i];
-        }
-      }
-      if (H) {  // eye(n)
-        for (int i = 0; i < n; i++) {
-          H[i * n + i] = 1.0;
-        }
-      }
+    case NormType::kQuadratic:  // y = 0.5 * x' * x
+      ElementwiseBatch(y, g, H, x, n, num, stride, QuadraticElement{});
       break;
-    }
 
     case NormType::kL22: {  // y = ((x*x')^q + p^(2*q))^(1/2/q) - p
-      double c = 0;
-      for (int i = 0; i < n; i++) {
-        c += x[i] * x[i];
-      }
-      double a = mju_pow(c, q / 2) + mju_pow(p, q);
-      double s = mju_pow(a, 1 / q);
-      y = s - p;
-      double d = mju_pow(c, q / 2 - 1);
-      double b = s / a * d;
-      if (g) {
-        for (int i = 0; i < n; i++) {
-          g[i] = b * x[i];
-        }
-      }
+      double pq = std::pow(p, q);
+      double c[kNormChunk];
+      for (int begin = 0; begin < num; begin += kNormChunk) {
+        int count = std::min(kNormChunk, num - begin);
+        SquaredNorms(c, x + begin * stride, n, count, stride);
+        for (int k = 0; k < count; k++) {
+          const double* xk = x + (begin + k) * stride;
+          double a = std::pow(c[k], q / 2) + pq;
+          double s = std::pow(a, 1 / q);
+          y[begin + k] = s - p;
+          if (!g) continue;
+          double d = std::pow(c[k], q / 2 - 1);
+          double b = s / a * d;
+          double* gk = g + (begin + k) * stride;
+          for (int i = 0; i < n; i++) {
+            gk[i] = b * xk[i];
+          }
 
-      if (H) {
-        c = (1 - q) * d / a + (q - 2) / std::max(c, mjMINVAL);
-        for (int i = 0; i < n; i++) {
-          for (int j = 0; j < n; j++) {
-            H[i + j * n] = b * ((i == j ? 1.0 : 0.0) + x[i] * x[j] * c);
+          if (H) {
+            double* Hk = H + (begin + k) * stride_hessian;
+            double e = (1 - q) * d / a + (q - 2) / std::max(c[k], mjMINVAL);
+            for (int i = 0; i < n; i++) {
+              for (int j = 0; j < n; j++) {
+                Hk[i + j * n] = b * ((i == j ? 1.0 : 0.0) + xk[i] * xk[j] * e);
+              }
+            }
           }
         }
       }
@@ -116,97 +282,65 @@ double Norm(double* g, double* H, const double* x, const double* params, int n,
     }
 
     case NormType::kL2: {  // y = sqrt(x*x' + p^2) - p
-      double s = mju_sqrt(mju_dot(x, x, n) + p * p);
-      y = s - p;
-      if (g) {
-        if (s) {
-          mju_scl(g, x, 1 / s, n);
-        } else {
-          mju_zero(g, n);
+      double s[kNormChunk];
+      for (int begin = 0; begin < num; begin += kNormChunk) {
+        int count = std::min(kNormChunk, num - begin);
+        SquaredNorms(s, x + begin * stride, n, count, stride);
+        for (int k = 0; k < count; k++) {
+          s[k] = std::sqrt(s[k] + p * p);
+          y[begin + k] = s[k] - p;
         }
-      }
+        if (!g) continue;
+        for (int k = 0; k < count; k++) {
+          const double* xk = x + (begin + k) * stride;
+          double* gk = g + (begin + k) * stride;
+          if (s[k]) {
+            mju_scl(gk, xk, 1 / s[k], n);
+          } else {
+            mju_zero(gk, n);
+          }
 
-      if (H) {  // H = (eye(n) - g*g')/s
-        if (s) {
-          for (int i = 0; i < n; i++) {
-            for (int j = 0; j < n; j++) {
-              H[i + j * n] = ((i == j ? 1 : 0) - g[i] * g[j]) / s;
+          if (H && s[k]) {  // H = (eye(n) - g*g')/s
+            double* Hk = H + (begin + k) * stride_hessian;
+            for (int i = 0; i < n; i++) {
+              for (int j = 0; j < n; j++) {
+                Hk[i + j * n] = ((i == j ? 1 : 0) - gk[i] * gk[j]) / s[k];
+              }
             }
           }
-        } else {
-          mju_zero(H, n * n);
         }
       }
       break;
     }
 
-    case NormType::kCosh: {  // y = p^2 * (cosh(x / p) - 1)
-      for (int i = 0; i < n; i++) {
-        y += p * p * (std::cosh(x[i] / p) - 1.0);
-        if (g) g[i] = p * std::sinh(x[i] / p);
-        if (H) H[i * n + i] = std::cosh(x[i] / p);
-      }
+    case NormType::kCosh:  // y = p^2 * (cosh(x / p) - 1)
+      ElementwiseBatch(y, g, H, x, n, num, stride, CoshElement{p});
       break;
-    }
 
-    case NormType::kPowerLoss: {  // y = abs(x)^p
-      for (int i = 0; i < n; i++) {
-        double s = mju_abs(x[i]);
-        y += mju_pow(s, p);
-        if (g) {
-          g[i] = mju_sign(x[i]) * p * mju_pow(s, p - 1);
-        }
-        if (H) {
-          H[i * n + i] = (p - 1) * p * mju_pow(s, p - 2);
-        }
-      }
+    case NormType::kPowerLoss:  // y = abs(x)^p
+      ElementwiseBatch(y, g, H, x, n, num, stride, PowerElement{p});
       break;
-    }
 
-    case NormType::kSmoothAbsLoss: {  // y = sqrt(x^2 + p^2) - p
-      for (int i = 0; i < n; i++) {
-        double s = mju_sqrt(x[i] * x[i] + p * p);
-        y += s - p;
-        if (g) g[i] = s ? x[i] / s : 0;
-        if (H) H[n * i + i] = s ? (1 - g[i] * g[i]) / s : 0;
-      }
+    case NormType::kSmoothAbsLoss:  // y = sqrt(x^2 + p^2) - p
+      ElementwiseBatch(y, g, H, x, n, num, stride, SmoothAbsElement{p});
       break;
-    }
 
-    case NormType::kSmoothAbs2Loss: {  // y = (abs(x)^q + p^q)^(1/q) - p
-      for (int i = 0; i < n; i++) {
-        double a = mju_abs(x[i]);
-        double d = mju_pow(a, q);
-        double e = d + mju_pow(p, q);
-        double s = mju_pow(e, 1 / q);
-        y += s - p;
-        double c = s * mju_pow(a, q - 2) / e;
-        if (g) g[i] = c * x[i];
-        if (H) H[i * n + i] = c * (q - 1) * (1 - d / e);
-      }
+    case NormType::kSmoothAbs2Loss:  // y = (abs(x)^q + p^q)^(1/q) - p
+      ElementwiseBatch(y, g, H, x, n, num, stride,
+                       SmoothAbs2Element{p, q, std::pow(p, q)});
       break;
-    }
 
-    case NormType::kRectifyLoss: {  // y  =  p*log(1 + exp(x/p))
-      for (int i = 0; i < n; i++) {
-        if (p > 0) {
-          double s = mju_exp(x[i] / p);
-          y += p * mju_log(1 + s);
-          if (g) g[i] = s / (1 + s);
-          if (H) H[i * n + i] = s / (p * (1 + s) * (1 + s));
-        } else {
-          y += x[i] > 0 ? x[i] : 0;
-          if (g) g[i] = x[i] > 0 ? 1 : 0;
-          if (H) H[i * n + i] = 0;
-        }
+    case NormType::kRectifyLoss:  // y  =  p*log(1 + exp(x/p))
+      if (p > 0) {
+        ElementwiseBatch(y, g, H, x, n, num, stride, RectifyElement{p});
+      } else {
+        ElementwiseBatch(y, g, H, x, n, num, stride, RampElement{});
       }
       break;
-    }
 
     default:
       mju_error("mj_norm: unknown norm type");
   }
-  return y;
 }
 
 }  // namespace mjpc
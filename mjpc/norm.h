@@ -41,6 +41,13 @@ int NormParameterDimension(int type);
 double Norm(double *g, double *H, const double *x, const double *params, int n,
             NormType type);
 
+// evaluate norm for num blocks of n residuals; block k is read from
+// x + k * stride, its value is written to y[k] and, optionally, its gradient
+// and Hessian to g + k * stride and H + k * stride * stride
+void NormBatch(double *y, double *g, double *H, const double *x,
+               const double *params, int n, int num, int stride,
+               NormType type);
+
 }  // namespace mjpc
 
 #endif  // MJPC_NORM_H_
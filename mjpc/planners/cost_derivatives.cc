@@ -23,6 +23,9 @@
 
 namespace mjpc {
 
+// number of time-step chunks scheduled per pool thread
+inline constexpr int kCostDerivativeChunksPerThread = 2;
+
 // allocate memory
 void CostDerivatives::Allocate(int dim_state_derivative, int dim_action,
                                int dim_residual, int T, int dim_max) {
@@ -40,12 +43,11 @@ void CostDerivatives::Allocate(int dim_state_derivative, int dim_action,
   cxu.resize(dim_state_derivative * dim_action * T);
 
   // scratch space
-  c_scratch_.resize(T * dim_max * dim_max);
-  cx_scratch_.resize(T * dim_state_derivative);
-  cu_scratch_.resize(T * dim_action);
-  cxx_scratch_.resize(T * dim_state_derivative * dim_state_derivative);
-  cuu_scratch_.resize(T * dim_action * dim_action);
-  cxu_scratch_.resize(T * dim_state_derivative * dim_action);
+  cost_.resize(T);
+  norm_value_.resize(T);
+  c_scratch_.resize(T * dim_max * (dim_state_derivative + dim_action));
+  rx_scratch_.resize(T * dim_max * dim_state_derivative);
+  ru_scratch_.resize(T * dim_max * dim_action);
 }
 
 // reset memory to zeros
@@ -60,54 +62,341 @@ void CostDerivatives::Reset(int dim_state_derivative, int dim_action,
   std::fill(cuu.begin(), cuu.begin() + dim_action * dim_action * T, 0.0);
   std::fill(cxu.begin(), cxu.begin() + dim_state_derivative * dim_action * T,
             0.0);
-  std::fill(cx_scratch_.begin(), cx_scratch_.begin() + T * dim_state_derivative,
-            0.0);
-  std::fill(cu_scratch_.begin(), cu_scratch_.begin() + T * dim_action, 0.0);
-  std::fill(
-      cxx_scratch_.begin(),
-      cxx_scratch_.begin() + T * dim_state_derivative * dim_state_derivative,
-      0.0);
-  std::fill(cuu_scratch_.begin(),
-            cuu_scratch_.begin() + T * dim_action * dim_action, 0.0);
-  std::fill(cxu_scratch_.begin(),
-            cxu_scratch_.begin() + T * dim_state_derivative * dim_action, 0.0);
 }
 
 // compute derivatives at one time step
 double CostDerivatives::DerivativeStep(
     double* Cx, double* Cu, double* Cxx, double* Cuu, double* Cxu, double* Cr,
-    double* Crr, double* C_scratch, double* Cx_scratch, double* Cu_scratch,
-    double* Cxx_scratch, double* Cuu_scratch, double* Cxu_scratch,
-    const double* r, const double* rx, const double* ru, int nr, int nx,
-    int dim_action, double weight, const double* p, NormType type) {
+    double* Crr, double* C_scratch, const double* r, const double* rx,
+    const double* ru, int nr, int nx, int dim_action, double weight,
+    const double* p, NormType type) {
   // norm derivatives
   double C = Norm(Cr, Crr, r, p, nr, type);
 
-  // cx
-  mju_mulMatTVec(Cx_scratch, rx, Cr, nr, nx);
-  mju_addToScl(Cx, Cx_scratch, weight, nx);
+  // accumulate
+  AccumulateStep(Cx, Cu, Cxx, Cuu, Cxu, Cr, Crr, C_scratch, rx, ru, nr, nx,
+                 dim_action, weight, type);
+
+  return weight * C;
+}
+
+// accumulate one term's derivatives at one time step from norm derivatives
+void CostDerivatives::AccumulateStep(double* Cx, double* Cu, double* Cxx,
+                                     double* Cuu, double* Cxu, const double* Cr,
+                                     const double* Crr, double* C_scratch,
+                                     const double* rx, const double* ru,
+                                     int nr, int nx, int dim_action,
+                                     double weight, NormType type) {
+  // Hessian-weighted Jacobians: Crr * rx, Crr * ru (identity for quadratic)
+  const double* Hx = rx;
+  const double* Hu = ru;
+  if (type != NormType::kQuadratic) {
+    mju_mulMatMat(C_scratch, Crr, rx, nr, nr, nx);
+    mju_mulMatMat(C_scratch + nr * nx, Crr, ru, nr, nr, dim_action);
+    Hx = C_scratch;
+    Hu = C_scratch + nr * nx;
+  }
+
+  // single pass over residual rows: gradient and Gauss-Newton Hessian
+  for (int k = 0; k < nr; k++) {
+    const double* rxk = rx + k * nx;
+    const double* ruk = ru + k * dim_action;
+    const double* hxk = Hx + k * nx;
+    const double* huk = Hu + k * dim_action;
+
+    // cx, cu
+    mju_addToScl(Cx, rxk, weight * Cr[k], nx);
+    mju_addToScl(Cu, ruk, weight * Cr[k], dim_action);
 
-  // cu
-  mju_mulMatTVec(Cu_scratch, ru, Cr, nr, dim_action);
-  mju_addToScl(Cu, Cu_scratch, weight, dim_action);
+    // cxx, cxu
+    for (int i = 0; i < nx; i++) {
+      double a = weight * hxk[i];
+      if (a == 0.0) continue;
+      mju_addToScl(Cxx + i * nx, rxk, a, nx);
+      mju_addToScl(Cxu + i * dim_action, ruk, a, dim_action);
+    }
 
-  // cxx
-  mju_mulMatMat(C_scratch, Crr, rx, nr, nr, nx);
-  mju_mulMatTMat(Cxx_scratch, C_scratch, rx, nr, nx, nx);
-  mju_addToScl(Cxx, Cxx_scratch, weight, nx * nx);
+    // cuu
+    for (int i = 0; i < dim_action; i++) {
+      double a = weight * huk[i];
+      if (a == 0.0) continue;
+      mju_addToScl(Cuu + i * dim_action, ruk, a, dim_action);
+    }
+  }
+}
 
-  // cxu
-  mju_mulMatTMat(Cxu_scratch, C_scratch, ru, nr, nx, dim_action);
-  mju_addToScl(Cxu, Cxu_scratch, weight, nx * dim_action);
+// compute derivatives at one time step using only the nonzero columns of the
+// residual Jacobians
+double CostDerivatives::DerivativeStepSparse(
+    double* Cx, double* Cu, double* Cxx, double* Cuu, double* Cxu, double* Cr,
+    double* Crr, double* C_scratch, double* rx_scratch, double* ru_scratch,
+    const double* r, const double* rx, const double* ru, int nr, int nx,
+    int dim_action, const int* column_x, int num_column_x,
+    const int* column_u, int num_column_u, double weight, const double* p,
+    NormType type) {
+  // norm derivatives
+  double C = Norm(Cr, Crr, r, p, nr, type);
 
-  // cuu
-  mju_mulMatMat(C_scratch, Crr, ru, nr, nr, dim_action);
-  mju_mulMatTMat(Cuu_scratch, C_scratch, ru, nr, dim_action, dim_action);
-  mju_addToScl(Cuu, Cuu_scratch, weight, dim_action * dim_action);
+  // accumulate
+  AccumulateStepSparse(Cx, Cu, Cxx, Cuu, Cxu, Cr, Crr, C_scratch, rx_scratch,
+                       ru_scratch, rx, ru, nr, nx, dim_action, column_x,
+                       num_column_x, column_u, num_column_u, weight, type);
 
   return weight * C;
 }
 
+// accumulate one term's derivatives at one time step from norm derivatives
+// using only the nonzero columns of the residual Jacobians
+void CostDerivatives::AccumulateStepSparse(
+    double* Cx, double* Cu, double* Cxx, double* Cuu, double* Cxu,
+    const double* Cr, const double* Crr, double* C_scratch,
+    double* rx_scratch, double* ru_scratch, const double* rx, const double* ru,
+    int nr, int nx, int dim_action, const int* column_x, int num_column_x,
+    const int* column_u, int num_column_u, double weight, NormType type) {
+  // compressed Jacobians
+  for (int i = 0; i < nr; i++) {
+    for (int j = 0; j < num_column_x; j++) {
+      rx_scratch[i * num_column_x + j] = rx[i * nx + column_x[j]];
+    }
+    for (int j = 0; j < num_column_u; j++) {
+      ru_scratch[i * num_column_u + j] = ru[i * dim_action + column_u[j]];
+    }
+  }
+
+  // Hessian-weighted compressed Jacobians (identity for quadratic)
+  const double* Hx = rx_scratch;
+  const double* Hu = ru_scratch;
+  if (type != NormType::kQuadratic) {
+    mju_mulMatMat(C_scratch, Crr, rx_scratch, nr, nr, num_column_x);
+    mju_mulMatMat(C_scratch + nr * num_column_x, Crr, ru_scratch, nr, nr,
+                  num_column_u);
+    Hx = C_scratch;
+    Hu = C_scratch + nr * num_column_x;
+  }
+
+  // single pass over residual rows, scatter into nonzero columns
+  for (int k = 0; k < nr; k++) {
+    const double* rxk = rx_scratch + k * num_column_x;
+    const double* ruk = ru_scratch + k * num_column_u;
+    const double* hxk = Hx + k * num_column_x;
+    const double* huk = Hu + k * num_column_u;
+    double g = weight * Cr[k];
+
+    // cx, cu
+    for (int j = 0; j < num_column_x; j++) {
+      Cx[column_x[j]] += g * rxk[j];
+    }
+    for (int j = 0; j < num_column_u; j++) {
+      Cu[column_u[j]] += g * ruk[j];
+    }
+
+    // cxx, cxu
+    for (int i = 0; i < num_column_x; i++) {
+      double a = weight * hxk[i];
+      if (a == 0.0) continue;
+      double* row = Cxx + column_x[i] * nx;
+      for (int j = 0; j < num_column_x; j++) {
+        row[column_x[j]] += a * rxk[j];
+      }
+      row = Cxu + column_x[i] * dim_action;
+      for (int j = 0; j < num_column_u; j++) {
+        row[column_u[j]] += a * ruk[j];
+      }
+    }
+
+    // cuu
+    for (int i = 0; i < num_column_u; i++) {
+      double a = weight * huk[i];
+      if (a == 0.0) continue;
+      double* row = Cuu + column_u[i] * dim_action;
+      for (int j = 0; j < num_column_u; j++) {
+        row[column_u[j]] += a * ruk[j];
+      }
+    }
+  }
+}
+
+// evaluate each term's norm and norm derivatives for a chunk of time steps;
+// gradients are stored at the term's residual offset in cr and Hessians are
+// packed term after term in crr
+void CostDerivatives::NormChunk(const double* r, int num_residual,
+                                const int* dim_norm_residual, int num_term,
+                                const double* weights, const NormType* norms,
+                                const double* parameters,
+                                const int* num_norm_parameter, int t_begin,
+                                int t_end, int T) {
+  int num = t_end - t_begin;
+  double* cost = DataAt(cost_, t_begin);
+  double* value = DataAt(norm_value_, t_begin);
+  mju_zero(cost, num);
+
+  int f_shift = 0;
+  int h_shift = 0;
+  int p_shift = 0;
+  for (int i = 0; i < num_term; i++) {
+    // norm over all time steps in chunk
+    NormBatch(value, DataAt(cr, t_begin * num_residual + f_shift),
+              DataAt(crr, t_begin * num_residual * num_residual + h_shift),
+              r + t_begin * num_residual + f_shift, parameters + p_shift,
+              dim_norm_residual[i], num, num_residual, norms[i]);
+
+    // weighted cost
+    double weight = weights[i] / T;
+    for (int k = 0; k < num; k++) {
+      cost[k] += weight * value[k];
+    }
+
+    f_shift += dim_norm_residual[i];
+    h_shift += dim_norm_residual[i] * dim_norm_residual[i];
+    p_shift += num_norm_parameter[i];
+  }
+}
+
+// compute all term derivatives and risk transformation at one time step
+void CostDerivatives::TimeStep(const double* rx, const double* ru,
+                               int dim_state_derivative, int dim_action,
+                               int dim_max, int num_sensors, int num_residual,
+                               const int* dim_norm_residual, int num_term,
+                               const double* weights, const NormType* norms,
+                               double risk, int t, int T) {
+  int nx = dim_state_derivative;
+  int nu = dim_action;
+
+  // outputs at time step
+  double* Cx = DataAt(cx, t * nx);
+  double* Cu = DataAt(cu, t * nu);
+  double* Cxx = DataAt(cxx, t * nx * nx);
+  double* Cuu = DataAt(cuu, t * nu * nu);
+  double* Cxu = DataAt(cxu, t * nx * nu);
+  double* Cr = DataAt(cr, t * num_residual);
+  double* Crr = DataAt(crr, t * num_residual * num_residual);
+
+  // scratch at time step
+  double* C_scratch = DataAt(c_scratch_, t * dim_max * (nx + nu));
+  double* rx_scratch = DataAt(rx_scratch_, t * dim_max * nx);
+  double* ru_scratch = DataAt(ru_scratch_, t * dim_max * nu);
+
+  // zero
+  mju_zero(Cx, nx);
+  mju_zero(Cu, nu);
+  mju_zero(Cxx, nx * nx);
+  mju_zero(Cuu, nu * nu);
+  mju_zero(Cxu, nx * nu);
+
+  // ----- term derivatives ----- //
+  const double* rxt = rx + t * num_sensors * nx;
+  const double* rut = ru + t * num_sensors * nu;
+  int f_shift = 0;
+  int h_shift = 0;
+  for (int i = 0; i < num_term; i++) {
+    int nr = dim_norm_residual[i];
+    int num_column_x = num_column_x_[i];
+    int num_column_u = num_column_u_[i];
+
+    if (num_column_x < nx || num_column_u < nu) {
+      // compressed products for terms that depend on a subset of the state
+      // and action
+      AccumulateStepSparse(Cx, Cu, Cxx, Cuu, Cxu, Cr + f_shift, Crr + h_shift,
+                           C_scratch, rx_scratch, ru_scratch,
+                           rxt + f_shift * nx, rut + f_shift * nu, nr, nx, nu,
+                           column_x_.data() + i * nx, num_column_x,
+                           column_u_.data() + i * nu, num_column_u,
+                           weights[i] / T, norms[i]);
+    } else {
+      AccumulateStep(Cx, Cu, Cxx, Cuu, Cxu, Cr + f_shift, Crr + h_shift,
+                     C_scratch, rxt + f_shift * nx, rut + f_shift * nu, nr, nx,
+                     nu, weights[i] / T, norms[i]);
+    }
+
+    f_shift += nr;
+    h_shift += nr * nr;
+  }
+  double c = cost_[t];
+
+  // ----- risk transformation ----- //
+  if (mju_abs(risk) < kRiskNeutralTolerance) {
+    return;
+  }
+
+  double s = mju_exp(risk * c);
+  double rs = risk * s;
+
+  // gradients: s * c
+  mju_scl(Cx, Cx, s, nx);
+  mju_scl(Cu, Cu, s, nu);
+
+  // Hessians: s * H + risk * s * g * g', one pass per block
+  for (int i = 0; i < nx; i++) {
+    double a = rs * Cx[i];
+    double* row = Cxx + i * nx;
+    for (int j = 0; j < nx; j++) {
+      row[j] = s * row[j] + a * Cx[j];
+    }
+    row = Cxu + i * nu;
+    for (int j = 0; j < nu; j++) {
+      row[j] = s * row[j] + a * Cu[j];
+    }
+  }
+  for (int i = 0; i < nu; i++) {
+    double a = rs * Cu[i];
+    double* row = Cuu + i * nu;
+    for (int j = 0; j < nu; j++) {
+      row[j] = s * row[j] + a * Cu[j];
+    }
+  }
+}
+
+// compute nonzero column pattern of each residual term over all time steps
+void CostDerivatives::ColumnPattern(const double* rx, const double* ru,
+                                    int dim_state_derivative, int dim_action,
+                                    int num_sensors,
+                                    const int* dim_norm_residual, int num_term,
+                                    int T) {
+  // resize
+  column_x_.resize(num_term * dim_state_derivative);
+  column_u_.resize(num_term * dim_action);
+  num_column_x_.resize(num_term);
+  num_column_u_.resize(num_term);
+
+  int f_shift = 0;
+  for (int i = 0; i < num_term; i++) {
+    int* column_x = column_x_.data() + i * dim_state_derivative;
+    int* column_u = column_u_.data() + i * dim_action;
+
+    // mark nonzero columns
+    std::fill(column_x, column_x + dim_state_derivative, 0);
+    std::fill(column_u, column_u + dim_action, 0);
+    for (int t = 0; t < T; t++) {
+      const double* rxt = rx + t * num_sensors * dim_state_derivative +
+                          f_shift * dim_state_derivative;
+      const double* rut =
+          ru + t * num_sensors * dim_action + f_shift * dim_action;
+      for (int j = 0; j < dim_norm_residual[i]; j++) {
+        for (int k = 0; k < dim_state_derivative; k++) {
+          if (rxt[j * dim_state_derivative + k] != 0.0) column_x[k] = 1;
+        }
+        for (int k = 0; k < dim_action; k++) {
+          if (rut[j * dim_action + k] != 0.0) column_u[k] = 1;
+        }
+      }
+    }
+
+    // compress marks into column indices
+    int nx = 0;
+    for (int k = 0; k < dim_state_derivative; k++) {
+      if (column_x[k]) column_x[nx++] = k;
+    }
+    int nu = 0;
+    for (int k = 0; k < dim_action; k++) {
+      if (column_u[k]) column_u[nu++] = k;
+    }
+    num_column_x_[i] = nx;
+    num_column_u_[i] = nu;
+
+    f_shift += dim_norm_residual[i];
+  }
+}
+
 // compute derivatives at all time steps
 void CostDerivatives::Compute(double* r, double* rx, double* ru,
                               int dim_state_derivative, int dim_action,
@@ -117,114 +406,33 @@ void CostDerivatives::Compute(double* r, double* rx, double* ru,
                               const double* parameters,
                               const int* num_norm_parameter, double risk,
                               int T, ThreadPool& pool) {
-  // reset
-  this->Reset(dim_state_derivative, dim_action, num_residual, T);
+  // nonzero columns of residual Jacobians
+  this->ColumnPattern(rx, ru, dim_state_derivative, dim_action, num_sensors,
+                      dim_norm_residual, num_term, T);
+
+  // contiguous chunks of time steps, a few per thread for load balancing
+  int num_chunk = std::min(T, kCostDerivativeChunksPerThread *
+                                  std::max(pool.NumThreads(), 1));
   {
     int count_before = pool.GetCount();
-    for (int t = 0; t < T; t++) {
+    for (int k = 0; k < num_chunk; k++) {
+      int t_begin = k * T / num_chunk;
+      int t_end = (k + 1) * T / num_chunk;
       pool.Schedule([&cd = *this, &r, &rx, &ru, num_term, num_residual,
                      &dim_norm_residual, &weights, &norms, &parameters,
                      &num_norm_parameter, risk, num_sensors,
-                     dim_state_derivative, dim_action, dim_max, t, T]() {
-        // ----- term derivatives ----- //
-        int f_shift = 0;
-        int p_shift = 0;
-        double c = 0.0;
-        for (int i = 0; i < num_term; i++) {
-          c += cd.DerivativeStep(
-              DataAt(cd.cx, t * dim_state_derivative),
-              DataAt(cd.cu, t * dim_action),
-              DataAt(cd.cxx, t * dim_state_derivative * dim_state_derivative),
-              DataAt(cd.cuu, t * dim_action * dim_action),
-              DataAt(cd.cxu, t * dim_state_derivative * dim_action),
-              DataAt(cd.cr, t * num_residual),
-              DataAt(cd.crr, t * num_residual * num_residual),
-              DataAt(cd.c_scratch_, t * dim_max * dim_max),
-              DataAt(cd.cx_scratch_, t * dim_state_derivative),
-              DataAt(cd.cu_scratch_, t * dim_action),
-              DataAt(cd.cxx_scratch_,
-                     t * dim_state_derivative * dim_state_derivative),
-              DataAt(cd.cuu_scratch_, t * dim_action * dim_action),
-              DataAt(cd.cxu_scratch_, t * dim_state_derivative * dim_action),
-              r + t * num_residual + f_shift,
-              rx + t * num_sensors * dim_state_derivative +
-                  f_shift * dim_state_derivative,
-              ru + t * num_sensors * dim_action + f_shift * dim_action,
-              dim_norm_residual[i], dim_state_derivative, dim_action,
-              weights[i] / T, parameters + p_shift, norms[i]);
-
-          f_shift += dim_norm_residual[i];
-          p_shift += num_norm_parameter[i];
-        }
-
-        // ----- risk transformation ----- //
-        if (mju_abs(risk) < kRiskNeutralTolerance) {
-          return;
+                     dim_state_derivative, dim_action, dim_max, t_begin, t_end,
+                     T]() {
+        cd.NormChunk(r, num_residual, dim_norm_residual, num_term, weights,
+                     norms, parameters, num_norm_parameter, t_begin, t_end, T);
+        for (int t = t_begin; t < t_end; t++) {
+          cd.TimeStep(rx, ru, dim_state_derivative, dim_action, dim_max,
+                      num_sensors, num_residual, dim_norm_residual, num_term,
+                      weights, norms, risk, t, T);
         }
-
-        double s = mju_exp(risk * c);
-
-        // cx
-        mju_scl(DataAt(cd.cx, t * dim_state_derivative),
-                DataAt(cd.cx, t * dim_state_derivative), s,
-                dim_state_derivative);
-
-        // cu
-        mju_scl(DataAt(cd.cu, t * dim_action), DataAt(cd.cu, t * dim_action), s,
-                dim_action);
-
-        // cxx
-        mju_scl(DataAt(cd.cxx, t * dim_state_derivative * dim_state_derivative),
-                DataAt(cd.cxx, t * dim_state_derivative * dim_state_derivative),
-                s, dim_state_derivative * dim_state_derivative);
-        mju_mulMatMat(DataAt(cd.cxx_scratch_,
-                             t * dim_state_derivative * dim_state_derivative),
-                      DataAt(cd.cx, t * dim_state_derivative),
-                      DataAt(cd.cx, t * dim_state_derivative),
-                      dim_state_derivative, 1, dim_state_derivative);
-        mju_scl(DataAt(cd.cxx_scratch_,
-                       t * dim_state_derivative * dim_state_derivative),
-                DataAt(cd.cxx_scratch_,
-                       t * dim_state_derivative * dim_state_derivative),
-                risk * s, dim_state_derivative * dim_state_derivative);
-        mju_addTo(
-            DataAt(cd.cxx, t * dim_state_derivative * dim_state_derivative),
-            DataAt(cd.cxx_scratch_,
-                   t * dim_state_derivative * dim_state_derivative),
-            dim_state_derivative * dim_state_derivative);
-
-        // cxu
-        mju_scl(DataAt(cd.cxu, t * dim_state_derivative * dim_action),
-                DataAt(cd.cxu, t * dim_state_derivative * dim_action), s,
-                dim_state_derivative * dim_action);
-        mju_mulMatMat(
-            DataAt(cd.cxu_scratch_, t * dim_state_derivative * dim_action),
-            DataAt(cd.cx, t * dim_state_derivative),
-            DataAt(cd.cu, t * dim_action), dim_state_derivative, 1, dim_action);
-        mju_scl(DataAt(cd.cxu_scratch_, t * dim_state_derivative * dim_action),
-                DataAt(cd.cxu_scratch_, t * dim_state_derivative * dim_action),
-                risk * s, dim_state_derivative * dim_action);
-        mju_addTo(
-            DataAt(cd.cxu, t * dim_state_derivative * dim_action),
-            DataAt(cd.cxu_scratch_, t * dim_state_derivative * dim_action),
-            dim_state_derivative * dim_action);
-
-        // cuu
-        mju_scl(DataAt(cd.cuu, t * dim_action * dim_action),
-                DataAt(cd.cuu, t * dim_action * dim_action), s,
-                dim_action * dim_action);
-        mju_mulMatMat(DataAt(cd.cuu_scratch_, t * dim_action * dim_action),
-                      DataAt(cd.cu, t * dim_action),
-                      DataAt(cd.cu, t * dim_action), dim_action, 1, dim_action);
-        mju_scl(DataAt(cd.cuu_scratch_, t * dim_action * dim_action),
-                DataAt(cd.cuu_scratch_, t * dim_action * dim_action), risk * s,
-                dim_action * dim_action);
-        mju_addTo(DataAt(cd.cuu, t * dim_action * dim_action),
-                  DataAt(cd.cuu_scratch_, t * dim_action * dim_action),
-                  dim_action * dim_action);
       });
     }
-    pool.WaitCount(count_before + T);
+    pool.WaitCount(count_before + num_chunk);
   }
   pool.ResetCount();
 }
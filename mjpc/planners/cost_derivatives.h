@@ -40,16 +40,32 @@ class CostDerivatives {
   // reset memory to zeros
   void Reset(int dim_state_derivative, int dim_action, int dim_residual, int T);
 
-  // compute derivatives at one time step
+  // accumulate one term's derivatives at one time step; gradient and
+  // Gauss-Newton Hessian are formed in a single pass over the residual rows
+  // (C_scratch: nr * (nx + dim_action))
   double DerivativeStep(double* Cx, double* Cu, double* Cxx, double* Cuu,
                         double* Cxu, double* Cr, double* Crr, double* C_scratch,
-                        double* Cx_scratch, double* Cu_scratch,
-                        double* Cxx_scratch, double* Cuu_scratch,
-                        double* Cxu_scratch, const double* r, const double* rx,
-                        const double* ru, int nr, int nx, int dim_action,
-                        double weight, const double* p, NormType type);
+                        const double* r, const double* rx, const double* ru,
+                        int nr, int nx, int dim_action, double weight,
+                        const double* p, NormType type);
 
-  // compute derivatives at all time steps
+  // compute derivatives at one time step using only the nonzero columns
+  // (column_x: num_column_x, column_u: num_column_u) of the residual Jacobians
+  double DerivativeStepSparse(
+      double* Cx, double* Cu, double* Cxx, double* Cuu, double* Cxu,
+      double* Cr, double* Crr, double* C_scratch, double* rx_scratch,
+      double* ru_scratch, const double* r, const double* rx, const double* ru,
+      int nr, int nx, int dim_action, const int* column_x, int num_column_x,
+      const int* column_u, int num_column_u, double weight, const double* p,
+      NormType type);
+
+  // compute nonzero column pattern of each residual term over all time steps
+  void ColumnPattern(const double* rx, const double* ru,
+                     int dim_state_derivative, int dim_action, int num_sensors,
+                     const int* dim_norm_residual, int num_term, int T);
+
+  // compute derivatives at all time steps; time steps are split into
+  // contiguous chunks that are processed in parallel
   void Compute(double* r, double* rx, double* ru, int dim_state_derivative,
                int dim_action, int dim_max, int num_sensors, int num_residual,
                const int* dim_norm_residual, int num_term,
@@ -59,7 +75,7 @@ class CostDerivatives {
 
   std::vector<double> cr;   // norm gradient wrt residual
                             //   (T * dim_residual)
-  std::vector<double> crr;  // norm Hessian wrt residual
+  std::vector<double> crr;  // norm Hessian wrt residual, per-term blocks
                             //   (T * dim_residual * dim_residual)
   std::vector<double> cx;   // cost gradient wrt state
                             //   (T * dim_state_derivative)
@@ -74,14 +90,56 @@ class CostDerivatives {
                             //   ((T - 1) * dim_state_derivative * dim_action)
 
  private:
+  // accumulate one term's derivatives at one time step from norm gradient Cr
+  // and Hessian Crr
+  void AccumulateStep(double* Cx, double* Cu, double* Cxx, double* Cuu,
+                      double* Cxu, const double* Cr, const double* Crr,
+                      double* C_scratch, const double* rx, const double* ru,
+                      int nr, int nx, int dim_action, double weight,
+                      NormType type);
+
+  // accumulate one term's derivatives at one time step from norm gradient Cr
+  // and Hessian Crr using only the nonzero columns of the residual Jacobians
+  void AccumulateStepSparse(double* Cx, double* Cu, double* Cxx, double* Cuu,
+                            double* Cxu, const double* Cr, const double* Crr,
+                            double* C_scratch, double* rx_scratch,
+                            double* ru_scratch, const double* rx,
+                            const double* ru, int nr, int nx, int dim_action,
+                            const int* column_x, int num_column_x,
+                            const int* column_u, int num_column_u,
+                            double weight, NormType type);
+
+  // evaluate each term's norm with NormBatch over time steps
+  // [t_begin, t_end): weighted costs, norm gradients and norm Hessians
+  void NormChunk(const double* r, int num_residual,
+                 const int* dim_norm_residual, int num_term,
+                 const double* weights, const NormType* norms,
+                 const double* parameters, const int* num_norm_parameter,
+                 int t_begin, int t_end, int T);
+
+  // zero outputs, accumulate all terms and apply risk transformation at one
+  // time step; requires NormChunk for this time step
+  void TimeStep(const double* rx, const double* ru, int dim_state_derivative,
+                int dim_action, int dim_max, int num_sensors, int num_residual,
+                const int* dim_norm_residual, int num_term,
+                const double* weights, const NormType* norms, double risk,
+                int t, int T);
+
+  // weighted cost and norm values at each time step
+  std::vector<double> cost_;        // (T)
+  std::vector<double> norm_value_;  // (T)
+
   // scratch spaces
-  std::vector<double> c_scratch_;    // (T * dim_max * dim_max)
-  std::vector<double> cx_scratch_;   // (T * dim_state_derivative)
-  std::vector<double> cu_scratch_;   // (T * dim_action)
-  std::vector<double> cxx_scratch_;  // (T * dim_state_derivative *
-                                     //  dim_state_derivative)
-  std::vector<double> cuu_scratch_;  // (T * dim_action * dim_action)
-  std::vector<double> cxu_scratch_;  // (T * dim_state_derivative * dim_action)
+  std::vector<double> c_scratch_;   // (T * dim_max *
+                                    //  (dim_state_derivative + dim_action))
+  std::vector<double> rx_scratch_;  // (T * dim_max * dim_state_derivative)
+  std::vector<double> ru_scratch_;  // (T * dim_max * dim_action)
+
+  // nonzero columns of residual Jacobians per term
+  std::vector<int> column_x_;      // (num_term * dim_state_derivative)
+  std::vector<int> column_u_;      // (num_term * dim_action)
+  std::vector<int> num_column_x_;  // (num_term)
+  std::vector<int> num_column_u_;  // (num_term)
 };
 
 }  // namespace mjpc
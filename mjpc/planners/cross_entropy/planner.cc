@@ -75,10 +75,6 @@ void CrossEntropyPlanner::Allocate() {
   // initial state
   int num_state = model->nq + model->nv + model->na;
 
-  // state
-  state.resize(num_state);
-  mocap.resize(7 * model->nmocap);
-  userdata.resize(model->nuserdata);
 
   // policy
   int num_max_parameter = model->nu * kMaxTrajectoryHorizon;
@@ -118,10 +114,7 @@ void CrossEntropyPlanner::Allocate() {
 void CrossEntropyPlanner::Reset(int horizon,
                                 const double* initial_repeated_action) {
   // state
-  std::fill(state.begin(), state.end(), 0.0);
-  std::fill(mocap.begin(), mocap.end(), 0.0);
-  std::fill(userdata.begin(), userdata.end(), 0.0);
-  time = 0.0;
+  HoldState(State::ZeroSnapshot(model));
 
   // policy parameters
   policy.Reset(horizon, initial_repeated_action);
@@ -156,8 +149,7 @@ void CrossEntropyPlanner::Reset(int horizon,
 
 // set state
 void CrossEntropyPlanner::SetState(const State& state) {
-  state.CopyTo(this->state.data(), this->mocap.data(), this->userdata.data(),
-               &this->time);
+  HoldState(state.Snapshot());
 }
 
 // optimize nominal policy using random sampling
@@ -169,6 +161,13 @@ void CrossEntropyPlanner::OptimizePolicy(int horizon, ThreadPool& pool) {
   // for the duration of this function.
   int num_trajectory = num_trajectory_;
 
+  // fewer rollouts if the budget doesn't allow all of them, keeping the elites
+  // and time for the policy update
+  num_trajectory = BudgetedCount(num_trajectory, n_elite_,
+                                 rollouts_compute_time, num_rollouts_,
+                                 pool.NumThreads(), policy_update_compute_time);
+  num_rollouts_ = num_trajectory;
+
   // n_elite_ might change in the GUI - keep constant for in this function
   n_elite_ = std::min(n_elite_, num_trajectory);
   int n_elite = std::min(n_elite_, num_trajectory);
@@ -272,6 +271,7 @@ void CrossEntropyPlanner::OptimizePolicy(int horizon, ThreadPool& pool) {
                               parameters_scratch.data() + (t + 1) * model->nu);
       policy.plan.AddNode(times_scratch[t], values);
     }
+    policy.plan.UpdateCoefficients();
   }
 
   // improvement: compare nominal to elite average
@@ -296,6 +296,7 @@ void CrossEntropyPlanner::NominalTrajectory(int horizon) {
                              time, mocap.data(), userdata.data(), horizon);
 }
 void CrossEntropyPlanner::NominalTrajectory(int horizon, ThreadPool& pool) {
+  ResizeMjData(model, pool.NumThreads());
   NominalTrajectory(horizon);
 }
 
@@ -337,6 +338,7 @@ void CrossEntropyPlanner::ResamplePolicy(int horizon) {
     resampled_policy.plan.AddNode(times_scratch[t], values);
   }
   resampled_policy.plan.SetInterpolation(policy.plan.Interpolation());
+  resampled_policy.plan.UpdateCoefficients();
 }
 
 // add random noise to nominal policy
@@ -406,15 +408,19 @@ void CrossEntropyPlanner::Rollouts(int num_trajectory, int horizon,
 
       // ----- rollout sample policy ----- //
 
+      // precompute actions along the horizon
+      s.candidate_policy[i].PrecomputeActions(time, model->opt.timestep,
+                                              horizon - 1);
+
       // policy
       auto sample_policy_i = [&candidate_policy = s.candidate_policy, &i](
                                  double* action, const double* state,
-                                 double time) {
-        candidate_policy[i].Action(action, state, time);
+                                 int index) {
+        candidate_policy[i].ActionDiscrete(action, state, index);
       };
 
       // policy rollout
-      s.trajectory[i].Rollout(
+      s.trajectory[i].RolloutDiscrete(
           sample_policy_i, task, model, s.data_[ThreadPool::WorkerId()].get(),
           state.data(), time, mocap.data(), userdata.data(), horizon);
     });
@@ -427,6 +433,12 @@ void CrossEntropyPlanner::Rollouts(int num_trajectory, int horizon,
   pool.ResetCount();
 }
 
+// seed nominal policy with trajectory actions
+void CrossEntropyPlanner::WarmStart(const Trajectory& trajectory) {
+  const std::unique_lock<std::shared_mutex> lock(mtx_);
+  policy.SetPlan(trajectory);
+}
+
 // returns the **nominal** trajectory (this is the purple trace)
 const Trajectory* CrossEntropyPlanner::BestTrajectory() {
   return &nominal_trajectory;
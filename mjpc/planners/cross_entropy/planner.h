@@ -73,6 +73,9 @@ class CrossEntropyPlanner : public Planner {
   // compute candidate trajectories
   void Rollouts(int num_trajectory, int horizon, ThreadPool& pool);
 
+  // seed nominal policy with trajectory actions
+  void WarmStart(const Trajectory& trajectory) override;
+
   // return trajectory with best total return
   const Trajectory* BestTrajectory() override;
 
@@ -95,12 +98,6 @@ class CrossEntropyPlanner : public Planner {
   mjModel* model;
   const Task* task;
 
-  // state
-  std::vector<double> state;
-  double time;
-  std::vector<double> mocap;
-  std::vector<double> userdata;
-
   // policy
   SamplingPolicy policy;  // (Guarded by mtx_)
   SamplingPolicy candidate_policy[kMaxTrajectory];
@@ -139,6 +136,10 @@ class CrossEntropyPlanner : public Planner {
   mjpc::spline::SplineInterpolation interpolation_ =
       mjpc::spline::SplineInterpolation::kZeroSpline;
   int num_trajectory_;
+
+  // number of rollouts in the last iteration, fewer than num_trajectory_
+  // when limited by the planning budget
+  int num_rollouts_ = 0;
   mutable std::shared_mutex mtx_;
 };
 
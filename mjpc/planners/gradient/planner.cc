@@ -16,6 +16,7 @@
 
 #include <algorithm>
 #include <chrono>
+#include <cmath>
 #include <shared_mutex>
 
 #include <mujoco/mujoco.h>
@@ -46,6 +47,11 @@ void GradientPlanner::Initialize(mjModel* model, const Task& task) {
   // model
   this->model = model;
 
+  // shared Jacobians
+  model_derivative.cache = derivative_cache;
+  model_derivative.reuse_tolerance =
+      GetNumberOrDefault(0.0, model, "derivative_reuse_tolerance");
+
   // task
   this->task = &task;
 
@@ -63,10 +69,6 @@ void GradientPlanner::Initialize(mjModel* model, const Task& task) {
 
 // allocate memory
 void GradientPlanner::Allocate() {
-  // state
-  state.resize(model->nq + model->nv + model->na);
-  mocap.resize(7 * model->nmocap);
-  userdata.resize(model->nuserdata);
 
   // candidate trajectories
   winner = -1;
@@ -108,10 +110,7 @@ void GradientPlanner::Allocate() {
 void GradientPlanner::Reset(int horizon,
                             const double* initial_repeated_action) {
   // state
-  std::fill(state.begin(), state.end(), 0.0);
-  std::fill(mocap.begin(), mocap.end(), 0.0);
-  std::fill(userdata.begin(), userdata.end(), 0.0);
-  time = 0.0;
+  HoldState(State::ZeroSnapshot(model));
 
   // model derivatives
   model_derivative.Reset(dim_state_derivative, dim_action, dim_sensor, horizon);
@@ -147,12 +146,14 @@ void GradientPlanner::Reset(int horizon,
 
   // derivative skip
   derivative_skip_ = GetNumberOrDefault(0, model, "derivative_skip");
+
+  // time of the last model derivatives
+  derivative_time_ = 0.0;
 }
 
 // set state
 void GradientPlanner::SetState(const State& state) {
-  state.CopyTo(this->state.data(), this->mocap.data(), this->userdata.data(),
-               &this->time);
+  HoldState(state.Snapshot());
 }
 
 // optimize nominal policy via gradient descent
@@ -192,10 +193,25 @@ void GradientPlanner::OptimizePolicy(int horizon, ThreadPool& pool) {
   // stop timer
   nominal_time = GetDuration(nominal_start);
 
+  // receding horizon: shift the previous derivatives by the elapsed time
+  // steps, so only the exposed tail and the changed steps are evaluated
+  if (model_derivative.reuse_tolerance > 0.0) {
+    model_derivative.Shift(
+        std::lround((trajectory[0].times[0] - derivative_time_) /
+                    model->opt.timestep),
+        dim_state_derivative, dim_action, dim_sensor, horizon);
+  }
+  derivative_time_ = trajectory[0].times[0];
+
   // update policy
   double c_best = c_prev;
   int skip = derivative_skip_;
+  double iteration_time = 0.0;
   for (int i = 0; i < settings.max_rollout; i++) {
+    // stop when the budget doesn't allow another iteration
+    if (i > 0 && BudgetRemaining() < iteration_time) break;
+    auto iteration_start = std::chrono::steady_clock::now();
+
     // ----- model derivatives ----- //
     // start timer
     auto model_derivative_start = std::chrono::steady_clock::now();
@@ -235,17 +251,15 @@ void GradientPlanner::OptimizePolicy(int horizon, ThreadPool& pool) {
                                      &cost_derivative, dim_state_derivative,
                                      dim_action, horizon);
 
-    // compute spline mapping linear operator
-    mappings[policy.representation]->Compute(
+    // compute spline mapping linear operator (cached by time grids)
+    mappings[policy.representation]->Update(
         candidate_policy[0].times, candidate_policy[0].num_spline_points,
         trajectory[0].times.data(), trajectory[0].horizon - 1);
 
     // compute total derivatives
-    mju_mulMatTVec(candidate_policy[0].parameter_update.data(),
-                   mappings[policy.representation]->Get(),
-                   candidate_policy[0].k.data(),
-                   model->nu * (trajectory[0].horizon - 1),
-                   model->nu * candidate_policy[0].num_spline_points);
+    mappings[policy.representation]->MulTVec(
+        candidate_policy[0].parameter_update.data(),
+        candidate_policy[0].k.data());
 
     // stop timer
     gradient_time += GetDuration(gradient_start);
@@ -297,6 +311,7 @@ void GradientPlanner::OptimizePolicy(int horizon, ThreadPool& pool) {
 
     // stop timer
     rollouts_time += GetDuration(rollouts_start);
+    iteration_time = GetDuration(iteration_start);
   }
 
   // update nominal policy
@@ -328,6 +343,9 @@ void GradientPlanner::OptimizePolicy(int horizon, ThreadPool& pool) {
 
 // compute trajectory using nominal policy
 void GradientPlanner::NominalTrajectory(int horizon, ThreadPool& pool) {
+  // hold the per-thread data
+  ResizeMjData(model, pool.NumThreads());
+
   // nominal policy
   auto nominal_policy = [&cp = candidate_policy[0]](
                             double* action, const double* state, double time) {
@@ -414,6 +432,12 @@ void GradientPlanner::Rollouts(int horizon, ThreadPool& pool) {
   pool.ResetCount();
 }
 
+// seed nominal policy with trajectory actions
+void GradientPlanner::WarmStart(const Trajectory& trajectory) {
+  const std::unique_lock<std::shared_mutex> lock(mtx_);
+  policy.CopyParametersFrom(trajectory);
+}
+
 // return trajectory with best total return
 const Trajectory* GradientPlanner::BestTrajectory() {
   return winner >= 0 ? &trajectory[winner] : nullptr;
@@ -75,6 +75,9 @@ class GradientPlanner : public Planner {
   // compute candidate trajectories
   void Rollouts(int horizon, ThreadPool& pool);
 
+  // seed nominal policy with trajectory actions
+  void WarmStart(const Trajectory& trajectory) override;
+
   // return trajectory with best total return
   const Trajectory* BestTrajectory() override;
 
@@ -97,12 +100,6 @@ class GradientPlanner : public Planner {
   mjModel* model;
   const Task* task;
 
-  // state
-  std::vector<double> state;
-  double time;
-  std::vector<double> mocap;
-  std::vector<double> userdata;
-
   // policy
   GradientPolicy policy;
   GradientPolicy previous_policy;
@@ -161,6 +158,9 @@ class GradientPlanner : public Planner {
  private:
   mutable std::shared_mutex mtx_;
   int derivative_skip_ = 0;
+
+  // time of the last model derivatives, to shift them as time advances
+  double derivative_time_ = 0.0;
 };
 
 }  // namespace mjpc
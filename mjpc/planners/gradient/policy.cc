@@ -131,4 +131,26 @@ void GradientPolicy::CopyParametersFrom(
   mju_copy(times.data(), src_times.data(), num_spline_points);
 }
 
+// copy parameters from trajectory actions
+void GradientPolicy::CopyParametersFrom(const Trajectory& trajectory) {
+  int num_action = trajectory.horizon - 1;
+  if (num_action < 1) return;
+
+  // node spacing
+  double start = trajectory.times[0];
+  double time_shift =
+      num_spline_points > 1
+          ? (trajectory.times[num_action - 1] - start) / (num_spline_points - 1)
+          : 0.0;
+
+  // sample actions
+  for (int i = 0; i < num_spline_points; i++) {
+    times[i] = start + i * time_shift;
+    double* parameter = parameters.data() + i * model->nu;
+    LinearInterpolation(parameter, times[i], trajectory.times,
+                        trajectory.actions.data(), model->nu, num_action);
+    Clamp(parameter, model->actuator_ctrlrange, model->nu);
+  }
+}
+
 }  // namespace mjpc
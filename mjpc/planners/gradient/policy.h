@@ -21,6 +21,7 @@
 #include "mjpc/planners/policy.h"
 #include "mjpc/spline/spline.h"
 #include "mjpc/task.h"
+#include "mjpc/trajectory.h"
 
 namespace mjpc {
 
@@ -53,6 +54,10 @@ class GradientPolicy : public Policy {
   void CopyParametersFrom(const std::vector<double>& src_parameters,
                           const std::vector<double>& src_times);
 
+  // set parameters to num_spline_points samples of a trajectory's actions,
+  // evenly spaced over the trajectory
+  void CopyParametersFrom(const Trajectory& trajectory);
+
   // ----- members ----- //
   const mjModel* model;
 
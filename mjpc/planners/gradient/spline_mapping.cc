@@ -15,17 +15,137 @@
 #include "mjpc/planners/gradient/spline_mapping.h"
 
 #include <algorithm>
+#include <cmath>
 #include <vector>
 
 #include "mjpc/trajectory.h"
 
 namespace mjpc {
 
+// compute mapping and banded form if relative time grids changed
+bool SplineMapping::Update(const std::vector<double>& input_times,
+                           int num_input, const double* output_times,
+                           int num_output) {
+  // compare relative time grids
+  double t0 = num_output > 0 ? output_times[0] : 0.0;
+  bool cached = num_input == num_input_ && num_output == num_output_;
+  for (int i = 0; cached && i < num_input; i++) {
+    cached = std::abs(input_times[i] - t0 - input_grid_[i]) <
+             kSplineMappingTimeTolerance;
+  }
+  for (int i = 0; cached && i < num_output; i++) {
+    cached = std::abs(output_times[i] - t0 - output_grid_[i]) <
+             kSplineMappingTimeTolerance;
+  }
+  if (cached) return false;
+
+  // save relative time grids
+  input_grid_.resize(num_input);
+  for (int i = 0; i < num_input; i++) {
+    input_grid_[i] = input_times[i] - t0;
+  }
+  output_grid_.resize(num_output);
+  for (int i = 0; i < num_output; i++) {
+    output_grid_[i] = output_times[i] - t0;
+  }
+
+  // compute
+  Compute(input_times, num_input, output_times, num_output);
+  Compress(num_input, num_output);
+
+  return true;
+}
+
+// banded form of mapping
+void SplineMapping::Compress(int num_input, int num_output) {
+  const double* mapping = Get();
+  int num_col = dim * num_input;
+
+  // nonzero points of first parameter per output time
+  band_first_.resize(num_output);
+  band_width_ = 1;
+  for (int i = 0; i < num_output; i++) {
+    const double* row = mapping + dim * i * num_col;
+    int first = -1, last = -1;
+    for (int k = 0; k < num_input; k++) {
+      if (row[dim * k] == 0.0) continue;
+      if (first < 0) first = k;
+      last = k;
+    }
+    if (first < 0) first = last = 0;
+    band_first_[i] = first;
+    band_width_ = std::max(band_width_, last - first + 1);
+  }
+
+  // weights, bands that would extend past the last point are shifted back
+  band_weight_.resize(num_output * band_width_);
+  for (int i = 0; i < num_output; i++) {
+    band_first_[i] = std::min(band_first_[i], num_input - band_width_);
+    const double* row = mapping + dim * i * num_col;
+    for (int b = 0; b < band_width_; b++) {
+      band_weight_[i * band_width_ + b] = row[dim * (band_first_[i] + b)];
+    }
+  }
+
+  num_input_ = num_input;
+  num_output_ = num_output;
+}
+
+// res = A * vec
+void SplineMapping::MulVec(double* res, const double* vec) const {
+  mju_zero(res, dim * num_output_);
+  for (int i = 0; i < num_output_; i++) {
+    const double* weight = band_weight_.data() + i * band_width_;
+    for (int b = 0; b < band_width_; b++) {
+      if (weight[b] == 0.0) continue;
+      mju_addToScl(res + dim * i, vec + dim * (band_first_[i] + b), weight[b],
+                   dim);
+    }
+  }
+}
+
+// res = A' * vec
+void SplineMapping::MulTVec(double* res, const double* vec) const {
+  mju_zero(res, dim * num_input_);
+  for (int i = 0; i < num_output_; i++) {
+    const double* weight = band_weight_.data() + i * band_width_;
+    for (int b = 0; b < band_width_; b++) {
+      if (weight[b] == 0.0) continue;
+      mju_addToScl(res + dim * (band_first_[i] + b), vec + dim * i, weight[b],
+                   dim);
+    }
+  }
+}
+
+// res = A' * A
+void SplineMapping::Gram(double* res) const {
+  int n = dim * num_input_;
+  mju_zero(res, n * n);
+  for (int i = 0; i < num_output_; i++) {
+    const double* weight = band_weight_.data() + i * band_width_;
+    for (int b0 = 0; b0 < band_width_; b0++) {
+      if (weight[b0] == 0.0) continue;
+      for (int b1 = 0; b1 < band_width_; b1++) {
+        if (weight[b1] == 0.0) continue;
+        double w = weight[b0] * weight[b1];
+        int row = dim * (band_first_[i] + b0);
+        int col = dim * (band_first_[i] + b1);
+        for (int j = 0; j < dim; j++) {
+          res[(row + j) * n + col + j] += w;
+        }
+      }
+    }
+  }
+}
+
 // allocate memory
 void ZeroSplineMapping::Allocate(int dim) {
   // dimensions
   this->dim = dim;
 
+  // invalidate cached mapping
+  num_input_ = num_output_ = 0;
+
   // allocate
   mapping.resize((dim * kMaxTrajectoryHorizon) *
                  (dim * kMaxGradientSplinePoints));
@@ -58,6 +178,9 @@ void LinearSplineMapping::Allocate(int dim) {
   // dimensions
   this->dim = dim;
 
+  // invalidate cached mapping
+  num_input_ = num_output_ = 0;
+
   // allocate
   mapping.resize((dim * kMaxTrajectoryHorizon) *
                  (dim * kMaxGradientSplinePoints));
@@ -105,6 +228,9 @@ void CubicSplineMapping::Allocate(int dim) {
   // dimensions
   this->dim = dim;
 
+  // invalidate cached mapping
+  num_input_ = num_output_ = 0;
+
   // allocate
   mapping.resize((dim * kMaxTrajectoryHorizon) *
                  (dim * kMaxGradientSplinePoints));
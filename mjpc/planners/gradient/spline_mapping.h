@@ -26,6 +26,9 @@ namespace mjpc {
 inline constexpr int kMinGradientSplinePoints = 1;
 inline constexpr int kMaxGradientSplinePoints = 25;
 
+// tolerance for comparing relative time grids of cached mappings
+inline constexpr double kSplineMappingTimeTolerance = 1.0e-8;
+
 // matrix representation for mapping between spline points and interpolated time
 // series.
 // A spline is made of num_input points, and each has one associated time, and
@@ -46,6 +49,12 @@ inline constexpr int kMaxGradientSplinePoints = 25;
 // flattened so that the parameters for each spline point are next to each
 // other, A*v gives the corresponding interpolated values, sampled at
 // output_times.
+//
+// Each output value depends on the same parameter of a few neighboring spline
+// points, so A is also stored in banded form: for output time i, the weights
+// of points first(i), ..., first(i) + band_width - 1, shared by all dim
+// parameters. Update recomputes A only if the time grids, relative to the
+// first output time, change.
 class SplineMapping {
  public:
   // constructor
@@ -65,6 +74,38 @@ class SplineMapping {
 
   // return mapping
   virtual double* Get() = 0;
+
+  // compute mapping and banded form if relative time grids changed, returns
+  // true if recomputed
+  bool Update(const std::vector<double>& input_times, int num_input,
+              const double* output_times, int num_output);
+
+  // res = A * vec (res: dim * num_output, vec: dim * num_input)
+  void MulVec(double* res, const double* vec) const;
+
+  // res = A' * vec (res: dim * num_input, vec: dim * num_output)
+  void MulTVec(double* res, const double* vec) const;
+
+  // res = A' * A (dim * num_input x dim * num_input)
+  void Gram(double* res) const;
+
+  // parameter dimension
+  int dim;
+
+ protected:
+  // banded form of mapping computed by Compute
+  void Compress(int num_input, int num_output);
+
+  // banded mapping
+  int num_input_ = 0;
+  int num_output_ = 0;
+  int band_width_ = 0;
+  std::vector<int> band_first_;      // (num_output)
+  std::vector<double> band_weight_;  // (num_output x band_width)
+
+  // relative time grids of cached mapping
+  std::vector<double> input_grid_;   // (num_input)
+  std::vector<double> output_grid_;  // (num_output)
 };
 
 // zero-order-hold mapping
@@ -89,7 +130,6 @@ class ZeroSplineMapping : public SplineMapping {
 
   // ----- members ----- //
   std::vector<double> mapping;
-  int dim;
 };
 
 // linear-interpolation mapping
@@ -115,7 +155,6 @@ class LinearSplineMapping : public SplineMapping {
 
   // ----- members ----- //
   std::vector<double> mapping;
-  int dim;
 };
 
 // cubic-interpolation mapping
@@ -143,7 +182,6 @@ class CubicSplineMapping : public SplineMapping {
   std::vector<double> mapping;
   std::vector<double> point_slope_mapping;
   std::vector<double> output_mapping;
-  int dim;
 };
 
 }  // namespace mjpc
@@ -16,6 +16,7 @@
 
 #include <algorithm>
 #include <chrono>
+#include <cmath>
 #include <cstddef>
 #include <cstdio>
 #include <iostream>
@@ -47,6 +48,11 @@ void iLQGPlanner::Initialize(mjModel* model, const Task& task) {
   // model
   this->model = model;
 
+  // shared Jacobians
+  model_derivative.cache = derivative_cache;
+  model_derivative.reuse_tolerance =
+      GetNumberOrDefault(0.0, model, "derivative_reuse_tolerance");
+
   // task
   this->task = &task;
 
@@ -62,14 +68,12 @@ void iLQGPlanner::Initialize(mjModel* model, const Task& task) {
   num_rollouts_gui_ = GetNumberOrDefault(10, model, "ilqg_num_rollouts");
   settings.regularization_type = GetNumberOrDefault(
       settings.regularization_type, model, "ilqg_regularization_type");
+  settings.num_segment =
+      GetNumberOrDefault(settings.num_segment, model, "ilqg_num_segment");
 }
 
 // allocate memory
 void iLQGPlanner::Allocate() {
-  // state
-  state.resize(model->nq + model->nv + model->na);
-  mocap.resize(7 * model->nmocap);
-  userdata.resize(model->nuserdata);
 
   // candidate trajectories
   for (int i = 0; i < kMaxTrajectory; i++) {
@@ -93,21 +97,26 @@ void iLQGPlanner::Allocate() {
   // policy
   policy.Allocate(model, *task, kMaxTrajectoryHorizon);
   previous_policy.Allocate(model, *task, kMaxTrajectoryHorizon);
+  candidate_policy.Allocate(model, *task, kMaxTrajectoryHorizon);
   for (int i = 0; i < kMaxTrajectory; i++) {
-    candidate_policy[i].Allocate(model, *task, kMaxTrajectoryHorizon);
+    candidate_view[i].Allocate(model);
   }
 
   // ----- boxQP ----- //
   boxqp.Allocate(dim_action);
+
+  // ----- multiple shooting ----- //
+  segment_start_.resize(kMaxShootingSegment * dim_state);
+  segment_end_.resize(kMaxShootingSegment * dim_state);
+  defect_.resize(kMaxTrajectoryHorizon * dim_state_derivative);
+  defect_flag_.resize(kMaxTrajectoryHorizon);
+  defect_value_.resize(dim_state_derivative);
 }
 
 // reset memory to zeros
 void iLQGPlanner::Reset(int horizon, const double* initial_repeated_action) {
   // state
-  std::fill(state.begin(), state.end(), 0.0);
-  std::fill(mocap.begin(), mocap.end(), 0.0);
-  std::fill(userdata.begin(), userdata.end(), 0.0);
-  time = 0.0;
+  HoldState(State::ZeroSnapshot(model));
 
   // model derivatives
   model_derivative.Reset(dim_state_derivative, dim_action, dim_sensor, horizon);
@@ -122,9 +131,7 @@ void iLQGPlanner::Reset(int horizon, const double* initial_repeated_action) {
   // policy
   policy.Reset(horizon, initial_repeated_action);
   previous_policy.Reset(horizon, initial_repeated_action);
-  for (int i = 0; i < kMaxTrajectory; i++) {
-    candidate_policy[i].Reset(horizon, initial_repeated_action);
-  }
+  candidate_policy.Reset(horizon, initial_repeated_action);
 
   // candidate trajectories
   for (int i = 0; i < kMaxTrajectory; i++) {
@@ -140,12 +147,18 @@ void iLQGPlanner::Reset(int horizon, const double* initial_repeated_action) {
 
   // derivative skip
   derivative_skip_ = GetNumberOrDefault(0, model, "derivative_skip");
+
+  // time of the last model derivatives
+  derivative_time_ = 0.0;
+
+  // multiple shooting
+  multiple_shooting_ = false;
+  segment_warmstart_ = false;
 }
 
 // set state
 void iLQGPlanner::SetState(const State& state) {
-  state.CopyTo(this->state.data(), this->mocap.data(), this->userdata.data(),
-               &this->time);
+  HoldState(state.Snapshot());
 }
 
 void iLQGPlanner::UpdateNumTrajectoriesFromGUI() {
@@ -159,6 +172,9 @@ void iLQGPlanner::OptimizePolicy(int horizon, ThreadPool& pool) {
   // get nominal trajectory
   this->NominalTrajectory(horizon, pool);
 
+  // out of budget, keep the current policy
+  if (BudgetRemaining() <= 0.0) return;
+
   // iteration
   this->Iteration(horizon, pool);
 }
@@ -183,13 +199,21 @@ void iLQGPlanner::NominalTrajectory(int horizon, ThreadPool& pool) {
   // start timer
   auto nominal_start = std::chrono::steady_clock::now();
 
+  // multiple shooting (parallel in time)
+  if (this->SegmentRollouts(horizon, pool)) {
+    // set feedback scaling
+    feedback_scaling = 1.0;
+
+    // end timer
+    nominal_compute_time = GetDuration(nominal_start);
+    return;
+  }
+
   // no one else should be writing, but we lock just in case:
   {
     const std::shared_lock<std::shared_mutex> lock(mtx_);
-    for (int i = 0; i < num_trajectory_; i++) {
-      candidate_policy[i].CopyFrom(policy, horizon);
-      candidate_policy[i].representation = policy.representation;
-    }
+    candidate_policy.CopyFrom(policy, horizon);
+    candidate_policy.representation = policy.representation;
   }
 
   // feedback rollouts (parallel)
@@ -205,14 +229,14 @@ void iLQGPlanner::NominalTrajectory(int horizon, ThreadPool& pool) {
     // state failed?
     {
       const std::shared_lock<std::shared_mutex> lock(mtx_);
-      candidate_policy[0].trajectory = policy.trajectory;
+      candidate_policy.trajectory = policy.trajectory;
     }
 
     // set feedback scaling
     feedback_scaling = 0.0;
   } else {
     // update nominal with winner
-    candidate_policy[0].trajectory = trajectory[best_nominal];
+    candidate_policy.trajectory = trajectory[best_nominal];
 
     // set feedback scaling
     feedback_scaling = linesearch_steps[best_nominal];
@@ -233,6 +257,17 @@ void iLQGPlanner::ActionFromPolicy(double* action, const double* state,
   }
 }
 
+// seed nominal policy with trajectory actions
+void iLQGPlanner::WarmStart(const Trajectory& trajectory) {
+  const std::unique_lock<std::shared_mutex> lock(mtx_);
+  policy.trajectory = trajectory;
+
+  // open loop until the first iteration
+  std::fill(policy.feedback_gain.begin(), policy.feedback_gain.end(), 0.0);
+  std::fill(policy.action_improvement.begin(), policy.action_improvement.end(),
+            0.0);
+}
+
 // return trajectory with best total return
 const Trajectory* iLQGPlanner::BestTrajectory() {
   const std::shared_lock<std::shared_mutex> lock(mtx_);
@@ -252,12 +287,16 @@ void iLQGPlanner::GUI(mjUI& ui) {
       {mjITEM_SELECT, "Reg. Type", 2, &settings.regularization_type,
        "Control\nFeedback\nValue\nNone"},
       {mjITEM_SLIDERINT, "Deriv. Skip", 2, &derivative_skip_, "0 16"},
+      {mjITEM_SLIDERINT, "Segments", 2, &settings.num_segment, "1 16"},
       {mjITEM_CHECKINT, "Terminal Print", 2, &settings.verbose, ""},
       {mjITEM_END}};
 
   // set number of trajectory slider limits
   mju::sprintf_arr(defiLQG[0].other, "%i %i", 1, kMaxTrajectory);
 
+  // set number of segments slider limits
+  mju::sprintf_arr(defiLQG[4].other, "%i %i", 1, kMaxShootingSegment);
+
   // add iLQG planner
   mjui_add(&ui, defiLQG);
 }
@@ -376,7 +415,7 @@ void iLQGPlanner::Plots(mjvFigure* fig_planner, mjvFigure* fig_timer,
 // single iLQG iteration
 void iLQGPlanner::Iteration(int horizon, ThreadPool& pool) {
   // set previous best cost
-  double previous_return = candidate_policy[0].trajectory.total_return;
+  double previous_return = candidate_policy.trajectory.total_return;
 
   // ----- setup ----- //
   // resize data for rollouts
@@ -391,11 +430,21 @@ void iLQGPlanner::Iteration(int horizon, ThreadPool& pool) {
   // start timer
   auto model_derivative_start = std::chrono::steady_clock::now();
 
+  // receding horizon: shift the previous derivatives by the elapsed time
+  // steps, so only the exposed tail and the changed steps are evaluated
+  if (model_derivative.reuse_tolerance > 0.0) {
+    model_derivative.Shift(
+        std::lround((candidate_policy.trajectory.times[0] - derivative_time_) /
+                    model->opt.timestep),
+        dim_state_derivative, dim_action, dim_sensor, horizon);
+  }
+  derivative_time_ = candidate_policy.trajectory.times[0];
+
   // compute model and sensor Jacobians
   model_derivative.Compute(
-      model, data_, candidate_policy[0].trajectory.states.data(),
-      candidate_policy[0].trajectory.actions.data(),
-      candidate_policy[0].trajectory.times.data(), dim_state,
+      model, data_, candidate_policy.trajectory.states.data(),
+      candidate_policy.trajectory.actions.data(),
+      candidate_policy.trajectory.times.data(), dim_state,
       dim_state_derivative, dim_action, dim_sensor, horizon,
       settings.fd_tolerance, settings.fd_mode, pool, derivative_skip_);
 
@@ -408,7 +457,7 @@ void iLQGPlanner::Iteration(int horizon, ThreadPool& pool) {
 
   // cost derivatives
   cost_derivative.Compute(
-      candidate_policy[0].trajectory.residual.data(), model_derivative.C.data(),
+      candidate_policy.trajectory.residual.data(), model_derivative.C.data(),
       model_derivative.D.data(), dim_state_derivative, dim_action, dim_max,
       dim_sensor, task->num_residual, task->dim_norm_residual.data(),
       task->num_term, task->weight.data(), task->norm.data(),
@@ -443,9 +492,21 @@ void iLQGPlanner::Iteration(int horizon, ThreadPool& pool) {
 
     // backward recursion
     for (t = horizon - 2; t >= 0; t--) {
+      // cost-to-go gradient, shifted by the defect between segments:
+      // Vx + Vxx * d
+      double* Vx = DataAt(backward_pass.Vx, (t + 1) * dim_state_derivative);
+      if (multiple_shooting_ && defect_flag_[t]) {
+        mju_mulMatVec(defect_value_.data(),
+                      DataAt(backward_pass.Vxx, (t + 1) * dim_state_derivative *
+                                                    dim_state_derivative),
+                      DataAt(defect_, t * dim_state_derivative),
+                      dim_state_derivative, dim_state_derivative);
+        mju_addTo(defect_value_.data(), Vx, dim_state_derivative);
+        Vx = defect_value_.data();
+      }
+
       int status = backward_pass.RiccatiStep(
-          dim_state_derivative, dim_action, backward_pass.regularization,
-          DataAt(backward_pass.Vx, (t + 1) * dim_state_derivative),
+          dim_state_derivative, dim_action, backward_pass.regularization, Vx,
           DataAt(backward_pass.Vxx,
                  (t + 1) * dim_state_derivative * dim_state_derivative),
           DataAt(model_derivative.A,
@@ -460,8 +521,8 @@ void iLQGPlanner::Iteration(int horizon, ThreadPool& pool) {
           DataAt(backward_pass.Vx, t * dim_state_derivative),
           DataAt(backward_pass.Vxx,
                  t * dim_state_derivative * dim_state_derivative),
-          DataAt(candidate_policy[0].action_improvement, t * dim_action),
-          DataAt(candidate_policy[0].feedback_gain,
+          DataAt(candidate_policy.action_improvement, t * dim_action),
+          DataAt(candidate_policy.feedback_gain,
                  t * dim_action * dim_state_derivative),
           backward_pass.dV, DataAt(backward_pass.Qx, t * dim_state_derivative),
           DataAt(backward_pass.Qu, t * dim_action),
@@ -470,7 +531,7 @@ void iLQGPlanner::Iteration(int horizon, ThreadPool& pool) {
           DataAt(backward_pass.Qxu, t * dim_state_derivative * dim_action),
           DataAt(backward_pass.Quu, t * dim_action * dim_action),
           backward_pass.Q_scratch.data(), boxqp,
-          DataAt(candidate_policy[0].trajectory.actions, t * dim_action),
+          DataAt(candidate_policy.trajectory.actions, t * dim_action),
           model->actuator_ctrlrange, settings.regularization_type,
           settings.action_limits);
 
@@ -492,14 +553,14 @@ void iLQGPlanner::Iteration(int horizon, ThreadPool& pool) {
       // complete
       if (t == 0) {
         // set feedback gains and improvement at final time step
-        mju_copy(DataAt(candidate_policy[0].feedback_gain,
+        mju_copy(DataAt(candidate_policy.feedback_gain,
                         (horizon - 1) * dim_action * dim_state_derivative),
-                 DataAt(candidate_policy[0].feedback_gain,
+                 DataAt(candidate_policy.feedback_gain,
                         (horizon - 2) * dim_action * dim_state_derivative),
                  dim_action * dim_state_derivative);
-        mju_copy(DataAt(candidate_policy[0].action_improvement,
+        mju_copy(DataAt(candidate_policy.action_improvement,
                         (horizon - 1) * dim_action),
-                 DataAt(candidate_policy[0].action_improvement,
+                 DataAt(candidate_policy.action_improvement,
                         (horizon - 2) * dim_action),
                  dim_action);
 
@@ -533,16 +594,23 @@ void iLQGPlanner::Iteration(int horizon, ThreadPool& pool) {
     return;
   }
 
+  // ----- line search depth ----- //
+  // fewer step sizes if the budget doesn't allow all of them
+  int num_linesearch = BudgetedCount(num_trajectory_, 2, rollouts_compute_time,
+                                     num_linesearch_, pool.NumThreads(),
+                                     policy_update_compute_time);
+  if (num_linesearch < num_trajectory_) {
+    num_trajectory_ = num_linesearch;
+    LogScale(linesearch_steps, 1.0, settings.min_linesearch_step,
+             num_trajectory_ - 1);
+    linesearch_steps[num_trajectory_ - 1] = 0.0;
+  }
+  num_linesearch_ = num_trajectory_;
+
   // ----- rollout policy ----- //
   auto rollouts_start = std::chrono::steady_clock::now();
 
-  // copy policy
-  for (int j = 1; j < num_trajectory_; j++) {
-    candidate_policy[j].CopyFrom(candidate_policy[0], horizon);
-    candidate_policy[j].representation = candidate_policy[0].representation;
-  }
-
-  // feedback rollouts (parallel)
+  // action rollouts (parallel)
   this->ActionRollouts(horizon, pool);
 
   // ----- evaluate rollouts ----- //
@@ -556,7 +624,14 @@ void iLQGPlanner::Iteration(int horizon, ThreadPool& pool) {
   }
 
   // update nominal with winner
-  candidate_policy[0].trajectory = trajectory[winner];
+  candidate_policy.trajectory = trajectory[winner];
+
+  // with multiple shooting, the nominal return includes the defects between
+  // segments; the zero-step candidate is a defect-free rollout of the same
+  // policy and is the baseline instead
+  if (multiple_shooting_ && !trajectory[num_trajectory_ - 1].failure) {
+    previous_return = trajectory[num_trajectory_ - 1].total_return;
+  }
 
   // improvement
   action_step = linesearch_steps[winner];
@@ -597,10 +672,13 @@ void iLQGPlanner::Iteration(int horizon, ThreadPool& pool) {
     const std::shared_lock<std::shared_mutex> lock(mtx_);
     // improvement
     previous_policy = policy;
-    policy.CopyFrom(candidate_policy[winner], horizon);
+    policy.CopyFrom(candidate_policy, horizon);
 
     // feedback scaling
     policy.feedback_scaling = 1.0;
+
+    // feasible nominal trajectory can seed multiple shooting
+    segment_warmstart_ = true;
   }
 
   // stop timer
@@ -616,56 +694,23 @@ void iLQGPlanner::Iteration(int horizon, ThreadPool& pool) {
 
 // compute candidate trajectories
 void iLQGPlanner::ActionRollouts(int horizon, ThreadPool& pool) {
+  // candidates: nominal policy with scaled action improvement
+  for (int i = 0; i < num_trajectory_; i++) {
+    candidate_view[i].Set(&candidate_policy, linesearch_steps[i], 1.0);
+  }
+
   int count_before = pool.GetCount();
   for (int i = 0; i < num_trajectory_; i++) {
     pool.Schedule([&data = data_, &trajectory = trajectory,
-                   &candidate_policy = candidate_policy,
-                   &linesearch_steps = linesearch_steps, &model = this->model,
+                   &candidate_view = candidate_view, &model = this->model,
                    &task = this->task, &state = this->state, &time = this->time,
                    &mocap = this->mocap, horizon, &userdata = this->userdata,
                    i]() {
-      // scale improvement
-      mju_addScl(candidate_policy[i].trajectory.actions.data(),
-                 candidate_policy[i].trajectory.actions.data(),
-                 candidate_policy[i].action_improvement.data(),
-                 linesearch_steps[i], model->nu * horizon);
-
       // policy
-      auto feedback_policy = [&candidate_policy = candidate_policy, model, i](
+      auto feedback_policy = [&candidate_view = candidate_view[i]](
                                  double* action, const double* state,
                                  int index) {
-        // dimensions
-        int dim_state = model->nq + model->nv + model->na;
-        int dim_state_derivative = 2 * model->nv + model->na;
-        int dim_action = model->nu;
-
-        // set improved action
-        mju_copy(
-            action,
-            DataAt(candidate_policy[i].trajectory.actions, index * dim_action),
-            dim_action);
-
-        // ----- feedback ----- //
-
-        // difference between current state and nominal state
-        StateDiff(
-            model, candidate_policy[i].state_scratch.data(),
-            DataAt(candidate_policy[i].trajectory.states, index * dim_state),
-            state, 1.0);
-
-        // compute feedback term
-        mju_mulMatVec(candidate_policy[i].action_scratch.data(),
-                      DataAt(candidate_policy[i].feedback_gain,
-                             index * dim_action * dim_state_derivative),
-                      candidate_policy[i].state_scratch.data(), dim_action,
-                      dim_state_derivative);
-
-        // add feedback
-        mju_addTo(action, candidate_policy[i].action_scratch.data(),
-                  dim_action);
-
-        // clamp controls
-        Clamp(action, model->actuator_ctrlrange, dim_action);
+        candidate_view.ActionDiscrete(action, state, index);
       };
 
       // policy rollout (discrete time)
@@ -681,22 +726,23 @@ void iLQGPlanner::ActionRollouts(int horizon, ThreadPool& pool) {
 
 // compute candidate trajectories searching over feedback scaling
 void iLQGPlanner::FeedbackRollouts(int horizon, ThreadPool& pool) {
+  // candidates: nominal policy with scaled feedback
+  for (int i = 0; i < num_trajectory_; i++) {
+    candidate_view[i].Set(&candidate_policy, 0.0, linesearch_steps[i]);
+  }
+
   int count_before = pool.GetCount();
   for (int i = 0; i < num_trajectory_; i++) {
     pool.Schedule([&data = data_, &trajectory = trajectory,
-                   &candidate_policy = candidate_policy,
-                   &linesearch_steps = linesearch_steps, &model = this->model,
+                   &candidate_view = candidate_view, &model = this->model,
                    &task = this->task, &state = this->state, &time = this->time,
                    &mocap = this->mocap, horizon, &userdata = this->userdata,
                    &settings = this->settings, i]() {
-      // feedback scaling
-      candidate_policy[i].feedback_scaling = linesearch_steps[i];
-
       // policy
       auto feedback_policy =
-          [&candidate_policy = candidate_policy[i], &settings = settings](
+          [&candidate_view = candidate_view[i], &settings = settings](
               double* action, const double* state, double time) {
-            candidate_policy.Action(
+            candidate_view.Action(
                 action, settings.nominal_feedback_scaling ? state : NULL, time);
           };
 
@@ -711,6 +757,110 @@ void iLQGPlanner::FeedbackRollouts(int horizon, ThreadPool& pool) {
   pool.ResetCount();
 }
 
+// multiple-shooting nominal rollout
+bool iLQGPlanner::SegmentRollouts(int horizon, ThreadPool& pool) {
+  multiple_shooting_ = false;
+  max_defect_ = 0.0;
+
+  // segments with at least two steps
+  int num_segment = mju_min(settings.num_segment, kMaxShootingSegment);
+  num_segment = mju_min(num_segment, (horizon - 1) / 2);
+  if (num_segment < 2 || !segment_warmstart_) return false;
+
+  // segment boundaries
+  for (int k = 0; k < num_segment; k++) {
+    segment_index_[k] = k * (horizon - 1) / num_segment;
+  }
+  segment_index_[num_segment] = horizon - 1;
+
+  // nominal policy, start states from previous nominal trajectory
+  {
+    const std::shared_lock<std::shared_mutex> lock(mtx_);
+    candidate_policy.CopyFrom(policy, horizon);
+    candidate_policy.representation = policy.representation;
+    for (int k = 0; k < num_segment; k++) {
+      candidate_view[k].Set(&candidate_policy, 0.0, 1.0);
+
+      // start state and time
+      double* start = DataAt(segment_start_, k * dim_state);
+      if (k == 0) {
+        mju_copy(start, state.data(), dim_state);
+        segment_time_[k] = time;
+      } else {
+        // nearest sample, robust to rounding in accumulated times
+        int bounds[2];
+        FindInterval(bounds, policy.trajectory.times,
+                     time + (segment_index_[k] + 0.5) * model->opt.timestep,
+                     policy.trajectory.horizon);
+        mju_copy(start, DataAt(policy.trajectory.states, bounds[0] * dim_state),
+                 dim_state);
+        segment_time_[k] = policy.trajectory.times[bounds[0]];
+      }
+    }
+  }
+
+  // segment rollouts (parallel)
+  trajectory[0].horizon = horizon;
+  int count_before = pool.GetCount();
+  for (int k = 0; k < num_segment; k++) {
+    pool.Schedule([&data = data_, &trajectory = trajectory,
+                   &candidate_view = candidate_view, &model = this->model,
+                   &task = this->task, &mocap = this->mocap,
+                   &userdata = this->userdata, &settings = this->settings,
+                   &segment_index = this->segment_index_,
+                   &segment_time = this->segment_time_,
+                   &segment_start = this->segment_start_,
+                   &segment_end = this->segment_end_,
+                   &segment_failure = this->segment_failure_, k]() {
+      int dim_state = model->nq + model->nv + model->na;
+
+      // policy
+      auto feedback_policy =
+          [&candidate_view = candidate_view[k], &settings = settings](
+              double* action, const double* state, double time) {
+            candidate_view.Action(
+                action, settings.nominal_feedback_scaling ? state : NULL, time);
+          };
+
+      // segment rollout
+      segment_failure[k] = !trajectory[0].RolloutSegment(
+          feedback_policy, task, model, data[ThreadPool::WorkerId()].get(),
+          DataAt(segment_start, k * dim_state), segment_time[k], mocap.data(),
+          userdata.data(), segment_index[k], segment_index[k + 1],
+          DataAt(segment_end, k * dim_state));
+    });
+  }
+  pool.WaitCount(count_before + num_segment);
+  pool.ResetCount();
+
+  // fall back to single shooting
+  for (int k = 0; k < num_segment; k++) {
+    if (segment_failure_[k]) return false;
+  }
+
+  // defects: end of segment k - 1 relative to start of segment k
+  std::fill(defect_flag_.begin(), defect_flag_.begin() + horizon, 0);
+  for (int k = 1; k < num_segment; k++) {
+    int t = segment_index_[k] - 1;
+    StateDiff(model, DataAt(defect_, t * dim_state_derivative),
+              DataAt(segment_start_, k * dim_state),
+              DataAt(segment_end_, (k - 1) * dim_state), 1.0);
+    defect_flag_[t] = 1;
+    max_defect_ = mju_max(
+        max_defect_,
+        mju_norm(DataAt(defect_, t * dim_state_derivative),
+                 dim_state_derivative));
+  }
+
+  // nominal trajectory
+  trajectory[0].failure = false;
+  trajectory[0].UpdateReturn(task);
+  candidate_policy.trajectory = trajectory[0];
+  multiple_shooting_ = true;
+
+  return true;
+}
+
 // return index of trajectory with best rollout
 int iLQGPlanner::BestRollout() {
   double best_return = 0;
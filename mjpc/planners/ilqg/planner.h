@@ -28,6 +28,9 @@
 
 namespace mjpc {
 
+// maximum number of multiple-shooting segments
+inline constexpr int kMaxShootingSegment = 16;
+
 // planner for iLQG
 class iLQGPlanner : public Planner {
  public:
@@ -58,6 +61,9 @@ class iLQGPlanner : public Planner {
   void ActionFromPolicy(double* action, const double* state, double time,
                         bool use_previous = false) override;
 
+  // seed nominal policy with trajectory actions
+  void WarmStart(const Trajectory& trajectory) override;
+
   // return trajectory with best total return
   const Trajectory* BestTrajectory() override;
 
@@ -85,25 +91,33 @@ class iLQGPlanner : public Planner {
   // linesearch over feedback scaling
   void FeedbackRollouts(int horizon, ThreadPool& pool);
 
+  // multiple-shooting nominal rollout: segments of the nominal policy are
+  // simulated in parallel from states of the previous nominal trajectory,
+  // returns false if not enabled or a segment fails
+  bool SegmentRollouts(int horizon, ThreadPool& pool);
+
   // return index of trajectory with best rollout
   int BestRollout();
 
+  // nominal trajectory of the last iteration was computed from segments
+  bool MultipleShooting() const { return multiple_shooting_; }
+
+  // largest defect norm between segments of the last nominal rollout
+  double MaxDefect() const { return max_defect_; }
+
   void UpdateNumTrajectoriesFromGUI();
 
   // ----- members ----- //
   mjModel* model;
   const Task* task;
 
-  // state
-  std::vector<double> state;
-  double time;
-  std::vector<double> mocap;
-  std::vector<double> userdata;
-
   // policy
   iLQGPolicy policy;
   iLQGPolicy previous_policy;
-  iLQGPolicy candidate_policy[kMaxTrajectory];
+  iLQGPolicy candidate_policy;  // nominal policy being improved
+
+  // line-search candidates referencing candidate_policy
+  iLQGPolicyView candidate_view[kMaxTrajectory];
 
   // dimensions
   int dim_state;             // state
@@ -157,7 +171,44 @@ class iLQGPlanner : public Planner {
  private:
   int num_trajectory_ = 1;
   int num_rollouts_gui_ = 1;
+
+  // line search step sizes in the last iteration, fewer than the rollouts
+  // set in the GUI when limited by the planning budget
+  int num_linesearch_ = 0;
   int derivative_skip_ = 0;
+
+  // time of the last model derivatives, to shift them as time advances
+  double derivative_time_ = 0.0;
+
+  // ----- multiple shooting ----- //
+  // nominal trajectory from segments, backward pass uses defects
+  bool multiple_shooting_ = false;
+
+  // previous nominal trajectory is feasible and can seed segments
+  bool segment_warmstart_ = false;
+
+  // segment boundaries (num_segment + 1)
+  int segment_index_[kMaxShootingSegment + 1];
+
+  // segment start times
+  double segment_time_[kMaxShootingSegment];
+
+  // segment start and end states (kMaxShootingSegment x dim_state)
+  std::vector<double> segment_start_;
+  std::vector<double> segment_end_;
+
+  // segment failure flags
+  int segment_failure_[kMaxShootingSegment];
+
+  // defects between segments, nonzero at last step of each segment
+  std::vector<double> defect_;     // (T * dim_state_derivative)
+  std::vector<int> defect_flag_;   // (T)
+
+  // largest defect norm
+  double max_defect_ = 0.0;
+
+  // value gradient shifted by defect (dim_state_derivative)
+  std::vector<double> defect_value_;
 };
 
 }  // namespace mjpc
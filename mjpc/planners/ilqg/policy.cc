@@ -81,6 +81,17 @@ void iLQGPolicy::Reset(int horizon, const double* initial_repeated_action) {
 // set action from policy
 void iLQGPolicy::Action(double* action, const double* state,
                         double time) const {
+  Action(action, state, time, 0.0, feedback_scaling, state_interp.data(),
+         feedback_gain_scratch.data(), state_scratch.data(),
+         action_scratch.data());
+}
+
+// set action from policy with action improvement, feedback scaling and
+// caller-provided scratch
+void iLQGPolicy::Action(double* action, const double* state, double time,
+                        double action_step, double feedback_scaling,
+                        double* state_interp, double* gain,
+                        double* state_diff, double* feedback) const {
   // dimension
   int dim_state = model->nq + model->nv + model->na;
   int dim_state_derivative = 2 * model->nv + model->na;
@@ -98,12 +109,12 @@ void iLQGPolicy::Action(double* action, const double* state,
 
     if (state) {
       // state reference
-      ZeroInterpolation(state_interp.data(), time, trajectory.times,
+      ZeroInterpolation(state_interp, time, trajectory.times,
                         trajectory.states.data(), dim_state,
                         trajectory.horizon);
 
       // gains
-      ZeroInterpolation(feedback_gain_scratch.data(), time, trajectory.times,
+      ZeroInterpolation(gain, time, trajectory.times,
                         feedback_gain.data(), dim_action * dim_state_derivative,
                         trajectory.horizon - 1);
     }
@@ -115,14 +126,14 @@ void iLQGPolicy::Action(double* action, const double* state,
 
     if (state) {
       // state
-      LinearInterpolation(state_interp.data(), time, trajectory.times,
+      LinearInterpolation(state_interp, time, trajectory.times,
                           trajectory.states.data(), dim_state,
                           trajectory.horizon);
 
       // normalize quaternions
-      mj_normalizeQuat(model, state_interp.data());
+      mj_normalizeQuat(model, state_interp);
 
-      LinearInterpolation(feedback_gain_scratch.data(), time, trajectory.times,
+      LinearInterpolation(gain, time, trajectory.times,
                           feedback_gain.data(),
                           dim_action * dim_state_derivative,
                           trajectory.horizon - 1);
@@ -135,25 +146,43 @@ void iLQGPolicy::Action(double* action, const double* state,
 
     if (state) {
       // state
-      CubicInterpolation(state_interp.data(), time, trajectory.times,
+      CubicInterpolation(state_interp, time, trajectory.times,
                          trajectory.states.data(), dim_state,
                          trajectory.horizon);
 
       // normalize quaternions
-      mj_normalizeQuat(model, state_interp.data());
+      mj_normalizeQuat(model, state_interp);
 
-      CubicInterpolation(feedback_gain_scratch.data(), time, trajectory.times,
+      CubicInterpolation(gain, time, trajectory.times,
                         feedback_gain.data(), dim_action * dim_state_derivative,
                         trajectory.horizon - 1);
     }
   }
 
+  // add scaled action improvement, interpolated as the actions
+  if (action_step != 0.0) {
+    if (bounds[0] == bounds[1] || representation == 0) {
+      ZeroInterpolation(feedback, time, trajectory.times,
+                        action_improvement.data(), dim_action,
+                        trajectory.horizon - 1);
+    } else if (representation == 1) {
+      LinearInterpolation(feedback, time, trajectory.times,
+                          action_improvement.data(), dim_action,
+                          trajectory.horizon - 1);
+    } else if (representation == 2) {
+      CubicInterpolation(feedback, time, trajectory.times,
+                         action_improvement.data(), dim_action,
+                         trajectory.horizon - 1);
+    }
+    mju_addToScl(action, feedback, action_step, dim_action);
+  }
+
   // add feedback
   if (state) {
-    StateDiff(model, state_scratch.data(), state_interp.data(), state, 1.0);
-    mju_mulMatVec(action_scratch.data(), feedback_gain_scratch.data(),
-                  state_scratch.data(), dim_action, dim_state_derivative);
-    mju_addToScl(action, action_scratch.data(), feedback_scaling, dim_action);
+    StateDiff(model, state_diff, state_interp, state, 1.0);
+    mju_mulMatVec(feedback, gain,
+                  state_diff, dim_action, dim_state_derivative);
+    mju_addToScl(action, feedback, feedback_scaling, dim_action);
   }
 
   // clamp controls
@@ -174,4 +203,57 @@ void iLQGPolicy::CopyFrom(const iLQGPolicy& policy, int horizon) {
            horizon * model->nu);
 }
 
+// allocate scratch
+void iLQGPolicyView::Allocate(const mjModel* model) {
+  state_interp_.resize(model->nq + model->nv + model->na);
+  gain_.resize(model->nu * (2 * model->nv + model->na));
+  state_diff_.resize(2 * model->nv + model->na);
+  feedback_.resize(model->nu);
+}
+
+// set nominal policy and scalings
+void iLQGPolicyView::Set(const iLQGPolicy* nominal, double action_step,
+                         double feedback_scaling) {
+  this->nominal = nominal;
+  this->action_step = action_step;
+  this->feedback_scaling = feedback_scaling;
+}
+
+// continuous-time action
+void iLQGPolicyView::Action(double* action, const double* state,
+                            double time) const {
+  nominal->Action(action, state, time, action_step, feedback_scaling,
+                  state_interp_.data(), gain_.data(), state_diff_.data(),
+                  feedback_.data());
+}
+
+// discrete-time action at trajectory index
+void iLQGPolicyView::ActionDiscrete(double* action, const double* state,
+                                    int index) const {
+  // dimensions
+  const mjModel* model = nominal->model;
+  int dim_state = model->nq + model->nv + model->na;
+  int dim_state_derivative = 2 * model->nv + model->na;
+  int dim_action = model->nu;
+
+  // improved action
+  mju_addScl(action, DataAt(nominal->trajectory.actions, index * dim_action),
+             DataAt(nominal->action_improvement, index * dim_action),
+             action_step, dim_action);
+
+  // difference between current state and nominal state
+  StateDiff(model, state_diff_.data(),
+            DataAt(nominal->trajectory.states, index * dim_state), state, 1.0);
+
+  // feedback
+  mju_mulMatVec(feedback_.data(),
+                DataAt(nominal->feedback_gain,
+                       index * dim_action * dim_state_derivative),
+                state_diff_.data(), dim_action, dim_state_derivative);
+  mju_addToScl(action, feedback_.data(), feedback_scaling, dim_action);
+
+  // clamp controls
+  Clamp(action, model->actuator_ctrlrange, dim_action);
+}
+
 }  // namespace mjpc
@@ -44,6 +44,15 @@ class iLQGPolicy : public Policy {
   // if state == nullptr, return the nominal action without a feedback term
   void Action(double* action, const double* state, double time) const override;
 
+  // set action from policy with scaled action improvement, feedback scaling
+  // and caller-provided scratch (state_interp: dim_state,
+  // gain: dim_action * dim_state_derivative,
+  // state_diff: dim_state_derivative, feedback: dim_action)
+  void Action(double* action, const double* state, double time,
+              double action_step, double feedback_scaling,
+              double* state_interp, double* gain, double* state_diff,
+              double* feedback) const;
+
   // copy policy
   void CopyFrom(const iLQGPolicy& policy, int horizon);
 
@@ -66,6 +75,46 @@ class iLQGPolicy : public Policy {
   double feedback_scaling;
 };
 
+// candidate of an iLQG policy that references a nominal policy instead of
+// copying it: actions are nominal actions plus scaled action improvement and
+// scaled feedback, computed on the fly. views of one nominal can be evaluated
+// concurrently.
+class iLQGPolicyView {
+ public:
+  // constructor
+  iLQGPolicyView() = default;
+
+  // destructor
+  ~iLQGPolicyView() = default;
+
+  // allocate scratch
+  void Allocate(const mjModel* model);
+
+  // set nominal policy and scalings
+  void Set(const iLQGPolicy* nominal, double action_step,
+           double feedback_scaling);
+
+  // continuous-time action, interpolated:
+  // u + action_step * du + feedback_scaling * K * (x - x_nominal)
+  void Action(double* action, const double* state, double time) const;
+
+  // discrete-time action at trajectory index:
+  // u + action_step * du + feedback_scaling * K * (x - x_nominal)
+  void ActionDiscrete(double* action, const double* state, int index) const;
+
+  // ----- members ----- //
+  const iLQGPolicy* nominal = nullptr;
+  double action_step = 0.0;
+  double feedback_scaling = 1.0;
+
+ private:
+  // scratch
+  mutable std::vector<double> state_interp_;  // dim_state
+  mutable std::vector<double> gain_;          // dim_action x dim_state_deriv.
+  mutable std::vector<double> state_diff_;    // dim_state_derivative
+  mutable std::vector<double> feedback_;      // dim_action
+};
+
 }  // namespace mjpc
 
 #endif  // MJPC_PLANNERS_ILQG_POLICY_H_
@@ -29,6 +29,7 @@ struct iLQGSettings {
       5;  // maximum number of regularization updates per iteration
   int action_limits = 1;  // flag
   int nominal_feedback_scaling = 1;  // flag
+  int num_segment = 1;  // multiple-shooting segments; 1: single shooting
   int verbose = 0;        // print optimizer info
 };
 
@@ -35,6 +35,7 @@ void iLQSPlanner::Initialize(mjModel* model, const Task& task) {
   sampling.Initialize(model, task);
 
   // iLQG
+  ilqg.derivative_cache = derivative_cache;
   ilqg.Initialize(model, task);
 }
 
@@ -79,8 +80,9 @@ void iLQSPlanner::SetState(const State& state) {
   // Sampling
   sampling.SetState(state);
 
-  // iLQG
-  ilqg.SetState(state);
+  // iLQG, sharing the same snapshot
+  ilqg.HoldState(sampling.HeldState());
+  HoldState(sampling.HeldState());
 }
 
 // optimize nominal policy using iLQS
@@ -118,9 +120,9 @@ void iLQSPlanner::OptimizePolicy(int horizon, ThreadPool& pool) {
       dim_actions = sampling.model->nu * (horizon - 1);
 
       // compute parameter to action mapping
-      mappings[sampling.policy.plan.Interpolation()]->Compute(
+      mappings[sampling.policy.plan.Interpolation()]->Update(
           spline_times_cache, num_spline_points,
-          ilqg.candidate_policy[0].trajectory.times.data(), horizon - 1);
+          ilqg.candidate_policy.trajectory.times.data(), horizon - 1);
 
       // ----- compute inverse mapping ----- //
       // resize
@@ -130,8 +132,8 @@ void iLQSPlanner::OptimizePolicy(int horizon, ThreadPool& pool) {
 
       // M = A' A
       double* mapping = mappings[sampling.policy.plan.Interpolation()]->Get();
-      mju_mulMatTMat(inversemapping_cache.data(), mapping, mapping, dim_actions,
-                     dim_parameters, dim_parameters);
+      mappings[sampling.policy.plan.Interpolation()]->Gram(
+          inversemapping_cache.data());
 
       // cholesky(M)
       mju_cholFactor(inversemapping_cache.data(), dim_parameters, 0.0);
@@ -151,7 +153,7 @@ void iLQSPlanner::OptimizePolicy(int horizon, ThreadPool& pool) {
     // compute parameters from actions via inverse mapping
     spline_parameters_cache.resize(dim_parameters);
     mju_mulMatVec(spline_parameters_cache.data(), inversemapping.data(),
-                  ilqg.candidate_policy[0].trajectory.actions.data(),
+                  ilqg.candidate_policy.trajectory.actions.data(),
                   dim_parameters, dim_actions);
 
     // clamp parameters
@@ -177,7 +179,7 @@ void iLQSPlanner::OptimizePolicy(int horizon, ThreadPool& pool) {
       (sampling.trajectory[sampling.winner].total_return <
        (previous_active_policy == kSampling
             ? sampling.trajectory[0].total_return
-            : ilqg.candidate_policy[0].trajectory.total_return))) {
+            : ilqg.candidate_policy.trajectory.total_return))) {
     // zero ilqg timers
     if (active_policy == kSampling) {
       ilqg.nominal_compute_time = 0.0;
@@ -195,7 +197,7 @@ void iLQSPlanner::OptimizePolicy(int horizon, ThreadPool& pool) {
   } else {  // no improvement found with sampling this round
     if (previous_active_policy == kSampling) {
       // update iLQG with the last winner
-      ilqg.candidate_policy[0].trajectory = sampling.trajectory[0];
+      ilqg.candidate_policy.trajectory = sampling.trajectory[0];
     }
   }
 
@@ -252,6 +254,12 @@ void iLQSPlanner::ActionFromPolicy(double* action, const double* state,
   }
 }
 
+// seed nominal policy with trajectory actions
+void iLQSPlanner::WarmStart(const Trajectory& trajectory) {
+  sampling.WarmStart(trajectory);
+  ilqg.WarmStart(trajectory);
+}
+
 // return trajectory with best total return
 const Trajectory* iLQSPlanner::BestTrajectory() {
   // return &trajectory;
@@ -69,6 +69,9 @@ class iLQSPlanner : public Planner {
   void ActionFromPolicy(double* action, const double* state,
                         double time, bool use_previous = false) override;
 
+  // seed nominal policy with trajectory actions
+  void WarmStart(const Trajectory& trajectory) override;
+
   // return trajectory with best total return
   const Trajectory* BestTrajectory() override;
 
@@ -22,6 +22,29 @@
 
 namespace mjpc {
 
+namespace {
+
+// true if a and b differ by less than tolerance in every element
+bool Near(const double* a, const double* b, int n, double tolerance) {
+  for (int i = 0; i < n; i++) {
+    if (mju_abs(a[i] - b[i]) >= tolerance) return false;
+  }
+  return true;
+}
+
+// first sensor row after the last user sensor
+int PhysicalSensorBegin(const mjModel* m) {
+  int begin = 0;
+  for (int i = 0; i < m->nsensor; i++) {
+    if (m->sensor_type[i] == mjSENS_USER) {
+      begin = m->sensor_adr[i] + m->sensor_dim[i];
+    }
+  }
+  return begin;
+}
+
+}  // namespace
+
 // allocate memory
 void ModelDerivatives::Allocate(int dim_state_derivative, int dim_action,
                                 int dim_sensor, int T) {
@@ -29,6 +52,8 @@ void ModelDerivatives::Allocate(int dim_state_derivative, int dim_action,
   B.resize(dim_state_derivative * dim_action * T);
   C.resize(dim_sensor * dim_state_derivative * T);
   D.resize(dim_sensor * dim_action * T);
+  u_.resize(dim_action * T);
+  evaluated_.resize(T);
 }
 
 // reset memory to zeros
@@ -39,6 +64,7 @@ void ModelDerivatives::Reset(int dim_state_derivative, int dim_action,
   std::fill(B.begin(), B.begin() + T * dim_state_derivative * dim_action, 0.0);
   std::fill(C.begin(), C.begin() + T * dim_sensor * dim_state_derivative, 0.0);
   std::fill(D.begin(), D.begin() + T * dim_sensor * dim_action, 0.0);
+  std::fill(evaluated_.begin(), evaluated_.end(), 0);
 }
 
 // compute derivatives at all time steps
@@ -71,13 +97,44 @@ void ModelDerivatives::Compute(const mjModel* m,
     }
   }
 
-  // evaluate derivatives
+  // colored finite-difference workspace
+  if (derivatives_.size() < pool.NumThreads()) {
+    derivatives_.resize(pool.NumThreads());
+  }
+
+  // evaluation points, invalid after a change of dimension or horizon (the
+  // terminal step has no A, B, D)
+  if (dim_state != dim_state_ || T != horizon_) {
+    x_.resize(dim_state * evaluated_.size());
+    std::fill(evaluated_.begin(), evaluated_.end(), 0);
+    dim_state_ = dim_state;
+    horizon_ = T;
+  }
+
+  // evaluate derivatives, except at unchanged time steps
   int count_before = pool.GetCount();
+  num_evaluated_ = 0;
   for (int t : evaluate_) {
-    pool.Schedule([&m, &data, &A = A, &B = B, &C = C, &D = D, &x, &u, &h,
-                   dim_state, dim_state_derivative, dim_action, dim_sensor, tol,
-                   mode, t, T]() {
+    const double* xt = x + t * dim_state;
+    const double* ut = u + t * dim_action;
+    double* xe = DataAt(x_, t * dim_state);
+    double* ue = DataAt(u_, t * dim_action);
+    if (reuse_tolerance > 0.0 && evaluated_[t] &&
+        Near(xe, xt, dim_state, reuse_tolerance) &&
+        Near(ue, ut, dim_action, reuse_tolerance)) {
+      continue;
+    }
+    mju_copy(xe, xt, dim_state);
+    mju_copy(ue, ut, dim_action);
+    evaluated_[t] = 1;
+    num_evaluated_++;
+    pool.Schedule([&m, &data, &A = A, &B = B, &C = C, &D = D,
+                   &derivatives = derivatives_, coloring = coloring,
+                   cache = cache, &x, &u, &h, dim_state,
+                   dim_state_derivative, dim_action, dim_sensor, tol, mode, t,
+                   T]() {
       mjData* d = data[ThreadPool::WorkerId()].get();
+      ColoredDerivatives& fd = derivatives[ThreadPool::WorkerId()];
       // set state
       SetState(m, d, x + t * dim_state);
       d->time = h[t];
@@ -86,23 +143,33 @@ void ModelDerivatives::Compute(const mjModel* m,
       mju_copy(d->ctrl, u + t * dim_action, dim_action);
 
       // Jacobians
-      if (t == T - 1) {
-        // Jacobians
-        mjd_transitionFD(m, d, tol, mode, nullptr, nullptr,
-                         DataAt(C, t * (dim_sensor * dim_state_derivative)),
-                         nullptr);
+      double* At = nullptr;
+      double* Bt = nullptr;
+      double* Ct = DataAt(C, t * (dim_sensor * dim_state_derivative));
+      double* Dt = nullptr;
+      if (t < T - 1) {
+        At = DataAt(A, t * (dim_state_derivative * dim_state_derivative));
+        Bt = DataAt(B, t * (dim_state_derivative * dim_action));
+        Dt = DataAt(D, t * (dim_sensor * dim_action));
+      }
+
+      // derivatives
+      if (coloring) {
+        fd.Transition(m, d, tol, mode, At, Bt, Ct, Dt);
       } else {
-        // derivatives
-        mjd_transitionFD(
-            m, d, tol, mode,
-            DataAt(A, t * (dim_state_derivative * dim_state_derivative)),
-            DataAt(B, t * (dim_state_derivative * dim_action)),
-            DataAt(C, t * (dim_sensor * dim_state_derivative)),
-            DataAt(D, t * (dim_sensor * dim_action)));
+        mjd_transitionFD(m, d, tol, mode, At, Bt, Ct, Dt);
+      }
+
+      // share dynamics and physical sensor rows at the current state
+      if (t == 0 && cache) {
+        int begin = PhysicalSensorBegin(m);
+        bool rows = begin < dim_sensor;
+        cache->Store(m, d, tol, mode, At, Bt, rows ? Ct : nullptr,
+                     rows ? Dt : nullptr, begin, dim_sensor);
       }
     });
   }
-  pool.WaitCount(count_before + evaluate_.size());
+  pool.WaitCount(count_before + num_evaluated_);
   pool.ResetCount();
 
   // interpolate derivatives
@@ -164,4 +231,30 @@ void ModelDerivatives::Compute(const mjModel* m,
   pool.ResetCount();
 }
 
+// shift derivatives back in time
+void ModelDerivatives::Shift(int steps, int dim_state_derivative,
+                             int dim_action, int dim_sensor, int T) {
+  if (steps <= 0) return;
+  if (steps >= T || T != horizon_) {
+    std::fill(evaluated_.begin(), evaluated_.end(), 0);
+    return;
+  }
+
+  // shift time steps [steps, T) to [0, T - steps)
+  auto shift = [steps, T](auto& buffer, int size) {
+    std::copy(buffer.begin() + steps * size, buffer.begin() + T * size,
+              buffer.begin());
+  };
+  shift(A, dim_state_derivative * dim_state_derivative);
+  shift(B, dim_state_derivative * dim_action);
+  shift(C, dim_sensor * dim_state_derivative);
+  shift(D, dim_sensor * dim_action);
+  shift(x_, dim_state_);
+  shift(u_, dim_action);
+  shift(evaluated_, 1);
+
+  // exposed tail, and the previous terminal step, which has no A, B, D
+  std::fill(evaluated_.begin() + T - steps - 1, evaluated_.begin() + T, 0);
+}
+
 }  // namespace mjpc
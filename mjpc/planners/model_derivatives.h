@@ -20,6 +20,7 @@
 #include <cstdlib>
 #include <vector>
 
+#include "mjpc/derivatives.h"
 #include "mjpc/threadpool.h"
 #include "mjpc/utilities.h"
 
@@ -47,6 +48,15 @@ class ModelDerivatives {
                int dim_state_derivative, int dim_action, int dim_sensor, int T,
                double tol, int mode, ThreadPool& pool, int skip = 0);
 
+  // shift derivatives and their evaluation points back by steps time steps,
+  // e.g., after the planning time advanced by steps, so that with
+  // reuse_tolerance only the newly exposed tail is evaluated
+  void Shift(int steps, int dim_state_derivative, int dim_action,
+             int dim_sensor, int T);
+
+  // number of time steps evaluated by the last Compute
+  int NumEvaluated() const { return num_evaluated_; }
+
   // Jacobians
   std::vector<double> A;  // model Jacobians wrt state
                           //   (T * dim_state_derivative * dim_state_derivative)
@@ -60,6 +70,32 @@ class ModelDerivatives {
   // indices
   std::vector<int> evaluate_;
   std::vector<int> interpolate_;
+
+  // perturb independent kinematic trees together
+  bool coloring = true;
+
+  // reuse the derivatives of a time step while its state and action are
+  // within reuse_tolerance (infinity norm) of the point they were evaluated
+  // at, assuming time-invariant dynamics. 0: evaluate all time steps
+  double reuse_tolerance = 0.0;
+
+  // Jacobians at t = 0 stored for other consumers of the model (e.g.,
+  // estimators), not owned; rows of user sensors (residuals) depend on task
+  // parameters and time and are not stored
+  DerivativeCache* cache = nullptr;
+
+ private:
+  // colored finite-difference derivatives (per worker)
+  std::vector<ColoredDerivatives> derivatives_;
+
+  // evaluation points (T * dim_state, T * dim_action) and flags (T) of the
+  // derivatives, for reuse
+  std::vector<double> x_;
+  std::vector<double> u_;
+  std::vector<int> evaluated_;
+  int dim_state_ = 0;
+  int horizon_ = 0;
+  int num_evaluated_ = 0;
 };
 
 }  // namespace mjpc
@@ -15,14 +15,50 @@
 #include "mjpc/planners/planner.h"
 
 #include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <limits>
+#include <memory>
+#include <utility>
+#include <vector>
 
 #include <mujoco/mujoco.h>
+#include "mjpc/states/state.h"
 #include "mjpc/utilities.h"
 
 namespace mjpc {
+void MjDataArena::Lease(std::vector<UniqueMjData>* data) {
+  if (lessee_ == data) return;
+  if (lessee_) {
+    pool_ = std::move(*lessee_);
+    lessee_->clear();
+  }
+  *data = std::move(pool_);
+  pool_.clear();
+  lessee_ = data;
+}
+
+void MjDataArena::Release(std::vector<UniqueMjData>* data) {
+  if (lessee_ != data) return;
+  pool_ = std::move(*data);
+  data->clear();
+  lessee_ = nullptr;
+}
+
+void MjDataArena::Clear() {
+  if (lessee_) lessee_->clear();
+  pool_.clear();
+  lessee_ = nullptr;
+}
+
+Planner::~Planner() {
+  if (data_arena) data_arena->Release(&data_);
+}
+
 void Planner::ResizeMjData(const mjModel* model, int num_threads) {
   int new_size = std::max(1, num_threads);
-  if (data_.size() > new_size) {
+  if (data_arena) data_arena->Lease(&data_);
+  if (!data_arena && data_.size() > new_size) {
     data_.erase(data_.begin() + new_size, data_.end());
   } else {
     data_.reserve(new_size);
@@ -31,4 +67,48 @@ void Planner::ResizeMjData(const mjModel* model, int num_threads) {
     }
   }
 }
+
+void Planner::HoldState(std::shared_ptr<const StateSnapshot> snapshot) {
+  state_snapshot_ = std::move(snapshot);
+  state = state_snapshot_->state;
+  time = state_snapshot_->time;
+  mocap = state_snapshot_->mocap;
+  userdata = state_snapshot_->userdata;
+}
+
+void Planner::StartBudget(std::chrono::steady_clock::time_point start,
+                          double budget) {
+  budget_start_ = start;
+  budget_ = budget;
+}
+
+void Planner::StopBudget() {
+  budget_used_ = budget_ > 0.0 ? 1.0e-6 * GetDuration(budget_start_) / budget_
+                               : 0.0;
+  budget_ = 0.0;
+}
+
+double Planner::BudgetRemaining() const {
+  if (budget_ <= 0.0) return std::numeric_limits<double>::infinity();
+  return 1.0e6 * budget_ - GetDuration(budget_start_);
+}
+
+int Planner::BudgetedCount(int count, int min_count, double previous_time,
+                           int previous_count, int num_threads,
+                           double reserve) const {
+  if (budget_ <= 0.0 || previous_count <= 0 || previous_time <= 0.0) {
+    return count;
+  }
+
+  // time per batch of num_threads parallel items
+  int threads = std::max(num_threads, 1);
+  int previous_batches = (previous_count + threads - 1) / threads;
+  double batch_time = previous_time / previous_batches;
+
+  // number of batches that fit in the remaining budget
+  double available = std::max(BudgetRemaining() - reserve, 0.0);
+  double fit = std::floor(available / batch_time) * threads;
+  if (fit >= count) return count;
+  return std::max(static_cast<int>(fit), std::min(min_count, count));
+}
 }  // namespace mjpc
@@ -15,8 +15,15 @@
 #ifndef MJPC_PLANNERS_PLANNER_H_
 #define MJPC_PLANNERS_PLANNER_H_
 
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <vector>
+
 #include <mujoco/mujoco.h>
 
+#include "mjpc/derivatives.h"
 #include "mjpc/states/state.h"
 #include "mjpc/task.h"
 #include "mjpc/threadpool.h"
@@ -28,11 +35,32 @@ namespace mjpc {
 inline constexpr int kMaxTrajectory = 128;
 inline constexpr int kMaxTrajectoryLarge = 1028;
 
+// per-thread mjData shared by the planners of an agent. the instances are
+// leased to one planner at a time, so switching planners neither reallocates
+// nor evicts a second copy of the working set from cache. lessees must plan
+// on the same thread.
+class MjDataArena {
+ public:
+  // moves the arena's instances into data, taking them back from the
+  // previous lessee
+  void Lease(std::vector<UniqueMjData>* data);
+
+  // returns the instances to the arena if data holds the lease
+  void Release(std::vector<UniqueMjData>* data);
+
+  // frees all instances, including the lessee's, e.g., on model change
+  void Clear();
+
+ private:
+  std::vector<UniqueMjData> pool_;
+  std::vector<UniqueMjData>* lessee_ = nullptr;
+};
+
 // virtual planner
 class Planner {
  public:
-  // destructor
-  virtual ~Planner() = default;
+  // destructor, returns leased mjData to the arena
+  virtual ~Planner();
 
   // initialize data and settings
   virtual void Initialize(mjModel* model, const Task& task) = 0;
@@ -61,6 +89,10 @@ class Planner {
   // iteration has completed
   virtual const Trajectory* BestTrajectory() = 0;
 
+  // seed the nominal policy with a trajectory's actions, e.g., the best
+  // trajectory of the previously active planner. ignored by default.
+  virtual void WarmStart(const Trajectory& trajectory) {}
+
   // visualize planner-specific traces
   virtual void Traces(mjvScene* scn) = 0;
 
@@ -75,8 +107,69 @@ class Planner {
   // return number of parameters optimized by planner
   virtual int NumParameters() = 0;
 
+  // per-thread mjData, leased from data_arena if set. with an arena, data_ is
+  // only grown, and is valid until another planner of the arena resizes.
   std::vector<UniqueMjData> data_;
   void ResizeMjData(const mjModel* model, int num_threads);
+
+  // per-thread mjData shared with the other planners of the agent, not owned
+  MjDataArena* data_arena = nullptr;
+
+  // Jacobians shared with other consumers of the model (e.g., estimator),
+  // not owned
+  DerivativeCache* derivative_cache = nullptr;
+
+  // ----- state ----- //
+  // views of the held state snapshot, which is shared with the state's other
+  // readers instead of copied
+  std::span<const double> state;
+  double time = 0.0;
+  std::span<const double> mocap;
+  std::span<const double> userdata;
+
+  // holds a state snapshot and sets the views above
+  void HoldState(std::shared_ptr<const StateSnapshot> snapshot);
+
+  // held state snapshot, null before the first HoldState
+  std::shared_ptr<const StateSnapshot> HeldState() const {
+    return state_snapshot_;
+  }
+
+  // sequence number of the held state snapshot
+  std::uint64_t StateSequence() const {
+    return state_snapshot_ ? state_snapshot_->sequence : 0;
+  }
+
+  // ----- planning budget ----- //
+  // sets a wall-clock budget (seconds) for the next OptimizePolicy call,
+  // counted from start, unlimited if not positive. planners scale their work
+  // down to fit the budget and keep the best policy found so far.
+  void StartBudget(std::chrono::steady_clock::time_point start, double budget);
+
+  // records the budget used, call after OptimizePolicy
+  void StopBudget();
+
+  // remaining budget (microseconds), infinite if unlimited
+  double BudgetRemaining() const;
+
+  // fraction of the budget used by the last OptimizePolicy call, zero if
+  // unlimited
+  double BudgetUsed() const { return budget_used_; }
+
+ protected:
+  // number of parallel work items, between min_count and count, that fit in
+  // the remaining budget less reserve (microseconds). the cost per item is
+  // estimated from previous_count items taking previous_time microseconds,
+  // evaluated num_threads at a time.
+  int BudgetedCount(int count, int min_count, double previous_time,
+                    int previous_count, int num_threads,
+                    double reserve = 0.0) const;
+
+ private:
+  std::shared_ptr<const StateSnapshot> state_snapshot_;
+  double budget_ = 0.0;
+  std::chrono::steady_clock::time_point budget_start_;
+  double budget_used_ = 0.0;
 };
 
 // additional optional interface for planners that can produce several policy
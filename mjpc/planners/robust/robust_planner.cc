@@ -59,24 +59,13 @@ void RobustPlanner::Initialize(mjModel* model, const Task& task) {
 
 void RobustPlanner::Allocate() {
   delegate_->Allocate();
-  // initial state
-  int num_state = model_->nq + model_->nv + model_->na;
-
-  // state
-  state_.resize(num_state);
-  mocap_.resize(7 * model_->nmocap);
-  userdata_.resize(model_->nuserdata);
-
   ResizeTrajectories(ncandidates_ * nrepetitions_);
 }
 
 void RobustPlanner::Reset(int horizon, const double* initial_repeated_action) {
   delegate_->Reset(horizon, initial_repeated_action);
   // state
-  std::fill(state_.begin(), state_.end(), 0.0);
-  std::fill(mocap_.begin(), mocap_.end(), 0.0);
-  std::fill(userdata_.begin(), userdata_.end(), 0.0);
-  time_ = 0.0;
+  HoldState(State::ZeroSnapshot(model_));
 
   for (auto& trajectory : trajectories_) {
     trajectory.Reset(kMaxTrajectoryHorizon);
@@ -84,8 +73,9 @@ void RobustPlanner::Reset(int horizon, const double* initial_repeated_action) {
 }
 
 void RobustPlanner::SetState(const State& state) {
+  // hold the delegate's snapshot, so both plan from the same state
   delegate_->SetState(state);
-  state.CopyTo(state_.data(), mocap_.data(), userdata_.data(), &time_);
+  HoldState(delegate_->HeldState());
 }
 
 void RobustPlanner::OptimizePolicy(int horizon, ThreadPool& pool) {
@@ -121,7 +111,7 @@ void RobustPlanner::OptimizePolicy(int horizon, ThreadPool& pool) {
         };
         trajectory->NoisyRollout(
             sample_policy_i, task_, model_, data_[ThreadPool::WorkerId()].get(),
-            state_.data(), time_, mocap_.data(), userdata_.data(),
+            state.data(), time, mocap.data(), userdata.data(),
             /*xfrc_std=*/xfrc_std_, /*xfrc_rate=*/xfrc_rate_, horizon);
       });
     }
@@ -163,6 +153,9 @@ void RobustPlanner::ActionFromPolicy(double* action, const double* state,
                                      double time, bool use_previous) {
   delegate_->ActionFromPolicy(action, state, time, use_previous);
 }
+void RobustPlanner::WarmStart(const Trajectory& trajectory) {
+  delegate_->WarmStart(trajectory);
+}
 const Trajectory* RobustPlanner::BestTrajectory() {
   return delegate_->BestTrajectory();
 }
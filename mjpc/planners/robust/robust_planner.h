@@ -49,6 +49,7 @@ class RobustPlanner : public Planner {
   void NominalTrajectory(int horizon, ThreadPool& pool) override;
   void ActionFromPolicy(double* action, const double* state, double time,
                         bool use_previous = false) override;
+  void WarmStart(const Trajectory& trajectory) override;
   const Trajectory* BestTrajectory() override;
   void Traces(mjvScene* scn) override;
   void GUI(mjUI& ui) override;
@@ -72,12 +73,6 @@ class RobustPlanner : public Planner {
   double xfrc_rate_ = 0.1;
 
   std::vector<Trajectory> trajectories_;
-
-  // state
-  std::vector<double> state_;
-  double time_;
-  std::vector<double> mocap_;
-  std::vector<double> userdata_;
 };
 
 }  // namespace mjpc
@@ -79,10 +79,6 @@ void SampleGradientPlanner::Allocate() {
   // initial state
   int num_state = model->nq + model->nv + model->na;
 
-  // state
-  state.resize(num_state);
-  mocap.resize(7 * model->nmocap);
-  userdata.resize(model->nuserdata);
 
   // policy
   int num_max_parameter = model->nu * kMaxTrajectoryHorizon;
@@ -106,7 +102,7 @@ void SampleGradientPlanner::Allocate() {
   trajectory.resize(kMaxTrajectory);
   candidate_policy.resize(kMaxTrajectory);
   for (int i = 0; i < kMaxTrajectory; i++) {
-    trajectory[i].Initialize(state.size(), model->nu, task->num_residual,
+    trajectory[i].Initialize(num_state, model->nu, task->num_residual,
                              task->num_trace, kMaxTrajectoryHorizon);
     trajectory[i].Allocate(kMaxTrajectoryHorizon);
     candidate_policy[i].Allocate(model, *task, kMaxTrajectoryHorizon);
@@ -121,10 +117,7 @@ void SampleGradientPlanner::Allocate() {
 void SampleGradientPlanner::Reset(int horizon,
                                   const double* initial_repeated_action) {
   // state
-  std::fill(state.begin(), state.end(), 0.0);
-  std::fill(mocap.begin(), mocap.end(), 0.0);
-  std::fill(userdata.begin(), userdata.end(), 0.0);
-  time = 0.0;
+  HoldState(State::ZeroSnapshot(model));
 
   // policy parameters
   policy.Reset(horizon, initial_repeated_action);
@@ -161,8 +154,7 @@ void SampleGradientPlanner::Reset(int horizon,
 
 // set state
 void SampleGradientPlanner::SetState(const State& state) {
-  state.CopyTo(this->state.data(), this->mocap.data(), this->userdata.data(),
-               &this->time);
+  HoldState(state.Snapshot());
 }
 
 // optimize nominal policy using random sampling and gradient search
@@ -274,6 +266,9 @@ void SampleGradientPlanner::OptimizePolicy(int horizon, ThreadPool& pool) {
 
 // compute trajectory using nominal policy
 void SampleGradientPlanner::NominalTrajectory(int horizon, ThreadPool& pool) {
+  // hold the per-thread data
+  ResizeMjData(model, pool.NumThreads());
+
   // set policy
   auto nominal_policy = [&cp = resampled_policy](
                             double* action, const double* state, double time) {
@@ -492,6 +487,12 @@ void SampleGradientPlanner::GradientCandidates(int num_trajectory,
   }
 }
 
+// seed nominal policy with trajectory actions
+void SampleGradientPlanner::WarmStart(const Trajectory& trajectory) {
+  const std::unique_lock<std::shared_mutex> lock(mtx_);
+  policy.SetPlan(trajectory);
+}
+
 // returns the nominal trajectory (this is the purple trace)
 const Trajectory* SampleGradientPlanner::BestTrajectory() {
   return &trajectory[winner];
@@ -80,6 +80,9 @@ class SampleGradientPlanner : public Planner {
   void GradientCandidates(int num_trajectory, int num_gradient, int horizon,
                           ThreadPool& pool);
 
+  // seed nominal policy with trajectory actions
+  void WarmStart(const Trajectory& trajectory) override;
+
   // return trajectory with best total return
   const Trajectory* BestTrajectory() override;
 
@@ -102,12 +105,6 @@ class SampleGradientPlanner : public Planner {
   mjModel* model;
   const Task* task;
 
-  // state
-  std::vector<double> state;
-  double time;
-  std::vector<double> mocap;
-  std::vector<double> userdata;
-
   // policy
   SamplingPolicy policy;  // (Guarded by mtx_)
   std::vector<SamplingPolicy> candidate_policy;
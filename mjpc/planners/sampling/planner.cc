@@ -79,10 +79,6 @@ void SamplingPlanner::Allocate() {
   // initial state
   int num_state = model->nq + model->nv + model->na;
 
-  // state
-  state.resize(num_state);
-  mocap.resize(7 * model->nmocap);
-  userdata.resize(model->nuserdata);
 
   // policy
   policy.Allocate(model, *task, kMaxTrajectoryHorizon);
@@ -106,10 +102,7 @@ void SamplingPlanner::Allocate() {
 void SamplingPlanner::Reset(int horizon,
                             const double* initial_repeated_action) {
   // state
-  std::fill(state.begin(), state.end(), 0.0);
-  std::fill(mocap.begin(), mocap.end(), 0.0);
-  std::fill(userdata.begin(), userdata.end(), 0.0);
-  time = 0.0;
+  HoldState(State::ZeroSnapshot(model));
 
   // policy parameters
   policy.Reset(horizon, initial_repeated_action);
@@ -144,8 +137,7 @@ void SamplingPlanner::Reset(int horizon,
 
 // set state
 void SamplingPlanner::SetState(const State& state) {
-  state.CopyTo(this->state.data(), this->mocap.data(), this->userdata.data(),
-               &this->time);
+  HoldState(state.Snapshot());
 }
 
 int SamplingPlanner::OptimizePolicyCandidates(int ncandidates, int horizon,
@@ -154,6 +146,13 @@ int SamplingPlanner::OptimizePolicyCandidates(int ncandidates, int horizon,
   // num_trajectory_ might change while this function runs. Keep it constant
   // for the duration of this function.
   int num_trajectory = num_trajectory_;
+
+  // fewer rollouts if the budget doesn't allow all of them, keeping time for
+  // the policy update
+  num_trajectory = BudgetedCount(num_trajectory, ncandidates,
+                                 rollouts_compute_time, num_rollouts_,
+                                 pool.NumThreads(), policy_update_compute_time);
+  num_rollouts_ = num_trajectory;
   ncandidates = std::min(ncandidates, num_trajectory);
   ResizeMjData(model, pool.NumThreads());
 
@@ -209,6 +208,9 @@ void SamplingPlanner::OptimizePolicy(int horizon, ThreadPool& pool) {
 
 // compute trajectory using nominal policy
 void SamplingPlanner::NominalTrajectory(int horizon, ThreadPool& pool) {
+  // hold the per-thread data
+  ResizeMjData(model, pool.NumThreads());
+
   // set policy
   auto nominal_policy = [&cp = candidate_policy[0]](
                             double* action, const double* state, double time) {
@@ -279,6 +281,7 @@ void SamplingPlanner::UpdateNominalPolicy(int horizon) {
                 (policy.plan.end() - 2)->values().end(),
                 new_node.values().begin());
     }
+    policy.plan.UpdateCoefficients();
   } else {
     // non-sliding, resample the plan into a scratch plan
     double time_shift;
@@ -300,6 +303,7 @@ void SamplingPlanner::UpdateNominalPolicy(int horizon) {
                                       nominal_time);
       nominal_time += time_shift;
     }
+    plan_scratch.UpdateCoefficients();
 
     // copy scratch into plan
     {
@@ -362,15 +366,19 @@ void SamplingPlanner::Rollouts(int num_trajectory, int horizon,
 
       // ----- rollout sample policy ----- //
 
+      // precompute actions along the horizon
+      s.candidate_policy[i].PrecomputeActions(time, model->opt.timestep,
+                                              horizon - 1);
+
       // policy
       auto sample_policy_i = [&candidate_policy = s.candidate_policy, &i](
                                  double* action, const double* state,
-                                 double time) {
-        candidate_policy[i].Action(action, state, time);
+                                 int index) {
+        candidate_policy[i].ActionDiscrete(action, state, index);
       };
 
       // policy rollout
-      s.trajectory[i].Rollout(
+      s.trajectory[i].RolloutDiscrete(
           sample_policy_i, task, model, s.data_[ThreadPool::WorkerId()].get(),
           state.data(), time, mocap.data(), userdata.data(), horizon);
     });
@@ -379,6 +387,12 @@ void SamplingPlanner::Rollouts(int num_trajectory, int horizon,
   pool.ResetCount();
 }
 
+// seed nominal policy with trajectory actions
+void SamplingPlanner::WarmStart(const Trajectory& trajectory) {
+  const std::unique_lock<std::shared_mutex> lock(mtx_);
+  policy.SetPlan(trajectory);
+}
+
 // return trajectory with best total return
 const Trajectory* SamplingPlanner::BestTrajectory() {
   return winner >= 0 ? &trajectory[winner] : nullptr;
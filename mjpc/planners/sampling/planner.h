@@ -79,6 +79,9 @@ class SamplingPlanner : public RankedPlanner {
   // compute candidate trajectories
   void Rollouts(int num_trajectory, int horizon, ThreadPool& pool);
 
+  // seed nominal policy with trajectory actions
+  void WarmStart(const Trajectory& trajectory) override;
+
   // return trajectory with best total return
   const Trajectory* BestTrajectory() override;
 
@@ -115,12 +118,6 @@ class SamplingPlanner : public RankedPlanner {
   mjModel* model;
   const Task* task;
 
-  // state
-  std::vector<double> state;
-  double time;
-  std::vector<double> mocap;
-  std::vector<double> userdata;
-
   // policy
   SamplingPolicy policy;  // (Guarded by mtx_)
   SamplingPolicy candidate_policy[kMaxTrajectory];
@@ -159,6 +156,10 @@ mjpc::spline::SplineInterpolation interpolation_ =
   std::uint8_t sliding_plan_ = false;
 
   int num_trajectory_;
+
+  // number of rollouts in the last iteration, fewer than num_trajectory_
+  // when limited by the planning budget
+  int num_rollouts_ = 0;
   mutable std::shared_mutex mtx_;
 };
 
@@ -38,6 +38,9 @@ void SamplingPolicy::Allocate(const mjModel* model, const Task& task,
 
   plan = TimeSpline(/*dim=*/model->nu);
   plan.Reserve(num_spline_points);
+
+  // precomputed actions
+  actions.resize(kMaxTrajectoryHorizon * model->nu);
 }
 
 // reset memory to zeros
@@ -58,6 +61,27 @@ void SamplingPolicy::Action(double* action, const double* state,
   Clamp(action, model->actuator_ctrlrange, model->nu);
 }
 
+// precompute actions for a rollout
+void SamplingPolicy::PrecomputeActions(double time, double timestep,
+                                       int num_steps) {
+  int nu = model->nu;
+  plan.UpdateCoefficients();
+  plan.SampleRange(time, timestep, num_steps,
+                   absl::MakeSpan(actions.data(), num_steps * nu));
+
+  // Clamp controls
+  for (int t = 0; t < num_steps; t++) {
+    Clamp(DataAt(actions, t * nu), model->actuator_ctrlrange, nu);
+  }
+}
+
+// set precomputed action at rollout step index
+void SamplingPolicy::ActionDiscrete(double* action, const double* state,
+                                    int index) const {
+  CHECK(action != nullptr);
+  mju_copy(action, DataAt(actions, index * model->nu), model->nu);
+}
+
 // copy policy
 void SamplingPolicy::CopyFrom(const SamplingPolicy& policy, int horizon) {
   this->plan = policy.plan;
@@ -69,4 +93,28 @@ void SamplingPolicy::SetPlan(const TimeSpline& plan) {
   this->plan = plan;
 }
 
+// set parameters from trajectory actions
+void SamplingPolicy::SetPlan(const Trajectory& trajectory) {
+  int num_action = trajectory.horizon - 1;
+  if (num_action < 1) return;
+
+  // node spacing
+  double start = trajectory.times[0];
+  double time_shift =
+      num_spline_points > 1
+          ? (trajectory.times[num_action - 1] - start) / (num_spline_points - 1)
+          : 0.0;
+
+  // sample actions
+  plan.Clear();
+  for (int i = 0; i < num_spline_points; i++) {
+    double time = start + i * time_shift;
+    TimeSpline::Node node = plan.AddNode(time);
+    LinearInterpolation(node.values().data(), time, trajectory.times,
+                        trajectory.actions.data(), model->nu, num_action);
+    Clamp(node.values().data(), model->actuator_ctrlrange, model->nu);
+  }
+  plan.UpdateCoefficients();
+}
+
 }  // namespace mjpc
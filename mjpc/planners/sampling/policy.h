@@ -15,10 +15,13 @@
 #ifndef MJPC_PLANNERS_SAMPLING_POLICY_H_
 #define MJPC_PLANNERS_SAMPLING_POLICY_H_
 
+#include <vector>
+
 #include <mujoco/mujoco.h>
 #include "mjpc/planners/policy.h"
 #include "mjpc/spline/spline.h"
 #include "mjpc/task.h"
+#include "mjpc/trajectory.h"
 
 namespace mjpc {
 
@@ -43,16 +46,30 @@ class SamplingPolicy : public Policy {
   // set action from policy
   void Action(double* action, const double* state, double time) const override;
 
+  // precompute actions for a rollout of num_steps physics steps starting at
+  // time
+  void PrecomputeActions(double time, double timestep, int num_steps);
+
+  // set precomputed action at rollout step index
+  void ActionDiscrete(double* action, const double* state, int index) const;
+
   // copy policy
   void CopyFrom(const SamplingPolicy& policy, int horizon);
 
   // copy parameters
   void SetPlan(const mjpc::spline::TimeSpline& plan);
 
+  // set parameters to num_spline_points samples of a trajectory's actions,
+  // evenly spaced over the trajectory
+  void SetPlan(const Trajectory& trajectory);
+
   // ----- members ----- //
   const mjModel* model;
   mjpc::spline::TimeSpline plan;
   int num_spline_points;
+
+  // precomputed rollout actions (kMaxTrajectoryHorizon x nu)
+  std::vector<double> actions;
 };
 
 }  // namespace mjpc
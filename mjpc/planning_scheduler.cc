@@ -0,0 +1,263 @@
+// Copyright 2022 DeepMind Technologies Limited
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "mjpc/planning_scheduler.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+
+#include <mujoco/mujoco.h>
+#include "mjpc/agent.h"
+
+namespace mjpc {
+
+namespace {
+
+// smallest planning budget (seconds), for iterations past their deadline
+constexpr double kMinBudget = 1.0e-6;
+
+// duration in seconds to clock duration
+PlanningScheduler::Clock::duration Seconds(double seconds) {
+  return std::chrono::duration_cast<PlanningScheduler::Clock::duration>(
+      std::chrono::duration<double>(seconds));
+}
+
+// release time plus a relative deadline in seconds, none if not positive
+PlanningScheduler::Clock::time_point Deadline(
+    PlanningScheduler::Clock::time_point release, double seconds) {
+  if (seconds <= 0.0) return PlanningScheduler::Clock::time_point::max();
+  return release + Seconds(seconds);
+}
+
+// elapsed time in microseconds
+double Microseconds(PlanningScheduler::Clock::time_point start,
+                    PlanningScheduler::Clock::time_point end) {
+  return std::chrono::duration<double, std::micro>(end - start).count();
+}
+
+}  // namespace
+
+PlanningScheduler::PlanningScheduler(int num_threads) : pool_(num_threads) {
+  for (int i = 0; i < num_threads; i++) {
+    dispatchers_.emplace_back([this]() { Dispatch(); });
+  }
+}
+
+PlanningScheduler::~PlanningScheduler() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    exit_ = true;
+  }
+  cv_.notify_all();
+  for (auto& dispatcher : dispatchers_) {
+    dispatcher.join();
+  }
+}
+
+int PlanningScheduler::AddAgent(Agent* agent, double period, int priority) {
+  int id;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    id = next_id_++;
+    Entry& entry = entries_[id];
+    entry.agent = agent;
+    entry.period = period;
+    entry.priority = priority;
+    entry.initialized = agent->GetModel() != nullptr;
+    entry.release = Clock::now();
+    entry.deadline = Deadline(entry.release, period);
+  }
+  cv_.notify_all();
+  return id;
+}
+
+void PlanningScheduler::RemoveAgent(int id) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  cv_.wait(lock, [&]() {
+    auto it = entries_.find(id);
+    return it == entries_.end() || !it->second.running;
+  });
+  entries_.erase(id);
+}
+
+void PlanningScheduler::PlanIteration(int id, double deadline) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  auto it = entries_.find(id);
+  if (it == entries_.end()) {
+    mju_error("PlanningScheduler: unknown agent %d", id);
+  }
+  Entry& entry = it->second;
+  entry.initialized = entry.agent->GetModel() != nullptr;
+  if (!entry.initialized) return;
+
+  // an iteration already in progress was released before this request
+  std::uint64_t target = entry.completed + (entry.running ? 2 : 1);
+  entry.requested = true;
+  entry.release = Clock::now();
+  entry.deadline =
+      Deadline(entry.release, deadline > 0.0 ? deadline : entry.period);
+  cv_.notify_all();
+
+  cv_.wait(lock, [&]() {
+    auto it = entries_.find(id);
+    return exit_ || it == entries_.end() || it->second.completed >= target;
+  });
+}
+
+void PlanningScheduler::SetEnabled(int id, bool enabled) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  auto it = entries_.find(id);
+  if (it == entries_.end()) return;
+  it->second.enabled = enabled;
+  if (enabled) {
+    it->second.initialized = it->second.agent->GetModel() != nullptr;
+    it->second.release = Clock::now();
+    it->second.deadline = Deadline(it->second.release, it->second.period);
+    cv_.notify_all();
+    return;
+  }
+
+  // wait for a running iteration, e.g., before the agent is re-initialized
+  cv_.wait(lock, [&]() {
+    auto it = entries_.find(id);
+    return it == entries_.end() || !it->second.running;
+  });
+}
+
+void PlanningScheduler::SetPriority(int id, int priority) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto it = entries_.find(id);
+  if (it != entries_.end()) it->second.priority = priority;
+}
+
+PlanningStats PlanningScheduler::Stats(int id) const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto it = entries_.find(id);
+  if (it == entries_.end()) return PlanningStats();
+  return it->second.stats;
+}
+
+bool PlanningScheduler::Ready(const Entry& entry, Clock::time_point now) {
+  if (entry.running || !entry.initialized) return false;
+  if (entry.requested) return true;
+  return entry.enabled && entry.period > 0.0 && entry.release <= now;
+}
+
+bool PlanningScheduler::Precedes(const Entry& a, int id_a, const Entry& b,
+                                 int id_b) {
+  int priority_a = a.priority + a.passed;
+  int priority_b = b.priority + b.passed;
+  if (priority_a != priority_b) return priority_a > priority_b;
+  if (a.deadline != b.deadline) return a.deadline < b.deadline;
+  return id_a < id_b;
+}
+
+void PlanningScheduler::Dispatch() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (!exit_) {
+    // select the most urgent ready agent, or the next release time
+    Clock::time_point now = Clock::now();
+    Clock::time_point wake = Clock::time_point::max();
+    Entry* next = nullptr;
+    int next_id = -1;
+    for (auto& [id, entry] : entries_) {
+      if (Ready(entry, now)) {
+        if (!next || Precedes(entry, id, *next, next_id)) {
+          next = &entry;
+          next_id = id;
+        }
+      } else if (!entry.running && entry.enabled && entry.period > 0.0 &&
+                 entry.release < wake) {
+        wake = entry.release;
+      }
+    }
+
+    // nothing to do, wait for a request or the next release
+    if (!next) {
+      if (wake == Clock::time_point::max()) {
+        cv_.wait(lock);
+      } else {
+        cv_.wait_until(lock, wake);
+      }
+      continue;
+    }
+
+    // admit another agent only while the pool has spare threads
+    if (num_running_ > 0 && pool_.NumQueued() >= pool_.NumThreads()) {
+      lock.unlock();
+      pool_.WaitQueued(pool_.NumThreads());
+      lock.lock();
+      continue;
+    }
+
+    // agents passed over age
+    for (auto& [id, entry] : entries_) {
+      if (&entry != next && Ready(entry, now)) entry.passed += 1;
+    }
+    next->passed = 0;
+
+    // run the iteration on the shared pool, without holding the lock.
+    // RemoveAgent waits for running entries, so next stays valid.
+    next->running = true;
+    num_running_ += 1;
+    next->requested = false;
+    Agent* agent = next->agent;
+    Clock::time_point release = next->release;
+    Clock::time_point deadline = next->deadline;
+    lock.unlock();
+    Clock::time_point start = Clock::now();
+
+    // the planner's budget is the time left until the deadline, at most the
+    // agent's own budget. late iterations get a minimal budget.
+    double budget = agent->PlanningBudget();
+    if (deadline != Clock::time_point::max()) {
+      double remaining = std::max(
+          std::chrono::duration<double>(deadline - start).count(), kMinBudget);
+      budget = budget > 0.0 ? std::min(budget, remaining) : remaining;
+    }
+    agent->PlanIteration(&pool_, budget);
+    Clock::time_point end = Clock::now();
+    double budget_used = agent->ActivePlanner().BudgetUsed();
+    lock.lock();
+
+    // statistics
+    PlanningStats& stats = next->stats;
+    stats.iterations += 1;
+    stats.last_latency = Microseconds(release, end);
+    stats.last_compute_time = Microseconds(start, end);
+    stats.budget_used = budget_used;
+    stats.mean_latency +=
+        (stats.last_latency - stats.mean_latency) / stats.iterations;
+    if (stats.last_latency > stats.max_latency) {
+      stats.max_latency = stats.last_latency;
+    }
+    if (end > deadline) stats.deadline_misses += 1;
+
+    // next release, without catching up on overruns. requests made during
+    // the iteration keep their own release time.
+    if (next->period > 0.0 && !next->requested) {
+      next->release = release + Seconds(next->period);
+      if (next->release < end) next->release = end;
+      next->deadline = Deadline(next->release, next->period);
+    }
+    next->running = false;
+    num_running_ -= 1;
+    next->completed += 1;
+    cv_.notify_all();
+  }
+}
+
+}  // namespace mjpc
@@ -0,0 +1,142 @@
+// Copyright 2022 DeepMind Technologies Limited
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MJPC_PLANNING_SCHEDULER_H_
+#define MJPC_PLANNING_SCHEDULER_H_
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "mjpc/agent.h"
+#include "mjpc/threadpool.h"
+
+namespace mjpc {
+
+// per-agent planning statistics, times in microseconds
+struct PlanningStats {
+  int iterations = 0;
+  int deadline_misses = 0;
+
+  // time from release (request) to completion of a planning iteration
+  double last_latency = 0.0;
+  double mean_latency = 0.0;
+  double max_latency = 0.0;
+
+  // time spent in Agent::PlanIteration
+  double last_compute_time = 0.0;
+
+  // fraction of the planning budget used by the last iteration, zero if
+  // unlimited
+  double budget_used = 0.0;
+};
+
+// runs the planning iterations of many agents on a single shared thread pool.
+// the pool counts completed rollouts per scheduling thread, so iterations of
+// different agents can overlap: each iteration runs on one of NumThreads()
+// dispatch threads, and another agent is admitted while fewer than
+// NumThreads() rollouts are waiting in the pool's queue, e.g., while the
+// running agents are in serial phases. among the agents that are ready, the
+// one with the highest priority is admitted first, ties are broken by the
+// earliest deadline, then by registration order. a ready agent gains one
+// priority level each time another agent is admitted instead (aging), so an
+// agent waits for at most (priority difference + 1) admissions of
+// higher-priority agents. each iteration is planned within the time left
+// until its deadline.
+class PlanningScheduler {
+ public:
+  using Clock = std::chrono::steady_clock;
+
+  // constructor
+  explicit PlanningScheduler(int num_threads);
+
+  // destructor
+  ~PlanningScheduler();
+
+  // ----- methods ----- //
+
+  // registers an agent and returns its id. with period > 0 (seconds) the agent
+  // is planned continuously: an iteration is released every period and is
+  // due one period after its release. with period <= 0 the agent is only
+  // planned on request, see PlanIteration. the agent must outlive its
+  // registration. the scheduler does not read the agent's model from its own
+  // thread: whether the agent is initialized is checked here, in
+  // PlanIteration and in SetEnabled, on the caller's thread. an agent with
+  // continuous planning must be paused while it is re-initialized.
+  int AddAgent(Agent* agent, double period = 0.0, int priority = 0);
+
+  // unregisters an agent, waiting for its running iteration to complete
+  void RemoveAgent(int id);
+
+  // requests a planning iteration for a registered agent and blocks until it
+  // has completed. the iteration is due deadline seconds from now, or one
+  // period from now if deadline <= 0.
+  void PlanIteration(int id, double deadline = 0.0);
+
+  // pauses or resumes continuous planning of an agent. pausing waits for a
+  // running iteration to complete.
+  void SetEnabled(int id, bool enabled);
+
+  // sets the priority of an agent
+  void SetPriority(int id, int priority);
+
+  // returns the planning statistics of an agent
+  PlanningStats Stats(int id) const;
+
+  // number of threads in the shared pool
+  int NumThreads() const { return pool_.NumThreads(); }
+
+ private:
+  struct Entry {
+    Agent* agent;
+    double period;
+    int priority;
+    int passed = 0;  // times run was given to another agent while ready
+    bool initialized = false;
+    bool enabled = true;
+    bool requested = false;
+    bool running = false;
+    Clock::time_point release;
+    Clock::time_point deadline;
+    std::uint64_t completed = 0;
+    PlanningStats stats;
+  };
+
+  // returns true if the entry has an iteration released at time now
+  static bool Ready(const Entry& entry, Clock::time_point now);
+
+  // returns true if entry a should run before entry b, with aging
+  static bool Precedes(const Entry& a, int id_a, const Entry& b, int id_b);
+
+  // dispatch loop, runs on each of dispatchers_
+  void Dispatch();
+
+  // ----- members ----- //
+  ThreadPool pool_;
+  mutable std::mutex mutex_;
+  std::condition_variable cv_;
+  std::map<int, Entry> entries_;
+  int next_id_ = 0;
+  int num_running_ = 0;
+  bool exit_ = false;
+  std::vector<std::thread> dispatchers_;
+};
+
+}  // namespace mjpc
+
+#endif  // MJPC_PLANNING_SCHEDULER_H_
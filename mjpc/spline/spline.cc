@@ -17,6 +17,7 @@
 #include <algorithm>
 #include <array>
 #include <cstddef>
+#include <cstdint>
 #include <utility>
 #include <vector>
 
@@ -25,31 +26,72 @@
 #include <absl/types/span.h>
 
 namespace mjpc::spline {
+namespace {
+
+// copies `num` ring buffer entries of `stride` elements, starting at slot
+// `begin` of a buffer with `capacity` slots, to the start of `dest`
+template <typename T>
+void CopyRing(const T* source, int stride, int capacity, int begin, int num,
+              T* dest) {
+  int first = std::min(num, capacity - begin);
+  std::copy(source + begin * stride, source + (begin + first) * stride, dest);
+  std::copy(source, source + (num - first) * stride, dest + first * stride);
+}
+
+}  // namespace
 
 TimeSpline::TimeSpline(int dim, SplineInterpolation interpolation,
                        int initial_capacity)
-    : interpolation_(interpolation), dim_(dim) {
-  values_.resize(initial_capacity * dim);  // Reserve space for node values
+    : interpolation_(interpolation), dim_(dim), capacity_(initial_capacity) {
+  // Reserve space for node times and values
+  nodes_.resize(capacity_ * (1 + dim_));
+  coefficients_.resize(capacity_ * 4 * dim_);
+  coefficients_valid_.resize(capacity_);
+}
+
+TimeSpline& TimeSpline::operator=(const TimeSpline& other) {
+  if (this == &other) {
+    return *this;
+  }
+  interpolation_ = other.interpolation_;
+  if (dim_ != other.dim_ || capacity_ < other.size_) {
+    dim_ = other.dim_;
+    capacity_ = other.capacity_;
+    nodes_.resize(capacity_ * (1 + dim_));
+    coefficients_.resize(capacity_ * 4 * dim_);
+    coefficients_valid_.resize(capacity_);
+  }
+
+  // Copy the nodes and cached coefficients to the start of the buffers, in at
+  // most two contiguous chunks each.
+  begin_ = 0;
+  size_ = other.size_;
+  const double* other_times = other.nodes_.data();
+  const double* other_values = other_times + other.capacity_;
+  CopyRing(other_times, 1, other.capacity_, other.begin_, size_,
+           nodes_.data());
+  CopyRing(other_values, dim_, other.capacity_, other.begin_, size_,
+           nodes_.data() + capacity_);
+  CopyRing(other.coefficients_.data(), 4 * dim_, other.capacity_,
+           other.begin_, size_, coefficients_.data());
+  CopyRing(other.coefficients_valid_.data(), 1, other.capacity_, other.begin_,
+           size_, coefficients_valid_.data());
+  return *this;
 }
 
-std::size_t TimeSpline::Size() const { return times_.size(); }
+std::size_t TimeSpline::Size() const { return size_; }
 
 TimeSpline::Node TimeSpline::NodeAt(int index) {
-  int values_index_ = values_begin_ + index * dim_;
-  if (values_index_ >= values_.size()) {
-    values_index_ -= values_.size();
-    CHECK_LE(values_index_, values_.size());
-  }
-  return Node(times_[index], values_.data() + values_index_, dim_);
+  // the slopes at the node's neighbours depend on its values
+  InvalidateCoefficients(index - 2, index + 1);
+  int slot = Slot(index);
+  return Node(nodes_[slot], nodes_.data() + capacity_ + slot * dim_, dim_);
 }
 
 TimeSpline::ConstNode TimeSpline::NodeAt(int index) const {
-  int values_index_ = values_begin_ + index * dim_;
-  if (values_index_ >= values_.size()) {
-    values_index_ -= values_.size();
-    CHECK_LE(values_index_, values_.size());
-  }
-  return ConstNode(times_[index], values_.data() + values_index_, dim_);
+  int slot = Slot(index);
+  return ConstNode(nodes_[slot], nodes_.data() + capacity_ + slot * dim_,
+                   dim_);
 }
 
 TimeSpline::iterator TimeSpline::begin() {
@@ -57,7 +99,7 @@ TimeSpline::iterator TimeSpline::begin() {
 }
 
 TimeSpline::iterator TimeSpline::end() {
-  return TimeSpline::iterator(this, times_.size());
+  return TimeSpline::iterator(this, size_);
 }
 
 TimeSpline::const_iterator TimeSpline::cbegin() const {
@@ -65,7 +107,7 @@ TimeSpline::const_iterator TimeSpline::cbegin() const {
 }
 
 TimeSpline::const_iterator TimeSpline::cend() const {
-  return TimeSpline::const_iterator(this, times_.size());
+  return TimeSpline::const_iterator(this, size_);
 }
 
 // Set Interpolation
@@ -80,24 +122,38 @@ int TimeSpline::Dim() const { return dim_; }
 // Reserves memory for at least num_nodes. If the spline already contains
 // more nodes, does nothing.
 void TimeSpline::Reserve(int num_nodes) {
-  if (num_nodes * dim_ <= values_.size()) {
+  if (num_nodes <= capacity_) {
     return;
   }
-  if (values_begin_ < values_end_ || times_.empty()) {
-    // Easy case: just resize the values_ vector and remap the spans if needed,
-    // without any further data copies.
-    values_.resize(num_nodes * dim_);
-  } else {
-    std::vector<double> new_values(num_nodes * dim_);
-    // Copy all existing values to the start of the new vector
-    std::copy(values_.begin() + values_begin_, values_.end(),
-              new_values.begin());
-    std::copy(values_.begin(), values_.begin() + values_end_,
-              new_values.begin() + values_.size() - values_begin_);
-    values_ = std::move(new_values);
-    values_begin_ = 0;
-    values_end_ = times_.size() * dim_;
+  std::vector<double> new_nodes(num_nodes * (1 + dim_));
+  std::vector<double> new_coefficients(num_nodes * 4 * dim_);
+  std::vector<uint8_t> new_coefficients_valid(num_nodes);
+  // Copy all existing nodes to the start of the new buffers
+  CopyRing(nodes_.data(), 1, capacity_, begin_, size_, new_nodes.data());
+  CopyRing(nodes_.data() + capacity_, dim_, capacity_, begin_, size_,
+           new_nodes.data() + num_nodes);
+  CopyRing(coefficients_.data(), 4 * dim_, capacity_, begin_, size_,
+           new_coefficients.data());
+  CopyRing(coefficients_valid_.data(), 1, capacity_, begin_, size_,
+           new_coefficients_valid.data());
+  nodes_ = std::move(new_nodes);
+  coefficients_ = std::move(new_coefficients);
+  coefficients_valid_ = std::move(new_coefficients_valid);
+  capacity_ = num_nodes;
+  begin_ = 0;
+}
+
+int TimeSpline::UpperBound(double time) const {
+  // Binary search with a fixed number of iterations, where each step is a
+  // conditional move rather than a branch.
+  int base = 0;
+  int length = size_;
+  while (length > 1) {
+    int half = length / 2;
+    base = TimeAt(base + half) <= time ? base + half : base;
+    length -= half;
   }
+  return size_ == 0 ? 0 : base + (TimeAt(base) <= time);
 }
 
 void TimeSpline::Sample(double time, absl::Span<double> values) const {
@@ -105,27 +161,28 @@ void TimeSpline::Sample(double time, absl::Span<double> values) const {
       << "Tried to sample " << values.size()
       << " values, but the dimensionality of the spline is " << dim_;
 
-  if (times_.empty()) {
+  if (size_ == 0) {
     std::fill(values.begin(), values.end(), 0.0);
     return;
   }
 
-  auto upper = std::upper_bound(times_.begin(), times_.end(), time);
-  if (upper == times_.end()) {
-    ConstNode n = NodeAt(upper - times_.begin() - 1);
+  int upper = UpperBound(time);
+  if (upper == size_) {
+    ConstNode n = NodeAt(upper - 1);
     std::copy(n.values().begin(), n.values().end(), values.begin());
     return;
   }
-  if (upper == times_.begin()) {
-    ConstNode n = NodeAt(upper - times_.begin());
+  if (upper == 0) {
+    ConstNode n = NodeAt(upper);
     std::copy(n.values().begin(), n.values().end(), values.begin());
     return;
   }
 
-  auto lower = upper - 1;
-  double t = (time - *lower) / (*upper - *lower);
-  ConstNode lower_node = NodeAt(lower - times_.begin());
-  ConstNode upper_node = NodeAt(upper - times_.begin());
+  int lower = upper - 1;
+  ConstNode lower_node = NodeAt(lower);
+  ConstNode upper_node = NodeAt(upper);
+  double t = (time - lower_node.time()) /
+             (upper_node.time() - lower_node.time());
   switch (interpolation_) {
     case SplineInterpolation::kZeroSpline:
       std::copy(lower_node.values().begin(), lower_node.values().end(),
@@ -138,12 +195,21 @@ void TimeSpline::Sample(double time, absl::Span<double> values) const {
       }
       return;
     case SplineInterpolation::kCubicSpline: {
-      std::array<double, 4> coefficients =
-          CubicCoefficients(time, lower - times_.begin());
+      if (coefficients_valid_[Slot(lower)]) {
+        // Horner evaluation of the cached interval polynomial
+        const double* c = coefficients_.data() + Slot(lower) * 4 * dim_;
+        for (int i = 0; i < dim_; i++) {
+          values[i] =
+              ((c[4 * i + 3] * t + c[4 * i + 2]) * t + c[4 * i + 1]) * t +
+              c[4 * i];
+        }
+        return;
+      }
+      std::array<double, 4> coefficients = CubicCoefficients(time, lower);
       for (int i = 0; i < dim_; i++) {
         double p0 = lower_node.values().at(i);
-        double m0 = Slope(lower - times_.begin(), i);
-        double m1 = Slope(upper - times_.begin(), i);
+        double m0 = Slope(lower, i);
+        double m1 = Slope(upper, i);
         double p1 = upper_node.values().at(i);
         values[i] = coefficients[0] * p0 + coefficients[1] * m0 +
                     coefficients[2] * p1 + coefficients[3] * m1;
@@ -161,10 +227,121 @@ std::vector<double> TimeSpline::Sample(double time) const {
   return values;
 }
 
+void TimeSpline::SampleRange(double time, double timestep, int num_samples,
+                             absl::Span<double> values) const {
+  CHECK_EQ(values.size(), num_samples * dim_)
+      << "Tried to sample " << values.size() << " values, but "
+      << num_samples << " samples of dimension " << dim_ << " were requested";
+  CHECK_GE(timestep, 0.0) << "Samples must be in time order";
+
+  if (size_ == 0) {
+    std::fill(values.begin(), values.end(), 0.0);
+    return;
+  }
+
+  int num_nodes = size_;
+
+  // first node with time greater than the first sample time
+  int upper = UpperBound(time);
+
+  int sample = 0;
+  while (sample < num_samples) {
+    // advance to the interval containing the current sample
+    while (upper < num_nodes && TimeAt(upper) <= time) {
+      upper++;
+    }
+
+    // samples [sample, last) lie in the same interval
+    int last = sample;
+    double last_time = time;
+    while (last < num_samples &&
+           (upper == num_nodes || last_time < TimeAt(upper))) {
+      last++;
+      last_time += timestep;
+    }
+    double* output = values.data() + sample * dim_;
+    int count = last - sample;
+
+    if (upper == 0 || upper == num_nodes) {
+      // before the first or after the last node: hold the boundary values
+      ConstNode n = NodeAt(upper == 0 ? 0 : num_nodes - 1);
+      for (int k = 0; k < count; k++) {
+        std::copy(n.values().begin(), n.values().end(), output + k * dim_);
+      }
+    } else {
+      int lower = upper - 1;
+      double lower_time = TimeAt(lower);
+      double upper_time = TimeAt(upper);
+      ConstNode lower_node = NodeAt(lower);
+      ConstNode upper_node = NodeAt(upper);
+      switch (interpolation_) {
+        case SplineInterpolation::kZeroSpline:
+          for (int k = 0; k < count; k++) {
+            std::copy(lower_node.values().begin(), lower_node.values().end(),
+                      output + k * dim_);
+          }
+          break;
+        case SplineInterpolation::kLinearSpline: {
+          double sample_time = time;
+          for (int k = 0; k < count; k++) {
+            double t = (sample_time - lower_time) / (upper_time - lower_time);
+            for (int i = 0; i < dim_; i++) {
+              output[k * dim_ + i] = lower_node.values()[i] * (1 - t) +
+                                     upper_node.values()[i] * t;
+            }
+            sample_time += timestep;
+          }
+          break;
+        }
+        case SplineInterpolation::kCubicSpline:
+          if (coefficients_valid_[Slot(lower)]) {
+            // Horner evaluation of the cached interval polynomial
+            const double* c = coefficients_.data() + Slot(lower) * 4 * dim_;
+            double sample_time = time;
+            for (int k = 0; k < count; k++) {
+              double t = (sample_time - lower_time) / (upper_time - lower_time);
+              for (int i = 0; i < dim_; i++) {
+                output[k * dim_ + i] =
+                    ((c[4 * i + 3] * t + c[4 * i + 2]) * t + c[4 * i + 1]) *
+                        t +
+                    c[4 * i];
+              }
+              sample_time += timestep;
+            }
+            break;
+          }
+          // end values and slopes are shared by all samples in the interval
+          for (int i = 0; i < dim_; i++) {
+            double p0 = lower_node.values()[i];
+            double m0 = Slope(lower, i);
+            double m1 = Slope(upper, i);
+            double p1 = upper_node.values()[i];
+            double sample_time = time;
+            for (int k = 0; k < count; k++) {
+              std::array<double, 4> coefficients =
+                  CubicCoefficients(sample_time, lower);
+              output[k * dim_ + i] = coefficients[0] * p0 +
+                                     coefficients[1] * m0 +
+                                     coefficients[2] * p1 +
+                                     coefficients[3] * m1;
+              sample_time += timestep;
+            }
+          }
+          break;
+        default:
+          CHECK(false) << "Unknown interpolation: " << interpolation_;
+      }
+    }
+
+    sample = last;
+    time = last_time;
+  }
+}
+
 int TimeSpline::DiscardBefore(double time) {
   // Find the first node that has n.time > time.
-  auto last_node = std::upper_bound(times_.begin(), times_.end(), time);
-  if (last_node == times_.begin()) {
+  int last_node = UpperBound(time);
+  if (last_node == 0) {
     return 0;
   }
 
@@ -172,26 +349,24 @@ int TimeSpline::DiscardBefore(double time) {
   // but the one before that.
   int keep_nodes = interpolation_ == SplineInterpolation::kCubicSpline ? 1 : 0;
   last_node--;
-  while (last_node != times_.begin() && keep_nodes) {
+  while (last_node != 0 && keep_nodes) {
     last_node--;
     keep_nodes--;
   }
-  int nodes_to_remove = last_node - times_.begin();
+  int nodes_to_remove = last_node;
 
-  times_.erase(times_.begin(), last_node);
-  values_begin_ += dim_ * nodes_to_remove;
-  if (values_begin_ >= values_.size()) {
-    values_begin_ -= values_.size();
-    CHECK_LE(values_begin_, values_.size());
-  }
+  begin_ = Slot(nodes_to_remove);
+  size_ -= nodes_to_remove;
+
+  // the slope at the new first node is one-sided
+  InvalidateCoefficients(0, 0);
   return nodes_to_remove;
 }
 
 void TimeSpline::Clear() {
-  times_.clear();
-  values_begin_ = 0;
-  values_end_ = 0;
-  // Don't change capacity_ or reset values_.
+  begin_ = 0;
+  size_ = 0;
+  // Don't change capacity_ or reset nodes_.
 }
 
 // Adds a new set of values at the given time. Implementation is only
@@ -204,29 +379,23 @@ TimeSpline::Node TimeSpline::AddNode(double time,
                                      absl::Span<const double> new_values) {
   CHECK(new_values.size() == dim_ || new_values.empty());
   // TODO(nimrod): Implement node insertion in the middle of the spline
-  CHECK(times_.empty() || time > times_.back() || time < times_.front())
+  CHECK(size_ == 0 || time > TimeAt(size_ - 1) || time < TimeAt(0))
       << "Adding nodes to the middle of the spline isn't supported.";
-  if (times_.size() * dim_ >= values_.size()) {
-    Reserve(times_.size() * 2);
+  if (size_ >= capacity_) {
+    Reserve(std::max(size_ * 2, 1));
   }
   Node new_node;
-  if (times_.empty() || time > times_.back()) {
-    CHECK_LE(values_end_ + dim_, values_.size());
-    times_.push_back(time);
-    values_end_ += dim_;
-    if (values_end_ >= values_.size()) {
-      CHECK_EQ(values_end_, values_.size());
-      values_end_ -= values_.size();
-    }
-    new_node = NodeAt(times_.size() - 1);
+  if (size_ == 0 || time > TimeAt(size_ - 1)) {
+    nodes_[Slot(size_)] = time;
+    size_++;
+    // also invalidates the intervals ending at the new node
+    new_node = NodeAt(size_ - 1);
   } else {
-    CHECK_LT(time, times_.front());
-    values_begin_ -= dim_;
-    if (values_begin_ < 0) {
-      values_begin_ += values_.size();
-    }
-    CHECK_LE(values_begin_ + dim_, values_.size());
-    times_.push_front(time);
+    CHECK_LT(time, TimeAt(0));
+    begin_ = begin_ == 0 ? capacity_ - 1 : begin_ - 1;
+    nodes_[begin_] = time;
+    size_++;
+    // also invalidates the intervals starting at the new node
     new_node = NodeAt(0);
   }
   if (!new_values.empty()) {
@@ -241,10 +410,10 @@ std::array<double, 4> TimeSpline::CubicCoefficients(
     double time, int lower_node_index) const {
   std::array<double, 4> coefficients;
   int upper_node_index = lower_node_index + 1;
-  CHECK(upper_node_index != times_.size())
+  CHECK(upper_node_index != size_)
       << "CubicCoefficients shouldn't be called for boundary conditions.";
-  double lower = times_[lower_node_index];
-  double upper = times_[upper_node_index];
+  double lower = TimeAt(lower_node_index);
+  double upper = TimeAt(upper_node_index);
   double t = (time - lower) / (upper - lower);
 
   coefficients[0] = 2.0 * t*t*t - 3.0 * t*t + 1.0;
@@ -256,6 +425,45 @@ std::array<double, 4> TimeSpline::CubicCoefficients(
   return coefficients;
 }
 
+void TimeSpline::UpdateCoefficients() {
+  if (interpolation_ != SplineInterpolation::kCubicSpline) {
+    return;
+  }
+  for (int i = 0; i < size_ - 1; i++) {
+    int slot = Slot(i);
+    if (!coefficients_valid_[slot]) {
+      IntervalCoefficients(i, coefficients_.data() + slot * 4 * dim_);
+      coefficients_valid_[slot] = 1;
+    }
+  }
+}
+
+void TimeSpline::IntervalCoefficients(int lower_node_index,
+                                      double* coefficients) const {
+  ConstNode lower = NodeAt(lower_node_index);
+  ConstNode upper = NodeAt(lower_node_index + 1);
+  double duration = upper.time() - lower.time();
+  for (int i = 0; i < dim_; i++) {
+    // Hermite basis expanded in powers of the normalized time
+    double p0 = lower.values()[i];
+    double p1 = upper.values()[i];
+    double m0 = Slope(lower_node_index, i) * duration;
+    double m1 = Slope(lower_node_index + 1, i) * duration;
+    coefficients[4 * i] = p0;
+    coefficients[4 * i + 1] = m0;
+    coefficients[4 * i + 2] = 3.0 * (p1 - p0) - 2.0 * m0 - m1;
+    coefficients[4 * i + 3] = 2.0 * (p0 - p1) + m0 + m1;
+  }
+}
+
+void TimeSpline::InvalidateCoefficients(int first, int last) {
+  first = std::max(first, 0);
+  last = std::min(last, size_ - 2);
+  for (int i = first; i <= last; i++) {
+    coefficients_valid_[Slot(i)] = 0;
+  }
+}
+
 double TimeSpline::Slope(int node_index, int value_index) const {
   ConstNode node = NodeAt(node_index);
   if (node_index == 0) {
@@ -265,7 +473,7 @@ double TimeSpline::Slope(int node_index, int value_index) const {
            (next.time() - node.time());
   }
   ConstNode prev = NodeAt(node_index - 1);
-  if (node_index == times_.size() - 1) {
+  if (node_index == size_ - 1) {
     return (node.values().at(value_index) - prev.values().at(value_index)) /
            (node.time() - prev.time());
   }
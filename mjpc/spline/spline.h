@@ -17,7 +17,7 @@
 
 #include <array>
 #include <cstddef>
-#include <deque>
+#include <cstdint>
 #include <iterator>
 #include <type_traits>
 #include <vector>
@@ -45,8 +45,10 @@ class TimeSpline {
                       int initial_capacity = 1);
 
   // Copyable, Movable.
+  // Copy assignment reuses the existing buffer when it can hold all of the
+  // other spline's nodes, and doesn't allocate in that case.
   TimeSpline(const TimeSpline& other) = default;
-  TimeSpline& operator=(const TimeSpline& other) = default;
+  TimeSpline& operator=(const TimeSpline& other);
   TimeSpline(TimeSpline&& other) = default;
   TimeSpline& operator=(TimeSpline&& other) = default;
 
@@ -213,6 +215,8 @@ class TimeSpline {
 
   // Returns the node at the given index, sorted by time. Any calls that mutate
   // the spline will invalidate the Node object.
+  // The non-const version marks the cached coefficients of intervals that
+  // depend on the node as stale, since values may be modified through it.
   Node NodeAt(int index);
   ConstNode NodeAt(int index) const;
 
@@ -238,6 +242,20 @@ class TimeSpline {
   // Interpolates values based on time, returns a vector of length Dim.
   std::vector<double> Sample(double time) const;
 
+  // Interpolates values at `num_samples` times, starting at `time` and spaced
+  // by `timestep`, writes results to `values` (num_samples x Dim).
+  // Sample times are accumulated as in mj_step and nodes are visited in order,
+  // so results match repeated calls to Sample without repeating the search.
+  void SampleRange(double time, double timestep, int num_samples,
+                   absl::Span<double> values) const;
+
+  // Computes the cached cubic coefficients of all intervals that were marked
+  // stale by changes to the spline. Sample and SampleRange evaluate intervals
+  // with cached coefficients as a polynomial, and fall back to computing
+  // slopes from the neighbouring nodes otherwise.
+  // Does nothing unless interpolation is kCubicSpline.
+  void UpdateCoefficients();
+
   // Removes any old nodes that have no effect on the values at time `time`.
   // Returns the number of nodes removed.
   int DiscardBefore(double time);
@@ -255,24 +273,49 @@ class TimeSpline {
   std::array<double, 4> CubicCoefficients(double time,
                                           int lower_node_index) const;
   double Slope(int node_index, int value_index) const;
+
+  // Computes the polynomial coefficients of the cubic interval starting at
+  // the given node, in the normalized interval time (4 x Dim).
+  void IntervalCoefficients(int lower_node_index, double* coefficients) const;
+
+  // Marks the cached coefficients of intervals [first, last] as stale.
+  void InvalidateCoefficients(int first, int last);
+
+  // Returns the buffer slot of the node at the given index.
+  int Slot(int index) const {
+    int slot = begin_ + index;
+    return slot >= capacity_ ? slot - capacity_ : slot;
+  }
+
+  // Returns the time of the node at the given index.
+  double TimeAt(int index) const { return nodes_[Slot(index)]; }
+
+  // Returns the index of the first node with a time later than `time`, or
+  // Size() if there is none.
+  int UpperBound(double time) const;
+
   SplineInterpolation interpolation_;
 
   int dim_;
 
-  // The time values for each node. This is kept sorted.
-  std::deque<double> times_;
+  // The nodes, stored in a ring buffer which is resized whenever too many
+  // nodes are added. The first capacity_ elements hold the node times, and
+  // are followed by capacity_ * dim_ node values. The times are kept sorted.
+  std::vector<double> nodes_;
+
+  // The number of nodes the buffer can hold.
+  int capacity_ = 0;
 
-  // The raw node values. Stored in a ring buffer, which is resized whenever
-  // too many nodes are added.
-  std::vector<double> values_;
+  // The buffer slot of the earliest node.
+  int begin_ = 0;
 
-  // The index in values_ for the data of the earliest node.
-  int values_begin_ = 0;
+  // The number of nodes.
+  int size_ = 0;
 
-  // One past the index in values_ for the end of the data of the last node.
-  // If values_end_ == values_begin_, either there's no data (nodes_ is empty),
-  // or the values_ buffer is full.
-  int values_end_ = 0;
+  // Cached cubic coefficients of the interval starting at each buffer slot
+  // (capacity_ x 4 x dim_), and whether they are up to date (capacity_).
+  std::vector<double> coefficients_;
+  std::vector<uint8_t> coefficients_valid_;
 };
 
 }  // namespace mjpc::spline
@@ -15,144 +15,186 @@
 #include "mjpc/states/state.h"
 
 #include <algorithm>
+#include <atomic>
+#include <functional>
+#include <memory>
 #include <mutex>
-#include <shared_mutex>
 
 #include <mujoco/mujoco.h>
 #include "mjpc/utilities.h"
 
 namespace mjpc {
 
+State::State() : snapshot_(std::make_shared<StateSnapshot>()) {}
+
 // allocate memory
 void State::Allocate(const mjModel* model) {
-  const std::unique_lock<std::shared_mutex> lock(mtx_);
-  state_.resize(model->nq + model->nv + model->na);
-  mocap_.resize(7 * model->nmocap);
-  userdata_.resize(model->nuserdata);
+  Update([model](StateSnapshot* snapshot) {
+    snapshot->state.resize(model->nq + model->nv + model->na);
+    snapshot->mocap.resize(7 * model->nmocap);
+    snapshot->userdata.resize(model->nuserdata);
+  });
 }
 
 // reset memory to zeros
 void State::Reset() {
-  const std::unique_lock<std::shared_mutex> lock(mtx_);
-  std::fill(state_.begin(), state_.end(), (double)0.0);
-  std::fill(mocap_.begin(), mocap_.end(), 0.0);
-  std::fill(userdata_.begin(), userdata_.end(), 0.0);
-  time_ = 0.0;
+  Update([](StateSnapshot* snapshot) {
+    std::fill(snapshot->state.begin(), snapshot->state.end(), 0.0);
+    std::fill(snapshot->mocap.begin(), snapshot->mocap.end(), 0.0);
+    std::fill(snapshot->userdata.begin(), snapshot->userdata.end(), 0.0);
+    snapshot->time = 0.0;
+  });
 }
 
 // set state from data
 void State::Set(const mjModel* model, const mjData* data) {
   if (model && data) {
-    const std::unique_lock<std::shared_mutex> lock(mtx_);
-
-    state_.resize(model->nq + model->nv + model->na);
-    mocap_.resize(7 * model->nmocap);
-
-    // state
-    SetPosition(model, data->qpos);
-    SetVelocity(model, data->qvel);
-    SetAct(model, data->act);
-
-    // mocap
-    SetMocap(model, data->mocap_pos, data->mocap_quat);
-
-    // userdata
-    SetUserData(model, data->userdata);
-
-    // time
-    SetTime(model, data->time);
+    Set(model, data->qpos, data->qvel, data->act, data->mocap_pos,
+        data->mocap_quat, data->userdata, data->time);
   }
 }
 
 void State::Set(const mjModel* model, const double* qpos, const double* qvel,
                 const double* act, const double* mocap_pos,
                 const double* mocap_quat, const double* userdata, double time) {
-  // lock
-  const std::unique_lock<std::shared_mutex> lock(mtx_);
+  Update([&](StateSnapshot* snapshot) {
+    snapshot->state.resize(model->nq + model->nv + model->na);
+    snapshot->mocap.resize(7 * model->nmocap);
+    snapshot->userdata.resize(model->nuserdata);
 
-  state_.resize(model->nq + model->nv + model->na);
-  mocap_.resize(7 * model->nmocap);
-
-  // state
-  SetPosition(model, qpos);
-  SetVelocity(model, qvel);
-  SetAct(model, act);
+    // state
+    mju_copy(snapshot->state.data(), qpos, model->nq);
+    mju_copy(DataAt(snapshot->state, model->nq), qvel, model->nv);
+    mju_copy(DataAt(snapshot->state, model->nq + model->nv), act, model->na);
 
-  // mocap
-  SetMocap(model, mocap_pos, mocap_quat);
+    // mocap
+    for (int i = 0; i < model->nmocap; i++) {
+      mju_copy(DataAt(snapshot->mocap, 7 * i), mocap_pos + 3 * i, 3);
+      mju_copy(DataAt(snapshot->mocap, 7 * i + 3), mocap_quat + 4 * i, 4);
+    }
 
-  // userdata
-  SetUserData(model, userdata);
+    // userdata
+    mju_copy(snapshot->userdata.data(), userdata, model->nuserdata);
 
-  // time
-  SetTime(model, time);
+    // time
+    snapshot->time = time;
+  });
 }
 
-// TODO: make all these "Set*" functions thread-safe, or change their name.
-
 // set qpos
 void State::SetPosition(const mjModel* model, const double* qpos) {
-  mju_copy(state_.data(), qpos, model->nq);
+  Update([&](StateSnapshot* snapshot) {
+    mju_copy(snapshot->state.data(), qpos, model->nq);
+  });
 }
 
 // set qvel
 void State::SetVelocity(const mjModel* model, const double* qvel) {
-  mju_copy(DataAt(state_, model->nq), qvel, model->nv);
+  Update([&](StateSnapshot* snapshot) {
+    mju_copy(DataAt(snapshot->state, model->nq), qvel, model->nv);
+  });
 }
 
 // set act
 void State::SetAct(const mjModel* model, const double* act) {
-  mju_copy(DataAt(state_, model->nq + model->nv), act, model->na);
+  Update([&](StateSnapshot* snapshot) {
+    mju_copy(DataAt(snapshot->state, model->nq + model->nv), act, model->na);
+  });
 }
 
 // set mocap
 void State::SetMocap(const mjModel* model, const double* mocap_pos,
                      const double* mocap_quat) {
-  // mocap
-  for (int i = 0; i < model->nmocap; i++) {
-    mju_copy(DataAt(mocap_, 7 * i), mocap_pos + 3 * i, 3);
-    mju_copy(DataAt(mocap_, 7 * i + 3), mocap_quat + 4 * i, 4);
-  }
+  Update([&](StateSnapshot* snapshot) {
+    for (int i = 0; i < model->nmocap; i++) {
+      mju_copy(DataAt(snapshot->mocap, 7 * i), mocap_pos + 3 * i, 3);
+      mju_copy(DataAt(snapshot->mocap, 7 * i + 3), mocap_quat + 4 * i, 4);
+    }
+  });
 }
 
 // set userdata
 void State::SetUserData(const mjModel* model, const double* userdata) {
-  mju_copy(userdata_.data(), userdata, model->nuserdata);
+  Update([&](StateSnapshot* snapshot) {
+    mju_copy(snapshot->userdata.data(), userdata, model->nuserdata);
+  });
 }
 
 // set time
 void State::SetTime(const mjModel* model, double time) {
-  time_ = time;
+  Update([time](StateSnapshot* snapshot) { snapshot->time = time; });
 }
 
 void State::CopyTo(double* dst_state, double* dst_mocap,
                    double* dst_userdata, double* dst_time) const {
-  const std::shared_lock<std::shared_mutex> lock(mtx_);
-  mju_copy(dst_state, this->state_.data(), this->state_.size());
-  *dst_time = this->time_;
-  mju_copy(dst_mocap, this->mocap_.data(), this->mocap_.size());
-  mju_copy(dst_userdata, this->userdata_.data(), this->userdata_.size());
+  std::shared_ptr<const StateSnapshot> snapshot = Snapshot();
+  mju_copy(dst_state, snapshot->state.data(), snapshot->state.size());
+  *dst_time = snapshot->time;
+  mju_copy(dst_mocap, snapshot->mocap.data(), snapshot->mocap.size());
+  mju_copy(dst_userdata, snapshot->userdata.data(), snapshot->userdata.size());
 }
 
 void State::CopyTo(const mjModel* model, mjData* data) const {
-  const std::shared_lock<std::shared_mutex> lock(mtx_);
+  std::shared_ptr<const StateSnapshot> snapshot = Snapshot();
 
-    // state
-    mju_copy(data->qpos, state_.data(), model->nq);
-    mju_copy(data->qvel, DataAt(state_, model->nq), model->nv);
-    mju_copy(data->act, DataAt(state_, model->nq + model->nv), model->na);
+  // state
+  const std::vector<double>& state = snapshot->state;
+  mju_copy(data->qpos, state.data(), model->nq);
+  mju_copy(data->qvel, DataAt(state, model->nq), model->nv);
+  mju_copy(data->act, DataAt(state, model->nq + model->nv), model->na);
 
-    // mocap
-    for (int i = 0; i < model->nmocap; i++) {
-      mju_copy(data->mocap_pos + 3 * i, DataAt(mocap_, 7 * i), 3);
-      mju_copy(data->mocap_quat + 4 * i, DataAt(mocap_, 7 * i + 3), 4);
-    }
+  // mocap
+  for (int i = 0; i < model->nmocap; i++) {
+    mju_copy(data->mocap_pos + 3 * i, DataAt(snapshot->mocap, 7 * i), 3);
+    mju_copy(data->mocap_quat + 4 * i, DataAt(snapshot->mocap, 7 * i + 3), 4);
+  }
 
-    // userdata
-    mju_copy(data->userdata, userdata_.data(), model->nuserdata);
+  // userdata
+  mju_copy(data->userdata, snapshot->userdata.data(), model->nuserdata);
 
-    // time
-    data->time = time_;
+  // time
+  data->time = snapshot->time;
+}
+
+std::shared_ptr<const StateSnapshot> State::Snapshot() const {
+  return std::atomic_load(&snapshot_);
+}
+
+std::shared_ptr<const StateSnapshot> State::ZeroSnapshot(
+    const mjModel* model) {
+  auto snapshot = std::make_shared<StateSnapshot>();
+  snapshot->state.resize(model->nq + model->nv + model->na);
+  snapshot->mocap.resize(7 * model->nmocap);
+  snapshot->userdata.resize(model->nuserdata);
+  return snapshot;
+}
+
+void State::Update(const std::function<void(StateSnapshot*)>& update) {
+  const std::lock_guard<std::mutex> lock(mtx_);
+  std::shared_ptr<StateSnapshot> current = std::atomic_load(&snapshot_);
+
+  // snapshots are never reused: a reader that released the previous one is
+  // not synchronized with this thread, so writing to it could race with its
+  // last reads
+  auto next = std::make_shared<StateSnapshot>();
+  next->state.assign(current->state.begin(), current->state.end());
+  next->mocap.assign(current->mocap.begin(), current->mocap.end());
+  next->userdata.assign(current->userdata.begin(), current->userdata.end());
+  next->time = current->time;
+  next->sequence = current->sequence + 1;
+
+  // apply changes
+
+  update(next.get());
+
+  // unchanged, keep the current snapshot and its sequence number
+  if (next->time == current->time && next->state == current->state &&
+      next->mocap == current->mocap && next->userdata == current->userdata) {
+    return;
+  }
+
+  std::atomic_store(&snapshot_, next);
+  previous_ = std::move(current);
 }
 
 }  // namespace mjpc
@@ -15,20 +15,35 @@
 #ifndef MJPC_STATES_STATE_H_
 #define MJPC_STATES_STATE_H_
 
-#include <shared_mutex>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
 #include <vector>
 
 #include <mujoco/mujoco.h>
 
 namespace mjpc {
 
-// data and methods for state
+// immutable snapshot of a State, shared by its readers. sequence increases
+// with every change published by the State, updates that leave the state
+// unchanged aren't published.
+struct StateSnapshot {
+  std::vector<double> state;     // (state dimension x 1)
+  std::vector<double> mocap;     // (mocap dimension x 1)
+  std::vector<double> userdata;  // (nuserdata x 1)
+  double time = 0.0;
+  std::uint64_t sequence = 0;
+};
+
+// data and methods for state. every change publishes a new snapshot, readers
+// load the latest snapshot without locking and hold it instead of copying.
 class State {
  public:
   friend class StateTest;
 
   // constructor
-  State() = default;
+  State();
 
   // destructor
   ~State() = default;
@@ -74,17 +89,36 @@ class State {
               double* time) const;
   void CopyTo(const mjModel* model, mjData* data) const;
 
-  const std::vector<double>& state() const { return state_; }
-  const std::vector<double>& mocap() const { return mocap_; }
-  const std::vector<double>& userdata() const { return userdata_; }
-  double time() const { return time_; }
+  // latest snapshot, never null. it doesn't change while held.
+  std::shared_ptr<const StateSnapshot> Snapshot() const;
+
+  // sequence number of the latest snapshot
+  std::uint64_t Sequence() const { return Snapshot()->sequence; }
+
+  // zero snapshot with the dimensions of model
+  static std::shared_ptr<const StateSnapshot> ZeroSnapshot(
+      const mjModel* model);
+
+  // views of the latest snapshot, valid until the next change after the one
+  // that replaces it. use Snapshot() to hold a consistent state.
+  const std::vector<double>& state() const { return Snapshot()->state; }
+  const std::vector<double>& mocap() const { return Snapshot()->mocap; }
+  const std::vector<double>& userdata() const { return Snapshot()->userdata; }
+  double time() const { return Snapshot()->time; }
 
  private:
-  std::vector<double> state_;  // (state dimension x 1)
-  std::vector<double> mocap_;  // (mocap dimension x 1)
-  std::vector<double> userdata_;  // (nuserdata x 1)
-  double time_;
-  mutable std::shared_mutex mtx_;
+  // copies the latest snapshot, applies update and publishes the result
+  void Update(const std::function<void(StateSnapshot*)>& update);
+
+  // latest snapshot, only accessed with std::atomic_load/std::atomic_store
+  std::shared_ptr<StateSnapshot> snapshot_;
+
+  // replaced snapshot, kept alive (never written) for one more change so
+  // views of it stay valid
+  std::shared_ptr<const StateSnapshot> previous_;
+
+  // serializes writers, readers don't lock
+  std::mutex mtx_;
 };
 
 }  // namespace mjpc
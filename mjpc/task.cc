@@ -14,9 +14,14 @@
 
 #include "mjpc/task.h"
 
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
 #include <cstring>
 #include <mutex>
 #include <memory>
+#include <string>
+#include <vector>
 
 #include <absl/strings/match.h>
 #include <mujoco/mujoco.h>
@@ -87,18 +92,22 @@ void BaseResidualFn::CostTerms(double* terms, const double* residual,
   }
 }
 
-// compute weighted cost from terms
+// compute weighted cost from compiled cost terms
 double BaseResidualFn::CostValue(const double* residual) const {
-  // cost terms
-  double terms[kMaxCostTerms];
-
-  // evaluate
-  this->CostTerms(terms, residual, /*weighted=*/true);
-
-  // summation of cost terms
   double cost = 0.0;
-  for (int i = 0; i < num_term_; i++) {
-    cost += terms[i];
+  for (const CostInstruction& op : cost_program_) {
+    const double* r = residual + op.residual_offset;
+    if (op.norm == NormType::kQuadratic) {
+      // fused weighted dot product over merged quadratic terms
+      const double* w = quadratic_weight_.data() + op.residual_offset;
+      for (int i = 0; i < op.dim; i++) {
+        cost += w[i] * r[i] * r[i];
+      }
+    } else {
+      cost += op.weight * Norm(nullptr, nullptr, r,
+                               DataAt(norm_parameter_, op.parameter_offset),
+                               op.dim, op.norm);
+    }
   }
 
   // exponential risk transformation
@@ -109,6 +118,82 @@ double BaseResidualFn::CostValue(const double* residual) const {
   }
 }
 
+// compute weighted costs for num residuals spaced by stride
+void BaseResidualFn::CostValues(double* costs, const double* residual,
+                                int num, int stride) const {
+  mju_zero(costs, num);
+
+  // accumulate instructions, each evaluated for a batch of residuals at once
+  double values[kCostBatchSize];
+  for (const CostInstruction& op : cost_program_) {
+    const double* r = residual + op.residual_offset;
+    if (op.norm == NormType::kQuadratic) {
+      const double* w = quadratic_weight_.data() + op.residual_offset;
+      for (int k = 0; k < num; k++) {
+        const double* rk = r + k * stride;
+        double c = 0.0;
+        for (int i = 0; i < op.dim; i++) {
+          c += w[i] * rk[i] * rk[i];
+        }
+        costs[k] += c;
+      }
+      continue;
+    }
+    for (int start = 0; start < num; start += kCostBatchSize) {
+      int count = std::min(kCostBatchSize, num - start);
+      NormBatch(values, nullptr, nullptr, r + start * stride,
+                DataAt(norm_parameter_, op.parameter_offset), op.dim, count,
+                stride, op.norm);
+      for (int i = 0; i < count; i++) {
+        costs[start + i] += op.weight * values[i];
+      }
+    }
+  }
+
+  // exponential risk transformation
+  if (mju_abs(risk_) >= kRiskNeutralTolerance) {
+    for (int i = 0; i < num; i++) {
+      costs[i] = (mju_exp(risk_ * costs[i]) - 1.0) / risk_;
+    }
+  }
+}
+
+// compile cost terms into a flat instruction list: zero-weight terms are
+// dropped, consecutive quadratic terms are merged and offsets precomputed
+void BaseResidualFn::CompileCost() {
+  cost_program_.clear();
+  quadratic_weight_.assign(num_residual_, 0.0);
+
+  int f_shift = 0;
+  int p_shift = 0;
+  for (int k = 0; k < num_term_; k++) {
+    int dim = dim_norm_residual_[k];
+    if (weight_[k] != 0.0) {
+      if (norm_[k] == NormType::kQuadratic) {
+        // 0.5 * w * r' * r, merged with a directly preceding quadratic term
+        mju_fill(quadratic_weight_.data() + f_shift, 0.5 * weight_[k], dim);
+        if (!cost_program_.empty() &&
+            cost_program_.back().norm == NormType::kQuadratic &&
+            cost_program_.back().residual_offset + cost_program_.back().dim ==
+                f_shift) {
+          cost_program_.back().dim += dim;
+        } else {
+          cost_program_.push_back(
+              {NormType::kQuadratic, f_shift, dim, p_shift, 1.0});
+        }
+      } else {
+        cost_program_.push_back({norm_[k], f_shift, dim, p_shift, weight_[k]});
+      }
+    }
+
+    // shift residual
+    f_shift += dim;
+
+    // shift parameters
+    p_shift += num_norm_parameter_[k];
+  }
+}
+
 void BaseResidualFn::Update() {
   num_residual_ = task_->num_residual;
   num_term_ = task_->num_term;
@@ -120,8 +205,124 @@ void BaseResidualFn::Update() {
   norm_parameter_ = task_->norm_parameter;
   risk_ = task_->risk;
   parameters_ = task_->parameters;
+  CompileCost();
 }
 
+namespace {
+// depth of DirectResidualScope on this thread
+thread_local int direct_residual_depth = 0;
+
+// residual registered for a model, or an alias resolving to the entry of
+// source (e.g., a per-thread copy of a registered model)
+struct ResidualEntry {
+  const mjModel* model;
+  const Task* task;
+  bool planning;
+  const mjModel* source;
+};
+
+// immutable registry snapshot, replaced on every registration. a snapshot is
+// freed once the registry and every thread that looked up a residual have
+// moved on to a newer one.
+using ResidualRegistry = std::vector<ResidualEntry>;
+
+// guards registry; registry_version counts published snapshots
+std::mutex registry_mutex;
+std::shared_ptr<const ResidualRegistry> registry;
+std::atomic<uint64_t> registry_version = 0;
+
+// snapshot and last lookup on this thread, refreshed when the version changes
+thread_local std::shared_ptr<const ResidualRegistry> cached_registry;
+thread_local uint64_t cached_version = 0;
+thread_local ResidualEntry cached_entry = {nullptr, nullptr, false, nullptr};
+thread_local const mjModel* cached_model = nullptr;
+
+// returns the entry for model in snapshot, or nullptr
+const ResidualEntry* FindEntry(const ResidualRegistry& snapshot,
+                               const mjModel* model) {
+  for (const ResidualEntry& entry : snapshot) {
+    if (entry.model == model) return &entry;
+  }
+  return nullptr;
+}
+
+// returns the task entry for model, following aliases, or nullptr; locks
+// only after the registry changed
+const ResidualEntry* FindResidual(const mjModel* model) {
+  uint64_t version = registry_version.load(std::memory_order_acquire);
+  if (cached_version != version) {
+    std::lock_guard<std::mutex> lock(registry_mutex);
+    cached_registry = registry;
+    cached_version = registry_version.load(std::memory_order_relaxed);
+    cached_model = nullptr;
+  }
+  if (cached_model != model) {
+    cached_entry = {nullptr, nullptr, false, nullptr};
+    const ResidualEntry* entry =
+        cached_registry ? FindEntry(*cached_registry, model) : nullptr;
+    for (int depth = 0; entry && entry->source && depth < 4; depth++) {
+      entry = FindEntry(*cached_registry, entry->source);
+    }
+    if (entry && !entry->source) cached_entry = *entry;
+    cached_model = model;
+  }
+  return cached_entry.task ? &cached_entry : nullptr;
+}
+
+// publishes a copy of the current registry with entry for model replaced by
+// (or removed, if entry is null) the given one; requires registry_mutex
+void PublishResidual(const mjModel* model, const ResidualEntry* entry) {
+  auto snapshot = std::make_shared<ResidualRegistry>();
+  if (registry) {
+    for (const ResidualEntry& e : *registry) {
+      if (e.model != model) snapshot->push_back(e);
+    }
+  }
+  if (entry) snapshot->push_back(*entry);
+  registry = std::move(snapshot);
+  registry_version.fetch_add(1, std::memory_order_release);
+}
+}  // namespace
+
+void RegisterResidual(const mjModel* model, const Task* task, bool planning) {
+  std::lock_guard<std::mutex> lock(registry_mutex);
+  ResidualEntry entry = {model, task, planning, nullptr};
+  PublishResidual(model, &entry);
+  if (!mjcb_sensor) mjcb_sensor = ResidualSensorCallback;
+}
+
+void RegisterResidualAlias(const mjModel* model, const mjModel* source) {
+  std::lock_guard<std::mutex> lock(registry_mutex);
+  ResidualEntry entry = {model, nullptr, false, source};
+  PublishResidual(model, &entry);
+}
+
+void UnregisterResidual(const mjModel* model) {
+  std::lock_guard<std::mutex> lock(registry_mutex);
+  PublishResidual(model, nullptr);
+}
+
+void ResidualSensorCallback(const mjModel* model, mjData* data, int stage) {
+  if (stage != mjSTAGE_ACC || DirectResidualScope::Active()) return;
+  const ResidualEntry* entry = FindResidual(model);
+  if (!entry) return;
+
+  // the planning residual is constant during planning and needs no lock
+  if (entry->planning) {
+    if (const ResidualFn* residual = entry->task->PlanningResidual()) {
+      residual->Residual(model, data, data->sensordata);
+      return;
+    }
+  }
+  entry->task->Residual(model, data, data->sensordata);
+}
+
+DirectResidualScope::DirectResidualScope() { direct_residual_depth++; }
+
+DirectResidualScope::~DirectResidualScope() { direct_residual_depth--; }
+
+bool DirectResidualScope::Active() { return direct_residual_depth > 0; }
+
 std::unique_ptr<ResidualFn> Task::Residual() const {
   std::lock_guard<std::mutex> lock(mutex_);
   return ResidualLocked();
@@ -200,6 +401,18 @@ void Task::Reset(const mjModel* model) {
     mju_error("Number of traces should be less than 100\n");
   }
 
+  // trace sensor ids and addresses
+  trace_id.resize(num_trace);
+  trace_adr.resize(num_trace);
+  kinematic_trace = true;
+  for (int i = 0; i < num_trace; i++) {
+    std::string name = "trace" + std::to_string(i);
+    int id = mj_name2id(model, mjOBJ_SENSOR, name.c_str());
+    trace_id[i] = id;
+    trace_adr[i] = id == -1 ? -1 : model->sensor_adr[id];
+    if (id >= 0 && !KinematicTrace(model, id)) kinematic_trace = false;
+  }
+
   // loop over sensors
   int parameter_shift = 0;
   for (int i = 0; i < num_term; i++) {
@@ -260,4 +473,10 @@ double Task::CostValue(const double* residual) const {
   return InternalResidual()->CostValue(residual);
 }
 
+void Task::CostValues(double* costs, const double* residual, int num,
+                      int stride) const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  InternalResidual()->CostValues(costs, residual, num, stride);
+}
+
 }  // namespace mjpc
@@ -31,6 +31,9 @@ inline constexpr double kRiskNeutralTolerance = 1.0e-6;
 // maximum cost terms
 inline constexpr int kMaxCostTerms = 128;
 
+// number of residuals evaluated per norm batch in CostValues
+inline constexpr int kCostBatchSize = 32;
+
 class Task;
 
 // abstract class for a residual function
@@ -43,10 +46,30 @@ class ResidualFn {
   virtual void CostTerms(double* terms, const double* residual,
                          bool weighted) const = 0;
   virtual double CostValue(const double* residual) const = 0;
+  virtual void CostValues(double* costs, const double* residual, int num,
+                          int stride) const = 0;
 
   // copies weights and parameters from the Task instance. This should be
   // called from the Task class.
   virtual void Update() = 0;
+
+  // false if Residual reads no sensordata, in which case rollouts with
+  // kinematic traces skip the sensor pipeline in the final forward pass and
+  // in Runge-Kutta steps
+  virtual bool ReadsSensorData() const { return true; }
+};
+
+// while alive on a thread, trajectory rollouts on that thread write residuals
+// directly and the sensor callback must not evaluate them
+class DirectResidualScope {
+ public:
+  DirectResidualScope();
+  ~DirectResidualScope();
+  DirectResidualScope(const DirectResidualScope&) = delete;
+  DirectResidualScope& operator=(const DirectResidualScope&) = delete;
+
+  // true if a scope is open on the calling thread
+  static bool Active();
 };
 
 // base implementation for ResidualFn implementations
@@ -58,9 +81,23 @@ class BaseResidualFn : public ResidualFn {
   void CostTerms(double* terms, const double* residual,
                  bool weighted) const override;
   double CostValue(const double* residual) const override;
+  void CostValues(double* costs, const double* residual, int num,
+                  int stride) const override;
   void Update() override;
 
  protected:
+  // compiled cost term: norm over a contiguous residual block
+  struct CostInstruction {
+    NormType norm;         // kQuadratic: merged terms, quadratic_weight_
+    int residual_offset;   // first residual element
+    int dim;               // number of residual elements
+    int parameter_offset;  // first norm parameter
+    double weight;         // term weight
+  };
+
+  // compile term table into cost_program_; called from Update
+  void CompileCost();
+
   int num_residual_;
   int num_term_;
   int num_trace_;
@@ -71,6 +108,8 @@ class BaseResidualFn : public ResidualFn {
   std::vector<double> norm_parameter_;
   double risk_;
   std::vector<double> parameters_;
+  std::vector<CostInstruction> cost_program_;
+  std::vector<double> quadratic_weight_;  // 0.5 * weight per residual element
   const Task* task_;
 };
 
@@ -118,6 +157,18 @@ class Task {
   // holding a lock
   double CostValue(const double* residual) const;
 
+  // calls CostValues on the pointer returned from InternalResidual(), while
+  // holding a lock; costs[k] is the cost of residual + k * stride
+  void CostValues(double* costs, const double* residual, int num,
+                  int stride) const;
+
+  // residual function copy which rollouts evaluate directly during a planning
+  // iteration; set by the agent, nullptr outside of planning
+  const ResidualFn* PlanningResidual() const { return planning_residual_; }
+  void SetPlanningResidual(const ResidualFn* residual) {
+    planning_residual_ = residual;
+  }
+
   virtual void ModifyScene(const mjModel* model, const mjData* data,
                            mjvScene* scene) const {}
 
@@ -135,6 +186,9 @@ class Task {
   int num_residual;
   int num_term;
   int num_trace;
+  std::vector<int> trace_id;   // sensor ids of traces, -1 if missing
+  std::vector<int> trace_adr;  // sensor addresses of traces, -1 if missing
+  bool kinematic_trace = false;  // all traces can be read from kinematics
   std::vector<int> dim_norm_residual;
   std::vector<int> num_norm_parameter;
   std::vector<NormType> norm;
@@ -169,8 +223,35 @@ class Task {
  private:
   // initial residual parameters from model
   void SetFeatureParameters(const mjModel* model);
+
+  const ResidualFn* planning_residual_ = nullptr;
 };
 
+// ----- residual dispatch ----- //
+// residuals fill the user sensors of a model through ResidualSensorCallback,
+// which looks up the task registered for that model. this lets a process host
+// several agents with different tasks.
+
+// registers task as the residual for model, replacing a previous entry. with
+// planning = true, the task's PlanningResidual() is used when set. installs
+// ResidualSensorCallback as mjcb_sensor if no sensor callback is set.
+void RegisterResidual(const mjModel* model, const Task* task,
+                      bool planning = false);
+
+// registers model to use the residual registered for source, resolved at
+// evaluation time; for internal copies of a model (e.g., per-thread models of
+// an estimator) that are created before or after source is registered
+void RegisterResidualAlias(const mjModel* model, const mjModel* source);
+
+// removes the entry or alias for model; must not race with simulation of
+// model
+void UnregisterResidual(const mjModel* model);
+
+// sensor callback: evaluates the residual registered for model at
+// mjSTAGE_ACC. each thread keeps the registry snapshot of its last lookup and
+// locks only to pick up a newer one after a registration.
+void ResidualSensorCallback(const mjModel* model, mjData* data, int stage);
+
 }  // namespace mjpc
 
 #endif  // MJPC_TASK_H_
@@ -36,6 +36,7 @@ class Acrobot : public Task {
     // -----------------------------------------------
     void Residual(const mjModel* model, const mjData* data,
                   double* residual) const override;
+    bool ReadsSensorData() const override { return false; }
   };
 
   Acrobot() : residual_(this) {}
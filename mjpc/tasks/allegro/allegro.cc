@@ -38,24 +38,22 @@ void Allegro::ResidualFn::Residual(const mjModel *model, const mjData *data,
   int counter = 0;
 
   // ---------- Cube position ----------
-  double *cube_position = SensorByName(model, data, "cube_position");
-  double *cube_goal_position = SensorByName(model, data, "cube_goal_position");
+  double *cube_position = data->sensordata + cube_position_adr_;
+  double *cube_goal_position = data->sensordata + cube_goal_position_adr_;
 
   mju_sub3(residual + counter, cube_position, cube_goal_position);
   counter += 3;
 
   // ---------- Cube orientation ----------
-  double *cube_orientation = SensorByName(model, data, "cube_orientation");
-  double *goal_cube_orientation =
-      SensorByName(model, data, "cube_goal_orientation");
+  double *cube_orientation = data->sensordata + cube_orientation_adr_;
+  double *goal_cube_orientation = data->sensordata + cube_goal_orientation_adr_;
   mju_normalize4(goal_cube_orientation);
 
   mju_subQuat(residual + counter, goal_cube_orientation, cube_orientation);
   counter += 3;
 
   // ---------- Cube linear velocity ----------
-  double *cube_linear_velocity =
-      SensorByName(model, data, "cube_linear_velocity");
+  double *cube_linear_velocity = data->sensordata + cube_linear_velocity_adr_;
 
   mju_copy(residual + counter, cube_linear_velocity, 3);
   counter += 3;
@@ -109,4 +107,15 @@ void Allegro::TransitionLocked(mjModel *model, mjData *data) {
   }
 }
 
+void Allegro::ResetLocked(const mjModel *model) {
+  residual_.cube_position_adr_ = SensorAdrByName(model, "cube_position");
+  residual_.cube_goal_position_adr_ =
+      SensorAdrByName(model, "cube_goal_position");
+  residual_.cube_orientation_adr_ = SensorAdrByName(model, "cube_orientation");
+  residual_.cube_goal_orientation_adr_ =
+      SensorAdrByName(model, "cube_goal_orientation");
+  residual_.cube_linear_velocity_adr_ =
+      SensorAdrByName(model, "cube_linear_velocity");
+}
+
 }  // namespace mjpc
@@ -32,6 +32,16 @@ class Allegro : public Task {
     explicit ResidualFn(const Allegro *task) : BaseResidualFn(task) {}
     void Residual(const mjModel *model, const mjData *data,
                   double *residual) const override;
+
+   private:
+    friend class Allegro;
+
+    // sensor addresses, resolved in ResetLocked
+    int cube_position_adr_ = -1;
+    int cube_goal_position_adr_ = -1;
+    int cube_orientation_adr_ = -1;
+    int cube_goal_orientation_adr_ = -1;
+    int cube_linear_velocity_adr_ = -1;
   };
   Allegro() : residual_(this) {}
 
@@ -40,8 +50,9 @@ class Allegro : public Task {
 
  protected:
   std::unique_ptr<mjpc::ResidualFn> ResidualLocked() const override {
-    return std::make_unique<ResidualFn>(this);
+    return std::make_unique<ResidualFn>(residual_);
   }
+  void ResetLocked(const mjModel *model) override;
   ResidualFn *InternalResidual() override { return &residual_; }
 
  private:
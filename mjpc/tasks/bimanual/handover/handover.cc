@@ -36,7 +36,7 @@ void Handover::ResidualFn::Residual(const mjModel* model, const mjData* data,
   int counter = 0;
 
   // reach left, encourage proper alignment
-  double* left_gripper = SensorByName(model, data, "left/gripper");
+  double* left_gripper = data->sensordata + left_gripper_adr_;
   mju_copy3(residual + counter, left_gripper);
   // The sensor is "object pos in the frame of the gripper".
   // X points forward in the gripper frame.
@@ -47,7 +47,7 @@ void Handover::ResidualFn::Residual(const mjModel* model, const mjData* data,
   counter += 3;
 
   // reach right, encourage proper alignment
-  double* right_gripper = SensorByName(model, data, "right/gripper");
+  double* right_gripper = data->sensordata + right_gripper_adr_;
   mju_copy3(residual + counter, right_gripper);
   residual[counter + 1] *= 2;
   residual[counter + 2] *= 2;
@@ -59,18 +59,9 @@ void Handover::ResidualFn::Residual(const mjModel* model, const mjData* data,
   double normal[4][3] = {{0}, {0}, {0}, {0}};
   int nnormal[4] = {0, 0, 0, 0};
 
-  // get body ids, object position
-  int finger[4] = {0};
-  char name[] = "finger__";
-  char finger_name[4][3] = {"LL", "LR", "RL", "RR"};
-  for (int segment = 0; segment < 4; segment++) {
-    name[6] = finger_name[segment][0];
-    name[7] = finger_name[segment][1];
-    int finger_sensor_id = mj_name2id(model, mjOBJ_SENSOR, name);
-    finger[segment] = model->sensor_objid[finger_sensor_id];
-  }
-  int target_sensor_id = mj_name2id(model, mjOBJ_SENSOR, "box");
-  int object_id = model->sensor_objid[target_sensor_id];
+  // body ids
+  const int* finger = finger_body_id_;
+  int object_id = box_body_id_;
 
   // loop over contacts, add up (and maybe flip) relevant normals
   int ncon = data->ncon;
@@ -122,8 +113,8 @@ void Handover::ResidualFn::Residual(const mjModel* model, const mjData* data,
   counter++;
 
   // bring
-  double* target = SensorByName(model, data, "target");
-  double* box = SensorByName(model, data, "box");
+  double* target = data->sensordata + target_adr_;
+  double* box = data->sensordata + box_adr_;
   mju_sub3(residual + counter, box, target);
   counter += 3;
 
@@ -178,4 +169,24 @@ void Handover::TransitionLocked(mjModel* model, mjData* data) {
   }
 }
 
+void Handover::ResetLocked(const mjModel* model) {
+  residual_.left_gripper_adr_ = SensorAdrByName(model, "left/gripper");
+  residual_.right_gripper_adr_ = SensorAdrByName(model, "right/gripper");
+  residual_.target_adr_ = SensorAdrByName(model, "target");
+  residual_.box_adr_ = SensorAdrByName(model, "box");
+
+  // finger and box body ids, from the objects their sensors are attached to
+  char name[] = "finger__";
+  char finger_name[4][3] = {"LL", "LR", "RL", "RR"};
+  for (int segment = 0; segment < 4; segment++) {
+    name[6] = finger_name[segment][0];
+    name[7] = finger_name[segment][1];
+    int finger_sensor_id = mj_name2id(model, mjOBJ_SENSOR, name);
+    if (finger_sensor_id < 0) mju_error_s("sensor '%s' not found", name);
+    residual_.finger_body_id_[segment] = model->sensor_objid[finger_sensor_id];
+  }
+  int box_sensor_id = mj_name2id(model, mjOBJ_SENSOR, "box");
+  residual_.box_body_id_ = model->sensor_objid[box_sensor_id];
+}
+
 }  // namespace mjpc::aloha
@@ -32,14 +32,26 @@ class Handover : public Task {
     explicit ResidualFn(const Handover* task) : BaseResidualFn(task) {}
     void Residual(const mjModel* model, const mjData* data,
                   double* residual) const override;
+
+   private:
+    friend class Handover;
+
+    // sensor addresses and body ids, resolved in ResetLocked
+    int left_gripper_adr_ = -1;
+    int right_gripper_adr_ = -1;
+    int target_adr_ = -1;
+    int box_adr_ = -1;
+    int finger_body_id_[4] = {-1, -1, -1, -1};
+    int box_body_id_ = -1;
   };
 
   Handover() : residual_(this) {}
   void TransitionLocked(mjModel* model, mjData* data) override;
 
  protected:
+  void ResetLocked(const mjModel* model) override;
   std::unique_ptr<mjpc::ResidualFn> ResidualLocked() const override {
-    return std::make_unique<ResidualFn>(this);
+    return std::make_unique<ResidualFn>(residual_);
   }
   ResidualFn* InternalResidual() override { return &residual_; }
   double last_solve_time = 0;
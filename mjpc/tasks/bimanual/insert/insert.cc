@@ -36,12 +36,12 @@ void Insert::ResidualFn::Residual(const mjModel* model, const mjData* data,
   // ======== reach
 
   // reach left
-  double* left_gripper = SensorByName(model, data, "left/gripper");
+  double* left_gripper = data->sensordata + left_gripper_adr_;
   mju_copy3(residual + counter, left_gripper);
   counter += 3;
 
   // reach right
-  double* right_gripper = SensorByName(model, data, "right/gripper");
+  double* right_gripper = data->sensordata + right_gripper_adr_;
   mju_copy3(residual + counter, right_gripper);
   counter += 3;
 
@@ -51,14 +51,9 @@ void Insert::ResidualFn::Residual(const mjModel* model, const mjData* data,
   double normal[4][3] = {{0}, {0}, {0}, {0}};
   int nnormal[4] = {0, 0, 0, 0};
 
-  // get body ids, object position
-  int finger[4] = {mj_name2id(model, mjOBJ_BODY, "left/left_finger_link"),
-                   mj_name2id(model, mjOBJ_BODY, "left/right_finger_link"),
-                   mj_name2id(model, mjOBJ_BODY, "right/left_finger_link"),
-                   mj_name2id(model, mjOBJ_BODY, "right/right_finger_link")};
-
-  int connector[2] = {mj_name2id(model, mjOBJ_GEOM, "connector_f_grip"),
-                      mj_name2id(model, mjOBJ_GEOM, "connector_m_grip")};
+  // body and geom ids
+  const int* finger = finger_body_id_;
+  const int* connector = connector_geom_id_;
 
   // the grasping cost here is different to the one in handover.cc:
   // - contacts between body (finger) and specific geom (connector_x_grip)
@@ -106,8 +101,8 @@ void Insert::ResidualFn::Residual(const mjModel* model, const mjData* data,
 
   // left hand
   if (nnormal[0] && nnormal[1]) {
-    double* left_x = SensorByName(model, data, "left/x");
-    double* f_x = SensorByName(model, data, "f/x");
+    double* left_x = data->sensordata + left_x_adr_;
+    double* f_x = data->sensordata + f_x_adr_;
     double frame_misalign = mju_dot3(left_x, f_x);
     mju_normalize3(normal[0]);
     mju_normalize3(normal[1]);
@@ -119,8 +114,8 @@ void Insert::ResidualFn::Residual(const mjModel* model, const mjData* data,
   // right hand
   grasp = 1;
   if (nnormal[2] && nnormal[3]) {
-    double* right_x = SensorByName(model, data, "right/x");
-    double* m_x = SensorByName(model, data, "m/x");
+    double* right_x = data->sensordata + right_x_adr_;
+    double* m_x = data->sensordata + m_x_adr_;
     double frame_misalign = mju_dot3(right_x, m_x);
     mju_normalize3(normal[2]);
     mju_normalize3(normal[3]);
@@ -130,12 +125,9 @@ void Insert::ResidualFn::Residual(const mjModel* model, const mjData* data,
   residual[counter++] = grasp;
 
   // ======== Lift (don't care much about x,y)
-  int msite_id = mj_name2id(model, mjOBJ_SITE, "connector_m");
-  int fsite_id = mj_name2id(model, mjOBJ_SITE, "connector_f");
-  double* m_pos = data->site_xpos + 3*msite_id;
-  double* f_pos = data->site_xpos + 3*fsite_id;
-  int target_id = mj_name2id(model, mjOBJ_GEOM, "target");
-  double* target_pos = data->geom_xpos + 3*target_id;
+  double* m_pos = data->site_xpos + 3*msite_id_;
+  double* f_pos = data->site_xpos + 3*fsite_id_;
+  double* target_pos = data->geom_xpos + 3*target_geom_id_;
 
   mju_sub3(residual + counter, m_pos, target_pos);
   residual[counter + 1] *= 0.1;  // we care much less about x and y than z
@@ -152,8 +144,8 @@ void Insert::ResidualFn::Residual(const mjModel* model, const mjData* data,
   // ad-hoc crosses of 6 points at distance kRadius away from the two sites,
   // aligned with the the orientation matrices (site_pos ± kRadius *{x, y, z})
 
-  double* m_mat = data->site_xmat + 9*msite_id;
-  double* f_mat = data->site_xmat + 9*fsite_id;
+  double* m_mat = data->site_xmat + 9*msite_id_;
+  double* f_mat = data->site_xmat + 9*fsite_id_;
 
   // construct crosses
   constexpr double kRadius = 0.08;
@@ -227,4 +219,28 @@ void Insert::TransitionLocked(mjModel* model, mjData* data) {
   }
 }
 
+void Insert::ResetLocked(const mjModel* model) {
+  residual_.left_gripper_adr_ = SensorAdrByName(model, "left/gripper");
+  residual_.right_gripper_adr_ = SensorAdrByName(model, "right/gripper");
+  residual_.left_x_adr_ = SensorAdrByName(model, "left/x");
+  residual_.f_x_adr_ = SensorAdrByName(model, "f/x");
+  residual_.right_x_adr_ = SensorAdrByName(model, "right/x");
+  residual_.m_x_adr_ = SensorAdrByName(model, "m/x");
+
+  int finger_index = 0;
+  for (const char* finger : {"left/left_finger_link", "left/right_finger_link",
+                             "right/left_finger_link",
+                             "right/right_finger_link"}) {
+    residual_.finger_body_id_[finger_index++] =
+        mj_name2id(model, mjOBJ_BODY, finger);
+  }
+  residual_.connector_geom_id_[0] =
+      mj_name2id(model, mjOBJ_GEOM, "connector_f_grip");
+  residual_.connector_geom_id_[1] =
+      mj_name2id(model, mjOBJ_GEOM, "connector_m_grip");
+  residual_.msite_id_ = mj_name2id(model, mjOBJ_SITE, "connector_m");
+  residual_.fsite_id_ = mj_name2id(model, mjOBJ_SITE, "connector_f");
+  residual_.target_geom_id_ = mj_name2id(model, mjOBJ_GEOM, "target");
+}
+
 }  // namespace mjpc::aloha
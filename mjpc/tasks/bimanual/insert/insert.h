@@ -32,14 +32,31 @@ class Insert : public Task {
     explicit ResidualFn(const Insert* task) : BaseResidualFn(task) {}
     void Residual(const mjModel* model, const mjData* data,
                   double* residual) const override;
+
+   private:
+    friend class Insert;
+
+    // sensor addresses and object ids, resolved in ResetLocked
+    int left_gripper_adr_ = -1;
+    int right_gripper_adr_ = -1;
+    int left_x_adr_ = -1;
+    int f_x_adr_ = -1;
+    int right_x_adr_ = -1;
+    int m_x_adr_ = -1;
+    int finger_body_id_[4] = {-1, -1, -1, -1};
+    int connector_geom_id_[2] = {-1, -1};
+    int msite_id_ = -1;
+    int fsite_id_ = -1;
+    int target_geom_id_ = -1;
   };
 
   Insert() : residual_(this) {}
   void TransitionLocked(mjModel* model, mjData* data) override;
 
  protected:
+  void ResetLocked(const mjModel* model) override;
   std::unique_ptr<mjpc::ResidualFn> ResidualLocked() const override {
-    return std::make_unique<ResidualFn>(this);
+    return std::make_unique<ResidualFn>(residual_);
   }
   ResidualFn* InternalResidual() override { return &residual_; }
   double last_solve_time = 0;
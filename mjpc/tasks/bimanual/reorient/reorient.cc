@@ -32,17 +32,17 @@ std::string Reorient::Name() const { return "Bimanual Reorient"; }
 void Reorient::ResidualFn::Residual(const mjModel* model, const mjData* data,
                                     double* residual) const {
   int counter = 0;
-  double* object_pos = SensorByName(model, data, "object_pos");
+  double* object_pos = data->sensordata + object_pos_adr_;
 
   // reach left, encourage proper alignment
-  double* left_gripper = SensorByName(model, data, "left/gripper");
+  double* left_gripper = data->sensordata + left_gripper_adr_;
   mju_copy3(residual + counter, left_gripper);
   residual[counter + 1] *= 3;
   residual[counter + 2] *= 3;
   counter += 3;
 
   // reach right, encourage proper alignment
-  double* right_gripper = SensorByName(model, data, "right/gripper");
+  double* right_gripper = data->sensordata + right_gripper_adr_;
   mju_copy3(residual + counter, right_gripper);
   residual[counter + 1] *= 3;
   residual[counter + 2] *= 3;
@@ -54,12 +54,9 @@ void Reorient::ResidualFn::Residual(const mjModel* model, const mjData* data,
   double normal[4][3] = {{0}, {0}, {0}, {0}};
   int nnormal[4] = {0, 0, 0, 0};
 
-  // get body ids, object id
-  int finger[4] = {mj_name2id(model, mjOBJ_BODY, "left/left_finger_link"),
-                   mj_name2id(model, mjOBJ_BODY, "left/right_finger_link"),
-                   mj_name2id(model, mjOBJ_BODY, "right/left_finger_link"),
-                   mj_name2id(model, mjOBJ_BODY, "right/right_finger_link")};
-  int object_id = mj_name2id(model, mjOBJ_BODY, "cross");
+  // body ids, object id
+  const int* finger = finger_body_id_;
+  int object_id = object_body_id_;
 
 
   int ncon = data->ncon;
@@ -103,9 +100,8 @@ void Reorient::ResidualFn::Residual(const mjModel* model, const mjData* data,
   residual[counter++] = grasp;
 
   // ---------- Bring and match orientation ----------
-  double* target_pos = SensorByName(model, data, "target_pos");
-  int target_orient_id = mj_name2id(model, mjOBJ_BODY, "target_orient");
-  double *target_orient = data->ximat + 9*target_orient_id;
+  double* target_pos = data->sensordata + target_pos_adr_;
+  double *target_orient = data->ximat + 9*target_orient_body_id_;
   double *object_orient = data->ximat + 9*object_id;
 
   // construct crosses
@@ -161,4 +157,22 @@ void Reorient::TransitionLocked(mjModel* model, mjData* data) {
   }
 }
 
+void Reorient::ResetLocked(const mjModel* model) {
+  residual_.object_pos_adr_ = SensorAdrByName(model, "object_pos");
+  residual_.left_gripper_adr_ = SensorAdrByName(model, "left/gripper");
+  residual_.right_gripper_adr_ = SensorAdrByName(model, "right/gripper");
+  residual_.target_pos_adr_ = SensorAdrByName(model, "target_pos");
+
+  int finger_index = 0;
+  for (const char* finger : {"left/left_finger_link", "left/right_finger_link",
+                             "right/left_finger_link",
+                             "right/right_finger_link"}) {
+    residual_.finger_body_id_[finger_index++] =
+        mj_name2id(model, mjOBJ_BODY, finger);
+  }
+  residual_.object_body_id_ = mj_name2id(model, mjOBJ_BODY, "cross");
+  residual_.target_orient_body_id_ =
+      mj_name2id(model, mjOBJ_BODY, "target_orient");
+}
+
 }  // namespace mjpc::aloha
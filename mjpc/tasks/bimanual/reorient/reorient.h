@@ -32,14 +32,27 @@ class Reorient : public Task {
     explicit ResidualFn(const Reorient* task) : BaseResidualFn(task) {}
     void Residual(const mjModel* model, const mjData* data,
                   double* residual) const override;
+
+   private:
+    friend class Reorient;
+
+    // sensor addresses and body ids, resolved in ResetLocked
+    int object_pos_adr_ = -1;
+    int left_gripper_adr_ = -1;
+    int right_gripper_adr_ = -1;
+    int target_pos_adr_ = -1;
+    int finger_body_id_[4] = {-1, -1, -1, -1};
+    int object_body_id_ = -1;
+    int target_orient_body_id_ = -1;
   };
 
   Reorient() : residual_(this) {}
   void TransitionLocked(mjModel* model, mjData* data) override;
 
  protected:
+  void ResetLocked(const mjModel* model) override;
   std::unique_ptr<mjpc::ResidualFn> ResidualLocked() const override {
-    return std::make_unique<ResidualFn>(this);
+    return std::make_unique<ResidualFn>(residual_);
   }
   ResidualFn* InternalResidual() override { return &residual_; }
   double last_solve_time = 0;
@@ -38,6 +38,7 @@ class Cartpole : public Task {
     // ------------------------------------------
     void Residual(const mjModel* model, const mjData* data,
                   double* residual) const override;
+    bool ReadsSensorData() const override { return false; }
   };
 
   Cartpole() : residual_(this) {}
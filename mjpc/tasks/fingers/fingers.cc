@@ -32,19 +32,18 @@ void Fingers::ResidualFn::Residual(const mjModel* model, const mjData* data,
   int counter = 0;
 
   // reach
-  double* finger_a = SensorByName(model, data, "finger_a");
-  double* box = SensorByName(model, data, "object");
+  double* finger_a = data->sensordata + finger_a_adr_;
+  double* box = data->sensordata + object_adr_;
   mju_sub3(residual + counter, finger_a, box);
   counter += 3;
-  double* finger_b = SensorByName(model, data, "finger_b");
+  double* finger_b = data->sensordata + finger_b_adr_;
   mju_sub3(residual + counter, finger_b, box);
   counter += 3;
 
   // bring
-  for (int i=0; i < 3; i++) {
-    double* object = SensorByName(model, data, std::to_string(i).c_str());
-    double* target = SensorByName(model, data,
-                                        (std::to_string(i) + "t").c_str());
+  for (int i=0; i < kNumObject; i++) {
+    double* object = data->sensordata + object_i_adr_[i];
+    double* target = data->sensordata + target_i_adr_[i];
     residual[counter++] = mju_dist3(object, target);
   }
 
@@ -55,4 +54,15 @@ void Fingers::ResidualFn::Residual(const mjModel* model, const mjData* data,
 
   CheckSensorDim(model, counter);
 }
+void Fingers::ResetLocked(const mjModel* model) {
+  residual_.finger_a_adr_ = SensorAdrByName(model, "finger_a");
+  residual_.object_adr_ = SensorAdrByName(model, "object");
+  residual_.finger_b_adr_ = SensorAdrByName(model, "finger_b");
+  for (int i = 0; i < ResidualFn::kNumObject; i++) {
+    residual_.object_i_adr_[i] = SensorAdrByName(model, std::to_string(i));
+    residual_.target_i_adr_[i] =
+        SensorAdrByName(model, std::to_string(i) + "t");
+  }
+}
+
 }  // namespace mjpc
@@ -30,13 +30,27 @@ class Fingers : public Task {
     explicit ResidualFn(const Fingers* task) : mjpc::BaseResidualFn(task) {}
     void Residual(const mjModel* model, const mjData* data,
                   double* residual) const override;
+
+    // number of objects brought to targets
+    static constexpr int kNumObject = 3;
+
+   private:
+    friend class Fingers;
+
+    // sensor addresses, resolved in ResetLocked
+    int finger_a_adr_ = -1;
+    int object_adr_ = -1;
+    int finger_b_adr_ = -1;
+    int object_i_adr_[kNumObject];
+    int target_i_adr_[kNumObject];
   };
   Fingers() : residual_(this) {}
 
  protected:
   std::unique_ptr<mjpc::ResidualFn> ResidualLocked() const override {
-    return std::make_unique<ResidualFn>(this);
+    return std::make_unique<ResidualFn>(residual_);
   }
+  void ResetLocked(const mjModel* model) override;
   ResidualFn* InternalResidual() override { return &residual_; }
 
  private:
@@ -27,10 +27,9 @@ std::string Interact::Name() const { return "Humanoid Interact"; }
 
 // ------------------ Residuals for humanoid contact keyframes task ------------
 void Interact::ResidualFn::UpResidual(const mjModel* model, const mjData* data,
-                                      double* residual, std::string&& name,
+                                      double* residual, int up_adr,
                                       int* counter) const {
-  name.append("_up");
-  double* up_vector = SensorByName(model, data, name);
+  double* up_vector = data->sensordata + up_adr;
   residual[(*counter)++] = mju_abs(up_vector[2] - 1.0);
 }
 
@@ -38,7 +37,7 @@ void Interact::ResidualFn::HeadHeightResidual(const mjModel* model,
                                               const mjData* data,
                                               double* residual,
                                               int* counter) const {
-  double head_height = SensorByName(model, data, "head_position")[2];
+  double head_height = data->sensordata[head_position_adr_ + 2];
   residual[(*counter)++] =
       mju_abs(head_height - parameters_[kHeadHeightParameterIndex]);
 }
@@ -47,7 +46,7 @@ void Interact::ResidualFn::TorsoHeightResidual(const mjModel* model,
                                                const mjData* data,
                                                double* residual,
                                                int* counter) const {
-  double torso_height = SensorByName(model, data, "torso_position")[2];
+  double torso_height = data->sensordata[torso_position_adr_ + 2];
   residual[(*counter)++] =
       mju_abs(torso_height - parameters_[kTorsoHeightParameterIndex]);
 }
@@ -56,10 +55,10 @@ void Interact::ResidualFn::KneeFeetXYResidual(const mjModel* model,
                                               const mjData* data,
                                               double* residual,
                                               int* counter) const {
-  double* knee_right = SensorByName(model, data, "knee_right");
-  double* knee_left = SensorByName(model, data, "knee_left");
-  double* foot_right = SensorByName(model, data, "foot_right");
-  double* foot_left = SensorByName(model, data, "foot_left");
+  double* knee_right = data->sensordata + knee_right_adr_;
+  double* knee_left = data->sensordata + knee_left_adr_;
+  double* foot_right = data->sensordata + foot_right_adr_;
+  double* foot_left = data->sensordata + foot_left_adr_;
 
   double knee_xy_avg[2] = {0.0};
   mju_addTo(knee_xy_avg, knee_left, 2);
@@ -79,9 +78,9 @@ void Interact::ResidualFn::COMFeetXYResidual(const mjModel* model,
                                              const mjData* data,
                                              double* residual,
                                              int* counter) const {
-  double* foot_right = SensorByName(model, data, "foot_right");
-  double* foot_left = SensorByName(model, data, "foot_left");
-  double* com_position = SensorByName(model, data, "torso_subtreecom");
+  double* foot_right = data->sensordata + foot_right_adr_;
+  double* foot_left = data->sensordata + foot_left_adr_;
+  double* com_position = data->sensordata + torso_subtreecom_adr_;
 
   double foot_xy_avg[2] = {0.0};
   mju_addTo(foot_xy_avg, foot_left, 2);
@@ -101,8 +100,8 @@ void Interact::ResidualFn::FacingDirectionResidual(const mjModel* model,
     return;
   }
 
-  double* torso_forward = SensorByName(model, data, "torso_forward");
-  double* torso_position = mjpc::SensorByName(model, data, "torso_position");
+  double* torso_forward = data->sensordata + torso_forward_adr_;
+  double* torso_position = data->sensordata + torso_position_adr_;
   double target[2] = {0.};
 
   mju_sub(target, residual_keyframe_.facing_target.data(), torso_position, 2);
@@ -165,13 +164,13 @@ void Interact::ResidualFn::Residual(const mjModel* model, const mjData* data,
                                     double* residual) const {
   int counter = 0;
 
-  double* com_velocity = SensorByName(model, data, "torso_subtreelinvel");
+  double* com_velocity = data->sensordata + torso_subtreelinvel_adr_;
 
   // ----- task-specific residual terms ------ //
-  UpResidual(model, data, residual, "torso", &counter);
-  UpResidual(model, data, residual, "pelvis", &counter);
-  UpResidual(model, data, residual, "foot_right", &counter);
-  UpResidual(model, data, residual, "foot_left", &counter);
+  UpResidual(model, data, residual, torso_up_adr_, &counter);
+  UpResidual(model, data, residual, pelvis_up_adr_, &counter);
+  UpResidual(model, data, residual, foot_right_up_adr_, &counter);
+  UpResidual(model, data, residual, foot_left_up_adr_, &counter);
   HeadHeightResidual(model, data, residual, &counter);
   TorsoHeightResidual(model, data, residual, &counter);
   KneeFeetXYResidual(model, data, residual, &counter);
@@ -240,4 +239,21 @@ void Interact::ModifyScene(const mjModel* model, const mjData* data,
   }
 }
 
+void Interact::ResetLocked(const mjModel* model) {
+  residual_.torso_up_adr_ = SensorAdrByName(model, "torso_up");
+  residual_.pelvis_up_adr_ = SensorAdrByName(model, "pelvis_up");
+  residual_.foot_right_up_adr_ = SensorAdrByName(model, "foot_right_up");
+  residual_.foot_left_up_adr_ = SensorAdrByName(model, "foot_left_up");
+  residual_.head_position_adr_ = SensorAdrByName(model, "head_position");
+  residual_.torso_position_adr_ = SensorAdrByName(model, "torso_position");
+  residual_.knee_right_adr_ = SensorAdrByName(model, "knee_right");
+  residual_.knee_left_adr_ = SensorAdrByName(model, "knee_left");
+  residual_.foot_right_adr_ = SensorAdrByName(model, "foot_right");
+  residual_.foot_left_adr_ = SensorAdrByName(model, "foot_left");
+  residual_.torso_subtreecom_adr_ = SensorAdrByName(model, "torso_subtreecom");
+  residual_.torso_forward_adr_ = SensorAdrByName(model, "torso_forward");
+  residual_.torso_subtreelinvel_adr_ =
+      SensorAdrByName(model, "torso_subtreelinvel");
+}
+
 }  // namespace mjpc::humanoid
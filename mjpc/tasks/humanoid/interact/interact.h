@@ -80,7 +80,7 @@ class Interact : public Task {
     TaskMode current_task_mode_;
 
     void UpResidual(const mjModel* model, const mjData* data, double* residual,
-                    std::string&& name, int* counter) const;
+                    int up_adr, int* counter) const;
 
     void HeadHeightResidual(const mjModel* model, const mjData* data,
                             double* residual, int* counter) const;
@@ -102,6 +102,21 @@ class Interact : public Task {
 
     void ContactResidual(const mjModel* model, const mjData* data,
                          double* residual, int* counter) const;
+
+    // sensor addresses, resolved in ResetLocked
+    int torso_up_adr_ = -1;
+    int pelvis_up_adr_ = -1;
+    int foot_right_up_adr_ = -1;
+    int foot_left_up_adr_ = -1;
+    int head_position_adr_ = -1;
+    int torso_position_adr_ = -1;
+    int knee_right_adr_ = -1;
+    int knee_left_adr_ = -1;
+    int foot_right_adr_ = -1;
+    int foot_left_adr_ = -1;
+    int torso_subtreecom_adr_ = -1;
+    int torso_forward_adr_ = -1;
+    int torso_subtreelinvel_adr_ = -1;
   };
 
   Interact() : residual_(this) {}
@@ -113,9 +128,9 @@ class Interact : public Task {
 
  protected:
   std::unique_ptr<mjpc::ResidualFn> ResidualLocked() const override {
-    return std::make_unique<ResidualFn>(this, residual_.residual_keyframe_,
-                                        residual_.current_task_mode_);
+    return std::make_unique<ResidualFn>(residual_);
   }
+  void ResetLocked(const mjModel* model) override;
   ResidualFn* InternalResidual() override { return &residual_; }
 
  private:
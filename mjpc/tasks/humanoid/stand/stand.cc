@@ -44,11 +44,11 @@ void Stand::ResidualFn::Residual(const mjModel* model, const mjData* data,
   // ----- Height: head feet vertical error ----- //
 
   // feet sensor positions
-  double* f1_position = SensorByName(model, data, "sp0");
-  double* f2_position = SensorByName(model, data, "sp1");
-  double* f3_position = SensorByName(model, data, "sp2");
-  double* f4_position = SensorByName(model, data, "sp3");
-  double* head_position = SensorByName(model, data, "head_position");
+  double* f1_position = data->sensordata + sp0_adr_;
+  double* f2_position = data->sensordata + sp1_adr_;
+  double* f3_position = data->sensordata + sp2_adr_;
+  double* f4_position = data->sensordata + sp3_adr_;
+  double* head_position = data->sensordata + head_position_adr_;
   double head_feet_error =
       head_position[2] - 0.25 * (f1_position[2] + f2_position[2] +
                                  f3_position[2] + f4_position[2]);
@@ -57,8 +57,8 @@ void Stand::ResidualFn::Residual(const mjModel* model, const mjData* data,
   // ----- Balance: CoM-feet xy error ----- //
 
   // capture point
-  double* com_position = SensorByName(model, data, "torso_subtreecom");
-  double* com_velocity = SensorByName(model, data, "torso_subtreelinvel");
+  double* com_position = data->sensordata + torso_subtreecom_adr_;
+  double* com_velocity = data->sensordata + torso_subtreelinvel_adr_;
   double kFallTime = 0.2;
   double capture_point[3] = {com_position[0], com_position[1], com_position[2]};
   mju_addToScl3(capture_point, com_velocity, kFallTime);
@@ -103,4 +103,15 @@ void Stand::ResidualFn::Residual(const mjModel* model, const mjData* data,
   }
 }
 
+void Stand::ResetLocked(const mjModel* model) {
+  residual_.sp0_adr_ = SensorAdrByName(model, "sp0");
+  residual_.sp1_adr_ = SensorAdrByName(model, "sp1");
+  residual_.sp2_adr_ = SensorAdrByName(model, "sp2");
+  residual_.sp3_adr_ = SensorAdrByName(model, "sp3");
+  residual_.head_position_adr_ = SensorAdrByName(model, "head_position");
+  residual_.torso_subtreecom_adr_ = SensorAdrByName(model, "torso_subtreecom");
+  residual_.torso_subtreelinvel_adr_ =
+      SensorAdrByName(model, "torso_subtreelinvel");
+}
+
 }  // namespace mjpc::humanoid
@@ -42,6 +42,18 @@ class Stand : public Task {
     // ----------------------------------------------------------------
     void Residual(const mjModel* model, const mjData* data,
                   double* residual) const override;
+
+   private:
+    friend class Stand;
+
+    // sensor addresses, resolved in ResetLocked
+    int sp0_adr_ = -1;
+    int sp1_adr_ = -1;
+    int sp2_adr_ = -1;
+    int sp3_adr_ = -1;
+    int head_position_adr_ = -1;
+    int torso_subtreecom_adr_ = -1;
+    int torso_subtreelinvel_adr_ = -1;
   };
 
   Stand() : residual_(this) {}
@@ -51,8 +63,9 @@ class Stand : public Task {
 
  protected:
   std::unique_ptr<mjpc::ResidualFn> ResidualLocked() const override {
-    return std::make_unique<ResidualFn>(this);
+    return std::make_unique<ResidualFn>(residual_);
   }
+  void ResetLocked(const mjModel* model) override;
   ResidualFn* InternalResidual() override { return &residual_; }
 
  private:
@@ -16,7 +16,6 @@
 
 #include <algorithm>
 #include <array>
-#include <cassert>
 #include <cmath>
 #include <string>
 #include <tuple>
@@ -66,7 +65,8 @@ int MotionStartIndex(int id) {
 }
 
 // names for humanoid bodies
-const std::array<std::string, 16> body_names = {
+const std::array<std::string, mjpc::humanoid::Tracking::ResidualFn::kNumBody>
+    body_names = {
     "pelvis",    "head",      "ltoe",  "rtoe",  "lheel",  "rheel",
     "lknee",     "rknee",     "lhand", "rhand", "lelbow", "relbow",
     "lshoulder", "rshoulder", "lhip",  "rhip",
@@ -122,12 +122,8 @@ void Tracking::ResidualFn::Residual(const mjModel *model, const mjData *data,
 
   // ----- position ----- //
   // Compute interpolated frame.
-  auto get_body_mpos = [&](const std::string &body_name, double result[3]) {
-    std::string mocap_body_name = "mocap[" + body_name + "]";
-    int mocap_body_id = mj_name2id(model, mjOBJ_BODY, mocap_body_name.c_str());
-    assert(0 <= mocap_body_id);
-    int body_mocapid = model->body_mocapid[mocap_body_id];
-    assert(0 <= body_mocapid);
+  auto get_body_mpos = [&](int body, double result[3]) {
+    int body_mocapid = body_mocap_id_[body];
 
     // current frame
     mju_scl3(
@@ -142,23 +138,20 @@ void Tracking::ResidualFn::Residual(const mjModel *model, const mjData *data,
         weight_1);
   };
 
-  auto get_body_sensor_pos = [&](const std::string &body_name,
-                                 double result[3]) {
-    std::string pos_sensor_name = "tracking_pos[" + body_name + "]";
-    double *sensor_pos = SensorByName(model, data, pos_sensor_name.c_str());
-    mju_copy3(result, sensor_pos);
+  auto get_body_sensor_pos = [&](int body, double result[3]) {
+    mju_copy3(result, data->sensordata + pos_sensor_adr_[body]);
   };
 
   // compute marker and sensor averages
   double avg_mpos[3] = {0};
   double avg_sensor_pos[3] = {0};
   int num_body = 0;
-  for (const auto &body_name : body_names) {
+  for (int body = 0; body < kNumBody; body++) {
     double body_mpos[3];
     double body_sensor_pos[3];
-    get_body_mpos(body_name, body_mpos);
+    get_body_mpos(body, body_mpos);
     mju_addTo3(avg_mpos, body_mpos);
-    get_body_sensor_pos(body_name, body_sensor_pos);
+    get_body_sensor_pos(body, body_sensor_pos);
     mju_addTo3(avg_sensor_pos, body_sensor_pos);
     num_body++;
   }
@@ -169,13 +162,13 @@ void Tracking::ResidualFn::Residual(const mjModel *model, const mjData *data,
   mju_sub3(&residual[counter], avg_mpos, avg_sensor_pos);
   counter += 3;
 
-  for (const auto &body_name : body_names) {
+  for (int body = 0; body < kNumBody; body++) {
     double body_mpos[3];
-    get_body_mpos(body_name, body_mpos);
+    get_body_mpos(body, body_mpos);
 
     // current position
     double body_sensor_pos[3];
-    get_body_sensor_pos(body_name, body_sensor_pos);
+    get_body_sensor_pos(body, body_sensor_pos);
 
     mju_subFrom3(body_mpos, avg_mpos);
     mju_subFrom3(body_sensor_pos, avg_sensor_pos);
@@ -186,13 +179,8 @@ void Tracking::ResidualFn::Residual(const mjModel *model, const mjData *data,
   }
 
   // ----- velocity ----- //
-  for (const auto &body_name : body_names) {
-    std::string mocap_body_name = "mocap[" + body_name + "]";
-    std::string linvel_sensor_name = "tracking_linvel[" + body_name + "]";
-    int mocap_body_id = mj_name2id(model, mjOBJ_BODY, mocap_body_name.c_str());
-    assert(0 <= mocap_body_id);
-    int body_mocapid = model->body_mocapid[mocap_body_id];
-    assert(0 <= body_mocapid);
+  for (int body = 0; body < kNumBody; body++) {
+    int body_mocapid = body_mocap_id_[body];
 
     // compute finite-difference velocity
     mju_copy3(
@@ -204,9 +192,8 @@ void Tracking::ResidualFn::Residual(const mjModel *model, const mjData *data,
     mju_scl3(&residual[counter], &residual[counter], kFps);
 
     // subtract current velocity
-    double *sensor_linvel =
-        SensorByName(model, data, linvel_sensor_name.c_str());
-    mju_subFrom3(&residual[counter], sensor_linvel);
+    mju_subFrom3(&residual[counter],
+                 data->sensordata + linvel_sensor_adr_[body]);
 
     counter += 3;
   }
@@ -266,4 +253,29 @@ void Tracking::TransitionLocked(mjModel *model, mjData *d) {
   mj_freeStack(d);
 }
 
+// resolve mocap bodies and tracking sensors by name
+void Tracking::ResetLocked(const mjModel *model) {
+  for (int body = 0; body < ResidualFn::kNumBody; body++) {
+    const std::string &body_name = body_names[body];
+
+    // mocap body
+    std::string mocap_body_name = "mocap[" + body_name + "]";
+    int mocap_body_id = mj_name2id(model, mjOBJ_BODY, mocap_body_name.c_str());
+    if (mocap_body_id < 0) {
+      mju_error_s("body '%s' not found", mocap_body_name.c_str());
+    }
+    residual_.body_mocap_id_[body] = model->body_mocapid[mocap_body_id];
+    if (residual_.body_mocap_id_[body] < 0) {
+      mju_error_s("body '%s' is not mocap", mocap_body_name.c_str());
+    }
+
+    // sensors
+    std::string pos_sensor_name = "tracking_pos[" + body_name + "]";
+    residual_.pos_sensor_adr_[body] = SensorAdrByName(model, pos_sensor_name);
+    std::string linvel_sensor_name = "tracking_linvel[" + body_name + "]";
+    residual_.linvel_sensor_adr_[body] =
+        SensorAdrByName(model, linvel_sensor_name);
+  }
+}
+
 }  // namespace mjpc::humanoid
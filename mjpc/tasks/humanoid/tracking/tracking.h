@@ -43,10 +43,18 @@ class Tracking : public Task {
     // ----------------------------------------------------------------
     void Residual(const mjModel* model, const mjData* data,
                   double* residual) const override;
+    // number of tracked bodies
+    static constexpr int kNumBody = 16;
+
    private:
     friend class Tracking;
     int current_mode_;
     double reference_time_;
+
+    // model handles, resolved in ResetLocked
+    int body_mocap_id_[kNumBody];
+    int pos_sensor_adr_[kNumBody];
+    int linvel_sensor_adr_[kNumBody];
   };
 
   Tracking() : residual_(this) {}
@@ -58,13 +66,15 @@ class Tracking : public Task {
   // ---------------------------------------------------------------------------
   void TransitionLocked(mjModel* model, mjData* data) override;
 
+  // resolve mocap bodies and tracking sensors by name
+  void ResetLocked(const mjModel* model) override;
+
   std::string Name() const override;
   std::string XmlPath() const override;
 
  protected:
   std::unique_ptr<mjpc::ResidualFn> ResidualLocked() const override {
-    return std::make_unique<ResidualFn>(this, residual_.current_mode_,
-                                        residual_.reference_time_);
+    return std::make_unique<ResidualFn>(residual_);
   }
   ResidualFn* InternalResidual() override { return &residual_; }
 
@@ -46,20 +46,20 @@ void Walk::ResidualFn::Residual(const mjModel* model, const mjData* data,
   int counter = 0;
 
   // ----- torso height ----- //
-  double torso_height = SensorByName(model, data, "torso_position")[2];
+  double torso_height = data->sensordata[torso_position_adr_ + 2];
   residual[counter++] = torso_height - parameters_[0];
 
   // ----- pelvis / feet ----- //
-  double* foot_right = SensorByName(model, data, "foot_right");
-  double* foot_left = SensorByName(model, data, "foot_left");
-  double pelvis_height = SensorByName(model, data, "pelvis_position")[2];
+  double* foot_right = data->sensordata + foot_right_adr_;
+  double* foot_left = data->sensordata + foot_left_adr_;
+  double pelvis_height = data->sensordata[pelvis_position_adr_ + 2];
   residual[counter++] =
       0.5 * (foot_left[2] + foot_right[2]) - pelvis_height - 0.2;
 
   // ----- balance ----- //
   // capture point
-  double* subcom = SensorByName(model, data, "torso_subcom");
-  double* subcomvel = SensorByName(model, data, "torso_subcomvel");
+  double* subcom = data->sensordata + torso_subcom_adr_;
+  double* subcomvel = data->sensordata + torso_subcomvel_adr_;
 
   double capture_point[3];
   mju_addScl(capture_point, subcom, subcomvel, 0.3, 3);
@@ -97,10 +97,10 @@ void Walk::ResidualFn::Residual(const mjModel* model, const mjData* data,
   counter += 2;
 
   // ----- upright ----- //
-  double* torso_up = SensorByName(model, data, "torso_up");
-  double* pelvis_up = SensorByName(model, data, "pelvis_up");
-  double* foot_right_up = SensorByName(model, data, "foot_right_up");
-  double* foot_left_up = SensorByName(model, data, "foot_left_up");
+  double* torso_up = data->sensordata + torso_up_adr_;
+  double* pelvis_up = data->sensordata + pelvis_up_adr_;
+  double* foot_right_up = data->sensordata + foot_right_up_adr_;
+  double* foot_left_up = data->sensordata + foot_left_up_adr_;
   double z_ref[3] = {0.0, 0.0, 1.0};
 
   // torso
@@ -123,10 +123,10 @@ void Walk::ResidualFn::Residual(const mjModel* model, const mjData* data,
   counter += model->nq - 7;
 
   // ----- walk ----- //
-  double* torso_forward = SensorByName(model, data, "torso_forward");
-  double* pelvis_forward = SensorByName(model, data, "pelvis_forward");
-  double* foot_right_forward = SensorByName(model, data, "foot_right_forward");
-  double* foot_left_forward = SensorByName(model, data, "foot_left_forward");
+  double* torso_forward = data->sensordata + torso_forward_adr_;
+  double* pelvis_forward = data->sensordata + pelvis_forward_adr_;
+  double* foot_right_forward = data->sensordata + foot_right_forward_adr_;
+  double* foot_left_forward = data->sensordata + foot_left_forward_adr_;
 
   double forward[2];
   mju_copy(forward, torso_forward, 2);
@@ -136,9 +136,8 @@ void Walk::ResidualFn::Residual(const mjModel* model, const mjData* data,
   mju_normalize(forward, 2);
 
   // com vel
-  double* waist_lower_subcomvel =
-      SensorByName(model, data, "waist_lower_subcomvel");
-  double* torso_velocity = SensorByName(model, data, "torso_velocity");
+  double* waist_lower_subcomvel = data->sensordata + waist_lower_subcomvel_adr_;
+  double* torso_velocity = data->sensordata + torso_velocity_adr_;
   double com_vel[2];
   mju_add(com_vel, waist_lower_subcomvel, torso_velocity, 2);
   mju_scl(com_vel, com_vel, 0.5, 2);
@@ -148,8 +147,8 @@ void Walk::ResidualFn::Residual(const mjModel* model, const mjData* data,
       standing * (mju_dot(com_vel, forward, 2) - parameters_[1]);
 
   // ----- move feet ----- //
-  double* foot_right_vel = SensorByName(model, data, "foot_right_velocity");
-  double* foot_left_vel = SensorByName(model, data, "foot_left_velocity");
+  double* foot_right_vel = data->sensordata + foot_right_velocity_adr_;
+  double* foot_left_vel = data->sensordata + foot_left_velocity_adr_;
   double move_feet[2];
   mju_copy(move_feet, com_vel, 2);
   mju_addToScl(move_feet, foot_right_vel, -0.5, 2);
@@ -179,4 +178,30 @@ void Walk::ResidualFn::Residual(const mjModel* model, const mjData* data,
   }
 }
 
+void Walk::ResetLocked(const mjModel* model) {
+  residual_.torso_position_adr_ = SensorAdrByName(model, "torso_position");
+  residual_.foot_right_adr_ = SensorAdrByName(model, "foot_right");
+  residual_.foot_left_adr_ = SensorAdrByName(model, "foot_left");
+  residual_.pelvis_position_adr_ = SensorAdrByName(model, "pelvis_position");
+  residual_.torso_subcom_adr_ = SensorAdrByName(model, "torso_subcom");
+  residual_.torso_subcomvel_adr_ = SensorAdrByName(model, "torso_subcomvel");
+  residual_.torso_up_adr_ = SensorAdrByName(model, "torso_up");
+  residual_.pelvis_up_adr_ = SensorAdrByName(model, "pelvis_up");
+  residual_.foot_right_up_adr_ = SensorAdrByName(model, "foot_right_up");
+  residual_.foot_left_up_adr_ = SensorAdrByName(model, "foot_left_up");
+  residual_.torso_forward_adr_ = SensorAdrByName(model, "torso_forward");
+  residual_.pelvis_forward_adr_ = SensorAdrByName(model, "pelvis_forward");
+  residual_.foot_right_forward_adr_ =
+      SensorAdrByName(model, "foot_right_forward");
+  residual_.foot_left_forward_adr_ =
+      SensorAdrByName(model, "foot_left_forward");
+  residual_.waist_lower_subcomvel_adr_ =
+      SensorAdrByName(model, "waist_lower_subcomvel");
+  residual_.torso_velocity_adr_ = SensorAdrByName(model, "torso_velocity");
+  residual_.foot_right_velocity_adr_ =
+      SensorAdrByName(model, "foot_right_velocity");
+  residual_.foot_left_velocity_adr_ =
+      SensorAdrByName(model, "foot_left_velocity");
+}
+
 }  // namespace mjpc::humanoid
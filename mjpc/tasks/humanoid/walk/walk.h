@@ -43,6 +43,29 @@ class Walk : public Task {
     // ----------------------------------------------------------------
     void Residual(const mjModel* model, const mjData* data,
                   double* residual) const override;
+
+   private:
+    friend class Walk;
+
+    // sensor addresses, resolved in ResetLocked
+    int torso_position_adr_ = -1;
+    int foot_right_adr_ = -1;
+    int foot_left_adr_ = -1;
+    int pelvis_position_adr_ = -1;
+    int torso_subcom_adr_ = -1;
+    int torso_subcomvel_adr_ = -1;
+    int torso_up_adr_ = -1;
+    int pelvis_up_adr_ = -1;
+    int foot_right_up_adr_ = -1;
+    int foot_left_up_adr_ = -1;
+    int torso_forward_adr_ = -1;
+    int pelvis_forward_adr_ = -1;
+    int foot_right_forward_adr_ = -1;
+    int foot_left_forward_adr_ = -1;
+    int waist_lower_subcomvel_adr_ = -1;
+    int torso_velocity_adr_ = -1;
+    int foot_right_velocity_adr_ = -1;
+    int foot_left_velocity_adr_ = -1;
   };
 
   Walk() : residual_(this) {}
@@ -52,8 +75,9 @@ class Walk : public Task {
 
  protected:
   std::unique_ptr<mjpc::ResidualFn> ResidualLocked() const override {
-    return std::make_unique<ResidualFn>(this);
+    return std::make_unique<ResidualFn>(residual_);
   }
+  void ResetLocked(const mjModel* model) override;
   ResidualFn* InternalResidual() override { return &residual_; }
 
  private:
@@ -37,21 +37,19 @@ void manipulation::Bring::ResidualFn::Residual(const mjModel* model,
   double hand[3] = {0};
   ComputeRobotiqHandPos(model, data, model_vals_, hand);
 
-  double* object = SensorByName(model, data, "object");
+  double* object = data->sensordata + object_adr_;
   mju_sub3(residual + counter, hand, object);
   counter += 3;
 
   // bring
-  for (int i=0; i < 8; i++) {
-    double* object = SensorByName(model, data, std::to_string(i).c_str());
-    double* target = SensorByName(model, data,
-                                        (std::to_string(i) + "t").c_str());
+  for (int i=0; i < kNumPoint; i++) {
+    double* object = data->sensordata + point_adr_[i];
+    double* target = data->sensordata + point_target_adr_[i];
     residual[counter++] = mju_dist3(object, target);
   }
 
   // careful
-  int object_id = mj_name2id(model, mjOBJ_BODY, "object");
-  residual[counter++] = CarefulCost(model, data, model_vals_, object_id);
+  residual[counter++] = CarefulCost(model, data, model_vals_, object_body_id_);
 
   // away
   residual[counter++] = mju_min(0, hand[2] - 0.6);
@@ -99,5 +97,14 @@ void manipulation::Bring::TransitionLocked(mjModel* model, mjData* data) {
 
 void manipulation::Bring::ResetLocked(const mjModel* model) {
   residual_.model_vals_ = ModelValues::FromModel(model);
+
+  // ----------  sensor addresses  ----------
+  residual_.object_adr_ = SensorAdrByName(model, "object");
+  for (int i = 0; i < ResidualFn::kNumPoint; i++) {
+    std::string name = std::to_string(i);
+    residual_.point_adr_[i] = SensorAdrByName(model, name);
+    residual_.point_target_adr_[i] = SensorAdrByName(model, name + "t");
+  }
+  residual_.object_body_id_ = mj_name2id(model, mjOBJ_BODY, "object");
 }
 }  // namespace mjpc
@@ -35,6 +35,13 @@ class Bring : public Task {
    private:
     friend class Bring;
     ModelValues model_vals_;
+
+    // sensor addresses and body id, resolved in ResetLocked
+    static constexpr int kNumPoint = 8;
+    int object_adr_ = -1;
+    int point_adr_[kNumPoint];
+    int point_target_adr_[kNumPoint];
+    int object_body_id_ = -1;
   };
 
   Bring() : residual_(this, ModelValues()) {}
@@ -43,7 +50,7 @@ class Bring : public Task {
 
  protected:
   std::unique_ptr<mjpc::ResidualFn> ResidualLocked() const override {
-    return std::make_unique<ResidualFn>(this, residual_.model_vals_);
+    return std::make_unique<ResidualFn>(residual_);
   }
   ResidualFn* InternalResidual() override { return &residual_; }
 
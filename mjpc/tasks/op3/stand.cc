@@ -40,20 +40,18 @@ void OP3::ResidualFn::Residual(const mjModel* model, const mjData* data,
   int mode = current_mode_;
 
   // ----- sensors ------ //
-  double* head_position = SensorByName(model, data, "head_position");
-  double* left_foot_position = SensorByName(model, data, "left_foot_position");
-  double* right_foot_position =
-      SensorByName(model, data, "right_foot_position");
-  double* left_hand_position = SensorByName(model, data, "left_hand_position");
-  double* right_hand_position =
-      SensorByName(model, data, "right_hand_position");
-  double* torso_up = SensorByName(model, data, "torso_up");
-  double* hand_right_up = SensorByName(model, data, "hand_right_up");
-  double* hand_left_up = SensorByName(model, data, "hand_left_up");
-  double* foot_right_up = SensorByName(model, data, "foot_right_up");
-  double* foot_left_up = SensorByName(model, data, "foot_left_up");
-  double* com_position = SensorByName(model, data, "body_subtreecom");
-  double* com_velocity = SensorByName(model, data, "body_subtreelinvel");
+  double* head_position = data->sensordata + head_position_adr_;
+  double* left_foot_position = data->sensordata + left_foot_position_adr_;
+  double* right_foot_position = data->sensordata + right_foot_position_adr_;
+  double* left_hand_position = data->sensordata + left_hand_position_adr_;
+  double* right_hand_position = data->sensordata + right_hand_position_adr_;
+  double* torso_up = data->sensordata + torso_up_adr_;
+  double* hand_right_up = data->sensordata + hand_right_up_adr_;
+  double* hand_left_up = data->sensordata + hand_left_up_adr_;
+  double* foot_right_up = data->sensordata + foot_right_up_adr_;
+  double* foot_left_up = data->sensordata + foot_left_up_adr_;
+  double* com_position = data->sensordata + body_subtreecom_adr_;
+  double* com_velocity = data->sensordata + body_subtreelinvel_adr_;
 
   // ----- Height ----- //
   if (mode == kModeStand) {
@@ -162,4 +160,24 @@ void OP3::TransitionLocked(mjModel* model, mjData* d) {
   }
 }
 
+void OP3::ResetLocked(const mjModel* model) {
+  residual_.head_position_adr_ = SensorAdrByName(model, "head_position");
+  residual_.left_foot_position_adr_ =
+      SensorAdrByName(model, "left_foot_position");
+  residual_.right_foot_position_adr_ =
+      SensorAdrByName(model, "right_foot_position");
+  residual_.left_hand_position_adr_ =
+      SensorAdrByName(model, "left_hand_position");
+  residual_.right_hand_position_adr_ =
+      SensorAdrByName(model, "right_hand_position");
+  residual_.torso_up_adr_ = SensorAdrByName(model, "torso_up");
+  residual_.hand_right_up_adr_ = SensorAdrByName(model, "hand_right_up");
+  residual_.hand_left_up_adr_ = SensorAdrByName(model, "hand_left_up");
+  residual_.foot_right_up_adr_ = SensorAdrByName(model, "foot_right_up");
+  residual_.foot_left_up_adr_ = SensorAdrByName(model, "foot_left_up");
+  residual_.body_subtreecom_adr_ = SensorAdrByName(model, "body_subtreecom");
+  residual_.body_subtreelinvel_adr_ =
+      SensorAdrByName(model, "body_subtreelinvel");
+}
+
 }  // namespace mjpc
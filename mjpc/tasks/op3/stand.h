@@ -52,6 +52,20 @@ class OP3 : public Task {
       kModeStand = 0,
       kModeHandstand,
     };
+
+    // sensor addresses, resolved in ResetLocked
+    int head_position_adr_ = -1;
+    int left_foot_position_adr_ = -1;
+    int right_foot_position_adr_ = -1;
+    int left_hand_position_adr_ = -1;
+    int right_hand_position_adr_ = -1;
+    int torso_up_adr_ = -1;
+    int hand_right_up_adr_ = -1;
+    int hand_left_up_adr_ = -1;
+    int foot_right_up_adr_ = -1;
+    int foot_left_up_adr_ = -1;
+    int body_subtreecom_adr_ = -1;
+    int body_subtreelinvel_adr_ = -1;
   };
 
   OP3() : residual_(this) {}
@@ -62,8 +76,9 @@ class OP3 : public Task {
 
  protected:
   std::unique_ptr<mjpc::ResidualFn> ResidualLocked() const override {
-    return std::make_unique<ResidualFn>(this, residual_.current_mode_);
+    return std::make_unique<ResidualFn>(residual_);
   }
+  void ResetLocked(const mjModel* model) override;
   ResidualFn* InternalResidual() override { return &residual_; }
 
  private:
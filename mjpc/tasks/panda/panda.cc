@@ -40,18 +40,18 @@ void Panda::ResidualFn::Residual(const mjModel* model, const mjData* data,
   int counter = 0;
 
   // reach
-  double* hand = SensorByName(model, data, "hand");
-  double* box = SensorByName(model, data, "box");
+  double* hand = data->sensordata + hand_adr_;
+  double* box = data->sensordata + box_adr_;
   mju_sub3(residual + counter, hand, box);
   counter += 3;
 
   // bring
-  double* box1 = SensorByName(model, data, "box1");
-  double* target1 = SensorByName(model, data, "target1");
+  double* box1 = data->sensordata + box1_adr_;
+  double* target1 = data->sensordata + target1_adr_;
   mju_sub3(residual + counter, box1, target1);
   counter += 3;
-  double* box2 = SensorByName(model, data, "box2");
-  double* target2 = SensorByName(model, data, "target2");
+  double* box2 = data->sensordata + box2_adr_;
+  double* target2 = data->sensordata + target2_adr_;
   mju_sub3(residual + counter, box2, target2);
   counter += 3;
 
@@ -95,4 +95,13 @@ void Panda::TransitionLocked(mjModel* model, mjData* data) {
     mju_normalize4(data->mocap_quat);
   }
 }
+void Panda::ResetLocked(const mjModel* model) {
+  residual_.hand_adr_ = SensorAdrByName(model, "hand");
+  residual_.box_adr_ = SensorAdrByName(model, "box");
+  residual_.box1_adr_ = SensorAdrByName(model, "box1");
+  residual_.target1_adr_ = SensorAdrByName(model, "target1");
+  residual_.box2_adr_ = SensorAdrByName(model, "box2");
+  residual_.target2_adr_ = SensorAdrByName(model, "target2");
+}
+
 }  // namespace mjpc
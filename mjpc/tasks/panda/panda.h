@@ -29,14 +29,26 @@ class Panda : public Task {
     explicit ResidualFn(const Panda* task) : mjpc::BaseResidualFn(task) {}
     void Residual(const mjModel* model, const mjData* data,
                   double* residual) const override;
+
+   private:
+    friend class Panda;
+
+    // sensor addresses, resolved in ResetLocked
+    int hand_adr_ = -1;
+    int box_adr_ = -1;
+    int box1_adr_ = -1;
+    int target1_adr_ = -1;
+    int box2_adr_ = -1;
+    int target2_adr_ = -1;
   };
   Panda() : residual_(this) {}
   void TransitionLocked(mjModel* model, mjData* data) override;
 
  protected:
   std::unique_ptr<mjpc::ResidualFn> ResidualLocked() const override {
-    return std::make_unique<ResidualFn>(this);
+    return std::make_unique<ResidualFn>(residual_);
   }
+  void ResetLocked(const mjModel* model) override;
   ResidualFn* InternalResidual() override { return &residual_; }
 
  private:
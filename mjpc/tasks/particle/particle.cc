@@ -34,14 +34,16 @@ std::string Particle::Name() const { return "Particle"; }
 // --------------------------------------------
 namespace {
 void ResidualImpl(const mjModel* model, const mjData* data,
-                  const double goal[2], double* residual) {
+                  const double goal[2], int tip_id, double* residual) {
   // ----- residual (0) ----- //
-  double* position = SensorByName(model, data, "position");
+  const double* position = data->site_xpos + 3 * tip_id;
   mju_sub(residual, position, goal, model->nq);
 
   // ----- residual (1) ----- //
-  double* velocity = SensorByName(model, data, "velocity");
-  mju_copy(residual + 2, velocity, model->nv);
+  // global frame velocity of the tip, as the framelinvel sensor
+  double velocity[6];
+  mj_objectVelocity(model, data, mjOBJ_SITE, tip_id, velocity, 0);
+  mju_copy(residual + 2, velocity + 3, model->nv);
 
   // ----- residual (2) ----- //
   mju_copy(residual + 4, data->ctrl, model->nu);
@@ -52,7 +54,7 @@ void Particle::ResidualFn::Residual(const mjModel* model, const mjData* data,
                                     double* residual) const {
   // some Lissajous curve
   double goal[2]{0.25 * mju_sin(data->time), 0.25 * mju_cos(data->time / mjPI)};
-  ResidualImpl(model, data, goal, residual);
+  ResidualImpl(model, data, goal, tip_id_, residual);
 }
 
 void Particle::TransitionLocked(mjModel* model, mjData* data) {
@@ -64,6 +66,10 @@ void Particle::TransitionLocked(mjModel* model, mjData* data) {
   data->mocap_pos[1] = goal[1];
 }
 
+void Particle::ResetLocked(const mjModel* model) {
+  residual_.tip_id_ = mj_name2id(model, mjOBJ_SITE, "tip");
+}
+
 std::string ParticleFixed::XmlPath() const {
   return GetModelPath("particle/task_timevarying.xml");
 }
@@ -73,7 +79,11 @@ void ParticleFixed::ResidualFn::Residual(const mjModel* model,
                                          const mjData* data,
                                          double* residual) const {
   double goal[2]{data->mocap_pos[0], data->mocap_pos[1]};
-  ResidualImpl(model, data, goal, residual);
+  ResidualImpl(model, data, goal, tip_id_, residual);
+}
+
+void ParticleFixed::ResetLocked(const mjModel* model) {
+  residual_.tip_id_ = mj_name2id(model, mjOBJ_SITE, "tip");
 }
 
 }  // namespace mjpc
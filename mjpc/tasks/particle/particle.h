@@ -36,14 +36,22 @@ class Particle : public Task {
     // --------------------------------------------
     void Residual(const mjModel* model, const mjData* data,
                   double* residual) const override;
+    bool ReadsSensorData() const override { return false; }
+
+   private:
+    friend class Particle;
+
+    // tip site, resolved in ResetLocked
+    int tip_id_ = -1;
   };
   Particle() : residual_(this) {}
   void TransitionLocked(mjModel* model, mjData* data) override;
 
  protected:
   std::unique_ptr<mjpc::ResidualFn> ResidualLocked() const override {
-    return std::make_unique<ResidualFn>(this);
+    return std::make_unique<ResidualFn>(residual_);
   }
+  void ResetLocked(const mjModel* model) override;
   ResidualFn* InternalResidual() override { return &residual_; }
 
  private:
@@ -67,13 +75,21 @@ class ParticleFixed : public Task {
     // --------------------------------------------
     void Residual(const mjModel* model, const mjData* data,
                   double* residual) const override;
+    bool ReadsSensorData() const override { return false; }
+
+   private:
+    friend class ParticleFixed;
+
+    // tip site, resolved in ResetLocked
+    int tip_id_ = -1;
   };
   ParticleFixed() : residual_(this) {}
 
  protected:
   std::unique_ptr<mjpc::ResidualFn> ResidualLocked() const override {
-    return std::make_unique<ResidualFn>(this);
+    return std::make_unique<ResidualFn>(residual_);
   }
+  void ResetLocked(const mjModel* model) override;
   ResidualFn* InternalResidual() override { return &residual_; }
 
  private:
@@ -37,15 +37,15 @@ std::string Quadrotor::Name() const { return "Quadrotor"; }
 void Quadrotor::ResidualFn::Residual(const mjModel* model, const mjData* data,
                                      double* residuals) const {
   // ---------- Residual (0) ----------
-  double* position = SensorByName(model, data, "position");
+  double* position = data->sensordata + position_adr_;
   mju_sub(residuals, position, data->mocap_pos, 3);
 
   // ---------- Residual (1) ----------
-  double* linear_velocity = SensorByName(model, data, "linear_velocity");
+  double* linear_velocity = data->sensordata + linear_velocity_adr_;
   mju_copy(residuals + 3, linear_velocity, 3);
 
   // ---------- Residual (2) ----------
-  double* angular_velocity = SensorByName(model, data, "angular_velocity");
+  double* angular_velocity = data->sensordata + angular_velocity_adr_;
   mju_copy(residuals + 6, angular_velocity, 3);
 
   // ---------- Residual (3) ----------
@@ -87,4 +87,11 @@ void Quadrotor::TransitionLocked(mjModel* model, mjData* data) {
   mju_copy4(data->mocap_quat, model->key_mquat + 4 * current_mode_);
 }
 
+void Quadrotor::ResetLocked(const mjModel* model) {
+  residual_.position_adr_ = SensorAdrByName(model, "position");
+  residual_.linear_velocity_adr_ = SensorAdrByName(model, "linear_velocity");
+  residual_.angular_velocity_adr_ =
+      SensorAdrByName(model, "angular_velocity");
+}
+
 }  // namespace mjpc
@@ -40,6 +40,14 @@ class Quadrotor : public Task {
     // ------------------------------------------------------------
     void Residual(const mjModel* model, const mjData* data,
                   double* residual) const override;
+
+   private:
+    friend class Quadrotor;
+
+    // sensor addresses, resolved in ResetLocked
+    int position_adr_ = -1;
+    int linear_velocity_adr_ = -1;
+    int angular_velocity_adr_ = -1;
   };
 
   Quadrotor() : residual_(this) {}
@@ -47,8 +55,9 @@ class Quadrotor : public Task {
 
  protected:
   std::unique_ptr<mjpc::ResidualFn> ResidualLocked() const override {
-    return std::make_unique<ResidualFn>(this);
+    return std::make_unique<ResidualFn>(residual_);
   }
+  void ResetLocked(const mjModel* model) override;
   ResidualFn* InternalResidual() override { return &residual_; }
 
  private:
@@ -47,7 +47,7 @@ void QuadrupedFlat::ResidualFn::Residual(const mjModel* model,
 
   double* torso_xmat = data->xmat + 9*torso_body_id_;
   double* goal_pos = data->mocap_pos + 3*goal_mocap_id_;
-  double* compos = SensorByName(model, data, "torso_subtreecom");
+  double* compos = data->sensordata + torso_subtreecom_adr_;
 
 
   // ---------- Upright ----------
@@ -147,7 +147,7 @@ void QuadrupedFlat::ResidualFn::Residual(const mjModel* model,
 
 
   // ---------- Balance ----------
-  double* comvel = SensorByName(model, data, "torso_subtreelinvel");
+  double* comvel = data->sensordata + torso_subtreelinvel_adr_;
   double capture_point[3];
   double fall_time = mju_sqrt(2*height_goal / 9.81);
   mju_addScl3(capture_point, compos, comvel, fall_time);
@@ -161,12 +161,12 @@ void QuadrupedFlat::ResidualFn::Residual(const mjModel* model,
 
 
   // ---------- Posture ----------
-  double* home = KeyQPosByName(model, data, "home");
+  double* home = model->key_qpos + model->nq * home_key_id_;
   mju_sub(residual + counter, data->qpos + 7, home + 7, model->nu);
   if (current_mode_ == kModeFlip) {
     double flip_time = data->time - mode_start_time_;
     if (flip_time < crouch_time_) {
-      double* crouch = KeyQPosByName(model, data, "crouch");
+      double* crouch = model->key_qpos + model->nq * crouch_key_id_;
       mju_sub(residual + counter, data->qpos + 7, crouch + 7, model->nu);
     } else if (flip_time >= crouch_time_ &&
                flip_time < jump_time_ + flight_time_) {
@@ -206,13 +206,13 @@ void QuadrupedFlat::ResidualFn::Residual(const mjModel* model,
     torso_heading[1] = handstand * torso_xmat[5];
   }
   mju_normalize(torso_heading, 2);
-  double heading_goal = parameters_[ParameterIndex(model, "Heading")];
+  double heading_goal = parameters_[heading_param_id_];
   residual[counter++] = torso_heading[0] - mju_cos(heading_goal);
   residual[counter++] = torso_heading[1] - mju_sin(heading_goal);
 
 
   // ---------- Angular momentum ----------
-  mju_copy3(residual + counter, SensorByName(model, data, "torso_angmom"));
+  mju_copy3(residual + counter, data->sensordata + torso_angmom_adr_);
   counter +=3;
 
 
@@ -300,8 +300,8 @@ void QuadrupedFlat::TransitionLocked(mjModel* model, mjData* data) {
   // ---------- Walk ----------
   double* goal_pos = data->mocap_pos + 3*residual_.goal_mocap_id_;
   if (mode == ResidualFn::kModeWalk) {
-    double angvel = parameters[ParameterIndex(model, "Walk turn")];
-    double speed = parameters[ParameterIndex(model, "Walk speed")];
+    double angvel = parameters[residual_.walk_turn_param_id_];
+    double speed = parameters[residual_.walk_speed_param_id_];
 
     // current torso direction
     double* torso_xmat = data->xmat + 9*residual_.torso_body_id_;
@@ -521,6 +521,9 @@ void QuadrupedFlat::ResetLocked(const mjModel* model) {
   residual_.cadence_param_id_ = ParameterIndex(model, "Cadence");
   residual_.amplitude_param_id_ = ParameterIndex(model, "Amplitude");
   residual_.duty_param_id_ = ParameterIndex(model, "Duty ratio");
+  residual_.heading_param_id_ = ParameterIndex(model, "Heading");
+  residual_.walk_turn_param_id_ = ParameterIndex(model, "Walk turn");
+  residual_.walk_speed_param_id_ = ParameterIndex(model, "Walk speed");
   residual_.balance_cost_id_ = CostTermByName(model, "Balance");
   residual_.upright_cost_id_ = CostTermByName(model, "Upright");
   residual_.height_cost_id_ = CostTermByName(model, "Height");
@@ -556,6 +559,18 @@ void QuadrupedFlat::ResetLocked(const mjModel* model) {
     shoulder_index++;
   }
 
+  // ----------  sensor addresses  ----------
+  residual_.torso_subtreecom_adr_ = SensorAdrByName(model, "torso_subtreecom");
+  residual_.torso_subtreelinvel_adr_ =
+      SensorAdrByName(model, "torso_subtreelinvel");
+  residual_.torso_angmom_adr_ = SensorAdrByName(model, "torso_angmom");
+
+  // ----------  keyframe ids  ----------
+  residual_.home_key_id_ = mj_name2id(model, mjOBJ_KEY, "home");
+  if (residual_.home_key_id_ < 0) mju_error("key 'home' not found");
+  residual_.crouch_key_id_ = mj_name2id(model, mjOBJ_KEY, "crouch");
+  if (residual_.crouch_key_id_ < 0) mju_error("key 'crouch' not found");
+
   // ----------  derived kinematic quantities for Flip  ----------
   residual_.gravity_ = mju_norm3(model->opt.gravity);
   // velocity at takeoff
@@ -731,13 +746,13 @@ void QuadrupedHill::ResidualFn::Residual(const mjModel* model,
   double height_goal = parameters_[0];
 
   // system's standing height
-  double standing_height = SensorByName(model, data, "position")[2];
+  double standing_height = data->sensordata[position_adr_ + 2];
 
   // average foot height
-  double FRz = SensorByName(model, data, "FR")[2];
-  double FLz = SensorByName(model, data, "FL")[2];
-  double RRz = SensorByName(model, data, "RR")[2];
-  double RLz = SensorByName(model, data, "RL")[2];
+  double FRz = data->sensordata[foot_adr_[0] + 2];
+  double FLz = data->sensordata[foot_adr_[1] + 2];
+  double RRz = data->sensordata[foot_adr_[2] + 2];
+  double RLz = data->sensordata[foot_adr_[3] + 2];
   double avg_foot_height = 0.25 * (FRz + FLz + RRz + RLz);
 
   residual[0] = (standing_height - avg_foot_height) - height_goal;
@@ -747,7 +762,7 @@ void QuadrupedHill::ResidualFn::Residual(const mjModel* model,
   const double* goal_position = data->mocap_pos;
 
   // system's position
-  double* position = SensorByName(model, data, "position");
+  double* position = data->sensordata + position_adr_;
 
   // position error
   mju_sub3(residual + 1, position, goal_position);
@@ -760,7 +775,7 @@ void QuadrupedHill::ResidualFn::Residual(const mjModel* model,
 
   // system's orientation
   double body_rotmat[9];
-  double* orientation = SensorByName(model, data, "orientation");
+  double* orientation = data->sensordata + orientation_adr_;
   mju_quat2Mat(body_rotmat, orientation);
 
   mju_sub(residual + 4, body_rotmat, goal_rotmat, 9);
@@ -816,4 +831,13 @@ void QuadrupedHill::TransitionLocked(mjModel* model, mjData* data) {
   mju_copy4(data->mocap_quat, model->key_mquat + 4 * residual_.current_mode_);
 }
 
+void QuadrupedHill::ResetLocked(const mjModel* model) {
+  residual_.position_adr_ = SensorAdrByName(model, "position");
+  residual_.orientation_adr_ = SensorAdrByName(model, "orientation");
+  int foot_index = 0;
+  for (const char* footname : {"FR", "FL", "RR", "RL"}) {
+    residual_.foot_adr_[foot_index++] = SensorAdrByName(model, footname);
+  }
+}
+
 }  // namespace mjpc
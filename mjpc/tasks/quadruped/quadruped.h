@@ -203,11 +203,19 @@ class QuadrupedFlat : public Task {
     int cadence_param_id_     = -1;
     int amplitude_param_id_   = -1;
     int duty_param_id_        = -1;
+    int heading_param_id_     = -1;
+    int walk_turn_param_id_   = -1;
+    int walk_speed_param_id_  = -1;
     int upright_cost_id_      = -1;
     int balance_cost_id_      = -1;
     int height_cost_id_       = -1;
     int foot_geom_id_[kNumFoot];
     int shoulder_body_id_[kNumFoot];
+    int torso_subtreecom_adr_    = -1;
+    int torso_subtreelinvel_adr_ = -1;
+    int torso_angmom_adr_        = -1;
+    int home_key_id_             = -1;
+    int crouch_key_id_           = -1;
 
     // derived kinematic quantities describing flip trajectory
     double gravity_           = 0;
@@ -271,13 +279,19 @@ class QuadrupedHill : public Task {
    private:
     friend class QuadrupedHill;
     int current_mode_;
+
+    // sensor addresses, resolved in ResetLocked
+    int position_adr_ = -1;
+    int orientation_adr_ = -1;
+    int foot_adr_[4] = {-1, -1, -1, -1};
   };
   QuadrupedHill() : residual_(this) {}
   void TransitionLocked(mjModel* model, mjData* data) override;
 
  protected:
+  void ResetLocked(const mjModel* model) override;
   std::unique_ptr<mjpc::ResidualFn> ResidualLocked() const override {
-    return std::make_unique<ResidualFn>(this, residual_.current_mode_);
+    return std::make_unique<ResidualFn>(residual_);
   }
   ResidualFn* InternalResidual() override { return &residual_; }
 
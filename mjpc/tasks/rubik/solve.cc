@@ -66,10 +66,10 @@ void Rubik::ResidualFn::Residual(const mjModel* model, const mjData* data,
 
   // ---------- Residual (0) ----------
   // goal position
-  double* goal_position = SensorByName(model, data, "palm_position");
+  double* goal_position = data->sensordata + palm_position_adr_;
 
   // system's position
-  double* position = SensorByName(model, data, "cube_position");
+  double* position = data->sensordata + cube_position_adr_;
 
   // position error
   mju_sub3(residual + counter, position, goal_position);
@@ -77,10 +77,10 @@ void Rubik::ResidualFn::Residual(const mjModel* model, const mjData* data,
 
   // ---------- Residual (1) ----------
   // goal orientation
-  double* goal_orientation = SensorByName(model, data, "cube_goal_orientation");
+  double* goal_orientation = data->sensordata + cube_goal_orientation_adr_;
 
   // system's orientation
-  double* orientation = SensorByName(model, data, "cube_orientation");
+  double* orientation = data->sensordata + cube_orientation_adr_;
   mju_normalize4(goal_orientation);
 
   // orientation error
@@ -88,8 +88,7 @@ void Rubik::ResidualFn::Residual(const mjModel* model, const mjData* data,
   counter += 3;
 
   // ---------- Residual (2) ----------
-  double* cube_linear_velocity =
-      SensorByName(model, data, "cube_linear_velocity");
+  double* cube_linear_velocity = data->sensordata + cube_linear_velocity_adr_;
   mju_copy(residual + counter, cube_linear_velocity, 3);
   counter += 3;
 
@@ -245,4 +244,14 @@ void Rubik::TransitionLocked(mjModel* model, mjData* data) {
   }
 }
 
+void Rubik::ResetLocked(const mjModel* model) {
+  residual_.palm_position_adr_ = SensorAdrByName(model, "palm_position");
+  residual_.cube_position_adr_ = SensorAdrByName(model, "cube_position");
+  residual_.cube_goal_orientation_adr_ =
+      SensorAdrByName(model, "cube_goal_orientation");
+  residual_.cube_orientation_adr_ = SensorAdrByName(model, "cube_orientation");
+  residual_.cube_linear_velocity_adr_ =
+      SensorAdrByName(model, "cube_linear_velocity");
+}
+
 }  // namespace mjpc
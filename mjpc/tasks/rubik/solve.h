@@ -44,6 +44,13 @@ class Rubik : public Task {
     friend class Rubik;
     int current_mode_ = 0;
     int goal_index_ = 0;
+
+    // sensor addresses, resolved in ResetLocked
+    int palm_position_adr_ = -1;
+    int cube_position_adr_ = -1;
+    int cube_goal_orientation_adr_ = -1;
+    int cube_orientation_adr_ = -1;
+    int cube_linear_velocity_adr_ = -1;
   };
 
   Rubik();
@@ -61,9 +68,9 @@ class Rubik : public Task {
 
  protected:
   std::unique_ptr<mjpc::ResidualFn> ResidualLocked() const override {
-    return std::make_unique<ResidualFn>(this, residual_.current_mode_,
-                                        residual_.goal_index_);
+    return std::make_unique<ResidualFn>(residual_);
   }
+  void ResetLocked(const mjModel* model) override;
   ResidualFn* InternalResidual() override { return &residual_; }
 
  private:
@@ -39,6 +39,16 @@ class ShadowReorient : public Task {
   // ------------------------------------------------------------
   void Residual(const mjModel* model, const mjData* data,
                 double* residual) const override;
+
+   private:
+    friend class ShadowReorient;
+
+    // sensor addresses, resolved in ResetLocked
+    int palm_position_adr_ = -1;
+    int cube_position_adr_ = -1;
+    int cube_goal_orientation_adr_ = -1;
+    int cube_orientation_adr_ = -1;
+    int cube_linear_velocity_adr_ = -1;
   };
   ShadowReorient() : residual_(this) {}
 
@@ -50,8 +60,9 @@ class ShadowReorient : public Task {
 
  protected:
   std::unique_ptr<mjpc::ResidualFn> ResidualLocked() const override {
-    return std::make_unique<ResidualFn>(this);
+    return std::make_unique<ResidualFn>(residual_);
   }
+  void ResetLocked(const mjModel* model) override;
   ResidualFn* InternalResidual() override { return &residual_; }
 
  private:
@@ -38,8 +38,9 @@ void Swimmer::ResidualFn::Residual(const mjModel* model, const mjData* data,
 
   // ---------- Residuals (5-6) ----------
   // nose to target XY displacement
-  double* target = SensorByName(model, data, "target");
-  double* nose = SensorByName(model, data, "nose");
+  // read from kinematics, as the framepos sensors "nose" and "target"
+  const double* target = data->xipos + 3 * target_id_;
+  const double* nose = data->geom_xpos + 3 * nose_id_;
   mju_sub(residual + model->nu, nose, target, 2);
 }
 
@@ -59,4 +60,9 @@ void Swimmer::TransitionLocked(mjModel* model, mjData* data) {
   }
 }
 
+void Swimmer::ResetLocked(const mjModel* model) {
+  residual_.target_id_ = mj_name2id(model, mjOBJ_BODY, "target");
+  residual_.nose_id_ = mj_name2id(model, mjOBJ_GEOM, "nose");
+}
+
 }  // namespace mjpc
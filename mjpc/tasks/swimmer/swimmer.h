@@ -35,6 +35,14 @@ class Swimmer : public Task {
 // -------------------------------------------------------------
     void Residual(const mjModel* model, const mjData* data,
                   double* residual) const override;
+    bool ReadsSensorData() const override { return false; }
+
+   private:
+    friend class Swimmer;
+
+    // target body and nose geom, resolved in ResetLocked
+    int target_id_ = -1;
+    int nose_id_ = -1;
   };
 
   Swimmer() : residual_(this) {}
@@ -46,8 +54,9 @@ class Swimmer : public Task {
 
  protected:
   std::unique_ptr<mjpc::ResidualFn> ResidualLocked() const override {
-    return std::make_unique<ResidualFn>(this);
+    return std::make_unique<ResidualFn>(residual_);
   }
+  void ResetLocked(const mjModel* model) override;
   ResidualFn* InternalResidual() override { return &residual_; }
 
  private:
@@ -43,15 +43,15 @@ void Walker::ResidualFn::Residual(const mjModel* model, const mjData* data,
   counter += model->nu;
 
   // ---------- Residual (1) -----------
-  double height = SensorByName(model, data, "torso_position")[2];
+  double height = data->sensordata[torso_position_adr_ + 2];
   residual[counter++] = height - parameters_[0];
 
   // ---------- Residual (2) ----------
-  double torso_up = SensorByName(model, data, "torso_zaxis")[2];
+  double torso_up = data->sensordata[torso_zaxis_adr_ + 2];
   residual[counter++] = torso_up - 1.0;
 
   // ---------- Residual (3) ----------
-  double com_vel = SensorByName(model, data, "torso_subtreelinvel")[0];
+  double com_vel = data->sensordata[torso_subtreelinvel_adr_];
   residual[counter++] = com_vel - parameters_[1];
 
   // sensor dim sanity check
@@ -67,4 +67,11 @@ void Walker::ResidualFn::Residual(const mjModel* model, const mjData* data,
                 "and actual length of residual %d", counter);
   }
 }
+
+void Walker::ResetLocked(const mjModel* model) {
+  residual_.torso_position_adr_ = SensorAdrByName(model, "torso_position");
+  residual_.torso_zaxis_adr_ = SensorAdrByName(model, "torso_zaxis");
+  residual_.torso_subtreelinvel_adr_ =
+      SensorAdrByName(model, "torso_subtreelinvel");
+}
 }  // namespace mjpc
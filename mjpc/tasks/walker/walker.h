@@ -40,13 +40,22 @@ class Walker : public Task {
 // --------------------------------------------
     void Residual(const mjModel* model, const mjData* data,
                   double* residual) const override;
+
+   private:
+    friend class Walker;
+
+    // sensor addresses, resolved in ResetLocked
+    int torso_position_adr_ = -1;
+    int torso_zaxis_adr_ = -1;
+    int torso_subtreelinvel_adr_ = -1;
   };
   Walker() : residual_(this) {}
 
  protected:
   std::unique_ptr<mjpc::ResidualFn> ResidualLocked() const override {
-    return std::make_unique<ResidualFn>(this);
+    return std::make_unique<ResidualFn>(residual_);
   }
+  void ResetLocked(const mjModel* model) override;
   ResidualFn* InternalResidual() override { return &residual_; }
 
  private:
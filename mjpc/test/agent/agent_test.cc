@@ -18,6 +18,7 @@
 #include <chrono>
 #include <memory>
 #include <thread>
+#include <vector>
 
 #include "gtest/gtest.h"
 #include <mujoco/mujoco.h>
@@ -397,6 +398,73 @@ class AgentTest : public ::testing::Test {
     mj_deleteData(data);
     mj_deleteModel(model);
   }
+
+  // planners are switched without reallocating the others, and share the
+  // agent's per-thread data
+  void TestPlannerSwitch() {
+    // load model
+    model = LoadTestModel("particle_task.xml");
+
+    // ----- initialize agent ----- //
+    agent->Initialize(model);
+    agent->Allocate();
+    agent->Reset();
+    agent->plan_enabled = true;
+
+    // only the active planner is allocated
+    EXPECT_EQ(agent->planner_, 0);
+    EXPECT_EQ(agent->planner_allocated_[0], 1);
+    EXPECT_EQ(agent->planner_allocated_[2], 0);
+
+    // pool
+    ThreadPool pool(2);
+
+    // plan with sampling
+    for (int i = 0; i < 5; i++) {
+      agent->PlanIteration(&pool);
+    }
+    Planner& sampling = agent->ActivePlanner();
+    ASSERT_GE(sampling.data_.size(), 2);
+    mjData* data0 = sampling.data_[0].get();
+    mjData* data1 = sampling.data_[1].get();
+    const Trajectory* best = sampling.BestTrajectory();
+    ASSERT_NE(best, nullptr);
+    double time = best->times[1];
+    std::vector<double> sampling_action(model->nu);
+    sampling.ActionFromPolicy(sampling_action.data(), nullptr, time);
+
+    // switch to iLQG, activated by the next iteration
+    agent->SetPlanner(2);
+    agent->plan_enabled = false;
+    for (int i = 0; i < 10000 && agent->planner_ != 2; i++) {
+      agent->PlanIteration(&pool);
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    ASSERT_EQ(agent->planner_, 2);
+    EXPECT_EQ(agent->planner_allocated_[1], 0);
+    EXPECT_EQ(agent->planner_allocated_[2], 1);
+
+    // warm started from the sampling policy
+    Planner& ilqg = agent->ActivePlanner();
+    std::vector<double> ilqg_action(model->nu);
+    ilqg.ActionFromPolicy(ilqg_action.data(), best->states.data(), time);
+    for (int i = 0; i < model->nu; i++) {
+      EXPECT_NEAR(ilqg_action[i], sampling_action[i], 1.0e-1);
+    }
+
+    // the same per-thread data is handed over
+    EXPECT_TRUE(sampling.data_.empty());
+    ASSERT_GE(ilqg.data_.size(), 2);
+    EXPECT_EQ(ilqg.data_[0].get(), data0);
+    EXPECT_EQ(ilqg.data_[1].get(), data1);
+
+    // plan with iLQG
+    agent->plan_enabled = true;
+    agent->PlanIteration(&pool);
+    EXPECT_EQ(ilqg.data_[0].get(), data0);
+
+    mj_deleteModel(model);
+  }
 };
 
 TEST_F(AgentTest, Initialization) { TestInitialization(); }
@@ -407,4 +475,6 @@ TEST_F(AgentTest, PreviousSamplingPolicy) { TestPreviousSamplingPolicy(); }
 TEST_F(AgentTest, PreviousILQGPolicy) { TestPreviousILQGPolicy(); }
 TEST_F(AgentTest, PreviousILQSPolicy) { TestPreviousILQSPolicy(); }
 
+TEST_F(AgentTest, PlannerSwitch) { TestPlannerSwitch(); }
+
 }  // namespace mjpc
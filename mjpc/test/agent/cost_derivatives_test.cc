@@ -12,11 +12,62 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
+#include "mjpc/planners/cost_derivatives.h"
+
+#include <vector>
+
+#include <mujoco/mujoco.h>
+
 #include "gtest/gtest.h"
+#include "mjpc/norm.h"
 
 namespace mjpc {
 namespace {
 
+TEST(CostDerivativesTest, SparseStep) {
+  // dimensions
+  const int nr = 3;
+  const int nx = 5;
+  const int nu = 2;
+
+  // residual and Jacobians, columns 1, 3 of rx and column 0 of ru are zero
+  double r[nr] = {0.1, -0.2, 0.3};
+  double rx[nr * nx] = {1.0, 0.0, 2.0,  0.0, -1.0, 0.5, 0.0, -0.3,
+                        0.0, 0.2, -2.0, 0.0, 0.7,  0.0, 1.5};
+  double ru[nr * nu] = {0.0, 1.0, 0.0, -0.4, 0.0, 2.0};
+  int column_x[3] = {0, 2, 4};
+  int column_u[1] = {1};
+  double p[2] = {0.1, 2.0};
+
+  for (NormType norm : {NormType::kQuadratic, NormType::kL22}) {
+    CostDerivatives cd;
+
+    // dense
+    std::vector<double> cx(nx), cu(nu), cxx(nx * nx), cuu(nu * nu),
+        cxu(nx * nu), cr(nr), crr(nr * nr), c_scratch(nr * (nx + nu));
+    double c = cd.DerivativeStep(cx.data(), cu.data(), cxx.data(), cuu.data(),
+                                 cxu.data(), cr.data(), crr.data(),
+                                 c_scratch.data(), r, rx, ru, nr, nx, nu, 1.3,
+                                 p, norm);
+
+    // sparse
+    std::vector<double> sx(nx), su(nu), sxx(nx * nx), suu(nu * nu),
+        sxu(nx * nu), rx_scratch(nr * nx), ru_scratch(nr * nu);
+    double s = cd.DerivativeStepSparse(
+        sx.data(), su.data(), sxx.data(), suu.data(), sxu.data(), cr.data(),
+        crr.data(), c_scratch.data(), rx_scratch.data(), ru_scratch.data(), r,
+        rx, ru, nr, nx, nu, column_x, 3, column_u, 1, 1.3, p, norm);
+
+    // test
+    EXPECT_NEAR(s, c, 1.0e-12);
+    for (int i = 0; i < nx; i++) EXPECT_NEAR(sx[i], cx[i], 1.0e-12);
+    for (int i = 0; i < nu; i++) EXPECT_NEAR(su[i], cu[i], 1.0e-12);
+    for (int i = 0; i < nx * nx; i++) EXPECT_NEAR(sxx[i], cxx[i], 1.0e-12);
+    for (int i = 0; i < nu * nu; i++) EXPECT_NEAR(suu[i], cuu[i], 1.0e-12);
+    for (int i = 0; i < nx * nu; i++) EXPECT_NEAR(sxu[i], cxu[i], 1.0e-12);
+  }
+}
+
 // void R(double* r, const double* x, const double* u) {
 //   r[0] = 0.1 * x[0];
 //   r[1] = 0.2 * x[1];
@@ -0,0 +1,522 @@
+// Copyright 2024 DeepMind Technologies Limited
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "mjpc/derivatives.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <mujoco/mujoco.h>
+
+#include "gtest/gtest.h"
+#include "mjpc/estimators/kalman.h"
+#include "mjpc/planners/model_derivatives.h"
+#include "mjpc/task.h"
+#include "mjpc/test/load.h"
+#include "mjpc/threadpool.h"
+#include "mjpc/utilities.h"
+
+namespace mjpc {
+namespace {
+
+TEST(DerivativesTest, Coloring) {
+  // load model
+  mjModel* model = LoadTestModel("particles.xml");
+  mjData* data = mj_makeData(model);
+  mj_forward(model, data);
+
+  // islands
+  DerivativeColoring coloring;
+  coloring.Compute(model, data, 0, model->nsensordata);
+
+  // two independent particles, filter actuator on second particle
+  EXPECT_EQ(coloring.num_island, 2);
+  EXPECT_EQ(coloring.dof_island[0], coloring.dof_island[1]);
+  EXPECT_EQ(coloring.dof_island[2], coloring.dof_island[3]);
+  EXPECT_NE(coloring.dof_island[0], coloring.dof_island[2]);
+  EXPECT_EQ(coloring.act_island[0], coloring.dof_island[2]);
+
+  // relative position sensor couples particles
+  EXPECT_TRUE(coloring.global_sensor);
+  EXPECT_EQ(coloring.sensor_island[0], coloring.dof_island[0]);
+  EXPECT_EQ(coloring.sensor_island[2], coloring.dof_island[2]);
+  EXPECT_EQ(coloring.sensor_island[model->nsensordata - 1], kGlobalIsland);
+
+  // delete data + model
+  mj_deleteData(data);
+  mj_deleteModel(model);
+}
+
+TEST(DerivativesTest, Transition) {
+  // load model
+  mjModel* model = LoadTestModel("particles.xml");
+  mjData* data = mj_makeData(model);
+
+  // dimensions
+  int nv = model->nv, na = model->na, nu = model->nu;
+  int ndx = 2 * nv + na;
+
+  // sensors without relative position
+  int ns = model->nsensordata;
+  int sensor_end = ns - 3;
+
+  // state
+  double qpos[4] = {0.1, -0.2, 0.3, -0.05};
+  double qvel[4] = {-0.3, 0.25, 0.1, 0.5};
+  mju_copy(data->qpos, qpos, model->nq);
+  mju_copy(data->qvel, qvel, nv);
+  data->act[0] = 0.2;
+  double ctrl[4] = {0.5, 1.0, -0.25, 0.1};
+  mju_copy(data->ctrl, ctrl, nu);
+
+  for (int centered = 0; centered < 2; centered++) {
+    // MuJoCo
+    std::vector<double> A(ndx * ndx);
+    std::vector<double> B(ndx * nu);
+    std::vector<double> C(ns * ndx);
+    std::vector<double> D(ns * nu);
+    mjd_transitionFD(model, data, 1.0e-6, centered, A.data(), B.data(),
+                     C.data(), D.data());
+
+    // colored
+    ColoredDerivatives derivatives;
+    std::vector<double> Ac(ndx * ndx);
+    std::vector<double> Bc(ndx * nu);
+    std::vector<double> Cc(ns * ndx);
+    std::vector<double> Dc(ns * nu);
+    derivatives.Transition(model, data, 1.0e-6, centered, Ac.data(),
+                           Bc.data(), Cc.data(), Dc.data(), 0, sensor_end);
+
+    // fewer evaluations than one (two) per column
+    EXPECT_LT(derivatives.NumEvaluations(),
+              1 + (centered ? 2 : 1) * (ndx + nu));
+
+    // test
+    for (int i = 0; i < ndx * ndx; i++) {
+      EXPECT_NEAR(Ac[i], A[i], 1.0e-5);
+    }
+    for (int i = 0; i < ndx * nu; i++) {
+      EXPECT_NEAR(Bc[i], B[i], 1.0e-5);
+    }
+    for (int i = 0; i < sensor_end * ndx; i++) {
+      EXPECT_NEAR(Cc[i], C[i], 1.0e-5);
+    }
+    for (int i = 0; i < sensor_end * nu; i++) {
+      EXPECT_NEAR(Dc[i], D[i], 1.0e-5);
+    }
+
+    // state is restored
+    for (int i = 0; i < nv; i++) {
+      EXPECT_NEAR(data->qpos[i], qpos[i], 1.0e-12);
+      EXPECT_NEAR(data->qvel[i], qvel[i], 1.0e-12);
+    }
+  }
+
+  // delete data + model
+  mj_deleteData(data);
+  mj_deleteModel(model);
+}
+
+// task whose residuals couple both particles
+class ParticlesTask : public Task {
+ public:
+  ParticlesTask() : residual_(this) {}
+  std::string Name() const override { return ""; }
+  std::string XmlPath() const override { return ""; }
+
+  class ResidualFn : public BaseResidualFn {
+   public:
+    explicit ResidualFn(ParticlesTask* task) : BaseResidualFn(task) {}
+    void Residual(const mjModel* model, const mjData* data,
+                  double* residual) const override {
+      // distance
+      residual[0] = data->qpos[0] - data->qpos[2];
+
+      // effort
+      residual[1] = data->qacc[0] * data->qvel[3] + data->qacc[3];
+    }
+  };
+
+  std::unique_ptr<mjpc::ResidualFn> ResidualLocked() const override {
+    return std::make_unique<ResidualFn>(residual_);
+  }
+  ResidualFn* InternalResidual() override { return &residual_; }
+  ResidualFn residual_;
+};
+
+TEST(DerivativesTest, TransitionResidual) {
+  // load model
+  mjModel* model = LoadTestModel("particles_task.xml");
+  mjData* data = mj_makeData(model);
+
+  // residual sensors
+  ParticlesTask task;
+  task.Reset(model);
+  RegisterResidual(model, &task);
+  mjcb_sensor = ResidualSensorCallback;
+
+  // dimensions
+  int nv = model->nv, na = model->na, nu = model->nu;
+  int ndx = 2 * nv + na;
+  int ns = model->nsensordata;
+
+  // state
+  double qpos[4] = {0.1, -0.2, 0.3, -0.05};
+  double qvel[4] = {-0.3, 0.25, 0.1, 0.5};
+  mju_copy(data->qpos, qpos, model->nq);
+  mju_copy(data->qvel, qvel, nv);
+  data->act[0] = 0.2;
+  double ctrl[4] = {0.5, 1.0, -0.25, 0.1};
+  mju_copy(data->ctrl, ctrl, nu);
+
+  for (int centered = 0; centered < 2; centered++) {
+    // MuJoCo
+    std::vector<double> A(ndx * ndx), B(ndx * nu), C(ns * ndx), D(ns * nu);
+    mjd_transitionFD(model, data, 1.0e-6, centered, A.data(), B.data(),
+                     C.data(), D.data());
+
+    // colored, residual rows by column
+    ColoredDerivatives derivatives;
+    std::vector<double> Ac(ndx * ndx), Bc(ndx * nu), Cc(ns * ndx),
+        Dc(ns * nu);
+    derivatives.Transition(model, data, 1.0e-6, centered, Ac.data(),
+                           Bc.data(), Cc.data(), Dc.data());
+    EXPECT_TRUE(derivatives.coloring.global_sensor);
+    EXPECT_LT(derivatives.NumEvaluations(),
+              1 + (centered ? 2 : 1) * (ndx + nu));
+    EXPECT_GT(derivatives.NumSensorEvaluations(), 0);
+
+    // test
+    for (int i = 0; i < ndx * ndx; i++) {
+      EXPECT_NEAR(Ac[i], A[i], 1.0e-5);
+    }
+    for (int i = 0; i < ndx * nu; i++) {
+      EXPECT_NEAR(Bc[i], B[i], 1.0e-5);
+    }
+    for (int i = 0; i < ns * ndx; i++) {
+      EXPECT_NEAR(Cc[i], C[i], 1.0e-5);
+    }
+    for (int i = 0; i < ns * nu; i++) {
+      EXPECT_NEAR(Dc[i], D[i], 1.0e-5);
+    }
+  }
+
+  UnregisterResidual(model);
+  mjcb_sensor = nullptr;
+
+  // delete data + model
+  mj_deleteData(data);
+  mj_deleteModel(model);
+}
+
+TEST(DerivativesTest, Inverse) {
+  // load model
+  mjModel* model = LoadTestModel("particles.xml");
+  mjData* data = mj_makeData(model);
+
+  // dimensions
+  int nv = model->nv;
+  int ns = model->nsensordata;
+  int sensor_end = ns - 3;
+
+  // state, acceleration
+  double qpos[4] = {0.1, -0.2, 0.3, -0.05};
+  double qvel[4] = {-0.3, 0.25, 0.1, 0.5};
+  double qacc[4] = {1.0, -0.5, 0.25, 0.75};
+  mju_copy(data->qpos, qpos, model->nq);
+  mju_copy(data->qvel, qvel, nv);
+  mju_copy(data->qacc, qacc, nv);
+
+  // MuJoCo
+  std::vector<double> DfDq(nv * nv), DfDv(nv * nv), DfDa(nv * nv);
+  std::vector<double> DsDq(nv * ns), DsDv(nv * ns), DsDa(nv * ns);
+  mjd_inverseFD(model, data, 1.0e-6, 1, DfDq.data(), DfDv.data(),
+                DfDa.data(), DsDq.data(), DsDv.data(), DsDa.data(), nullptr);
+
+  // colored
+  ColoredDerivatives derivatives;
+  std::vector<double> DfDqc(nv * nv), DfDvc(nv * nv), DfDac(nv * nv);
+  std::vector<double> DsDqc(nv * ns), DsDvc(nv * ns), DsDac(nv * ns);
+  derivatives.Inverse(model, data, 1.0e-6, 1, DfDqc.data(), DfDvc.data(),
+                      DfDac.data(), DsDqc.data(), DsDvc.data(), DsDac.data(),
+                      0, sensor_end);
+  EXPECT_LT(derivatives.NumEvaluations(), 1 + 3 * nv);
+
+  // test
+  for (int i = 0; i < nv * nv; i++) {
+    EXPECT_NEAR(DfDqc[i], DfDq[i], 1.0e-5);
+    EXPECT_NEAR(DfDvc[i], DfDv[i], 1.0e-5);
+    EXPECT_NEAR(DfDac[i], DfDa[i], 1.0e-5);
+  }
+  for (int i = 0; i < nv; i++) {
+    for (int j = 0; j < sensor_end; j++) {
+      EXPECT_NEAR(DsDqc[i * ns + j], DsDq[i * ns + j], 1.0e-5);
+      EXPECT_NEAR(DsDvc[i * ns + j], DsDv[i * ns + j], 1.0e-5);
+      EXPECT_NEAR(DsDac[i * ns + j], DsDa[i * ns + j], 1.0e-5);
+    }
+  }
+
+  // delete data + model
+  mj_deleteData(data);
+  mj_deleteModel(model);
+}
+
+TEST(DerivativesTest, Cache) {
+  // load model
+  mjModel* model = LoadTestModel("particles.xml");
+  mjData* data = mj_makeData(model);
+
+  // dimensions
+  int nv = model->nv, na = model->na, nu = model->nu;
+  int ndx = 2 * nv + na;
+  int ns = model->nsensordata;
+
+  // state
+  data->qpos[0] = 0.1;
+  data->qvel[1] = -0.3;
+  data->ctrl[0] = 0.5;
+
+  // Jacobians
+  std::vector<double> A(ndx * ndx), B(ndx * nu), C(ns * ndx), D(ns * nu);
+  mjd_transitionFD(model, data, 1.0e-6, 0, A.data(), B.data(), C.data(),
+                   D.data());
+
+  // store sensor rows [0, 2) and dynamics
+  DerivativeCache cache;
+  cache.Store(model, data, 1.0e-6, false, A.data(), B.data(), C.data(), NULL,
+              0, 2);
+
+  // hit
+  std::vector<double> Ac(ndx * ndx), Cc(ns * ndx);
+  EXPECT_TRUE(cache.Lookup(model, data, 1.0e-6, false, Ac.data(), NULL,
+                           Cc.data(), NULL, 0, 2));
+  for (int i = 0; i < ndx * ndx; i++) EXPECT_EQ(Ac[i], A[i]);
+  for (int i = 0; i < 2 * ndx; i++) EXPECT_EQ(Cc[i], C[i]);
+
+  // misses: sensor rows, D, settings, control
+  EXPECT_FALSE(cache.Lookup(model, data, 1.0e-6, false, NULL, NULL, Cc.data(),
+                            NULL, 0, ns));
+  EXPECT_FALSE(cache.Lookup(model, data, 1.0e-6, false, NULL, NULL, NULL,
+                            D.data(), 0, 2));
+  EXPECT_FALSE(cache.Lookup(model, data, 1.0e-6, true, Ac.data(), NULL, NULL,
+                            NULL, 0, 2));
+  data->ctrl[0] = 0.6;
+  EXPECT_FALSE(cache.Lookup(model, data, 1.0e-6, false, Ac.data(), NULL,
+                            NULL, NULL, 0, 2));
+  EXPECT_EQ(cache.NumHits(), 1);
+  EXPECT_EQ(cache.NumMisses(), 4);
+
+  // clear
+  data->ctrl[0] = 0.5;
+  cache.Clear();
+  EXPECT_FALSE(cache.Lookup(model, data, 1.0e-6, false, Ac.data(), NULL,
+                            NULL, NULL, 0, 2));
+
+  // delete data + model
+  mj_deleteData(data);
+  mj_deleteModel(model);
+}
+
+TEST(ModelDerivativesTest, CacheHandoff) {
+  // load model
+  mjModel* model = LoadTestModel("particles.xml");
+
+  // dimensions
+  int nq = model->nq, nv = model->nv, na = model->na, nu = model->nu;
+  int nx = nq + nv + na;
+  int ndx = 2 * nv + na;
+  int ns = model->nsensordata;
+  const int T = 3;
+
+  // estimator sharing the cache
+  DerivativeCache cache;
+  Kalman kalman(model);
+  kalman.derivative_cache = &cache;
+  kalman.settings.epsilon = 1.0e-6;
+  kalman.settings.flg_centered = false;
+  kalman.state[0] = 0.1;
+  kalman.state[nq + 1] = -0.3;
+
+  // planner trajectory starting at the estimator state, with different time
+  // and warmstart
+  std::vector<double> x(T * nx);
+  std::vector<double> u(T * nu, 0.5);
+  std::vector<double> h(T);
+  for (int t = 0; t < T; t++) {
+    mju_copy(x.data() + t * nx, kalman.state.data(), nx);
+    h[t] = 1.5 + t * model->opt.timestep;
+  }
+
+  ThreadPool pool(1);
+  std::vector<UniqueMjData> datas;
+  datas.push_back(MakeUniqueMjData(mj_makeData(model)));
+  mju_fill(datas[0]->qacc_warmstart, 1.0, nv);
+
+  ModelDerivatives md;
+  md.Allocate(ndx, nu, ns, T);
+  md.cache = &cache;
+  md.Compute(model, datas, x.data(), u.data(), h.data(), nx, ndx, nu, ns, T,
+             1.0e-6, 0, pool);
+  EXPECT_EQ(cache.NumMisses(), 1);
+
+  // estimator measurement update at the same state and control reuses the
+  // planner's sensor Jacobian
+  std::vector<double> sensor(ns);
+  kalman.UpdateMeasurement(u.data(), sensor.data());
+  EXPECT_EQ(cache.NumHits(), 1);
+  EXPECT_EQ(cache.NumMisses(), 1);
+
+  // delete model
+  mj_deleteModel(model);
+}
+
+TEST(ModelDerivativesTest, CacheResidualRows) {
+  // load model
+  mjModel* model = LoadTestModel("particle_task.xml");
+  mjData* data = mj_makeData(model);
+
+  // dimensions
+  int nq = model->nq, nv = model->nv, na = model->na, nu = model->nu;
+  int nx = nq + nv + na;
+  int ndx = 2 * nv + na;
+  int ns = model->nsensordata;
+  const int T = 2;
+
+  // rows after the user sensors
+  int begin = 0;
+  for (int i = 0; i < model->nsensor; i++) {
+    if (model->sensor_type[i] == mjSENS_USER) {
+      begin = model->sensor_adr[i] + model->sensor_dim[i];
+    }
+  }
+  ASSERT_GT(begin, 0);
+  ASSERT_LT(begin, ns);
+
+  // planner derivatives at the current state
+  data->qpos[0] = 0.1;
+  data->ctrl[0] = 0.5;
+  std::vector<double> x(T * nx);
+  std::vector<double> u(T * nu);
+  std::vector<double> h(T);
+  for (int t = 0; t < T; t++) {
+    mju_copy(x.data() + t * nx, data->qpos, nq);
+    mju_copy(x.data() + t * nx + nq, data->qvel, nv);
+    mju_copy(u.data() + t * nu, data->ctrl, nu);
+  }
+
+  ThreadPool pool(1);
+  std::vector<UniqueMjData> datas;
+  datas.push_back(MakeUniqueMjData(mj_makeData(model)));
+
+  DerivativeCache cache;
+  ModelDerivatives md;
+  md.Allocate(ndx, nu, ns, T);
+  md.cache = &cache;
+  md.Compute(model, datas, x.data(), u.data(), h.data(), nx, ndx, nu, ns, T,
+             1.0e-6, 0, pool);
+
+  // dynamics and physical sensor rows are shared, residual rows are not
+  std::vector<double> A(ndx * ndx), C(ns * ndx);
+  EXPECT_TRUE(cache.Lookup(model, data, 1.0e-6, false, A.data(), NULL,
+                           C.data(), NULL, begin, ns));
+  EXPECT_FALSE(cache.Lookup(model, data, 1.0e-6, false, NULL, NULL,
+                            C.data(), NULL, 0, ns));
+
+  // moving the goal invalidates the entry
+  data->mocap_pos[0] += 0.1;
+  EXPECT_FALSE(cache.Lookup(model, data, 1.0e-6, false, A.data(), NULL,
+                            NULL, NULL, begin, ns));
+
+  // delete data + model
+  mj_deleteData(data);
+  mj_deleteModel(model);
+}
+
+TEST(ModelDerivativesTest, Shift) {
+  // load model
+  mjModel* model = LoadTestModel("particles.xml");
+  mjData* data = mj_makeData(model);
+
+  // dimensions
+  int nq = model->nq, nv = model->nv, na = model->na, nu = model->nu;
+  int nx = nq + nv + na;
+  int ndx = 2 * nv + na;
+  int ns = model->nsensordata;
+  const int T = 10;
+  const int shift = 2;
+
+  // rollout
+  std::vector<double> x((T + shift) * nx);
+  std::vector<double> u((T + shift) * nu);
+  std::vector<double> h(T + shift);
+  double qvel[4] = {-0.3, 0.25, 0.1, 0.5};
+  mju_copy(data->qvel, qvel, nv);
+  for (int t = 0; t < T + shift; t++) {
+    mju_copy(data->ctrl, qvel, nu);
+    mju_copy(x.data() + t * nx, data->qpos, nq);
+    mju_copy(x.data() + t * nx + nq, data->qvel, nv);
+    mju_copy(x.data() + t * nx + nq + nv, data->act, na);
+    mju_copy(u.data() + t * nu, data->ctrl, nu);
+    h[t] = data->time;
+    mj_step(model, data);
+  }
+
+  // per-thread data
+  ThreadPool pool(2);
+  std::vector<UniqueMjData> datas;
+  for (int i = 0; i < pool.NumThreads(); i++) {
+    datas.push_back(MakeUniqueMjData(mj_makeData(model)));
+  }
+
+  // derivatives, reused while the time steps are unchanged
+  ModelDerivatives md;
+  md.Allocate(ndx, nu, ns, T);
+  md.reuse_tolerance = 1.0e-10;
+  md.Compute(model, datas, x.data(), u.data(), h.data(), nx, ndx, nu, ns, T,
+             1.0e-6, 0, pool);
+  EXPECT_EQ(md.NumEvaluated(), T);
+  md.Compute(model, datas, x.data(), u.data(), h.data(), nx, ndx, nu, ns, T,
+             1.0e-6, 0, pool);
+  EXPECT_EQ(md.NumEvaluated(), 0);
+
+  // after a shift, only the exposed tail and the previous terminal step are
+  // evaluated
+  md.Shift(shift, ndx, nu, ns, T);
+  md.Compute(model, datas, x.data() + shift * nx, u.data() + shift * nu,
+             h.data() + shift, nx, ndx, nu, ns, T, 1.0e-6, 0, pool);
+  EXPECT_EQ(md.NumEvaluated(), shift + 1);
+
+  // same as evaluating all time steps
+  ModelDerivatives full;
+  full.Allocate(ndx, nu, ns, T);
+  full.Compute(model, datas, x.data() + shift * nx, u.data() + shift * nu,
+               h.data() + shift, nx, ndx, nu, ns, T, 1.0e-6, 0, pool);
+  for (int i = 0; i < (T - 1) * ndx * ndx; i++) {
+    EXPECT_NEAR(md.A[i], full.A[i], 1.0e-8);
+  }
+  for (int i = 0; i < (T - 1) * ndx * nu; i++) {
+    EXPECT_NEAR(md.B[i], full.B[i], 1.0e-8);
+  }
+  for (int i = 0; i < T * ns * ndx; i++) {
+    EXPECT_NEAR(md.C[i], full.C[i], 1.0e-8);
+  }
+
+  // delete data + model
+  mj_deleteData(data);
+  mj_deleteModel(model);
+}
+
+}  // namespace
+}  // namespace mjpc
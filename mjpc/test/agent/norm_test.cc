@@ -15,6 +15,9 @@
 #include "mjpc/norm.h"
 
 #include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <vector>
 
 #include "gmock/gmock.h"
 #include "gtest/gtest.h"
@@ -92,6 +95,87 @@ TEST_P(NormTest, Hessian) {
   }
 }
 
+TEST_P(NormTest, Batch) {
+  const double* params = GetParam().params;
+  const mjpc::NormType norm_type = GetParam().norm_type;
+
+  // blocks with padding between them
+  constexpr int kStride = kDims + 1;
+  std::vector<double> x(kNPoints * kStride, 7.0);
+  for (int i = 0; i < kNPoints; ++i) {
+    std::copy(kPoints[i], kPoints[i] + kDims, x.data() + i * kStride);
+  }
+
+  // evaluate batch
+  std::vector<double> y(kNPoints);
+  std::vector<double> g(kNPoints * kStride);
+  std::vector<double> H(kNPoints * kStride * kStride);
+  mjpc::NormBatch(y.data(), g.data(), H.data(), x.data(), params, kDims,
+                  kNPoints, kStride, norm_type);
+
+  // compare with single evaluations
+  for (int i = 0; i < kNPoints; ++i) {
+    double gi[kDims];
+    double Hi[kDims * kDims];
+    double yi = mjpc::Norm(gi, Hi, kPoints[i], params, kDims, norm_type);
+    EXPECT_EQ(y[i], yi);
+    for (int j = 0; j < kDims; ++j) {
+      EXPECT_EQ(g[i * kStride + j], gi[j]);
+    }
+    for (int j = 0; j < kDims * kDims; ++j) {
+      EXPECT_EQ(H[i * kStride * kStride + j], Hi[j]);
+    }
+  }
+}
+
+// benchmark a trajectory-sized batch against per-block evaluation; times are
+// reported as test properties
+TEST_P(NormTest, BatchBenchmark) {
+  const double* params = GetParam().params;
+  const mjpc::NormType norm_type = GetParam().norm_type;
+
+  // residual blocks of a long horizon, spanning several chunks
+  constexpr int kNumBlock = 1000;
+  constexpr int kDim = 3;
+  constexpr int kStride = 8;
+  constexpr int kRepeat = 200;
+  std::vector<double> x(kNumBlock * kStride);
+  for (int i = 0; i < kNumBlock * kStride; ++i) {
+    x[i] = std::sin(0.37 * i);
+  }
+
+  // per-block evaluation
+  std::vector<double> y_block(kNumBlock);
+  auto start = std::chrono::steady_clock::now();
+  for (int r = 0; r < kRepeat; ++r) {
+    for (int k = 0; k < kNumBlock; ++k) {
+      y_block[k] = mjpc::Norm(nullptr, nullptr, x.data() + k * kStride,
+                              params, kDim, norm_type);
+    }
+  }
+  auto block_time = std::chrono::steady_clock::now() - start;
+
+  // batch evaluation
+  std::vector<double> y_batch(kNumBlock);
+  start = std::chrono::steady_clock::now();
+  for (int r = 0; r < kRepeat; ++r) {
+    mjpc::NormBatch(y_batch.data(), nullptr, nullptr, x.data(), params, kDim,
+                    kNumBlock, kStride, norm_type);
+  }
+  auto batch_time = std::chrono::steady_clock::now() - start;
+
+  // same values
+  for (int k = 0; k < kNumBlock; ++k) {
+    EXPECT_EQ(y_batch[k], y_block[k]);
+  }
+
+  using std::chrono::microseconds;
+  RecordProperty("block_us", static_cast<int>(
+      std::chrono::duration_cast<microseconds>(block_time).count()));
+  RecordProperty("batch_us", static_cast<int>(
+      std::chrono::duration_cast<microseconds>(batch_time).count()));
+}
+
 INSTANTIATE_TEST_SUITE_P(
     NormTest, NormTest,
     testing::ValuesIn<NormTestCase>({
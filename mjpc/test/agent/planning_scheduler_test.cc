@@ -0,0 +1,175 @@
+// Copyright 2022 DeepMind Technologies Limited
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "mjpc/planning_scheduler.h"
+
+#include <chrono>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include <mujoco/mujoco.h>
+#include "mjpc/agent.h"
+#include "mjpc/test/load.h"
+#include "mjpc/test/testdata/particle_residual.h"
+
+namespace mjpc {
+namespace {
+
+// waits until an agent has completed at least n iterations
+void WaitIterations(const PlanningScheduler& scheduler, int id, int n) {
+  while (scheduler.Stats(id).iterations < n) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+}
+
+// agents planned on request and continuously share one pool
+TEST(PlanningSchedulerTest, SharedPool) {
+  // model
+  mjModel* model = LoadTestModel("particle_task.xml");
+
+  // agents
+  Agent requested(model, std::make_shared<ParticleTestTask>());
+  Agent continuous(model, std::make_shared<ParticleTestTask>());
+  requested.plan_enabled = true;
+  continuous.plan_enabled = true;
+
+  // scheduler
+  PlanningScheduler scheduler(2);
+  EXPECT_EQ(scheduler.NumThreads(), 2);
+  int requested_id = scheduler.AddAgent(&requested);
+
+  // continuous agent with a period longer than the test: released once at
+  // registration and once when resumed
+  int continuous_id = scheduler.AddAgent(&continuous, 3600.0, 1);
+
+  // plan on request
+  for (int i = 0; i < 5; i++) {
+    scheduler.PlanIteration(requested_id);
+  }
+  PlanningStats stats = scheduler.Stats(requested_id);
+  EXPECT_EQ(stats.iterations, 5);
+  EXPECT_EQ(stats.deadline_misses, 0);
+  EXPECT_GT(stats.mean_latency, 0.0);
+  EXPECT_GE(stats.max_latency, stats.mean_latency);
+  EXPECT_GE(stats.last_latency, stats.last_compute_time);
+
+  // continuous planning, first release
+  WaitIterations(scheduler, continuous_id, 1);
+  EXPECT_EQ(scheduler.Stats(continuous_id).iterations, 1);
+
+  // paused agents are not planned, resuming releases an iteration
+  scheduler.SetEnabled(continuous_id, false);
+  scheduler.PlanIteration(requested_id);
+  EXPECT_EQ(scheduler.Stats(continuous_id).iterations, 1);
+  scheduler.SetEnabled(continuous_id, true);
+  WaitIterations(scheduler, continuous_id, 2);
+  EXPECT_EQ(scheduler.Stats(continuous_id).iterations, 2);
+
+  // removed agents have no statistics
+  scheduler.RemoveAgent(continuous_id);
+  EXPECT_EQ(scheduler.Stats(continuous_id).iterations, 0);
+  scheduler.RemoveAgent(requested_id);
+
+  // delete model
+  mj_deleteModel(model);
+}
+
+// a higher-priority agent that is always ready does not starve others
+TEST(PlanningSchedulerTest, Aging) {
+  // model
+  mjModel* model = LoadTestModel("particle_task.xml");
+
+  // agents
+  Agent requested(model, std::make_shared<ParticleTestTask>());
+  Agent continuous(model, std::make_shared<ParticleTestTask>());
+  requested.plan_enabled = true;
+  continuous.plan_enabled = true;
+
+  // continuous agent is released again before its iterations complete
+  PlanningScheduler scheduler(1);
+  const int priority = 3;
+  int requested_id = scheduler.AddAgent(&requested);
+  int continuous_id = scheduler.AddAgent(&continuous, 1.0e-9, priority);
+  WaitIterations(scheduler, continuous_id, 1);
+
+  // requests complete after at most priority + 1 iterations of the other
+  // agent, plus one running when the request is made
+  for (int i = 0; i < 3; i++) {
+    int before = scheduler.Stats(continuous_id).iterations;
+    scheduler.PlanIteration(requested_id);
+    int after = scheduler.Stats(continuous_id).iterations;
+    EXPECT_LE(after - before, priority + 2);
+  }
+  EXPECT_EQ(scheduler.Stats(requested_id).iterations, 3);
+
+  scheduler.RemoveAgent(continuous_id);
+  scheduler.RemoveAgent(requested_id);
+
+  // delete model
+  mj_deleteModel(model);
+}
+
+// continuous agents overlap on the shared pool, aggregate iterations per
+// second are reported as a test property
+TEST(PlanningSchedulerTest, Throughput) {
+  // model
+  mjModel* model = LoadTestModel("particle_task.xml");
+
+  // agents
+  constexpr int kNumAgent = 4;
+  std::vector<std::unique_ptr<Agent>> agents;
+  for (int i = 0; i < kNumAgent; i++) {
+    agents.push_back(
+        std::make_unique<Agent>(model, std::make_shared<ParticleTestTask>()));
+    agents.back()->plan_enabled = true;
+  }
+
+  // agents are released again before their iterations complete
+  PlanningScheduler scheduler(kNumAgent);
+  std::vector<int> ids;
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < kNumAgent; i++) {
+    ids.push_back(scheduler.AddAgent(agents[i].get(), 1.0e-9));
+  }
+
+  // plan for a fixed wall-clock time
+  std::this_thread::sleep_for(std::chrono::milliseconds(500));
+  for (int id : ids) {
+    scheduler.SetEnabled(id, false);
+  }
+  double seconds = std::chrono::duration<double>(
+                       std::chrono::steady_clock::now() - start).count();
+
+  // every agent is planned
+  int iterations = 0;
+  for (int id : ids) {
+    int agent_iterations = scheduler.Stats(id).iterations;
+    EXPECT_GT(agent_iterations, 0);
+    iterations += agent_iterations;
+  }
+  RecordProperty("iterations_per_second",
+                 static_cast<int>(iterations / seconds));
+
+  for (int id : ids) {
+    scheduler.RemoveAgent(id);
+  }
+
+  // delete model
+  mj_deleteModel(model);
+}
+
+}  // namespace
+}  // namespace mjpc
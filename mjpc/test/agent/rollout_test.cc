@@ -12,6 +12,8 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
+#include <memory>
+
 #include "gtest/gtest.h"
 #include <mujoco/mujoco.h>
 #include "mjpc/task.h"
@@ -58,7 +60,7 @@ void sensor(const mjModel* m, mjData* d, int stage);
 
 // sensor callback
 void sensor(const mjModel* model, mjData* data, int stage) {
-  if (stage == mjSTAGE_ACC) {
+  if (stage == mjSTAGE_ACC && !DirectResidualScope::Active()) {
     task.Residual(model, data, data->sensordata);
   }
 }
@@ -152,5 +154,84 @@ TEST(RolloutTest, Particle) {
   mjcb_sensor = nullptr;
 }
 
+// rollouts with a planning residual match rollouts through the sensor callback
+TEST(RolloutTest, PlanningResidual) {
+  // load model
+  mjModel* model = LoadTestModel("particle_task.xml");
+  task.Reset(model);
+
+  // create data
+  mjData* data = mj_makeData(model);
+  int num_residual = task.num_residual;
+  int dim_state = model->nq + model->nv;
+
+  // set callback
+  mjcb_sensor = sensor;
+  mj_forward(model, data);
+
+  // policy
+  auto policy = [](double* action, const double* state, double time) {
+    mju_scl(action, state, -10.0, 2);
+    mju_addToScl(action, state + 2, -2.5, 2);
+  };
+
+  // initial state
+  double state[4] = {0.1, -0.1, 0.0, 0.0};
+  double mocap[7];
+  mju_copy(mocap, data->mocap_pos, 3);
+  mju_copy(mocap + 3, data->mocap_quat, 4);
+
+  // steps are evaluated differently for single-stage and Runge-Kutta
+  // integrators
+  for (int integrator : {mjINT_EULER, mjINT_RK4}) {
+    model->opt.integrator = integrator;
+
+    // trajectories
+    int horizon = 50;
+    Trajectory callback_trajectory;
+    callback_trajectory.Initialize(dim_state, model->nu, num_residual, 1,
+                                   horizon);
+    callback_trajectory.Allocate(horizon);
+    Trajectory direct_trajectory;
+    direct_trajectory.Initialize(dim_state, model->nu, num_residual, 1,
+                                 horizon);
+    direct_trajectory.Allocate(horizon);
+
+    // rollout through the sensor callback
+    callback_trajectory.Rollout(policy, &task, model, data, state, 0.0, mocap,
+                                NULL, horizon);
+
+    // rollout evaluating the planning residual directly
+    std::unique_ptr<ResidualFn> residual = task.Residual();
+    task.SetPlanningResidual(residual.get());
+    mju_zero(data->sensordata, model->nsensordata);
+    direct_trajectory.Rollout(policy, &task, model, data, state, 0.0, mocap,
+                              NULL, horizon);
+    task.SetPlanningResidual(nullptr);
+
+    // the sensor callback was bypassed
+    EXPECT_EQ(mju_L1(data->sensordata, num_residual), 0.0);
+
+    // identical trajectories
+    for (int i = 0; i < dim_state * horizon; i++) {
+      EXPECT_EQ(direct_trajectory.states[i], callback_trajectory.states[i]);
+    }
+    for (int i = 0; i < num_residual * horizon; i++) {
+      EXPECT_EQ(direct_trajectory.residual[i], callback_trajectory.residual[i]);
+    }
+    for (int i = 0; i < 3 * horizon; i++) {
+      EXPECT_EQ(direct_trajectory.trace[i], callback_trajectory.trace[i]);
+    }
+    EXPECT_EQ(direct_trajectory.total_return, callback_trajectory.total_return);
+  }
+
+  // delete model + data
+  mj_deleteData(data);
+  mj_deleteModel(model);
+
+  // unset callback
+  mjcb_sensor = nullptr;
+}
+
 }  // namespace
 }  // namespace mjpc
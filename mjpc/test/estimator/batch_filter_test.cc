@@ -15,12 +15,17 @@
 #include <absl/random/random.h>
 #include <mujoco/mujoco.h>
 
+#include <algorithm>
+#include <cmath>
 #include <cstddef>
+#include <memory>
+#include <string>
 #include <vector>
 
 #include "gtest/gtest.h"
 #include "mjpc/direct/trajectory.h"
 #include "mjpc/estimators/batch.h"
+#include "mjpc/task.h"
 #include "mjpc/test/load.h"
 #include "mjpc/test/simulation.h"
 #include "mjpc/utilities.h"
@@ -116,5 +121,166 @@ TEST(BatchFilter, Box3Drot) {
   mj_deleteModel(model);
 }
 
+TEST(BatchFilter, MarginalizedPrior) {
+  // load model
+  mjModel* model = LoadTestModel("estimator/box/task3Drot2.xml");
+
+  // ----- rollout ----- //
+  int T = 12;
+  Simulation sim(model, T);
+  auto controller = [](double* ctrl, double time) {};
+  double qvel[3] = {1.0, -0.75, 1.25};
+  sim.SetState(NULL, qvel);
+  sim.Rollout(controller);
+
+  // ----- Batch ----- //
+
+  // initialize batch
+  Batch batch(1);
+  batch.Initialize(model);
+  batch.Reset();
+
+  // set initial configurations
+  double* q0 = batch.configuration.Get(0);
+  double* q1 = batch.configuration.Get(1);
+  mju_copy(q1, sim.qpos.Get(0), model->nq);
+  mju_copy(q0, q1, model->nq);
+  mj_integratePos(model, q0, sim.qvel.Get(0), -1.0 * model->opt.timestep);
+
+  // dimensions
+  int nv = model->nv;
+  int length = batch.ConfigurationLength();
+  int nvar = nv * length;
+  int ncondition = nvar - nv;
+
+  // dense marginalization
+  std::vector<double> hessian(nvar * nvar);
+  std::vector<double> condmat(ncondition * ncondition);
+  std::vector<double> weights(nvar * nvar);
+  std::vector<double> mat00(nvar * nvar), mat10(nvar * nvar);
+  std::vector<double> mat11(nvar * nvar);
+  std::vector<double> tmp0(nvar * nvar), tmp1(nvar * nvar);
+
+  for (int t = 0; t < T - 1; t++) {
+    // update
+    batch.Update(sim.ctrl.Get(t), sim.sensor.Get(t));
+
+    // window not filled
+    if (t < length - 2) continue;
+
+    // Schur complement of first configuration in cost Hessian
+    mju_copy(hessian.data(), batch.GetCostHessian(), nvar * nvar);
+    ConditionMatrix(condmat.data(), hessian.data(), mat00.data(),
+                    mat10.data(), mat11.data(), tmp0.data(), tmp1.data(),
+                    nvar, nv, ncondition);
+
+    // prior for shifted configurations
+    mju_zero(weights.data(), nvar * nvar);
+    SetBlockInMatrix(weights.data(), condmat.data(), 1.0, nvar, nvar,
+                     ncondition, ncondition, 0, 0);
+    for (int i = ncondition; i < nvar; i++) {
+      weights[nvar * i + i] = batch.scale_prior;
+    }
+    DenseToBlockBand(weights.data(), nvar, nv, 3);
+
+    // test
+    const double* prior = batch.PriorWeights();
+    for (int i = 0; i < nvar * nvar; i++) {
+      EXPECT_NEAR(prior[i], weights[i], 1.0e-8 * (1.0 + std::abs(weights[i])));
+    }
+  }
+
+  // delete model
+  mj_deleteModel(model);
+}
+
+// task whose residual is the position of two sites
+class SiteTask : public Task {
+ public:
+  SiteTask() : residual_(this) {}
+  std::string Name() const override { return ""; }
+  std::string XmlPath() const override { return ""; }
+
+  class ResidualFn : public BaseResidualFn {
+   public:
+    explicit ResidualFn(SiteTask* task) : BaseResidualFn(task) {}
+    void Residual(const mjModel* model, const mjData* data,
+                  double* residual) const override {
+      mju_copy(residual, data->site_xpos, 6);
+    }
+  };
+
+  std::unique_ptr<mjpc::ResidualFn> ResidualLocked() const override {
+    return std::make_unique<ResidualFn>(residual_);
+  }
+  ResidualFn* InternalResidual() override { return &residual_; }
+  ResidualFn residual_;
+};
+
+// parameter Jacobians on the optimizer's perturbed models evaluate the
+// residual registered for the estimator model
+TEST(BatchParameter, ParticleUserSensor) {
+  // load model
+  mjModel* model = LoadTestModel("estimator/particle/task1D_user.xml");
+  model->opt.enableflags |= mjENBL_INVDISCRETE;
+
+  // dimensions
+  int nq = model->nq;
+  int nv = model->nv;
+  int ns = model->nsensordata;
+
+  // task evaluates the user sensors
+  SiteTask task;
+  task.Reset(model);
+  RegisterResidual(model, &task);
+  mjcb_sensor = ResidualSensorCallback;
+
+  // ----- rollout ----- //
+  int T = 5;
+  Simulation sim(model, T);
+  RegisterResidualAlias(sim.model, model);
+  double q[1] = {1.0};
+  sim.SetState(q, NULL);
+  auto controller = [](double* ctrl, double time) {};
+  sim.Rollout(controller);
+  EXPECT_NE(sim.sensor.Get(0)[2], 0.0);
+
+  // ----- batch ----- //
+  Batch batch(model, T);
+  RegisterResidual(batch.Model(), &task);
+
+  // set data
+  mju_copy(batch.configuration.Data(), sim.qpos.Data(), nq * T);
+  mju_copy(batch.configuration_previous.Data(), sim.qpos.Data(), nq * T);
+  mju_copy(batch.sensor_measurement.Data(), sim.sensor.Data(), ns * T);
+  mju_copy(batch.force_measurement.Data(), sim.qfrc_actuator.Data(), nv * T);
+  mju_copy(batch.parameters.data(), model->site_pos, 6);
+  batch.parameters[2] += 0.25;  // perturb site0 z coordinate
+  batch.parameters[5] -= 0.25;  // perturb site1 z coordinate
+
+  // noise
+  std::fill(batch.noise_process.begin(), batch.noise_process.end(), 1.0);
+  std::fill(batch.noise_sensor.begin(), batch.noise_sensor.end(), 1.0e-5);
+
+  // parameter prior
+  mju_copy(batch.parameters_previous.data(), model->site_pos, 6);
+  std::fill(batch.noise_parameter.begin(), batch.noise_parameter.end(), 1.0);
+
+  // optimize
+  batch.Optimize();
+
+  // parameters recovered from user sensors
+  for (int i = 0; i < 6; i++) {
+    EXPECT_NEAR(batch.parameters[i], model->site_pos[i], 1.0e-4);
+  }
+
+  // unregister + delete model
+  UnregisterResidual(batch.Model());
+  UnregisterResidual(sim.model);
+  UnregisterResidual(model);
+  mjcb_sensor = nullptr;
+  mj_deleteModel(model);
+}
+
 }  // namespace
 }  // namespace mjpc
@@ -111,5 +111,139 @@ TEST(Estimator, Kalman) {
   mj_deleteModel(model);
 }
 
+// run filters from the same prior on the same noisy rollout and expect the
+// same estimates, returns the last noisy sensor in sensor
+void ExpectSameEstimates(const mjModel* model, Kalman* reference,
+                         Kalman* filter, std::vector<double>* sensor) {
+  // ----- rollout ----- //
+  int T = 50;
+  Simulation sim(model, T);
+  auto controller = [](double* ctrl, double time) {};
+  double qpos0[1] = {0.25};
+  sim.SetState(qpos0, NULL);
+  sim.Rollout(controller);
+
+  // same initial state and covariance
+  int ndstate = reference->DimensionProcess();
+  std::vector<double> covariance(ndstate * ndstate);
+  mju_eye(covariance.data(), ndstate);
+  mju_scl(covariance.data(), covariance.data(), 1.0e-3, ndstate * ndstate);
+  for (Kalman* kalman : {reference, filter}) {
+    mju_copy(kalman->state.data(), sim.qpos.Get(0), model->nq);
+    mju_copy(kalman->state.data() + model->nq, sim.qvel.Get(0), model->nv);
+    kalman->SetCovariance(covariance.data());
+    mju_fill(kalman->noise_process.data(), 1.0e-5, ndstate);
+    mju_fill(kalman->noise_sensor.data(), 1.0e-5, model->nsensordata);
+  }
+
+  // same estimate after each update
+  auto expect_same = [&]() {
+    for (int i = 0; i < model->nq + model->nv; i++) {
+      EXPECT_NEAR(filter->state[i], reference->state[i], 1.0e-8);
+    }
+    const double* expected = reference->Covariance();
+    const double* actual = filter->Covariance();
+    for (int i = 0; i < ndstate * ndstate; i++) {
+      EXPECT_NEAR(actual[i], expected[i], 1.0e-10);
+    }
+  };
+
+  // noisy sensor
+  sensor->resize(model->nsensordata);
+  absl::BitGen gen_;
+
+  for (int t = 0; t < T; t++) {
+    // noisy sensor
+    mju_copy(sensor->data(), sim.sensor.Get(t), model->nsensordata);
+    for (int i = 0; i < model->nsensordata; i++) {
+      (*sensor)[i] += 1.0e-3 * absl::Gaussian<double>(gen_, 0.0, 1.0);
+    }
+
+    // measurement updates
+    reference->UpdateMeasurement(sim.ctrl.Get(t), sensor->data());
+    filter->UpdateMeasurement(sim.ctrl.Get(t), sensor->data());
+    expect_same();
+
+    // prediction updates
+    reference->UpdatePrediction();
+    filter->UpdatePrediction();
+    expect_same();
+  }
+}
+
+TEST(Estimator, SquareRootKalman) {
+  // load model
+  mjModel* model = LoadTestModel("estimator/particle/task_imu.xml");
+
+  // dense and square-root filters
+  Kalman kalman(model);
+  SquareRootKalman square_root(model);
+  EXPECT_FALSE(kalman.settings.square_root);
+  EXPECT_TRUE(square_root.settings.square_root);
+
+  std::vector<double> sensor;
+  ExpectSameEstimates(model, &kalman, &square_root, &sensor);
+
+  // delete model
+  mj_deleteModel(model);
+}
+
+TEST(Estimator, SquareRootKalmanSequential) {
+  // load model
+  mjModel* model = LoadTestModel("estimator/particle/task_imu.xml");
+
+  // the square-root update takes precedence over sequential updates
+  Kalman kalman(model);
+  SquareRootKalman square_root(model);
+  square_root.settings.sequential = true;
+
+  std::vector<double> sensor;
+  ExpectSameEstimates(model, &kalman, &square_root, &sensor);
+  EXPECT_EQ(square_root.NumSensorUpdated(), 0);
+
+  // delete model
+  mj_deleteModel(model);
+}
+
+TEST(Estimator, SequentialKalman) {
+  // load model
+  mjModel* model = LoadTestModel("estimator/particle/task_imu.xml");
+
+  // dense and sequential filters
+  Kalman kalman(model);
+  Kalman sequential(model);
+  sequential.settings.sequential = true;
+
+  std::vector<double> sensor;
+  ExpectSameEstimates(model, &kalman, &sequential, &sensor);
+  EXPECT_EQ(sequential.NumSensorUpdated(), model->nsensor);
+
+  // repeated sensor values are used without a mask
+  std::vector<double> ctrl(model->nu);
+  sequential.UpdateMeasurement(ctrl.data(), sensor.data());
+  EXPECT_EQ(sequential.NumSensorUpdated(), model->nsensor);
+
+  // sensors without new data are skipped
+  std::vector<int> mask(model->nsensor, 0);
+  std::vector<double> state = sequential.state;
+  std::vector<double> covariance = sequential.covariance;
+  sequential.UpdateMeasurement(ctrl.data(), sensor.data(), mask.data());
+  EXPECT_EQ(sequential.NumSensorUpdated(), 0);
+  for (int i = 0; i < model->nsensor; i++) {
+    EXPECT_EQ(sequential.TimerSensor(i), 0.0);
+  }
+  EXPECT_EQ(sequential.state, state);
+  EXPECT_EQ(sequential.covariance, covariance);
+
+  // only the flagged sensor is updated
+  mask[0] = 1;
+  sequential.UpdateMeasurement(ctrl.data(), sensor.data(), mask.data());
+  EXPECT_EQ(sequential.NumSensorUpdated(), 1);
+  EXPECT_NE(sequential.covariance, covariance);
+
+  // delete model
+  mj_deleteModel(model);
+}
+
 }  // namespace
 }  // namespace mjpc
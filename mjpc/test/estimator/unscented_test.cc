@@ -23,6 +23,7 @@
 #include "mjpc/direct/trajectory.h"
 #include "mjpc/test/load.h"
 #include "mjpc/test/simulation.h"
+#include "mjpc/threadpool.h"
 #include "mjpc/utilities.h"
 
 namespace mjpc {
@@ -186,5 +187,124 @@ TEST(Unscented, Box3Drot) {
   mj_deleteModel(model);
 }
 
+TEST(Unscented, ParallelSigmaPoints) {
+  // load model
+  mjModel* model = LoadTestModel("estimator/box/task3Drot.xml");
+
+  // ----- rollout ----- //
+  int T = 10;
+  Simulation sim(model, T);
+  auto controller = [](double* ctrl, double time) {};
+  double qvel[3] = {1.0, -0.75, 1.25};
+  sim.SetState(NULL, qvel);
+  sim.Rollout(controller);
+
+  // ----- Unscented ----- //
+
+  // serial and parallel filters
+  Unscented serial(model);
+  Unscented parallel(model);
+  ThreadPool pool(3);
+  parallel.pool = &pool;
+  EXPECT_EQ(serial.Pool(), nullptr);
+  EXPECT_EQ(parallel.Pool(), &pool);
+
+  // same initial state
+  for (Unscented* unscented : {&serial, &parallel}) {
+    mju_copy(unscented->state.data(), sim.qpos.Get(0), model->nq);
+    mju_copy(unscented->state.data() + model->nq, sim.qvel.Get(0), model->nv);
+  }
+
+  int ndstate = serial.DimensionProcess();
+  for (int t = 0; t < T - 1; t++) {
+    // update
+    serial.Update(sim.ctrl.Get(t), sim.sensor.Get(t));
+    parallel.Update(sim.ctrl.Get(t), sim.sensor.Get(t));
+
+    // sigma points are reduced in the same order
+    for (int i = 0; i < model->nq + model->nv; i++) {
+      EXPECT_EQ(parallel.state[i], serial.state[i]);
+    }
+    for (int i = 0; i < ndstate * ndstate; i++) {
+      EXPECT_EQ(parallel.covariance[i], serial.covariance[i]);
+    }
+    EXPECT_EQ(parallel.Time(), serial.Time());
+  }
+
+  // delete model
+  mj_deleteModel(model);
+}
+
+TEST(Unscented, SquareRoot) {
+  // load model
+  mjModel* model = LoadTestModel("estimator/box/task3Drot.xml");
+
+  // ----- rollout ----- //
+  int T = 20;
+  Simulation sim(model, T);
+  auto controller = [](double* ctrl, double time) {};
+  double qvel[3] = {1.0, -0.75, 1.25};
+  sim.SetState(NULL, qvel);
+  sim.Rollout(controller);
+
+  // ----- Unscented ----- //
+
+  // dense and square-root filters
+  Unscented unscented(model);
+  SquareRootUnscented square_root(model);
+  EXPECT_TRUE(square_root.settings.square_root);
+
+  // same initial state and covariance
+  int ndstate = unscented.DimensionProcess();
+  for (Unscented* filter :
+       {&unscented, static_cast<Unscented*>(&square_root)}) {
+    mju_copy(filter->state.data(), sim.qpos.Get(0), model->nq);
+    mju_copy(filter->state.data() + model->nq, sim.qvel.Get(0), model->nv);
+    mju_eye(filter->covariance.data(), ndstate);
+    mju_scl(filter->covariance.data(), filter->covariance.data(), 1.0e-5,
+            ndstate * ndstate);
+    mju_fill(filter->noise_process.data(), 1.0e-5, ndstate);
+    mju_fill(filter->noise_sensor.data(), 1.0e-5, model->nsensordata);
+  }
+
+  for (int t = 0; t < T - 1; t++) {
+    // update
+    unscented.Update(sim.ctrl.Get(t), sim.sensor.Get(t));
+    square_root.Update(sim.ctrl.Get(t), sim.sensor.Get(t));
+
+    // same estimate
+    for (int i = 0; i < model->nq + model->nv; i++) {
+      EXPECT_NEAR(square_root.state[i], unscented.state[i], 1.0e-8);
+    }
+    const double* covariance = square_root.Covariance();
+    for (int i = 0; i < ndstate * ndstate; i++) {
+      EXPECT_NEAR(covariance[i], unscented.covariance[i], 1.0e-10);
+    }
+  }
+
+  // factor reproduces covariance
+  std::vector<double> product(ndstate * ndstate);
+  const double* factor = square_root.CovarianceFactor();
+  mju_mulMatMatT(product.data(), factor, factor, ndstate, ndstate, ndstate);
+  for (int i = 0; i < ndstate * ndstate; i++) {
+    EXPECT_NEAR(product[i], square_root.Covariance()[i], 1.0e-12);
+  }
+
+  // covariance set externally is refactorized
+  std::vector<double> identity(ndstate * ndstate);
+  mju_eye(identity.data(), ndstate);
+  square_root.SetCovariance(identity.data());
+  unscented.SetCovariance(identity.data());
+  unscented.Update(sim.ctrl.Get(T - 1), sim.sensor.Get(T - 1));
+  square_root.Update(sim.ctrl.Get(T - 1), sim.sensor.Get(T - 1));
+  const double* covariance = square_root.Covariance();
+  for (int i = 0; i < ndstate * ndstate; i++) {
+    EXPECT_NEAR(covariance[i], unscented.covariance[i], 1.0e-8);
+  }
+
+  // delete model
+  mj_deleteModel(model);
+}
+
 }  // namespace
 }  // namespace mjpc
@@ -155,5 +155,60 @@ TEST(GradientTest, CubicTest) {
   EXPECT_NEAR(mju_L1(map_error, n * T * n * S), 0.0, 1.0e-5);
 }
 
+// test banded application and caching of cubic spline mapping
+TEST(GradientTest, CubicBandedTest) {
+  // spline points
+  const int S = 6;
+  std::vector<double> x = {0.1, 0.3, 0.7, 1.2, 1.21, 1.6};
+
+  // times
+  const int n = 2;
+  const int T = 10;
+  double t[T];
+  for (int i = 0; i < T; i++) {
+    t[i] = x[0] + i * (x[S - 1] - x[0]) / (T - 1);
+  }
+
+  CubicSplineMapping csm;
+  csm.Allocate(n);
+  EXPECT_TRUE(csm.Update(x, S, t, T));
+  const double* M = csm.mapping.data();
+
+  // A * v
+  double v[n * S] = {-1.0, 0.2, 0.5, 0.7, 0.1, 0.34,
+                     -0.7, 0.9, 0.2, 0.1, -0.05, 1.0};
+  double dense[n * T], banded[n * T];
+  mju_mulMatVec(dense, M, v, n * T, n * S);
+  csm.MulVec(banded, v);
+  for (int i = 0; i < n * T; i++) EXPECT_NEAR(banded[i], dense[i], 1.0e-12);
+
+  // A' * w
+  double w[n * T];
+  for (int i = 0; i < n * T; i++) w[i] = 0.1 * i - 0.5;
+  double denseT[n * S], bandedT[n * S];
+  mju_mulMatTVec(denseT, M, w, n * T, n * S);
+  csm.MulTVec(bandedT, w);
+  for (int i = 0; i < n * S; i++) EXPECT_NEAR(bandedT[i], denseT[i], 1.0e-12);
+
+  // A' * A
+  double gram[n * S * n * S], gram_banded[n * S * n * S];
+  mju_mulMatTMat(gram, M, M, n * T, n * S, n * S);
+  csm.Gram(gram_banded);
+  for (int i = 0; i < n * S * n * S; i++) {
+    EXPECT_NEAR(gram_banded[i], gram[i], 1.0e-12);
+  }
+
+  // shifted grids use cached mapping
+  std::vector<double> xs(S);
+  double ts[T];
+  for (int i = 0; i < S; i++) xs[i] = x[i] + 0.25;
+  for (int i = 0; i < T; i++) ts[i] = t[i] + 0.25;
+  EXPECT_FALSE(csm.Update(xs, S, ts, T));
+
+  // changed grid recomputes
+  xs[2] += 0.01;
+  EXPECT_TRUE(csm.Update(xs, S, ts, T));
+}
+
 }  // namespace
 }  // namespace mjpc
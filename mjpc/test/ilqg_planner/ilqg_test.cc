@@ -12,6 +12,8 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
+#include <vector>
+
 #include "gtest/gtest.h"
 #include <mujoco/mujoco.h>
 #include "mjpc/planners/ilqg/planner.h"
@@ -93,27 +95,31 @@ TEST(iLQGTest, Particle) {
   }
 
   // test final state
-  EXPECT_NEAR(planner.candidate_policy[0]
-                  .trajectory.states[(steps - 1) * (model->nq + model->nv)],
-              state.mocap()[0], 1.0e-2);
-  EXPECT_NEAR(planner.candidate_policy[0]
-                  .trajectory.states[(steps - 1) * (model->nq + model->nv) + 1],
-              state.mocap()[1], 1.0e-2);
-  EXPECT_NEAR(planner.candidate_policy[0]
-                  .trajectory.states[(steps - 1) * (model->nq + model->nv) + 2],
-              0.0, 1.0e-1);
-  EXPECT_NEAR(planner.candidate_policy[0]
-                  .trajectory.states[(steps - 1) * (model->nq + model->nv) + 3],
-              0.0, 1.0e-1);
+  EXPECT_NEAR(
+      planner.candidate_policy.trajectory
+          .states[(steps - 1) * (model->nq + model->nv)],
+      state.mocap()[0], 1.0e-2);
+  EXPECT_NEAR(
+      planner.candidate_policy.trajectory
+          .states[(steps - 1) * (model->nq + model->nv) + 1],
+      state.mocap()[1], 1.0e-2);
+  EXPECT_NEAR(
+      planner.candidate_policy.trajectory
+          .states[(steps - 1) * (model->nq + model->nv) + 2],
+      0.0, 1.0e-1);
+  EXPECT_NEAR(
+      planner.candidate_policy.trajectory
+          .states[(steps - 1) * (model->nq + model->nv) + 3],
+      0.0, 1.0e-1);
 
   // test action limits
   for (int t = 0; t < steps - 1; t++) {
     for (int i = 0; i < model->nu; i++) {
       EXPECT_LE(
-          planner.candidate_policy[0].trajectory.actions[t * model->nu + i],
+          planner.candidate_policy.trajectory.actions[t * model->nu + i],
           model->actuator_ctrlrange[2 * i + 1]);
       EXPECT_GE(
-          planner.candidate_policy[0].trajectory.actions[t * model->nu + i],
+          planner.candidate_policy.trajectory.actions[t * model->nu + i],
           model->actuator_ctrlrange[2 * i]);
     }
   }
@@ -125,5 +131,234 @@ TEST(iLQGTest, Particle) {
   mj_deleteModel(model);
 }
 
+// optimize particle task and return final nominal return
+double OptimizeParticle(int num_segment, int iterations, double* max_defect,
+                        double* first_return) {
+  // load model
+  model = LoadTestModel("particle_task.xml");
+  task.Reset(model);
+
+  // create data
+  mjData* data = mj_makeData(model);
+  mj_forward(model, data);
+
+  // state
+  state.Initialize(model);
+  state.Allocate(model);
+  state.Reset();
+  state.Set(model, data);
+
+  // planner
+  iLQGPlanner planner;
+  planner.Initialize(model, task);
+  planner.Allocate();
+  planner.Reset(kMaxTrajectoryHorizon);
+  planner.settings.num_segment = num_segment;
+
+  // settings
+  double horizon = 2.5;
+  double timestep = 0.1;
+  int steps =
+      mju_max(mju_min(horizon / timestep + 1, kMaxTrajectoryHorizon), 1);
+  model->opt.timestep = timestep;
+
+  // sensor callback
+  mjcb_sensor = sensor;
+
+  // threadpool
+  ThreadPool pool(2);
+
+  // optimize from a fixed state
+  planner.SetState(state);
+  *max_defect = 0.0;
+  for (int i = 0; i < iterations; i++) {
+    planner.OptimizePolicy(steps, pool);
+    if (i == 0) {
+      *first_return = planner.candidate_policy.trajectory.total_return;
+    }
+
+    // segments are used after the first iteration
+    if (num_segment > 1 && i > 0) {
+      EXPECT_TRUE(planner.MultipleShooting());
+      *max_defect = planner.MaxDefect();
+    }
+  }
+  double total_return = planner.policy.trajectory.total_return;
+
+  // delete data + model
+  mj_deleteData(data);
+  mj_deleteModel(model);
+
+  return total_return;
+}
+
+// test iLQG planner with multiple shooting on particle task
+TEST(iLQGTest, MultipleShooting) {
+  int iterations = 10;
+
+  // single shooting
+  double single_defect, single_first;
+  double single_return =
+      OptimizeParticle(1, iterations, &single_defect, &single_first);
+
+  // multiple shooting
+  double multiple_defect, multiple_first;
+  double multiple_return =
+      OptimizeParticle(4, iterations, &multiple_defect, &multiple_first);
+
+  // defects vanish once the nominal policy reproduces its trajectory
+  EXPECT_NEAR(multiple_defect, 0.0, 1.0e-6);
+
+  // cost decreases and matches single shooting
+  EXPECT_LT(multiple_return, multiple_first);
+  EXPECT_LE(multiple_return, single_return + 1.0e-3 * mju_abs(single_return));
+}
+
+// test policy view with action step matches materialized policy
+TEST(iLQGPolicyViewTest, ActionStep) {
+  // load model
+  model = LoadTestModel("particle_task.xml");
+  task.Reset(model);
+
+  // dimensions
+  int dim_state = model->nq + model->nv + model->na;
+  int dim_state_derivative = 2 * model->nv + model->na;
+  int dim_action = model->nu;
+  const int T = 5;
+  double action_step = 0.3;
+  double feedback_scaling = 0.5;
+
+  // nominal policy
+  iLQGPolicy nominal;
+  nominal.Allocate(model, task, T);
+  nominal.Reset(T);
+  nominal.trajectory.horizon = T;
+  for (int t = 0; t < T; t++) {
+    nominal.trajectory.times[t] = 0.1 * t;
+    for (int i = 0; i < dim_state; i++) {
+      nominal.trajectory.states[t * dim_state + i] = 0.01 * (t + i);
+    }
+    for (int i = 0; i < dim_action; i++) {
+      nominal.trajectory.actions[t * dim_action + i] = 0.1 * (i - t);
+      nominal.action_improvement[t * dim_action + i] = 0.05 * (t + i + 1);
+    }
+    for (int i = 0; i < dim_action * dim_state_derivative; i++) {
+      nominal.feedback_gain[t * dim_action * dim_state_derivative + i] =
+          -0.1 * (i % 3 + 1);
+    }
+  }
+
+  // materialized candidate: u + action_step * du, no action improvement
+  iLQGPolicy materialized;
+  materialized.Allocate(model, task, T);
+  materialized.Reset(T);
+  materialized.CopyFrom(nominal, T);
+  mju_addToScl(materialized.trajectory.actions.data(),
+               nominal.action_improvement.data(), action_step,
+               T * dim_action);
+  mju_zero(materialized.action_improvement.data(), T * dim_action);
+
+  // views
+  iLQGPolicyView view;
+  view.Allocate(model);
+  view.Set(&nominal, action_step, feedback_scaling);
+  iLQGPolicyView materialized_view;
+  materialized_view.Allocate(model);
+  materialized_view.Set(&materialized, 0.0, feedback_scaling);
+
+  std::vector<double> state(dim_state, 0.02);
+  std::vector<double> action(dim_action);
+  std::vector<double> reference(dim_action);
+  for (int representation = 0; representation < 3; representation++) {
+    nominal.representation = representation;
+    materialized.representation = representation;
+
+    // continuous time, between knots
+    for (int t = 0; t < T - 1; t++) {
+      double time = 0.1 * t + 0.03;
+      view.Action(action.data(), state.data(), time);
+      materialized_view.Action(reference.data(), state.data(), time);
+      for (int i = 0; i < dim_action; i++) {
+        EXPECT_NEAR(action[i], reference[i], 1.0e-12);
+      }
+    }
+  }
+
+  // discrete time
+  for (int t = 0; t < T - 1; t++) {
+    view.ActionDiscrete(action.data(), state.data(), t);
+    materialized_view.ActionDiscrete(reference.data(), state.data(), t);
+    for (int i = 0; i < dim_action; i++) {
+      EXPECT_NEAR(action[i], reference[i], 1.0e-12);
+    }
+  }
+
+  // delete model
+  mj_deleteModel(model);
+}
+
+// test updated policy replays the winning line-search candidate
+TEST(iLQGTest, WinnerPolicy) {
+  // load model
+  model = LoadTestModel("particle_task.xml");
+  task.Reset(model);
+
+  // create data
+  mjData* data = mj_makeData(model);
+  mj_forward(model, data);
+
+  // state
+  state.Initialize(model);
+  state.Allocate(model);
+  state.Reset();
+  state.Set(model, data);
+
+  // planner
+  iLQGPlanner planner;
+  planner.Initialize(model, task);
+  planner.Allocate();
+  planner.Reset(kMaxTrajectoryHorizon);
+
+  // settings
+  int steps = 11;
+  model->opt.timestep = 0.1;
+
+  // sensor callback
+  mjcb_sensor = sensor;
+
+  // threadpool
+  ThreadPool pool(2);
+
+  // a few iterations
+  planner.SetState(state);
+  for (int i = 0; i < 3; i++) {
+    planner.OptimizePolicy(steps, pool);
+  }
+
+  // winner has the lowest return among the candidates
+  const Trajectory& winner = planner.trajectory[planner.winner];
+  EXPECT_FALSE(winner.failure);
+  EXPECT_EQ(planner.BestRollout(), planner.winner);
+
+  // policy reference is the winner's rollout
+  int dim_state = model->nq + model->nv + model->na;
+  int nu = model->nu;
+  EXPECT_EQ(planner.policy.trajectory.total_return, winner.total_return);
+
+  // policy replays the winner's actions at the winner's states
+  std::vector<double> action(nu);
+  for (int t = 0; t < steps - 1; t++) {
+    planner.policy.Action(action.data(), winner.states.data() + t * dim_state,
+                          winner.times[t]);
+    for (int i = 0; i < nu; i++) {
+      EXPECT_NEAR(action[i], winner.actions[t * nu + i], 1.0e-10);
+    }
+  }
+
+  // delete data + model
+  mj_deleteData(data);
+  mj_deleteModel(model);
+}
+
 }  // namespace
 }  // namespace mjpc
@@ -12,6 +12,8 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
+#include <chrono>
+
 #include "gtest/gtest.h"
 #include <mujoco/mujoco.h>
 #include "mjpc/planners/sampling/planner.h"
@@ -114,5 +116,63 @@ TEST(SamplingPlannerTest, RandomSearch) {
   mj_deleteModel(model);
 }
 
+
+// test sampling planner within a planning budget
+TEST(SamplingPlannerTest, Budget) {
+  // load model
+  model = LoadTestModel("particle_task.xml");
+  task.Reset(model);
+
+  // create data
+  mjData* data = mj_makeData(model);
+
+  // ----- state ----- //
+  state.Initialize(model);
+  state.Allocate(model);
+  state.Reset();
+  state.Set(model, data);
+
+  // ----- sampling planner ----- //
+  SamplingPlanner planner;
+  planner.Initialize(model, task);
+  planner.Allocate();
+  planner.Reset(kMaxTrajectoryHorizon);
+  planner.SetState(state);
+  int steps = 11;
+  model->opt.timestep = 0.1;
+
+  // sensor callback
+  mjcb_sensor = sensor;
+
+  // threadpool
+  ThreadPool pool(1);
+
+  // unlimited
+  planner.StartBudget(std::chrono::steady_clock::now(), 0.0);
+  planner.OptimizePolicy(steps, pool);
+  planner.StopBudget();
+  EXPECT_EQ(planner.BudgetUsed(), 0.0);
+
+  // generous budget
+  planner.StartBudget(std::chrono::steady_clock::now(), 10.0);
+  planner.OptimizePolicy(steps, pool);
+  planner.StopBudget();
+  EXPECT_GT(planner.BudgetUsed(), 0.0);
+  EXPECT_LT(planner.BudgetUsed(), 1.0);
+
+  // exhausted budget still returns a policy
+  planner.StartBudget(std::chrono::steady_clock::now(), 1.0e-9);
+  planner.OptimizePolicy(steps, pool);
+  planner.StopBudget();
+  EXPECT_GT(planner.BudgetUsed(), 1.0);
+  EXPECT_NE(planner.BestTrajectory(), nullptr);
+
+  // delete data
+  mj_deleteData(data);
+
+  // delete model
+  mj_deleteModel(model);
+}
+
 }  // namespace
 }  // namespace mjpc
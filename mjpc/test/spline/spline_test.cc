@@ -158,6 +158,70 @@ TEST(TimeSplineTest, Cubic) {
   }
 }
 
+TEST_P(TimeSplineAllInterpolationsTest, SampleRange) {
+  const TimeSplineTestCase& test_case = GetParam();
+  TimeSpline spline(/*dim=*/2);
+  spline.SetInterpolation(test_case.interpolation);
+
+  std::vector<double> values(2 * 40);
+  spline.SampleRange(0.0, 0.1, 40, absl::MakeSpan(values));
+  for (double value : values) {
+    EXPECT_EQ(value, 0.0);
+  }
+
+  spline.AddNode(0.5, {1.0, 2.0});
+  spline.AddNode(1.0, {2.0, 0.0});
+  spline.AddNode(2.25, {-1.0, 4.0});
+  spline.AddNode(3.0, {3.0, 4.0});
+
+  // samples before, inside and after the nodes match single samples
+  spline.SampleRange(0.0, 0.1, 40, absl::MakeSpan(values));
+  double time = 0.0;
+  for (int k = 0; k < 40; k++) {
+    std::vector<double> sample = spline.Sample(time);
+    EXPECT_EQ(values[2 * k], sample[0]) << "time " << time;
+    EXPECT_EQ(values[2 * k + 1], sample[1]) << "time " << time;
+    time += 0.1;
+  }
+}
+
+TEST(TimeSplineTest, CubicCoefficients) {
+  TimeSpline spline(/*dim=*/2, SplineInterpolation::kCubicSpline);
+  spline.AddNode(0.0, {1.0, 2.0});
+  spline.AddNode(1.0, {2.0, 0.0});
+  spline.AddNode(2.5, {-1.0, 4.0});
+  spline.AddNode(3.0, {3.0, 4.0});
+
+  // cached coefficients match slopes computed from the nodes
+  TimeSpline cached = spline;
+  cached.UpdateCoefficients();
+  for (double time = -0.5; time < 3.5; time += 0.125) {
+    std::vector<double> expected = spline.Sample(time);
+    std::vector<double> actual = cached.Sample(time);
+    EXPECT_NEAR(actual[0], expected[0], 1.0e-12) << "time " << time;
+    EXPECT_NEAR(actual[1], expected[1], 1.0e-12) << "time " << time;
+  }
+
+  // editing a node through a view only affects nearby intervals
+  cached.NodeAt(3).values()[0] = 5.0;
+  spline.NodeAt(3).values()[0] = 5.0;
+  EXPECT_THAT(cached.Sample(2.75), ElementsAre(spline.Sample(2.75)[0],
+                                               spline.Sample(2.75)[1]));
+  cached.UpdateCoefficients();
+  EXPECT_NEAR(cached.Sample(2.75)[0], spline.Sample(2.75)[0], 1.0e-12);
+
+  // discarding and adding nodes updates the end intervals
+  EXPECT_EQ(cached.DiscardBefore(2.6), 1);
+  EXPECT_EQ(spline.DiscardBefore(2.6), 1);
+  cached.AddNode(4.0, {0.0, 1.0});
+  spline.AddNode(4.0, {0.0, 1.0});
+  cached.UpdateCoefficients();
+  for (double time = 1.0; time < 4.0; time += 0.125) {
+    EXPECT_NEAR(cached.Sample(time)[0], spline.Sample(time)[0], 1.0e-12);
+    EXPECT_NEAR(cached.Sample(time)[1], spline.Sample(time)[1], 1.0e-12);
+  }
+}
+
 TEST_P(TimeSplineAllInterpolationsTest, DiscardBefore) {
   const TimeSplineTestCase& test_case = GetParam();
   TimeSpline spline(/*dim=*/2);
@@ -217,12 +281,12 @@ TEST(TimeSplineTest, DiscardBeforeRingLoop) {
 
   EXPECT_EQ(spline.DiscardBefore(3), 2);
   EXPECT_EQ(spline.Size(), 2);
-  // At this point, values_begin_ = 2, values_end_ = 4. Adding two more entries
+  // At this point, the first node is in slot 2 of 4. Adding two more entries
   // so the ring buffer loops around.
   spline.AddNode(5.0, {5.0});
   spline.AddNode(6.0, {6.0});
 
-  // Remove elements so that values_begin_ has to go around the end of the
+  // Remove elements so that the first node has to go around the end of the
   // buffer.
   EXPECT_EQ(spline.DiscardBefore(6.0), 3);
   EXPECT_EQ(spline.Size(), 1);
@@ -230,6 +294,34 @@ TEST(TimeSplineTest, DiscardBeforeRingLoop) {
   EXPECT_EQ(spline.Sample(1.0)[0], 6.0);
 }
 
+TEST(TimeSplineTest, CopyAssignmentRingBuffer) {
+  TimeSpline spline(/*dim=*/2);
+  spline.SetInterpolation(SplineInterpolation::kLinearSpline);
+  spline.Reserve(4);
+
+  // loop the ring buffer around
+  spline.AddNode(1.0, {1.0, 2.0});
+  spline.AddNode(2.0, {2.0, 3.0});
+  spline.AddNode(3.0, {3.0, 4.0});
+  EXPECT_EQ(spline.DiscardBefore(2.5), 1);
+  spline.AddNode(4.0, {4.0, 5.0});
+  spline.AddNode(5.0, {5.0, 6.0});
+  EXPECT_EQ(spline.Size(), 4);
+
+  // copy into a spline with a larger buffer, and into one that's too small
+  TimeSpline spline2(/*dim=*/2, SplineInterpolation::kZeroSpline,
+                     /*initial_capacity=*/8);
+  TimeSpline spline3(/*dim=*/2);
+  spline2 = spline;
+  spline3 = spline;
+  for (TimeSpline* copy : {&spline2, &spline3}) {
+    EXPECT_EQ(copy->Size(), 4);
+    EXPECT_EQ(copy->Interpolation(), SplineInterpolation::kLinearSpline);
+    EXPECT_THAT(copy->Sample(2.5), ElementsAre(2.5, 3.5));
+    EXPECT_THAT(copy->Sample(4.5), ElementsAre(4.5, 5.5));
+  }
+}
+
 TEST(TimeSplineTest, ReserveAfterAdd) {
   TimeSpline spline(/*dim=*/2);
   spline.SetInterpolation(SplineInterpolation::kLinearSpline);
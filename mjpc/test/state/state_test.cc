@@ -14,6 +14,9 @@
 
 #include "mjpc/states/state.h"
 
+#include <cstdint>
+#include <memory>
+
 #include "gtest/gtest.h"
 #include <mujoco/mujoco.h>
 #include "mjpc/test/load.h"
@@ -49,27 +52,41 @@ class StateTest : public ::testing::Test {
     mju_copy(data->mocap_quat, mocap + 3, 4);
 
     // set state state
+    std::uint64_t sequence = state.Sequence();
+    state.Set(model, data);
+    EXPECT_GT(state.Sequence(), sequence);
+
+    // held snapshots don't change
+    std::shared_ptr<const StateSnapshot> snapshot = state.Snapshot();
+    EXPECT_EQ(snapshot->sequence, state.Sequence());
+
+    // unchanged state isn't published
+    sequence = state.Sequence();
     state.Set(model, data);
+    EXPECT_EQ(state.Sequence(), sequence);
+    EXPECT_EQ(state.Snapshot(), snapshot);
 
     // test state state
-    EXPECT_NEAR(state.state_[0], 1.0, 1.0e-5);
-    EXPECT_NEAR(state.state_[1], 1.0, 1.0e-5);
-    EXPECT_NEAR(state.state_[2], 2.0, 1.0e-5);
-    EXPECT_NEAR(state.state_[2], 2.0, 1.0e-5);
+    EXPECT_NEAR(state.state()[0], 1.0, 1.0e-5);
+    EXPECT_NEAR(state.state()[1], 1.0, 1.0e-5);
+    EXPECT_NEAR(state.state()[2], 2.0, 1.0e-5);
+    EXPECT_NEAR(state.state()[2], 2.0, 1.0e-5);
 
     // test state mocap state
     double mocap_error[7];
-    mju_sub(mocap_error, state.mocap_.data(), data->mocap_pos, 3);
-    mju_sub(mocap_error + 3, DataAt(state.mocap_, 3), data->mocap_quat, 4);
+    mju_sub(mocap_error, state.mocap().data(), data->mocap_pos, 3);
+    mju_sub(mocap_error + 3, DataAt(state.mocap(), 3), data->mocap_quat, 4);
 
     EXPECT_NEAR(mju_L1(mocap_error, 7), 0.0, 1.0e-5);
 
     // reset
     state.Reset();
+    EXPECT_GT(state.Sequence(), snapshot->sequence);
+    EXPECT_NEAR(snapshot->state[0], 1.0, 1.0e-5);
 
     // test reset
-    EXPECT_NEAR(mju_L1(state.state_.data(), 4), 0.0, 1.0e-5);
-    EXPECT_NEAR(mju_L1(state.mocap_.data(), 7), 0.0, 1.0e-5);
+    EXPECT_NEAR(mju_L1(state.state().data(), 4), 0.0, 1.0e-5);
+    EXPECT_NEAR(mju_L1(state.mocap().data(), 7), 0.0, 1.0e-5);
 
     // delete model + data
     mj_deleteData(data);
@@ -15,6 +15,7 @@
 #include "mjpc/task.h"
 #include <memory>
 #include <string>
+#include <vector>
 
 #include "gtest/gtest.h"
 #include <mujoco/mujoco.h>
@@ -22,6 +23,7 @@
 #include "mjpc/tasks/tasks.h"
 #include "mjpc/testspeed.h"
 #include "mjpc/test/load.h"
+#include "mjpc/utilities.h"
 
 namespace mjpc {
 namespace {
@@ -94,10 +96,260 @@ TEST(TasksTest, Task) {
   EXPECT_NEAR(mju_abs(tc - (mju_exp(task.risk * c) - 1.0) / task.risk), 0.0,
               1.0e-5);
 
+  // batched costs
+  double residuals[8];
+  mju_copy(residuals, residual, 4);
+  mju_copy(residuals + 4, residual, 4);
+  double costs[2];
+  task.CostValues(costs, residuals, 2, 4);
+
+  // test batched costs
+  EXPECT_NEAR(costs[0], tc, 1.0e-12);
+  EXPECT_NEAR(costs[1], tc, 1.0e-12);
+
   // delete model
   mj_deleteModel(model);
 }
 
+// task with a hand-written term table, exposing the compiled cost program
+class CompiledTask : public Task {
+ public:
+  CompiledTask() : residual_(this) {}
+  std::string Name() const override { return ""; }
+  std::string XmlPath() const override { return ""; }
+
+  class ResidualFn : public BaseResidualFn {
+   public:
+    explicit ResidualFn(CompiledTask* task) : BaseResidualFn(task) {}
+    void Residual(const mjModel*, const mjData*, double*) const override {}
+    int NumInstructions() const { return cost_program_.size(); }
+    const CostInstruction& Instruction(int i) const {
+      return cost_program_[i];
+    }
+  };
+
+  std::unique_ptr<mjpc::ResidualFn> ResidualLocked() const override {
+    return std::make_unique<ResidualFn>(residual_);
+  }
+  ResidualFn* InternalResidual() override { return &residual_; }
+  ResidualFn residual_;
+};
+
+// compiled cost program matches the term table
+TEST(TasksTest, CompileCost) {
+  CompiledTask task;
+
+  // terms: merged quadratics, zero weights and other norms
+  task.norm = {NormType::kQuadratic,      NormType::kQuadratic,
+               NormType::kL2,             NormType::kSmoothAbs2Loss,
+               NormType::kQuadratic,      NormType::kCosh,
+               NormType::kQuadratic,      NormType::kQuadratic};
+  task.dim_norm_residual = {2, 1, 2, 2, 1, 1, 2, 1};
+  task.weight = {2.0, 3.0, 0.0, 1.5, 0.0, 0.7, 0.5, 0.25};
+  task.num_term = task.norm.size();
+  task.num_norm_parameter.clear();
+  for (NormType norm : task.norm) {
+    task.num_norm_parameter.push_back(NormParameterDimension(norm));
+  }
+  task.norm_parameter = {0.1, 0.2, 0.3, 0.4};
+  task.num_residual = 12;
+  task.num_trace = 0;
+  task.risk = 0.0;
+  task.UpdateResidual();
+
+  // zero-weight terms dropped, adjacent quadratic terms merged
+  const CompiledTask::ResidualFn& fn = task.residual_;
+  ASSERT_EQ(fn.NumInstructions(), 4);
+  EXPECT_EQ(fn.Instruction(0).norm, NormType::kQuadratic);
+  EXPECT_EQ(fn.Instruction(0).residual_offset, 0);
+  EXPECT_EQ(fn.Instruction(0).dim, 3);
+  EXPECT_EQ(fn.Instruction(1).norm, NormType::kSmoothAbs2Loss);
+  EXPECT_EQ(fn.Instruction(1).residual_offset, 5);
+  EXPECT_EQ(fn.Instruction(1).parameter_offset, 1);
+  EXPECT_EQ(fn.Instruction(1).weight, 1.5);
+  EXPECT_EQ(fn.Instruction(2).norm, NormType::kCosh);
+  EXPECT_EQ(fn.Instruction(2).residual_offset, 8);
+  EXPECT_EQ(fn.Instruction(2).parameter_offset, 3);
+  EXPECT_EQ(fn.Instruction(3).norm, NormType::kQuadratic);
+  EXPECT_EQ(fn.Instruction(3).residual_offset, 9);
+  EXPECT_EQ(fn.Instruction(3).dim, 3);
+  for (int i = 0; i < fn.NumInstructions(); i++) {
+    EXPECT_NE(fn.Instruction(i).weight, 0.0);
+  }
+
+  // residuals
+  const int num = 3;
+  double residuals[num * 12];
+  for (int i = 0; i < num * 12; i++) {
+    residuals[i] = 0.1 * ((i * 7) % 11) - 0.4;
+  }
+
+  for (double risk : {0.0, 0.3}) {
+    task.risk = risk;
+    task.UpdateResidual();
+
+    // batched costs
+    double costs[num];
+    task.CostValues(costs, residuals, num, 12);
+
+    for (int k = 0; k < num; k++) {
+      const double* residual = residuals + k * 12;
+
+      // reference: weighted sum over terms
+      double reference = 0.0;
+      int f_shift = 0;
+      int p_shift = 0;
+      for (int i = 0; i < task.num_term; i++) {
+        reference +=
+            task.weight[i] * Norm(nullptr, nullptr, residual + f_shift,
+                                  task.norm_parameter.data() + p_shift,
+                                  task.dim_norm_residual[i], task.norm[i]);
+        f_shift += task.dim_norm_residual[i];
+        p_shift += task.num_norm_parameter[i];
+      }
+      if (risk != 0.0) {
+        reference = (mju_exp(risk * reference) - 1.0) / risk;
+      }
+
+      // test compiled costs
+      EXPECT_NEAR(task.CostValue(residual), reference, 1.0e-12);
+      EXPECT_NEAR(costs[k], reference, 1.0e-12);
+    }
+  }
+}
+
+// task whose residual is a constant
+class ConstantTask : public Task {
+ public:
+  explicit ConstantTask(double value) : residual_(this, value) {}
+  std::string Name() const override { return ""; }
+  std::string XmlPath() const override { return ""; }
+
+  class ResidualFn : public BaseResidualFn {
+   public:
+    ResidualFn(ConstantTask* task, double value)
+        : BaseResidualFn(task), value_(value) {}
+    void Residual(const mjModel* model, const mjData* data,
+                  double* residual) const override {
+      mju_fill(residual, value_, num_residual_);
+    }
+    double value_;
+  };
+
+  std::unique_ptr<mjpc::ResidualFn> ResidualLocked() const override {
+    return std::make_unique<ResidualFn>(residual_);
+  }
+  ResidualFn* InternalResidual() override { return &residual_; }
+  ResidualFn residual_;
+};
+
+// residuals are dispatched by model
+TEST(TasksTest, ResidualDispatch) {
+  // two models with different tasks
+  mjModel* model1 = LoadTestModel("particle_task.xml");
+  mjModel* model2 = mj_copyModel(nullptr, model1);
+  mjData* data1 = mj_makeData(model1);
+  mjData* data2 = mj_makeData(model2);
+  ConstantTask task1(1.0);
+  ConstantTask task2(2.0);
+  task1.Reset(model1);
+  task2.Reset(model2);
+
+  // register
+  RegisterResidual(model1, &task1);
+  RegisterResidual(model2, &task2, /*planning=*/true);
+  mjcb_sensor = ResidualSensorCallback;
+
+  mj_forward(model1, data1);
+  mj_forward(model2, data2);
+  for (int i = 0; i < task1.num_residual; i++) {
+    EXPECT_EQ(data1->sensordata[i], 1.0);
+    EXPECT_EQ(data2->sensordata[i], 2.0);
+  }
+
+  // the planning residual is used when set
+  ConstantTask::ResidualFn planning_residual(&task2, 3.0);
+  planning_residual.Update();
+  task2.SetPlanningResidual(&planning_residual);
+  mj_forward(model2, data2);
+  EXPECT_EQ(data2->sensordata[0], 3.0);
+  task2.SetPlanningResidual(nullptr);
+
+  // unregistered models are left alone
+  UnregisterResidual(model1);
+  mju_zero(data1->sensordata, model1->nsensordata);
+  mj_forward(model1, data1);
+  EXPECT_EQ(data1->sensordata[0], 0.0);
+
+  UnregisterResidual(model2);
+  mjcb_sensor = nullptr;
+  mj_deleteData(data1);
+  mj_deleteData(data2);
+  mj_deleteModel(model1);
+  mj_deleteModel(model2);
+}
+
+// repeated registrations replace the cached lookup of every thread
+TEST(TasksTest, ResidualReregister) {
+  mjModel* model = LoadTestModel("particle_task.xml");
+  mjData* data = mj_makeData(model);
+  mjcb_sensor = ResidualSensorCallback;
+
+  for (int i = 0; i < 100; i++) {
+    ConstantTask task(i);
+    task.Reset(model);
+    RegisterResidual(model, &task);
+    mj_forward(model, data);
+    EXPECT_EQ(data->sensordata[0], i);
+    UnregisterResidual(model);
+  }
+
+  // nothing registered
+  mju_zero(data->sensordata, model->nsensordata);
+  mj_forward(model, data);
+  EXPECT_EQ(data->sensordata[0], 0.0);
+
+  mjcb_sensor = nullptr;
+  mj_deleteData(data);
+  mj_deleteModel(model);
+}
+
+// residuals of the quadruped evaluate without name lookups
+TEST(TasksTest, QuadrupedNameLookupFree) {
+#ifdef NDEBUG
+  GTEST_SKIP() << "name lookups are only reported in debug builds";
+#else
+  std::shared_ptr<Task> task;
+  for (auto& t : GetTasks()) {
+    if (t->Name() == "Quadruped Flat") task = t;
+  }
+  ASSERT_NE(task, nullptr);
+
+  // load model
+  char error[1000] = "";
+  mjModel* model =
+      mj_loadXML(task->XmlPath().c_str(), nullptr, error, sizeof(error));
+  ASSERT_NE(model, nullptr) << error;
+  mjData* data = mj_makeData(model);
+  task->Reset(model);
+  mj_forward(model, data);
+
+  // task residual and planning copy
+  std::vector<double> residual(task->num_residual);
+  std::unique_ptr<ResidualFn> planning_residual = task->Residual();
+  {
+    NameLookupFreeScope no_name_lookup;
+    testing::internal::CaptureStderr();
+    task->Residual(model, data, residual.data());
+    planning_residual->Residual(model, data, residual.data());
+    EXPECT_EQ(testing::internal::GetCapturedStderr(), "");
+  }
+
+  mj_deleteData(data);
+  mj_deleteModel(model);
+#endif
+}
+
 TEST(StepAllTasksTest, Task) {
   auto tasks = GetTasks();
   for (auto& task : tasks) {
@@ -16,6 +16,7 @@
 
 #include <vector>
 #include <array>
+#include <string>
 
 #include <absl/random/random.h>
 #include <mujoco/mujoco.h>
@@ -663,6 +664,45 @@ TEST(Inverse, Mat3) {
   EXPECT_NEAR(res[8], sol[8], 1.0e-5);
 }
 
+TEST(TriangularFactor, Mat3x5) {
+  // matrix
+  double mat[15] = {1.0,  0.2, -0.3, 0.5, 0.1,  -0.4, 2.0, 0.3,
+                    0.0, 0.7, 0.6, -0.1, 1.5, 0.2, -0.8};
+
+  // mat * mat'
+  double product[9];
+  mju_mulMatMatT(product, mat, mat, 3, 5, 3);
+
+  // factor
+  double factor[9];
+  double scratch[5];
+  TriangularFactor(factor, mat, 3, 5, scratch);
+
+  // lower triangular, positive diagonal
+  EXPECT_EQ(factor[1], 0.0);
+  EXPECT_EQ(factor[2], 0.0);
+  EXPECT_EQ(factor[5], 0.0);
+  EXPECT_GT(factor[0], 0.0);
+  EXPECT_GT(factor[4], 0.0);
+  EXPECT_GT(factor[8], 0.0);
+
+  // factor * factor' = mat * mat'
+  double res[9];
+  mju_mulMatMatT(res, factor, factor, 3, 3, 3);
+  for (int i = 0; i < 9; i++) {
+    EXPECT_NEAR(res[i], product[i], 1.0e-10);
+  }
+
+  // same as Cholesky factor
+  int rank = mju_cholFactor(product, 3, 0.0);
+  EXPECT_EQ(rank, 3);
+  for (int i = 0; i < 3; i++) {
+    for (int j = 0; j <= i; j++) {
+      EXPECT_NEAR(factor[3 * i + j], product[3 * i + j], 1.0e-10);
+    }
+  }
+}
+
 TEST(ConditionMatrixDense, Mat3Dense) {
   // dimensions
   const int n = 3;
@@ -727,6 +767,43 @@ TEST(ConditionMatrixBand, Mat4Band) {
   EXPECT_NEAR(mju_norm(error, n1 * n1), 0.0, 1.0e-4);
 }
 
+TEST(BlockFromBand, Get) {
+  // dimensions
+  int dblock = 2;
+  int nblock = 3;
+  int ntotal = dblock * 5;
+  int nband = dblock * nblock;
+
+  // symmetric block band matrix
+  std::vector<double> F(ntotal * ntotal);
+  std::vector<double> A(ntotal * ntotal);
+  absl::BitGen gen_;
+  for (int i = 0; i < ntotal * ntotal; i++) {
+    F[i] = absl::Gaussian<double>(gen_, 0.0, 1.0);
+  }
+  mju_mulMatTMat(A.data(), F.data(), F.data(), ntotal, ntotal, ntotal);
+  DenseToBlockBand(A.data(), ntotal, dblock, nblock);
+
+  // band
+  std::vector<double> band(ntotal * nband);
+  mju_dense2Band(band.data(), A.data(), ntotal, nband, 0);
+
+  // blocks above, on, and below the diagonal, and outside the band
+  int rows[4] = {2, 4, 6, 0};
+  int cols[4] = {4, 4, 2, 8};
+  std::vector<double> block(3 * dblock * dblock);
+  std::vector<double> block_dense(3 * dblock * dblock);
+  for (int k = 0; k < 4; k++) {
+    BlockFromBand(block.data(), band.data(), nband, 3, dblock, rows[k],
+                  cols[k]);
+    BlockFromMatrix(block_dense.data(), A.data(), 3, dblock, ntotal, ntotal,
+                    rows[k], cols[k]);
+    for (int i = 0; i < 3 * dblock; i++) {
+      EXPECT_NEAR(block[i], block_dense[i], 1.0e-12);
+    }
+  }
+}
+
 TEST(BlockInBand, Set) {
   // set up (0)
   double block0[9] = {1, 2, 3, 2, 4, 5, 3, 5, 6};
@@ -797,5 +874,36 @@ TEST(BlockInBand, Set) {
   }
 }
 
+TEST(NameLookupFreeScope, SensorByName) {
+#ifdef NDEBUG
+  GTEST_SKIP() << "name lookups are only reported in debug builds";
+#else
+  mjModel* model = LoadTestModel("particle_task.xml");
+  mjData* data = mj_makeData(model);
+
+  // outside a scope: no report
+  testing::internal::CaptureStderr();
+  EXPECT_NE(SensorByName(model, data, "Position"), nullptr);
+  EXPECT_EQ(testing::internal::GetCapturedStderr(), "");
+
+  // inside a scope: lookup is reported
+  {
+    NameLookupFreeScope no_name_lookup;
+    testing::internal::CaptureStderr();
+    EXPECT_NE(SensorByName(model, data, "Position"), nullptr);
+    std::string output = testing::internal::GetCapturedStderr();
+    EXPECT_NE(output.find("name lookup \"Position\""), std::string::npos);
+  }
+
+  // scope closed
+  testing::internal::CaptureStderr();
+  SensorByName(model, data, "Velocity");
+  EXPECT_EQ(testing::internal::GetCapturedStderr(), "");
+
+  mj_deleteData(data);
+  mj_deleteModel(model);
+#endif
+}
+
 }  // namespace
 }  // namespace mjpc
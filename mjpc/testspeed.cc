@@ -31,15 +31,6 @@
 
 namespace mjpc {
 
-namespace {
-Task* task;
-void residual_callback(const mjModel* model, mjData* data, int stage) {
-  if (stage == mjSTAGE_ACC) {
-    task->Residual(model, data, data->sensordata);
-  }
-}
-}  // namespace
-
 // Run synchronous planning, print timing info,return 0 if nothing failed.
 double SynchronousPlanningCost(std::string task_name, int planner_thread_count,
                                int steps_per_planning_iteration,
@@ -82,9 +73,8 @@ double SynchronousPlanningCost(std::string task_name, int planner_thread_count,
   agent.Reset(data->ctrl);
   agent.plan_enabled = true;
 
-  // make task available for global callback:
-  task = agent.ActiveTask();
-  mjcb_sensor = &residual_callback;
+  // residuals of the physics model are evaluated by the active task
+  RegisterResidual(model, agent.ActiveTask());
 
   std::cout << " Planning threads:  " << planner_thread_count << "\n";
   ThreadPool pool(planner_thread_count);
@@ -122,9 +112,9 @@ double SynchronousPlanningCost(std::string task_name, int planner_thread_count,
   std::cout << "Average cost per step (lower is better): "
             << total_cost / total_steps << "\n";
 
+  UnregisterResidual(model);
   mj_deleteData(data);
   mj_deleteModel(model);
-  mjcb_sensor = nullptr;
   return total_cost;
 }
 }  // namespace mjpc
@@ -27,7 +27,7 @@ namespace mjpc {
 ABSL_CONST_INIT thread_local int ThreadPool::worker_id_ = -1;
 
 // ThreadPool constructor
-ThreadPool::ThreadPool(int num_threads) : ctr_(0) {
+ThreadPool::ThreadPool(int num_threads) {
   for (int i = 0; i < num_threads; i++) {
     threads_.push_back(std::thread(&ThreadPool::WorkerThread, this, i));
   }
@@ -38,7 +38,7 @@ ThreadPool::~ThreadPool() {
   {
     std::unique_lock<std::mutex> lock(m_);
     for (int i = 0; i < threads_.size(); i++) {
-      queue_.push(nullptr);
+      queue_.push({nullptr, std::this_thread::get_id()});
     }
     cv_in_.notify_all();
   }
@@ -50,7 +50,7 @@ ThreadPool::~ThreadPool() {
 // ThreadPool scheduler
 void ThreadPool::Schedule(std::function<void()> task) {
   std::unique_lock<std::mutex> lock(m_);
-  queue_.push(std::move(task));
+  queue_.push({std::move(task), std::this_thread::get_id()});
   cv_in_.notify_one();
 }
 
@@ -58,19 +58,20 @@ void ThreadPool::Schedule(std::function<void()> task) {
 void ThreadPool::WorkerThread(int i) {
   worker_id_ = i;
   while (true) {
-    auto task = [&]() {
+    auto [task, owner] = [&]() {
       std::unique_lock<std::mutex> lock(m_);
       cv_in_.wait(lock, [&]() { return !queue_.empty(); });
-      std::function<void()> task = std::move(queue_.front());
+      auto task = std::move(queue_.front());
       queue_.pop();
       cv_in_.notify_one();
+      cv_ext_.notify_all();
       return task;
     }();
     if (task == nullptr) {
       {
         std::unique_lock<std::mutex> lock(m_);
-        ++ctr_;
-        cv_ext_.notify_one();
+        ++ctr_[owner];
+        cv_ext_.notify_all();
       }
       break;
     }
@@ -78,8 +79,8 @@ void ThreadPool::WorkerThread(int i) {
 
     {
       std::unique_lock<std::mutex> lock(m_);
-      ++ctr_;
-      cv_ext_.notify_one();
+      ++ctr_[owner];
+      cv_ext_.notify_all();
     }
   }
 }
@@ -22,6 +22,8 @@
 #include <mutex>
 #include <queue>
 #include <thread>
+#include <unordered_map>
+#include <utility>
 #include <vector>
 
 #include <absl/base/attributes.h>
@@ -47,16 +49,35 @@ class ThreadPool {
   // set task for threadpool
   void Schedule(std::function<void()> task);
 
-  // return number of tasks completed
-  std::uint64_t GetCount() { return ctr_; }
+  // return number of completed tasks scheduled by the calling thread. counts
+  // are kept per scheduling thread, so several threads can share the pool.
+  std::uint64_t GetCount() {
+    std::unique_lock<std::mutex> lock(m_);
+    return CountLocked();
+  }
 
-  // reset count to zero
-  void ResetCount() { ctr_ = 0; }
+  // reset count of the calling thread to zero
+  void ResetCount() {
+    std::unique_lock<std::mutex> lock(m_);
+    ctr_.erase(std::this_thread::get_id());
+  }
 
-  // wait for count, then return
+  // wait for count of the calling thread, then return
   void WaitCount(int value) {
     std::unique_lock<std::mutex> lock(m_);
-    cv_ext_.wait(lock, [&]() { return this->GetCount() >= value; });
+    cv_ext_.wait(lock, [&]() { return CountLocked() >= value; });
+  }
+
+  // return number of tasks waiting for a thread
+  int NumQueued() {
+    std::unique_lock<std::mutex> lock(m_);
+    return queue_.size();
+  }
+
+  // wait until fewer than size tasks are waiting for a thread
+  void WaitQueued(int size) {
+    std::unique_lock<std::mutex> lock(m_);
+    cv_ext_.wait(lock, [&]() { return queue_.size() < size; });
   }
 
  private:
@@ -65,6 +86,12 @@ class ThreadPool {
   // execute task with available thread
   void WorkerThread(int i);
 
+  // count of the calling thread, requires m_
+  std::uint64_t CountLocked() const {
+    auto it = ctr_.find(std::this_thread::get_id());
+    return it == ctr_.end() ? 0 : it->second;
+  }
+
   ABSL_CONST_INIT static thread_local int worker_id_;
 
   // ----- members ----- //
@@ -72,8 +99,9 @@ class ThreadPool {
   std::mutex m_;
   std::condition_variable cv_in_;
   std::condition_variable cv_ext_;
-  std::queue<std::function<void()>> queue_;
-  std::uint64_t ctr_;
+  // tasks and the threads that scheduled them
+  std::queue<std::pair<std::function<void()>, std::thread::id>> queue_;
+  std::unordered_map<std::thread::id, std::uint64_t> ctr_;
 };
 
 }  // namespace mjpc
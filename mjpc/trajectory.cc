@@ -21,13 +21,103 @@
 #include <absl/random/distributions.h>
 #include <absl/random/random.h>
 #include <mujoco/mujoco.h>
+#include "mjpc/task.h"
 #include "mjpc/utilities.h"
 
 namespace mjpc {
 namespace {
 // maximum return value
 inline constexpr double kMaxReturnValue = 1.0e6;
-}
+
+// state saved around a step to evaluate the residual at its start
+inline constexpr int kStepState =
+    mjSTATE_TIME | mjSTATE_QPOS | mjSTATE_QVEL | mjSTATE_ACT;
+
+// records residuals and traces during a rollout. when the agent has set a
+// planning residual on the task, the residual is evaluated directly into the
+// trajectory instead of through the sensor callback, and forward passes made
+// only for the residual skip the sensor pipeline if neither the residual nor
+// the traces read sensordata.
+class RolloutEvaluator {
+ public:
+  RolloutEvaluator(const Task* task, const mjModel* model, int dim_residual)
+      : task_(task),
+        model_(model),
+        dim_residual_(dim_residual),
+        residual_fn_(task->PlanningResidual()),
+        skip_sensor_(residual_fn_ && !residual_fn_->ReadsSensorData() &&
+                     task->kinematic_trace) {}
+
+  // step data, recording residual and trace at the state before the step
+  void Step(mjData* data, double* residual, double* trace) const {
+    if (!residual_fn_) {
+      mj_step(model_, data);
+      Record(data, residual, trace);
+      return;
+    }
+
+    // the residual callback is inert in every stage of mj_step
+    DirectResidualScope direct_residual;
+
+    // Runge-Kutta stages move data away from the start state, evaluate there
+    // before stepping
+    if (model_->opt.integrator != mjINT_EULER &&
+        model_->opt.integrator != mjINT_IMPLICIT &&
+        model_->opt.integrator != mjINT_IMPLICITFAST) {
+      Forward(data, residual, trace);
+      mj_step(model_, data);
+      return;
+    }
+
+    // Euler and implicit steps keep the forward quantities and sensordata of
+    // the start state, evaluate with the start state restored
+    mj_markStack(data);
+    int size = mj_stateSize(model_, kStepState);
+    mjtNum* start = mj_stackAllocNum(data, size);
+    mjtNum* end = mj_stackAllocNum(data, size);
+    mj_getState(model_, data, start, kStepState);
+    mj_step(model_, data);
+    mj_getState(model_, data, end, kStepState);
+    mj_setState(model_, data, start, kStepState);
+    residual_fn_->Residual(model_, data, residual);
+    GetTraces(trace, data, task_->trace_adr.data(), task_->num_trace);
+    mj_setState(model_, data, end, kStepState);
+    mj_freeStack(data);
+  }
+
+  // forward data, recording residual and trace at the current state
+  void Forward(mjData* data, double* residual, double* trace) const {
+    if (!residual_fn_) {
+      mj_forward(model_, data);
+      Record(data, residual, trace);
+      return;
+    }
+
+    DirectResidualScope direct_residual;
+    mj_forwardSkip(model_, data, mjSTAGE_NONE, skip_sensor_);
+    residual_fn_->Residual(model_, data, residual);
+    if (skip_sensor_) {
+      GetKinematicTraces(trace, model_, data, task_->trace_id.data(),
+                         task_->num_trace);
+    } else {
+      GetTraces(trace, data, task_->trace_adr.data(), task_->num_trace);
+    }
+  }
+
+ private:
+  // copy residual and traces computed by the sensor pipeline
+  void Record(const mjData* data, double* residual, double* trace) const {
+    mju_copy(residual, data->sensordata, dim_residual_);
+    GetTraces(trace, data, task_->trace_adr.data(), task_->num_trace);
+  }
+
+  const Task* task_;
+  const mjModel* model_;
+  int dim_residual_;
+  const ResidualFn* residual_fn_;
+  bool skip_sensor_;
+};
+}  // namespace
 
 // initialize dimensions
 void Trajectory::Initialize(int dim_state, int dim_action, int dim_residual,
@@ -103,6 +193,10 @@ void Trajectory::NoisyRollout(
     const Task* task, const mjModel* model, mjData* data, const double* state,
     double time, const double* mocap, const double* userdata, double xfrc_std,
     double xfrc_rate, int steps) {
+  // residuals and traces use cached handles
+  NameLookupFreeScope no_name_lookup;
+  RolloutEvaluator evaluator(task, model, dim_residual);
+
   // reset failure flag
   failure = false;
 
@@ -111,30 +205,14 @@ void Trajectory::NoisyRollout(
   int nv = model->nv;
   int na = model->na;
   int nu = model->nu;
-  int nmocap = model->nmocap;
-  int nuserdata = model->nuserdata;
 
   // horizon
   horizon = steps;
 
-  // set mocap
-  for (int i = 0; i < nmocap; i++) {
-    mju_copy(data->mocap_pos + 3 * i, mocap + 7 * i, 3);
-    mju_copy(data->mocap_quat + 4 * i, mocap + 7 * i + 3, 4);
-  }
-
-  // set userdata
-  mju_copy(data->userdata, userdata, nuserdata);
-
-  // set initial state
+  // set initial state, time, mocap and userdata
+  ResetMjData(model, data, state, time, mocap, userdata, data_reset);
   mju_copy(states.data(), state, dim_state);
-  mju_copy(data->qpos, state, nq);
-  mju_copy(data->qvel, state + nq, nv);
-  mju_copy(data->act, state + nq + nv, na);
-
-  // set initial time
   times[0] = time;
-  data->time = time;
 
   absl::BitGen gen;
 
@@ -154,16 +232,9 @@ void Trajectory::NoisyRollout(
       }
     }
 
-    // step
-    mj_step(model, data);
-
-    // record residual
-    mju_copy(DataAt(residual, t * dim_residual), data->sensordata,
-             dim_residual);
-
-    // record trace
-    GetTraces(DataAt(trace, t * 3 * task->num_trace), model, data,
-              task->num_trace);
+    // step, record residual and trace
+    evaluator.Step(data, DataAt(residual, t * dim_residual),
+                   DataAt(trace, t * 3 * task->num_trace));
 
     // check for step warnings
     if ((failure |= CheckWarnings(data))) {
@@ -194,16 +265,9 @@ void Trajectory::NoisyRollout(
     mju_zero(DataAt(actions, (horizon - 1) * dim_action), dim_action);
   }
 
-  // final forward
-  mj_forward(model, data);
-
-  // final residual
-  mju_copy(DataAt(residual, (horizon - 1) * dim_residual), data->sensordata,
-           dim_residual);
-
-  // final trace
-  GetTraces(DataAt(trace, (horizon - 1) * 3 * task->num_trace), model, data,
-            task->num_trace);
+  // final forward, residual and trace
+  evaluator.Forward(data, DataAt(residual, (horizon - 1) * dim_residual),
+                    DataAt(trace, (horizon - 1) * 3 * task->num_trace));
 
   // compute return
   UpdateReturn(task);
@@ -215,6 +279,10 @@ void Trajectory::RolloutDiscrete(
         policy,
     const Task* task, const mjModel* model, mjData* data, const double* state,
     double time, const double* mocap, const double* userdata, int steps) {
+  // residuals and traces use cached handles
+  NameLookupFreeScope no_name_lookup;
+  RolloutEvaluator evaluator(task, model, dim_residual);
+
   // reset failure flag
   failure = false;
 
@@ -223,46 +291,23 @@ void Trajectory::RolloutDiscrete(
   int nv = model->nv;
   int na = model->na;
   int nu = model->nu;
-  int nmocap = model->nmocap;
-  int nuserdata = model->nuserdata;
 
   // horizon
   horizon = steps;
 
-  // set mocap
-  for (int i = 0; i < nmocap; i++) {
-    mju_copy(data->mocap_pos + 3 * i, mocap + 7 * i, 3);
-    mju_copy(data->mocap_quat + 4 * i, mocap + 7 * i + 3, 4);
-  }
-
-  // set userdata
-  mju_copy(data->userdata, userdata, nuserdata);
-
-  // set initial state
+  // set initial state, time, mocap and userdata
+  ResetMjData(model, data, state, time, mocap, userdata, data_reset);
   mju_copy(states.data(), state, dim_state);
-  mju_copy(data->qpos, state, nq);
-  mju_copy(data->qvel, state + nq, nv);
-  mju_copy(data->act, state + nq + nv, na);
-
-  // set initial time
   times[0] = time;
-  data->time = time;
 
   for (int t = 0; t < horizon - 1; t++) {
     // set action
     policy(DataAt(actions, t * nu), DataAt(states, t * dim_state), t);
     mju_copy(data->ctrl, DataAt(actions, t * nu), nu);
 
-    // step
-    mj_step(model, data);
-
-    // record residual
-    mju_copy(DataAt(residual, t * dim_residual), data->sensordata,
-             dim_residual);
-
-    // record trace
-    GetTraces(DataAt(trace, t * 3 * task->num_trace), model, data,
-              task->num_trace);
+    // step, record residual and trace
+    evaluator.Step(data, DataAt(residual, t * dim_residual),
+                   DataAt(trace, t * 3 * task->num_trace));
 
     // check for step warnings
     if ((failure |= CheckWarnings(data))) {
@@ -293,31 +338,93 @@ void Trajectory::RolloutDiscrete(
     mju_zero(DataAt(actions, (horizon - 1) * dim_action), dim_action);
   }
 
-  // final forward
-  mj_forward(model, data);
-
-  // final residual
-  mju_copy(DataAt(residual, (horizon - 1) * dim_residual), data->sensordata,
-           dim_residual);
-
-  // final trace
-  GetTraces(DataAt(trace, (horizon - 1) * 3 * task->num_trace), model, data,
-            task->num_trace);
+  // final forward, residual and trace
+  evaluator.Forward(data, DataAt(residual, (horizon - 1) * dim_residual),
+                    DataAt(trace, (horizon - 1) * 3 * task->num_trace));
 
   // compute return
   UpdateReturn(task);
 }
 
+// simulate segment of a multiple-shooting trajectory
+bool Trajectory::RolloutSegment(
+    std::function<void(double* action, const double* state, double time)>
+        policy,
+    const Task* task, const mjModel* model, mjData* data, const double* state,
+    double time, const double* mocap, const double* userdata, int begin,
+    int end, double* end_state) {
+  // residuals and traces use cached handles
+  NameLookupFreeScope no_name_lookup;
+  RolloutEvaluator evaluator(task, model, dim_residual);
+
+  // model sizes
+  int nq = model->nq;
+  int nv = model->nv;
+  int na = model->na;
+  int nu = model->nu;
+
+  // last segment
+  bool last = end == horizon - 1;
+
+  // set initial state, time, mocap and userdata
+  ResetMjData(model, data, state, time, mocap, userdata, data_reset);
+  mju_copy(DataAt(states, begin * dim_state), state, dim_state);
+  times[begin] = time;
+
+  for (int t = begin; t < end; t++) {
+    // set action
+    policy(DataAt(actions, t * nu), DataAt(states, t * dim_state), data->time);
+    mju_copy(data->ctrl, DataAt(actions, t * nu), nu);
+
+    // step, record residual and trace
+    evaluator.Step(data, DataAt(residual, t * dim_residual),
+                   DataAt(trace, t * 3 * task->num_trace));
+
+    // check for step warnings
+    if (CheckWarnings(data)) {
+      std::cerr << "Rollout divergence at step\n";
+      return false;
+    }
+
+    // record state, next segment's start state is not overwritten
+    if (t + 1 < end || last) {
+      mju_copy(DataAt(states, (t + 1) * dim_state), data->qpos, nq);
+      mju_copy(DataAt(states, (t + 1) * dim_state + nq), data->qvel, nv);
+      mju_copy(DataAt(states, (t + 1) * dim_state + nq + nv), data->act, na);
+      times[t + 1] = data->time;
+    }
+  }
+
+  // state at end of segment
+  mju_copy(end_state, data->qpos, nq);
+  mju_copy(end_state + nq, data->qvel, nv);
+  mju_copy(end_state + nq + nv, data->act, na);
+
+  if (!last) return true;
+
+  // copy final action
+  if (horizon > 1) {
+    mju_copy(DataAt(actions, (horizon - 1) * dim_action),
+             DataAt(actions, (horizon - 2) * dim_action), dim_action);
+  } else {
+    mju_zero(DataAt(actions, (horizon - 1) * dim_action), dim_action);
+  }
+
+  // final forward, residual and trace
+  evaluator.Forward(data, DataAt(residual, (horizon - 1) * dim_residual),
+                    DataAt(trace, (horizon - 1) * 3 * task->num_trace));
+
+  return true;
+}
+
 // calculates total_return and costs
 void Trajectory::UpdateReturn(const Task* task) {
-  // reset
-  total_return = 0;
+  // compute stage costs
+  task->CostValues(costs.data(), residual.data(), horizon, task->num_residual);
 
+  // total return
+  total_return = 0;
   for (int t = 0; t < horizon; t++) {
-    // compute stage cost
-    costs[t] = task->CostValue(DataAt(residual, t * task->num_residual));
-
-    // update total return
     total_return += costs[t];
   }
 
@@ -20,6 +20,7 @@
 
 #include <mujoco/mujoco.h>
 #include "mjpc/task.h"
+#include "mjpc/utilities.h"
 
 namespace mjpc {
 
@@ -70,6 +71,21 @@ class Trajectory {
       const Task* task, const mjModel* model, mjData* data, const double* state,
       double time, const double* mocap, const double* userdata, int steps);
 
+  // simulate segment [begin, end] of a multiple-shooting trajectory starting
+  // from state at time; the state reached at end is written to end_state
+  // (dim_state) and recorded in states only for the final segment
+  // (end == horizon - 1). returns false on divergence. segments can be
+  // simulated concurrently, failure and total_return are not modified.
+  bool RolloutSegment(
+      std::function<void(double* action, const double* state, double time)>
+          policy,
+      const Task* task, const mjModel* model, mjData* data, const double* state,
+      double time, const double* mocap, const double* userdata, int begin,
+      int end, double* end_state);
+
+  // calculates total_return and costs
+  void UpdateReturn(const Task* task);
+
   // ----- members ----- //
   int horizon;                   // trajectory length
   int dim_state;                 // states dimension
@@ -85,9 +101,8 @@ class Trajectory {
   double total_return;           // (1)
   bool failure;                  // true if last rollout had a warning
 
- private:
-  // calculates total_return and costs
-  void UpdateReturn(const Task* task);
+  // reset of the reused mjData at the start of a rollout
+  MjDataReset data_reset = MjDataReset::kStateOnly;
 };
 
 }  // namespace mjpc
@@ -165,6 +165,7 @@ double ResidualParameterFromSelection(const mjModel* m, std::string_view name,
 // get sensor data using string
 double* SensorByName(const mjModel* m, const mjData* d,
                      const std::string& name) {
+  CheckNameLookup(name);
   int id = mj_name2id(m, mjOBJ_SENSOR, name.c_str());
   if (id == -1) {
     std::cerr << "sensor \"" << name << "\" not found.\n";
@@ -174,6 +175,35 @@ double* SensorByName(const mjModel* m, const mjData* d,
   }
 }
 
+// get sensor data address using string
+int SensorAdrByName(const mjModel* m, const std::string& name) {
+  CheckNameLookup(name);
+  int id = mj_name2id(m, mjOBJ_SENSOR, name.c_str());
+  if (id == -1) {
+    mju_error_s("sensor '%s' not found", name.c_str());
+  }
+  return m->sensor_adr[id];
+}
+
+namespace {
+// number of open NameLookupFreeScopes on this thread
+thread_local int name_lookup_free_depth = 0;
+}  // namespace
+
+NameLookupFreeScope::NameLookupFreeScope() { name_lookup_free_depth++; }
+
+NameLookupFreeScope::~NameLookupFreeScope() { name_lookup_free_depth--; }
+
+// report a name lookup made inside a NameLookupFreeScope
+void CheckNameLookup(std::string_view name) {
+#ifndef NDEBUG
+  if (name_lookup_free_depth > 0) {
+    std::cerr << "name lookup \"" << name
+              << "\" during rollout; resolve it once in ResetLocked\n";
+  }
+#endif
+}
+
 // get default residual parameter data using string
 double DefaultParameterValue(const mjModel* model, std::string_view name) {
   int id =
@@ -187,6 +217,7 @@ double DefaultParameterValue(const mjModel* model, std::string_view name) {
 
 // get index to residual parameter data using string
 int ParameterIndex(const mjModel* model, std::string_view name) {
+  CheckNameLookup(name);
   int id =
       mj_name2id(model, mjOBJ_NUMERIC, absl::StrCat("residual_", name).c_str());
 
@@ -211,6 +242,7 @@ double DefaultResidualSelection(const mjModel* m, int numeric_index) {
 }
 
 int CostTermByName(const mjModel* m, const std::string& name) {
+  CheckNameLookup(name);
   int id = mj_name2id(m, mjOBJ_SENSOR, name.c_str());
   if (id == -1 || m->sensor_type[id] != mjSENS_USER) {
     std::cerr << "cost term \"" << name << "\" not found.\n";
@@ -266,9 +298,95 @@ void GetTraces(double* traces, const mjModel* m, const mjData* d,
   }
 }
 
+// get traces from sensor addresses
+void GetTraces(double* traces, const mjData* d, const int* trace_adr,
+               int num_trace) {
+  for (int i = 0; i < num_trace; i++) {
+    if (trace_adr[i] >= 0) {
+      mju_copy(traces + 3 * i, d->sensordata + trace_adr[i], 3);
+    }
+  }
+}
+
+// world-frame framepos sensor
+bool KinematicTrace(const mjModel* m, int sensor_id) {
+  if (m->sensor_type[sensor_id] != mjSENS_FRAMEPOS) return false;
+  if (m->sensor_refid[sensor_id] >= 0) return false;
+  if (m->sensor_cutoff[sensor_id] > 0) return false;
+  switch (m->sensor_objtype[sensor_id]) {
+    case mjOBJ_BODY:
+    case mjOBJ_XBODY:
+    case mjOBJ_GEOM:
+    case mjOBJ_SITE:
+    case mjOBJ_CAMERA:
+      return true;
+    default:
+      return false;
+  }
+}
+
+// get traces from kinematics
+void GetKinematicTraces(double* traces, const mjModel* m, const mjData* d,
+                        const int* trace_id, int num_trace) {
+  for (int i = 0; i < num_trace; i++) {
+    int id = trace_id[i];
+    if (id < 0) continue;
+    int objid = m->sensor_objid[id];
+    const double* pos;
+    switch (m->sensor_objtype[id]) {
+      case mjOBJ_BODY:
+        pos = d->xipos + 3 * objid;
+        break;
+      case mjOBJ_XBODY:
+        pos = d->xpos + 3 * objid;
+        break;
+      case mjOBJ_GEOM:
+        pos = d->geom_xpos + 3 * objid;
+        break;
+      case mjOBJ_SITE:
+        pos = d->site_xpos + 3 * objid;
+        break;
+      case mjOBJ_CAMERA:
+        pos = d->cam_xpos + 3 * objid;
+        break;
+      default:
+        mju_error("trace %d is not a kinematic trace", i);
+        return;
+    }
+    mju_copy3(traces + 3 * i, pos);
+  }
+}
+
+// reset data to state, time, mocap and userdata
+void ResetMjData(const mjModel* model, mjData* data, const double* state,
+                 double time, const double* mocap, const double* userdata,
+                 MjDataReset reset) {
+  if (reset == MjDataReset::kFull) {
+    mj_resetData(model, data);
+  }
+
+  // mocap
+  for (int i = 0; i < model->nmocap; i++) {
+    mju_copy(data->mocap_pos + 3 * i, mocap + 7 * i, 3);
+    mju_copy(data->mocap_quat + 4 * i, mocap + 7 * i + 3, 4);
+  }
+
+  // userdata
+  mju_copy(data->userdata, userdata, model->nuserdata);
+
+  // state
+  mju_copy(data->qpos, state, model->nq);
+  mju_copy(data->qvel, state + model->nq, model->nv);
+  mju_copy(data->act, state + model->nq + model->nv, model->na);
+
+  // time
+  data->time = time;
+}
+
 // get keyframe `qpos` data using string
 double* KeyQPosByName(const mjModel* m, const mjData* d,
                       const std::string& name) {
+  CheckNameLookup(name);
   int id = mj_name2id(m, mjOBJ_KEY, name.c_str());
   if (id == -1) {
     return nullptr;
@@ -1147,6 +1265,24 @@ void BlockFromMatrix(double* block, const double* mat, int rb, int cb, int rm,
   }
 }
 
+// get block (size: rb x cb) from symmetric band matrix (lower band storage,
+// bandwidth nband) given block upper row and left column indices (ri, ci)
+void BlockFromBand(double* block, const double* band, int nband, int rb,
+                   int cb, int ri, int ci) {
+  for (int i = 0; i < rb; i++) {
+    for (int j = 0; j < cb; j++) {
+      // lower triangle element
+      int row = std::max(ri + i, ci + j);
+      int col = std::min(ri + i, ci + j);
+      int diff = row - col;
+
+      // elements outside the band are zero
+      block[i * cb + j] =
+          diff < nband ? band[row * nband + nband - 1 - diff] : 0.0;
+    }
+  }
+}
+
 // differentiate mju_subQuat wrt qa, qb
 void DifferentiateSubQuat(double jaca[9], double jacb[9], const double qa[4],
                           const double qb[4]) {
@@ -1413,6 +1549,39 @@ void Inverse3(double* res, const double* mat) {
   mju_scl(res, res, 1.0 / det, 9);
 }
 
+// lower triangular factor with positive diagonal: res * res' = mat * mat'
+void TriangularFactor(double* res, double* mat, int n, int m,
+                      double* scratch) {
+  // reflect columns k, ..., m - 1 to zero row k right of the diagonal
+  for (int k = 0; k < n; k++) {
+    double* row = mat + k * m + k;
+    int nv = m - k;
+    double sigma = mju_norm(row, nv);
+    if (sigma == 0.0) continue;
+
+    // Householder vector: v = x - alpha * e0
+    double alpha = row[0] > 0.0 ? -sigma : sigma;
+    mju_copy(scratch, row, nv);
+    scratch[0] -= alpha;
+    double vv = mju_dot(scratch, scratch, nv);
+
+    // rows k, ..., n - 1: x -= 2 (x' v) / (v' v) v
+    for (int i = k; i < n; i++) {
+      double* x = mat + i * m + k;
+      mju_addToScl(x, scratch, -2.0 * mju_dot(x, scratch, nv) / vv, nv);
+    }
+  }
+
+  // lower triangle, columns with negative diagonal are flipped
+  mju_zero(res, n * n);
+  for (int i = 0; i < n; i++) {
+    for (int j = 0; j <= i; j++) {
+      double sign = mat[j * m + j] < 0.0 ? -1.0 : 1.0;
+      res[i * n + j] = sign * mat[i * m + j];
+    }
+  }
+}
+
 // condition matrix: res = mat11 - mat10 * mat00 \ mat10^T; return rank of
 // mat00
 // TODO(taylor): thread
@@ -94,6 +94,23 @@ void Clamp(double* x, const double* bounds, int n);
 double* SensorByName(const mjModel* m, const mjData* d,
                      const std::string& name);
 
+// get sensor data address using string, mju_error if not found; resolve once
+// (e.g., in ResetLocked) and read d->sensordata + address in residuals
+int SensorAdrByName(const mjModel* m, const std::string& name);
+
+// scope in which name lookups are flagged on the calling thread in debug
+// builds; opened by rollouts, where residuals must use cached handles
+class NameLookupFreeScope {
+ public:
+  NameLookupFreeScope();
+  ~NameLookupFreeScope();
+  NameLookupFreeScope(const NameLookupFreeScope&) = delete;
+  NameLookupFreeScope& operator=(const NameLookupFreeScope&) = delete;
+};
+
+// report a name lookup made inside a NameLookupFreeScope (debug builds only)
+void CheckNameLookup(std::string_view name);
+
 double DefaultParameterValue(const mjModel* model, std::string_view name);
 
 int ParameterIndex(const mjModel* model, std::string_view name);
@@ -110,6 +127,36 @@ void CheckSensorDim(const mjModel* model, int residual_size);
 void GetTraces(double* traces, const mjModel* m, const mjData* d,
                int num_trace);
 
+// get traces from sensor addresses (trace_adr: num_trace, -1 if missing)
+void GetTraces(double* traces, const mjData* d, const int* trace_adr,
+               int num_trace);
+
+// returns true if the sensor is a world-frame framepos sensor, whose value can
+// be read from kinematics without evaluating sensors
+bool KinematicTrace(const mjModel* m, int sensor_id);
+
+// get traces from kinematics (trace_id: num_trace sensor ids, -1 if missing),
+// every present trace must satisfy KinematicTrace
+void GetKinematicTraces(double* traces, const mjModel* m, const mjData* d,
+                        const int* trace_id, int num_trace);
+
+// how a reused mjData is reset before simulating from a state
+//   kStateOnly: writes only what a rollout reads, qpos, qvel, act, mocap,
+//     userdata and time. everything else, e.g. the solver's qacc_warmstart,
+//     stays warm from the previous simulation on the same mjData.
+//   kFull: calls mj_resetData first, so the result doesn't depend on earlier
+//     use of the mjData, at the cost of touching all of it.
+enum class MjDataReset {
+  kStateOnly = 0,
+  kFull,
+};
+
+// reset data to state (nq + nv + na), time, mocap (7 x nmocap, position and
+// quaternion) and userdata (nuserdata)
+void ResetMjData(const mjModel* model, mjData* data, const double* state,
+                 double time, const double* mocap, const double* userdata,
+                 MjDataReset reset = MjDataReset::kStateOnly);
+
 // get keyframe `qpos` data using string
 double* KeyQPosByName(const mjModel* m, const mjData* d,
                       const std::string& name);
@@ -356,6 +403,11 @@ void AddBlockInMatrix(double* mat, const double* block, double scale, int rm,
 void BlockFromMatrix(double* block, const double* mat, int rb, int cb, int rm,
                      int cm, int ri, int ci);
 
+// get block (size: rb x cb) from symmetric band matrix (lower band storage,
+// bandwidth nband) given block upper row and left column indices (ri, ci)
+void BlockFromBand(double* block, const double* band, int nband, int rb,
+                   int cb, int ri, int ci);
+
 // differentiate mju_subQuat wrt qa, qb
 void DifferentiateSubQuat(double jaca[9], double jacb[9], const double qa[4],
                           const double qb[4]);
@@ -404,6 +456,12 @@ double Determinant3(const double* mat);
 // inverse of 3x3 matrix
 void Inverse3(double* res, const double* mat);
 
+// lower triangular factor with positive diagonal: res * res' = mat * mat',
+// res (n x n), mat (n x m) with m >= n. mat is overwritten by Householder
+// reflections of its columns, scratch (m)
+void TriangularFactor(double* res, double* mat, int n, int m,
+                      double* scratch);
+
 // condition matrix: res = mat11 - mat10 * mat00 \ mat10^T; return rank of mat00
 // TODO(taylor): thread
 void ConditionMatrix(double* res, const double* mat, double* mat00,